@@ -7,9 +7,17 @@ See the file COPYING for details.
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <pthread.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ALLPAIRS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 #include "allpairs_compare.h"
+#include "buffer.h"
 #include "path.h"
 #include "stringtools.h"
 #include "text_list.h"
@@ -19,53 +27,283 @@ See the file COPYING for details.
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static int swalign_min_score = 0;
+static pthread_key_t swalign_key;
+static pthread_once_t swalign_once = PTHREAD_ONCE_INIT;
+
+static pthread_key_t output_key;
+static pthread_once_t output_once = PTHREAD_ONCE_INIT;
+
+static void output_key_create()
+{
+	pthread_key_create(&output_key, 0);
+}
+
+void allpairs_compare_set_output( buffer_t *b )
+{
+	pthread_once(&output_once, output_key_create);
+	pthread_setspecific(output_key, b);
+}
+
+static buffer_t * allpairs_compare_output()
+{
+	pthread_once(&output_once, output_key_create);
+	return pthread_getspecific(output_key);
+}
+
+void allpairs_compare_printf( const char *fmt, ... )
+{
+	va_list args;
+	va_start(args, fmt);
+
+	buffer_t *b = allpairs_compare_output();
+	if(b) {
+		buffer_putvfstring(b, fmt, args);
+	} else {
+		pthread_mutex_lock(&mutex);
+		vprintf(fmt, args);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	va_end(args);
+}
+
 /*
 If you have a custom comparison function, implement it in allpairs_compare_CUSTOM.
 Arguments data1 and data2 point to the objects to be compared.
 Arguments size1 and size2 are the length of each object in bytes.
 When the comparison is complete, output name1, name2, and the result of the comparison.
 The result may take any form that you find useful.
-Note that pthread_mutex_lock/unlock is needed around the printf for safety in a multithreaded program.
+Use allpairs_compare_printf for the output, so that each thread writes into its own buffer.
 */
 
 static void allpairs_compare_CUSTOM( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
 {
 	int result = 5;
 
-	pthread_mutex_lock(&mutex);
-	printf("%s\t%s\t%d\n",name1,name2,result);
-	pthread_mutex_unlock(&mutex);
+	allpairs_compare_printf("%s\t%s\t%d\n",name1,name2,result);
 }
 
 /*
-This is a simple bitwise comparison function that just counts up
-the number of bytes in each object that are different.
+The kernels of BITWISE and IRIS count bytes and bits sixteen or thirty-two
+at a time when the processor supports it.  They are chosen once, when the
+comparison function is looked up.
 */
 
-static void allpairs_compare_BITWISE( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
+typedef unsigned int (*bytes_differ_t) ( const char *a, const char *b, unsigned int n );
+typedef void (*bits_differ_t) ( const unsigned char *code1, const unsigned char *mask1, const unsigned char *code2, const unsigned char *mask2, unsigned int n, unsigned int *distance, unsigned int *total );
+
+static unsigned int bytes_differ_scalar( const char *a, const char *b, unsigned int n )
 {
 	unsigned int i, count = 0;
-	unsigned int minsize;
-
-	minsize = size1 - size2 ? size2 : size1;
 
-	count = 0;
-	for(i = 0; i < minsize; i++) {
-		if(data1[i] != data2[i]) {
+	for(i = 0; i < n; i++) {
+		if(a[i] != b[i]) {
 			count++;
 		}
 	}
 
-	pthread_mutex_lock(&mutex);
-	printf("%s\t%s\t%d\n",name1,name2,count);
-	pthread_mutex_unlock(&mutex);
+	return count;
+}
+
+/* Inlined into each kernel, so that __builtin_popcount is compiled for the target of the kernel. */
+
+static inline __attribute__((always_inline)) void bits_differ_generic( const unsigned char *code1, const unsigned char *mask1, const unsigned char *code2, const unsigned char *mask2, unsigned int n, unsigned int *distance, unsigned int *total )
+{
+	unsigned int i;
+	unsigned int d = 0, t = 0;
+
+	for(i = 0; i + 8 <= n; i += 8) {
+		uint64_t c1, m1, c2, m2;
+		memcpy(&c1, code1 + i, 8);
+		memcpy(&m1, mask1 + i, 8);
+		memcpy(&c2, code2 + i, 8);
+		memcpy(&m2, mask2 + i, 8);
+		d += __builtin_popcountll((c1 ^ c2) & m1 & m2);
+		t += __builtin_popcountll(m1 & m2);
+	}
+
+	for(; i < n; i++) {
+		d += __builtin_popcount((code1[i] ^ code2[i]) & mask1[i] & mask2[i]);
+		t += __builtin_popcount(mask1[i] & mask2[i]);
+	}
+
+	*distance = d;
+	*total = t;
+}
+
+static void bits_differ_scalar( const unsigned char *code1, const unsigned char *mask1, const unsigned char *code2, const unsigned char *mask2, unsigned int n, unsigned int *distance, unsigned int *total )
+{
+	bits_differ_generic(code1, mask1, code2, mask2, n, distance, total);
+}
+
+#ifdef ALLPAIRS_X86_KERNELS
+
+/* Equal bytes are counted down in byte lanes, which are summed every 255 iterations, before they overflow. */
+
+__attribute__((target("sse2")))
+static unsigned int bytes_differ_sse2( const char *a, const char *b, unsigned int n )
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i total = zero;
+	unsigned int i = 0;
+
+	while(i + 16 <= n) {
+		__m128i equal = zero;
+		unsigned int stop = i + 255 * 16 < n ? i + 255 * 16 : n;
+		for(; i + 16 <= stop; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+			__m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+			equal = _mm_sub_epi8(equal, _mm_cmpeq_epi8(x, y));
+		}
+		total = _mm_add_epi64(total, _mm_sad_epu8(equal, zero));
+	}
+
+	unsigned int same = _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total));
+
+	return i - same + bytes_differ_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static unsigned int bytes_differ_avx2( const char *a, const char *b, unsigned int n )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i total = zero;
+	unsigned int i = 0;
+
+	while(i + 32 <= n) {
+		__m256i equal = zero;
+		unsigned int stop = i + 255 * 32 < n ? i + 255 * 32 : n;
+		for(; i + 32 <= stop; i += 32) {
+			__m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+			__m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+			equal = _mm256_sub_epi8(equal, _mm256_cmpeq_epi8(x, y));
+		}
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(equal, zero));
+	}
+
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, total);
+	unsigned int same = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	return i - same + bytes_differ_sse2(a + i, b + i, n - i);
+}
+
+/* The same as the scalar version, but with the popcnt instruction. */
+
+__attribute__((target("popcnt")))
+static void bits_differ_popcnt( const unsigned char *code1, const unsigned char *mask1, const unsigned char *code2, const unsigned char *mask2, unsigned int n, unsigned int *distance, unsigned int *total )
+{
+	bits_differ_generic(code1, mask1, code2, mask2, n, distance, total);
+}
+
+/* Bits are counted with a lookup table of the nibbles in each byte lane. */
+
+__attribute__((target("avx2")))
+static __m256i popcount_bytes_avx2( __m256i v )
+{
+	const __m256i table = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+
+	__m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+	__m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+
+	return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static void bits_differ_avx2( const unsigned char *code1, const unsigned char *mask1, const unsigned char *code2, const unsigned char *mask2, unsigned int n, unsigned int *distance, unsigned int *total )
+{
+	__m256i d = _mm256_setzero_si256();
+	__m256i t = _mm256_setzero_si256();
+	unsigned int i;
+
+	for(i = 0; i + 32 <= n; i += 32) {
+		__m256i c1 = _mm256_loadu_si256((const __m256i *) (code1 + i));
+		__m256i m1 = _mm256_loadu_si256((const __m256i *) (mask1 + i));
+		__m256i c2 = _mm256_loadu_si256((const __m256i *) (code2 + i));
+		__m256i m2 = _mm256_loadu_si256((const __m256i *) (mask2 + i));
+		__m256i m = _mm256_and_si256(m1, m2);
+		d = _mm256_add_epi64(d, popcount_bytes_avx2(_mm256_and_si256(_mm256_xor_si256(c1, c2), m)));
+		t = _mm256_add_epi64(t, popcount_bytes_avx2(m));
+	}
+
+	uint64_t dl[4], tl[4];
+	_mm256_storeu_si256((__m256i *) dl, d);
+	_mm256_storeu_si256((__m256i *) tl, t);
+
+	bits_differ_popcnt(code1 + i, mask1 + i, code2 + i, mask2 + i, n - i, distance, total);
+
+	*distance += dl[0] + dl[1] + dl[2] + dl[3];
+	*total += tl[0] + tl[1] + tl[2] + tl[3];
+}
+
+#endif
+
+static bytes_differ_t bytes_differ = bytes_differ_scalar;
+static bits_differ_t bits_differ = bits_differ_scalar;
+
+static void allpairs_compare_kernels_select()
+{
+#ifdef ALLPAIRS_X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		bytes_differ = bytes_differ_avx2;
+		bits_differ = bits_differ_avx2;
+	} else {
+		if(__builtin_cpu_supports("sse2")) {
+			bytes_differ = bytes_differ_sse2;
+		}
+		if(__builtin_cpu_supports("popcnt")) {
+			bits_differ = bits_differ_popcnt;
+		}
+	}
+#endif
+}
+
+/*
+This is a simple bitwise comparison function that just counts up
+the number of bytes in each object that are different.
+*/
+
+static void allpairs_compare_BITWISE( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
+{
+	unsigned int minsize = size1 < size2 ? size1 : size2;
+	unsigned int count = bytes_differ(data1, data2, minsize);
+
+	allpairs_compare_printf("%s\t%s\t%d\n",name1,name2,count);
 }
 
 /*
 This function aligns two DNA sequences using the Smith-Waterman algorithm,
-and if the quality is sufficiently good, displays the alignment.
+and if the score is sufficiently good, displays the alignment.
+Each thread keeps its own alignment workspace, so that the buffers are
+reused from one pair to the next.
 */
 
+static void swalign_workspace_delete( void *w )
+{
+	align_workspace_delete(w);
+}
+
+static void swalign_key_create()
+{
+	pthread_key_create(&swalign_key, swalign_workspace_delete);
+}
+
+static struct align_workspace * swalign_workspace()
+{
+	pthread_once(&swalign_once, swalign_key_create);
+
+	struct align_workspace *w = pthread_getspecific(swalign_key);
+	if(!w) {
+		w = align_workspace_create(0);
+		pthread_setspecific(swalign_key, w);
+	}
+
+	return w;
+}
+
 static void allpairs_compare_SWALIGN( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
 {
 	char *stra = strdup(data1);
@@ -74,17 +312,29 @@ static void allpairs_compare_SWALIGN( const char *name1, const char *data1, int
 	stra[size1-1] = 0;
 	strb[size2-1] = 0;
 
-	struct matrix *m = matrix_create(size1-1,size2-1);
-	struct alignment *aln = align_smith_waterman(m,stra,strb);
-
-	pthread_mutex_lock(&mutex);
-	printf("> %s %s\n",name1,name2);
-	alignment_print(stdout,stra,strb,aln);
-	pthread_mutex_unlock(&mutex);
+	struct alignment *aln = align_smith_waterman_threshold(swalign_workspace(),stra,strb,swalign_min_score);
+
+	if(aln) {
+		buffer_t *b = allpairs_compare_output();
+		if(b) {
+			char *text;
+			size_t length;
+			FILE *stream = open_memstream(&text, &length);
+			fprintf(stream,"> %s %s\n",name1,name2);
+			alignment_print(stream,stra,strb,aln);
+			fclose(stream);
+			buffer_putlstring(b, text, length);
+			free(text);
+		} else {
+			pthread_mutex_lock(&mutex);
+			printf("> %s %s\n",name1,name2);
+			alignment_print(stdout,stra,strb,aln);
+			pthread_mutex_unlock(&mutex);
+		}
+	}
 
 	free(stra);
 	free(strb);
-	matrix_delete(m);
 	alignment_delete(aln);
 }
 
@@ -92,115 +342,62 @@ static void allpairs_compare_SWALIGN( const char *name1, const char *data1, int
 This function compares two iris templates in the binary format used by the Computer Vision Research Lab at the University of Notre Dame.
 */
 
-static void allpairs_compare_IRIS( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
+/*
+Parse the header of an iris template, and find its code and mask.
+Returns the number of bytes of each, or -1 if the template is malformed.
+*/
+
+static int iris_template_parse( const char *data, int size, const unsigned char **code, const unsigned char **mask )
 {
-	int i, j, count = 0;
-	int size, band, inner, outer, quality;
-	const int power2[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	int bits, band, inner, outer, quality;
+	char header[256];
 
-	// Start processing data in mmap1
-	sscanf(data1, "%d %d %d %d %d", &size, &band, &inner, &outer, &quality);
-	data1 = strchr(data1, '\n');
+	const char *end = memchr(data, '\n', size);
+	if(!end || end - data >= (int) sizeof(header))
+		return -1;
 
-	// Let data1 points to the start of code data
-	data1++;
+	memcpy(header, data, end - data);
+	header[end - data] = 0;
 
-	if(size1 - (data1 - (char *) data1) != size / 8 * 2) {
-		fprintf(stderr, "allpairs_multicore: Image 1 data size error!\n");
-		exit(1);
-	}
+	if(sscanf(header, "%d %d %d %d %d", &bits, &band, &inner, &outer, &quality) != 5)
+		return -1;
 
-	int code1[size];
-	int mask1[size];
-
-	count = 0;
-	for(i = 0; i < size / 8; i++) {
-		for(j = 0; j < 8; j++) {
-			if(data1[i] & power2[j]) {
-				code1[count] = 1;
-				count++;
-			} else {
-				code1[count] = 0;
-				count++;
-			}
-		}
-	}
+	int bytes = bits / 8;
+	if(size - (end + 1 - data) != bytes * 2)
+		return -1;
 
-	// Let data1 now points to the start of mask data
-	data1 += i;
-
-	count = 0;
-	for(i = 0; i < size / 8; i++) {
-		for(j = 0; j < 8; j++) {
-			if(data1[i] & power2[j]) {
-				mask1[count] = 1;
-				count++;
-			} else {
-				mask1[count] = 0;
-				count++;
-			}
-		}
-	}
+	*code = (const unsigned char *) end + 1;
+	*mask = *code + bytes;
 
-	sscanf(data2, "%d %d %d %d %d", &size, &band, &inner, &outer, &quality);
-	data2 = strchr(data2, '\n');
+	return bytes;
+}
 
-	// Let data2 points to the start of code data
-	data2++;
+static void allpairs_compare_IRIS( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 )
+{
+	const unsigned char *code1, *mask1, *code2, *mask2;
+	unsigned int distance, total;
 
-	if(size2 - (data2 - (char *) data2) != size / 8 * 2) {
-		fprintf(stderr, "allpairs_multicore: Image 2 data size error!\n");
+	int bytes1 = iris_template_parse(data1, size1, &code1, &mask1);
+	if(bytes1 < 0) {
+		fprintf(stderr, "allpairs_multicore: Image 1 data size error!\n");
 		exit(1);
 	}
 
-	int code2[size];
-	int mask2[size];
-
-	count = 0;
-	for(i = 0; i < size / 8; i++) {
-		for(j = 0; j < 8; j++) {
-			if(data2[i] & power2[j]) {
-				code2[count] = 1;
-				count++;
-			} else {
-				code2[count] = 0;
-				count++;
-			}
-		}
+	int bytes2 = iris_template_parse(data2, size2, &code2, &mask2);
+	if(bytes2 < 0) {
+		fprintf(stderr, "allpairs_multicore: Image 2 data size error!\n");
+		exit(1);
 	}
 
-	// Let data1 now points to the start of mask data
-	data2 += i;
-
-	count = 0;
-	for(i = 0; i < size / 8; i++) {
-		for(j = 0; j < 8; j++) {
-			if(data2[i] & power2[j]) {
-				mask2[count] = 1;
-				count++;
-			} else {
-				mask2[count] = 0;
-				count++;
-			}
-		}
-	}
+	/* the distance is the fraction of differing bits, of those valid in both masks. */
+	bits_differ(code1, mask1, code2, mask2, bytes1 < bytes2 ? bytes1 : bytes2, &distance, &total);
 
-	int codes[size];
-	int masks[size];
-	int results[size];
-	int distance = 0;
-	int total = 0;
-	for(i = 0; i < size; i++) {
-		codes[i] = code1[i] ^ code2[i];
-		masks[i] = mask1[i] & mask2[i];
-		results[i] = codes[i] & masks[i];
-		distance = distance + results[i];
-		total = total + masks[i];
-	}
+	allpairs_compare_printf("%s\t%s\t%lf\n",name1,name2,distance/(double)total);
+}
 
-	pthread_mutex_lock(&mutex);
-	printf("%s\t%s\t%lf\n",name1,name2,distance/(double)total);
-	pthread_mutex_unlock(&mutex);
+void allpairs_compare_set_min_score( int score )
+{
+	swalign_min_score = score;
 }
 
 allpairs_compare_t allpairs_compare_function_get( const char *name )
@@ -208,10 +405,12 @@ allpairs_compare_t allpairs_compare_function_get( const char *name )
 	if(!strcmp(name,"CUSTOM")) {
 		return allpairs_compare_CUSTOM;
 	} else if(!strcmp(name,"BITWISE")) {
+		allpairs_compare_kernels_select();
 		return allpairs_compare_BITWISE;
 	} else if(!strcmp(name,"SWALIGN")) {
 		return allpairs_compare_SWALIGN;
 	} else if(!strcmp(name,"IRIS")) {
+		allpairs_compare_kernels_select();
 		return allpairs_compare_IRIS;
 	} else {
 		return 0;
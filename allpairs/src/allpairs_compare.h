@@ -7,10 +7,20 @@ See the file COPYING for details.
 #ifndef ALLPAIRS_COMPARE_H
 #define ALLPAIRS_COMPARE_H
 
+#include "buffer.h"
+
 typedef void (*allpairs_compare_t) ( const char *name1, const char *data1, int size1, const char *name2, const char *data2, int size2 );
 
 allpairs_compare_t allpairs_compare_function_get( const char *name );
 
+/* Comparison functions display their results with allpairs_compare_printf.
+The results go to the buffer set by the calling thread with allpairs_compare_set_output, or to stdout if none. */
+void allpairs_compare_printf( const char *fmt, ... ) __attribute__ (( format(printf,1,2) ));
+void allpairs_compare_set_output( buffer_t *b );
+
+/* Pairs with a lower Smith-Waterman score are not displayed by SWALIGN. */
+void allpairs_compare_set_min_score( int score );
+
 struct text_list *allpairs_remote_create(const char *path, const char *set);
 
 #endif
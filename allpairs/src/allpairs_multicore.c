@@ -13,9 +13,11 @@ See the file COPYING for details.
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <pthread.h>
 
 #include "allpairs_compare.h"
+#include "allpairs_pack.h"
 
 #include "cctools.h"
 #include "debug.h"
@@ -27,6 +29,8 @@ See the file COPYING for details.
 #include "full_io.h"
 #include "getopt_aux.h"
 #include "rmonitor_poll.h"
+#include "buffer.h"
+#include "timestamp.h"
 
 static const char *progname = "allpairs_multicore";
 static const char *extra_arguments = "";
@@ -39,11 +43,24 @@ static int index_array[2];
 enum {
 	LONG_OPT_SYMMETRIC=UCHAR_MAX+1,
 	LONG_OPT_INDEX,
+	LONG_OPT_MIN_SCORE,
+	LONG_OPT_PACK,
+};
+
+/*
+A set is either a list of file names, or a pack of the objects
+mapped into memory with allpairs_pack.
+*/
+
+struct set {
+	struct text_list *list;
+	struct allpairs_pack *pack;
 };
 
 static void show_help(const char *cmd)
 {
 	fprintf(stdout, "Usage: %s [options] <set A> <set B> <compare program>\n", cmd);
+	fprintf(stdout, "   or: %s --pack <set> <pack file>\n", cmd);
 	fprintf(stdout, "where options are:\n");
 	fprintf(stdout, " %-30s Block size: number of items to hold in memory at once. (default: 50%% of RAM\n", "-b,--block-size=<items>");
 	fprintf(stdout, " %-30s Number of cores to be used. (default: # of cores in machine)\n", "-c,--cores=<cores>");
@@ -52,6 +69,8 @@ static void show_help(const char *cmd)
 	/* --index and --symmetric can not be used concurrently. */
 	fprintf(stdout, " %-30s Specify the indexes of a matrix (used by allpairs_master to specify the indexes of the submatrix for each task).\n", "   --index=\"<xstart> <ystart>\"");
 	fprintf(stdout, " %-30s Compute half of a symmetric matrix.\n", "   --symmetric");
+	fprintf(stdout, " %-30s With SWALIGN, only display alignments with at least this score.\n", "   --min-score=<score>");
+	fprintf(stdout, " %-30s Write the objects of a set into a single pack file, which can be given as set A or B.\n", "   --pack");
 	fprintf(stdout, " %-30s Show program version.\n", "-v,--version");
 	fprintf(stdout, " %-30s Display this message.\n", "-h,--help");
 }
@@ -66,31 +85,74 @@ static int get_file_size( const char *path )
 	}
 }
 
+static int set_size( struct set *s )
+{
+	return s->pack ? allpairs_pack_size(s->pack) : text_list_size(s->list);
+}
+
+static const char * set_name( struct set *s, int i )
+{
+	return s->pack ? allpairs_pack_name(s->pack,i) : text_list_get(s->list,i);
+}
+
+static int set_item_size( struct set *s, int i )
+{
+	int length;
+	if(s->pack) {
+		allpairs_pack_data(s->pack,i,&length);
+		return length;
+	} else {
+		return get_file_size(text_list_get(s->list,i));
+	}
+}
+
+static struct set * set_load( const char *path )
+{
+	struct set *s = calloc(1,sizeof(*s));
+
+	s->pack = allpairs_pack_open(path);
+	if(s->pack) {
+		debug(D_DEBUG,"%s: pack of %d objects",path,allpairs_pack_size(s->pack));
+		return s;
+	} else if(errno!=EINVAL) {
+		free(s);
+		return 0;
+	}
+
+	s->list = text_list_load(path);
+	if(!s->list) {
+		free(s);
+		return 0;
+	}
+
+	return s;
+}
+
 /*
 block_size_estimate computes how many items we can effectively
 get in memory at once by measuring the first 100 elements of the set,
 and then choosing a number to fit within 1/2 of the available RAM.
 */
 
-int block_size_estimate( struct text_list *seta, struct rmsummary *tr )
+int block_size_estimate( struct set *seta, struct rmsummary *tr )
 {
-	int count = MIN(100,text_list_size(seta));
+	int count = MIN(100,set_size(seta));
 	int i;
 	UINT64_T total_data = 0,total_mem;
 	int block_size;
 
 	for(i=0;i<count;i++) {
-		total_data += get_file_size(text_list_get(seta,i));
+		total_data += set_item_size(seta,i);
 	}
 
 	total_mem = tr->memory * MEGABYTE / 2;
 
 	if(total_data>=total_mem) {
-		block_size = text_list_size(seta) * total_mem / total_data;
+		block_size = set_size(seta) * total_mem / total_data;
 		if(block_size<1) block_size = 1;
-		if(block_size>text_list_size(seta)) block_size = text_list_size(seta);
+		if(block_size>set_size(seta)) block_size = set_size(seta);
 	} else {
-		block_size = text_list_size(seta);
+		block_size = set_size(seta);
 	}
 
 	return block_size;
@@ -99,6 +161,7 @@ int block_size_estimate( struct text_list *seta, struct rmsummary *tr )
 /*
 Load the named file into memory, returning the actual data of
 the file, and filling length with the length of the buffer in bytes.
+The data is followed by a NUL byte, which is not counted in length.
 The result should be free()d when done.
 */
 
@@ -114,133 +177,319 @@ char * load_one_file( const char *filename, int *length )
 	*length = ftell(file);
 	fseek(file,0,SEEK_SET);
 
-	char *data = malloc(*length);
+	char *data = malloc(*length+1);
 	if(!data) {
 		fprintf(stderr,"%s: out of memory!\n",progname);
 		exit(1);
 	}
 
 	full_fread(file,data,*length);
+	data[*length] = 0;
 	fclose(file);
 
 	return data;
 }
 
 /*
-pthreads requires that we pass all arguments through as a single
-pointer, so we are forced to use a little structure to send all
-of the desired arguments.
+An item of a set loaded into memory, and its index in the set.
+The items of a pack are used in place: loading them only asks the
+kernel to read their pages ahead, and freeing them releases the pages
+from this process, while they stay in the page cache for the next pass
+or for other processes.
 */
 
-struct thread_args {
-	allpairs_compare_t func;
-	char **xname;
-	char **xdata;
-	int   *xdata_length;
-	int   *xdata_id; //the index array of xdata in the matrix constructed by seta and setb
-	char  *yname;
-	char  *ydata;
-	int    ydata_length;
-	int ydata_id; //the index of ydata in the matrix constructed by seta and setb
+struct item {
+	const char *name;
+	const char *data;
+	int length;
+	int id;
 };
 
+static void items_load( struct item *items, struct set *set, int start, int count )
+{
+	int i;
+
+	if(set->pack) allpairs_pack_advise(set->pack,start,count,MADV_WILLNEED);
+
+	for(i=0;i<count;i++) {
+		items[i].id = start + i;
+		items[i].name = set_name(set,start+i);
+		if(set->pack) {
+			items[i].data = allpairs_pack_data(set->pack,start+i,&items[i].length);
+		} else {
+			items[i].data = load_one_file(items[i].name,&items[i].length);
+		}
+	}
+}
+
+static void items_free( struct item *items, struct set *set, int count )
+{
+	int i;
+
+	if(set->pack) {
+		if(count>0) allpairs_pack_advise(set->pack,items[0].id,count,MADV_DONTNEED);
+		return;
+	}
+
+	for(i=0;i<count;i++) {
+		free((char *) items[i].data);
+	}
+}
+
 /*
-A single thread will loop over a whole block-row of the results,
-calling the comparison function once for each pair of items.
+Whether the result of a pair is wanted.  Since this only depends on
+xid <= yid, a tile is wanted at all if its first column and last row are.
 */
 
-static void * row_loop_threaded( void *args )
+static int pair_wanted( int xid, int yid )
 {
-	int i;
-	struct thread_args *targs = args;
 	if(nindex == 2) {
-		for(i=0;i<block_size;i++) {
-			if((index_array[0] + targs->xdata_id[i]) <= (index_array[1] + targs->ydata_id)) //calcuate xindex and yindex of the unit in the original matrix of allpairs_master
-				targs->func(targs->xname[i],targs->xdata[i],targs->xdata_length[i],targs->yname,targs->ydata,targs->ydata_length);
-		}
-	} else if (is_symmetric) {
-		for(i=0;i<block_size;i++) {
-			if(targs->xdata_id[i] <= targs->ydata_id)
-				targs->func(targs->xname[i],targs->xdata[i],targs->xdata_length[i],targs->yname,targs->ydata,targs->ydata_length);
-		}
+		//calcuate xindex and yindex of the unit in the original matrix of allpairs_master
+		return (index_array[0] + xid) <= (index_array[1] + yid);
+	} else if(is_symmetric) {
+		return xid <= yid;
 	} else {
-		for(i=0;i<block_size;i++) {
-			targs->func(targs->xname[i],targs->xdata[i],targs->xdata_length[i],targs->yname,targs->ydata,targs->ydata_length);
+		return 1;
+	}
+}
+
+/*
+The threaded main loop works on tiles of the result matrix, small enough
+that the items of a tile stay in cache while they are compared.  A pool of
+num_cores threads takes the tiles of a pass in order, and writes the results
+of each tile into its own buffer.  The main thread writes the buffers out in
+the order of the tiles, so the output does not depend on the timing of the
+threads, and no lock is held while comparing.
+This only applies to functions loaded via dynamic linking.
+*/
+
+/* Each side of a tile holds about this many bytes of items. */
+#define TILE_BYTES (128*1024)
+#define TILE_ITEMS_MAX 64
+
+struct tile {
+	int xstart, xstop;
+	int ystart, ystop;
+	int done;
+	UINT64_T comparisons;
+	buffer_t output;
+};
+
+struct tile_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t work_ready;
+	pthread_cond_t tile_done;
+
+	allpairs_compare_t func;
+	struct item *x;
+	struct item *y;
+
+	struct tile *tiles;
+	int ntiles;
+	int next;
+	int exit;
+};
+
+static void tile_compare( struct tile_pool *p, struct tile *t )
+{
+	int i, j;
+
+	allpairs_compare_set_output(&t->output);
+
+	for(j=t->ystart;j<t->ystop;j++) {
+		struct item *y = &p->y[j];
+		for(i=t->xstart;i<t->xstop;i++) {
+			struct item *x = &p->x[i];
+			if(pair_wanted(x->id,y->id)) {
+				p->func(x->name,x->data,x->length,y->name,y->data,y->length);
+				t->comparisons++;
+			}
 		}
 	}
+
+	allpairs_compare_set_output(0);
+}
+
+static void * tile_loop_threaded( void *arg )
+{
+	struct tile_pool *p = arg;
+
+	pthread_mutex_lock(&p->mutex);
+	while(1) {
+		while(!p->exit && p->next>=p->ntiles) {
+			pthread_cond_wait(&p->work_ready,&p->mutex);
+		}
+		if(p->exit) break;
+
+		struct tile *t = &p->tiles[p->next++];
+		pthread_mutex_unlock(&p->mutex);
+
+		tile_compare(p,t);
+
+		pthread_mutex_lock(&p->mutex);
+		t->done = 1;
+		pthread_cond_broadcast(&p->tile_done);
+	}
+	pthread_mutex_unlock(&p->mutex);
+
 	return 0;
 }
 
 /*
-The threaded main loop loads an entire block of objects into memory,
-then forks threads, one for each row in the block, until done.
-This only applies to functions loaded via dynamic linking.
-Up to num_cores threads will be running simultaneously.
+Start a pass over the tiles of the loaded columns x and rows y,
+skipping the tiles without any wanted pairs.
 */
 
-static int main_loop_threaded( allpairs_compare_t funcptr, struct text_list *seta, struct text_list *setb )
+static void tile_pass_start( struct tile_pool *p, struct item *x, int xcount, struct item *y, int ycount, int tile_width, int tile_height )
 {
-	int x,i,j,c;
+	int i, j, n = 0;
+
+	pthread_mutex_lock(&p->mutex);
+
+	p->x = x;
+	p->y = y;
+
+	for(j=0;j<ycount;j+=tile_height) {
+		for(i=0;i<xcount;i+=tile_width) {
+			struct tile *t = &p->tiles[n];
+			t->xstart = i;
+			t->xstop = MIN(i+tile_width,xcount);
+			t->ystart = j;
+			t->ystop = MIN(j+tile_height,ycount);
+			if(!pair_wanted(x[t->xstart].id,y[t->ystop-1].id)) continue;
+			t->done = 0;
+			t->comparisons = 0;
+			buffer_init(&t->output);
+			n++;
+		}
+	}
+
+	p->ntiles = n;
+	p->next = 0;
+
+	pthread_cond_broadcast(&p->work_ready);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+/*
+Write out the results of each tile of the pass, in order, as they complete.
+Returns the number of comparisons done.
+*/
+
+static UINT64_T tile_pass_finish( struct tile_pool *p )
+{
+	UINT64_T comparisons = 0;
+	int i;
+	for(i=0;i<p->ntiles;i++) {
+		struct tile *t = &p->tiles[i];
+
+		pthread_mutex_lock(&p->mutex);
+		while(!t->done) {
+			pthread_cond_wait(&p->tile_done,&p->mutex);
+		}
+		pthread_mutex_unlock(&p->mutex);
+
+		size_t length;
+		const char *text = buffer_tolstring(&t->output,&length);
+		fwrite(text,1,length,stdout);
+		buffer_free(&t->output);
+
+		comparisons += t->comparisons;
+	}
+
+	return comparisons;
+}
+
+static int main_loop_threaded( allpairs_compare_t funcptr, struct set *seta, struct set *setb )
+{
+	int x,j,c;
+	int xsize = set_size(seta);
+	int ysize = set_size(setb);
 
-	char *xname[block_size];
-	char *xdata[block_size];
-	int xdata_id[block_size];
-	int xdata_length[block_size];
+	struct item *xitems = malloc(block_size*sizeof(struct item));
 
-	char *yname[num_cores];
-	char *ydata[num_cores];
-	int ydata_length[num_cores];
-	int ydata_id[num_cores];
+	/* the tile size is chosen from the size of the first items. */
+	int count = MIN(100,xsize);
+	UINT64_T total_data = 0;
+	for(c=0;c<count;c++) {
+		total_data += set_item_size(seta,c);
+	}
+	int item_size = count ? MAX(1,total_data/count) : 1;
+	int tile_side = MAX(1,MIN(TILE_ITEMS_MAX,TILE_BYTES/item_size));
+	int tile_rows = tile_side*num_cores;
+
+	debug(D_DEBUG,"tiles of %d x %d items, %d rows loaded at once",tile_side,tile_side,tile_rows);
+
+	/* the rows being compared, and the next ones being loaded meanwhile. */
+	struct item *yitems[2];
+	yitems[0] = malloc(tile_rows*sizeof(struct item));
+	yitems[1] = malloc(tile_rows*sizeof(struct item));
+
+	struct tile_pool pool;
+	memset(&pool,0,sizeof(pool));
+	pthread_mutex_init(&pool.mutex,0);
+	pthread_cond_init(&pool.work_ready,0);
+	pthread_cond_init(&pool.tile_done,0);
+	pool.func = funcptr;
+	pool.tiles = malloc(((block_size+tile_side-1)/tile_side)*num_cores*sizeof(struct tile));
 
-	struct thread_args args[num_cores];
 	pthread_t thread[num_cores];
+	for(c=0;c<num_cores;c++) {
+		pthread_create(&thread[c],0,tile_loop_threaded,&pool);
+	}
+
+	UINT64_T comparisons = 0;
+	timestamp_t start = timestamp_get();
 
 	/* for each block sized vertical stripe... */
-	for(x=0;x<text_list_size(seta);x+=block_size) {
+	for(x=0;x<xsize;x+=block_size) {
 
 		/* load the horizontal members of the stripe */
-		for(i=0;i<block_size;i++) {
-			xdata_id[i] = x + i;
-			xname[i] = text_list_get(seta,x+i);
-			xdata[i] = load_one_file(text_list_get(seta,x+i),&xdata_length[i]);
-		}
+		int xcount = MIN(block_size,xsize-x);
+		items_load(xitems,seta,x,xcount);
 
-		/* for each row in the stripe ... */
-		for(j=0;j<text_list_size(setb);j+=num_cores) {
-
-			/* don't start more threads than rows remaining. */
-			int n = MIN(num_cores,text_list_size(setb)-j);
-
-			/* start one thread working on a whole row. */
-			for(c=0;c<n;c++) {
-				yname[c] = text_list_get(setb,j+c);
-				ydata_id[c] = j + c;
-				ydata[c] = load_one_file(text_list_get(setb,j+c),&ydata_length[c]);
-
-				args[c].func         = funcptr;
-				args[c].xname        = xname;
-				args[c].xdata        = xdata;
-				args[c].xdata_length = xdata_length;
-				args[c].xdata_id = xdata_id;
-				args[c].yname	     = yname[c];
-				args[c].ydata        = ydata[c];
-				args[c].ydata_length = ydata_length[c];
-				args[c].ydata_id = ydata_id[c];
-				pthread_create(&thread[c],0,row_loop_threaded,&args[c]);
-			}
+		int current = 0;
+		int ycount = MIN(tile_rows,ysize);
+		items_load(yitems[current],setb,0,ycount);
 
-			/* wait for each one to finish */
-			for(c=0;c<n;c++) {
-				pthread_join(thread[c],0);
-				free(ydata[c]);
-			}
-		}
+		/* for each group of rows in the stripe ... */
+		for(j=0;j<ysize;j+=tile_rows) {
+			tile_pass_start(&pool,xitems,xcount,yitems[current],ycount,tile_side,tile_side);
+
+			/* load the next rows while these are compared. */
+			int next_count = MIN(tile_rows,ysize-j-tile_rows);
+			if(next_count>0) items_load(yitems[!current],setb,j+tile_rows,next_count);
+
+			comparisons += tile_pass_finish(&pool);
 
-		for(i=0;i<block_size;i++) {
-			free(xdata[i]);
+			items_free(yitems[current],setb,ycount);
+			current = !current;
+			ycount = next_count;
 		}
+
+		items_free(xitems,seta,xcount);
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.exit = 1;
+	pthread_cond_broadcast(&pool.work_ready);
+	pthread_mutex_unlock(&pool.mutex);
+
+	for(c=0;c<num_cores;c++) {
+		pthread_join(thread[c],0);
 	}
 
+	double elapsed = (timestamp_get()-start)/1000000.0;
+	debug(D_DEBUG,UINT64_FORMAT " comparisons in %.3f s, %.0f comparisons/s",comparisons,elapsed,elapsed>0 ? comparisons/elapsed : 0);
+
+	pthread_mutex_destroy(&pool.mutex);
+	pthread_cond_destroy(&pool.work_ready);
+	pthread_cond_destroy(&pool.tile_done);
+	free(pool.tiles);
+	free(yitems[0]);
+	free(yitems[1]);
+	free(xitems);
+
 	return 0;
 }
 
@@ -314,6 +563,7 @@ int main(int argc, char *argv[])
 {
 	int c;
 	int result;
+	int pack_mode = 0;
 
 	debug_config(progname);
 
@@ -326,6 +576,8 @@ int main(int argc, char *argv[])
 		{"extra-args", required_argument, 0, 'e'},
 		{"symmetric", no_argument, 0, LONG_OPT_SYMMETRIC},
 		{"index", required_argument, 0, LONG_OPT_INDEX},
+		{"min-score", required_argument, 0, LONG_OPT_MIN_SCORE},
+		{"pack", no_argument, 0, LONG_OPT_PACK},
 		{0,0,0,0}
 	};
 
@@ -354,6 +606,12 @@ int main(int argc, char *argv[])
 		case LONG_OPT_SYMMETRIC:
 			is_symmetric = 1;
 			break;
+		case LONG_OPT_MIN_SCORE:
+			allpairs_compare_set_min_score(atoi(optarg));
+			break;
+		case LONG_OPT_PACK:
+			pack_mode = 1;
+			break;
 		case 'v':
 			cctools_version_print(stdout, progname);
 			exit(0);
@@ -368,6 +626,26 @@ int main(int argc, char *argv[])
 
 	cctools_version_debug(D_DEBUG, argv[0]);
 
+	if(pack_mode) {
+		if((argc - optind) != 2) {
+			show_help(progname);
+			exit(1);
+		}
+
+		struct text_list *set = text_list_load(argv[optind]);
+		if(!set) {
+			fprintf(stderr, "allpairs_multicore: cannot open %s: %s\n",argv[optind],strerror(errno));
+			exit(1);
+		}
+
+		if(!allpairs_pack_create(argv[optind+1],set)) {
+			fprintf(stderr, "allpairs_multicore: cannot write pack %s: %s\n",argv[optind+1],strerror(errno));
+			exit(1);
+		}
+
+		return 0;
+	}
+
 	if((argc - optind) < 3) {
 		show_help(progname);
 		exit(1);
@@ -377,13 +655,13 @@ int main(int argc, char *argv[])
 	const char * setbpath = argv[optind+1];
 	const char * funcpath = argv[optind+2];
 
-	struct text_list *seta = text_list_load(setapath);
+	struct set *seta = set_load(setapath);
 	if(!seta) {
 		fprintf(stderr, "allpairs_multicore: cannot open %s: %s\n",setapath,strerror(errno));
 		exit(1);
 	}
 
-	struct text_list *setb = text_list_load(setbpath);
+	struct set *setb = set_load(setbpath);
 	if(!setb) {
 		fprintf(stderr, "allpairs_multicore: cannot open %s: %s\n",setbpath,strerror(errno));
 		exit(1);
@@ -405,7 +683,11 @@ int main(int argc, char *argv[])
 			fprintf(stderr, "%s: %s is neither an executable program nor an internal function.\n",progname,funcpath);
 			return 1;
 		}
-		result = main_loop_program(funcpath,seta,setb);
+		if(seta->pack || setb->pack) {
+			fprintf(stderr, "%s: packed sets can only be used with internal functions.\n",progname);
+			return 1;
+		}
+		result = main_loop_program(funcpath,seta->list,setb->list);
 	}
 
 	return result;
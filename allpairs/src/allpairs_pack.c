@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "allpairs_pack.h"
+
+#include "copy_stream.h"
+#include "full_io.h"
+#include "macros.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+The layout of a pack, in the byte order of the host:
+the header, count index entries, the names, each terminated by NUL,
+and the objects, each aligned to ALLPAIRS_PACK_ALIGN and terminated by NUL.
+*/
+
+#define ALLPAIRS_PACK_MAGIC "allpairs pack 1\n"
+#define ALLPAIRS_PACK_ALIGN 64
+
+struct allpairs_pack_header {
+	char magic[16];
+	uint64_t count;
+};
+
+struct allpairs_pack_entry {
+	uint64_t name;
+	uint64_t data;
+	uint64_t length;
+};
+
+struct allpairs_pack {
+	char *map;
+	size_t size;
+	int count;
+	struct allpairs_pack_entry *index;
+};
+
+static uint64_t align_up( uint64_t offset, uint64_t alignment )
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+int allpairs_pack_create( const char *path, struct text_list *set )
+{
+	int count = text_list_size(set);
+	int i;
+
+	struct allpairs_pack_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ALLPAIRS_PACK_MAGIC, sizeof(header.magic));
+	header.count = count;
+
+	struct allpairs_pack_entry *index = calloc(count ? count : 1, sizeof(*index));
+
+	uint64_t offset = sizeof(header) + count * sizeof(*index);
+	for(i = 0; i < count; i++) {
+		index[i].name = offset;
+		offset += strlen(text_list_get(set, i)) + 1;
+	}
+
+	for(i = 0; i < count; i++) {
+		struct stat info;
+		if(stat(text_list_get(set, i), &info) != 0) {
+			free(index);
+			return 0;
+		}
+		offset = align_up(offset, ALLPAIRS_PACK_ALIGN);
+		index[i].data = offset;
+		index[i].length = info.st_size;
+		offset += info.st_size + 1;
+	}
+
+	FILE *file = fopen(path, "w");
+	if(!file) {
+		free(index);
+		return 0;
+	}
+
+	full_fwrite(file, &header, sizeof(header));
+	full_fwrite(file, index, count * sizeof(*index));
+	for(i = 0; i < count; i++) {
+		const char *name = text_list_get(set, i);
+		full_fwrite(file, name, strlen(name) + 1);
+	}
+
+	int ok = 1;
+	for(i = 0; i < count && ok; i++) {
+		FILE *input = fopen(text_list_get(set, i), "r");
+		if(!input) {
+			ok = 0;
+			break;
+		}
+
+		fseek(file, index[i].data, SEEK_SET);
+		if(copy_stream_to_stream(input, file) != (int64_t) index[i].length || fputc(0, file) == EOF) {
+			errno = EIO;
+			ok = 0;
+		}
+		fclose(input);
+	}
+
+	free(index);
+
+	if(fclose(file) != 0)
+		ok = 0;
+
+	if(!ok)
+		unlink(path);
+
+	return ok;
+}
+
+/* The name and the object of an entry must be within the map, and end in NUL. */
+static int entry_is_valid( struct allpairs_pack *p, struct allpairs_pack_entry *e )
+{
+	if(e->name >= p->size || !memchr(p->map + e->name, 0, p->size - e->name))
+		return 0;
+
+	if(e->data >= p->size || e->length >= p->size - e->data || p->map[e->data + e->length] != 0)
+		return 0;
+
+	return 1;
+}
+
+struct allpairs_pack *allpairs_pack_open( const char *path )
+{
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return 0;
+
+	struct stat info;
+	struct allpairs_pack_header header;
+
+	if(fstat(fd, &info) != 0 || full_read(fd, &header, sizeof(header)) != sizeof(header) || memcmp(header.magic, ALLPAIRS_PACK_MAGIC, sizeof(header.magic))) {
+		close(fd);
+		errno = EINVAL;
+		return 0;
+	}
+
+	/* compare by division, so that a large count cannot overflow. */
+	uint64_t max_count = ((uint64_t) info.st_size - sizeof(header)) / sizeof(struct allpairs_pack_entry);
+	if(header.count > max_count || header.count > INT_MAX) {
+		close(fd);
+		errno = EINVAL;
+		return 0;
+	}
+
+	char *map = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return 0;
+
+	struct allpairs_pack *p = malloc(sizeof(*p));
+	p->map = map;
+	p->size = info.st_size;
+	p->count = header.count;
+	p->index = (struct allpairs_pack_entry *) (map + sizeof(header));
+
+	int i;
+	for(i = 0; i < p->count; i++) {
+		struct allpairs_pack_entry *e = &p->index[i];
+		if(!entry_is_valid(p, e)) {
+			allpairs_pack_close(p);
+			errno = EINVAL;
+			return 0;
+		}
+	}
+
+	/* the index and names are used throughout. */
+	if(p->count > 0)
+		madvise(map, p->index[0].data, MADV_WILLNEED);
+
+	return p;
+}
+
+void allpairs_pack_close( struct allpairs_pack *p )
+{
+	if(!p)
+		return;
+	munmap(p->map, p->size);
+	free(p);
+}
+
+int allpairs_pack_size( struct allpairs_pack *p )
+{
+	return p->count;
+}
+
+const char *allpairs_pack_name( struct allpairs_pack *p, int i )
+{
+	if(i < 0 || i >= p->count)
+		return 0;
+	return p->map + p->index[i].name;
+}
+
+const char *allpairs_pack_data( struct allpairs_pack *p, int i, int *length )
+{
+	*length = p->index[i].length;
+	return p->map + p->index[i].data;
+}
+
+void allpairs_pack_advise( struct allpairs_pack *p, int start, int count, int advice )
+{
+	if(count < 1)
+		return;
+
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t begin = p->index[start].data / page * page;
+	uint64_t end = align_up(p->index[start + count - 1].data + p->index[start + count - 1].length + 1, page);
+
+	madvise(p->map + begin, MIN(end, p->size) - begin, advice);
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,39 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef ALLPAIRS_PACK_H
+#define ALLPAIRS_PACK_H
+
+#include <stdint.h>
+
+#include "text_list.h"
+
+/*
+A pack holds all the objects of a set in a single file, with an index of
+their names, offsets and lengths.  It is mapped into memory, so that the
+objects are used in place, and the pages are shared through the page cache
+by all the processes that use the same pack.  Each object is followed by a
+NUL byte, which is not part of its length.
+*/
+
+struct allpairs_pack;
+
+/* Write the objects named in set into a pack at path. Returns 0 on failure, with errno set. */
+int allpairs_pack_create( const char *path, struct text_list *set );
+
+/* Map the pack at path. Returns 0 on failure, with errno set to EINVAL if the file is not a pack. */
+struct allpairs_pack *allpairs_pack_open( const char *path );
+
+void allpairs_pack_close( struct allpairs_pack *p );
+
+int allpairs_pack_size( struct allpairs_pack *p );
+const char *allpairs_pack_name( struct allpairs_pack *p, int i );
+const char *allpairs_pack_data( struct allpairs_pack *p, int i, int *length );
+
+/* Give madvise advice on the pages of the objects from start to start+count. */
+void allpairs_pack_advise( struct allpairs_pack *p, int start, int count, int advice );
+
+#endif
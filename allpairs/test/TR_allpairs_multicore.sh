@@ -0,0 +1,84 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+TEST_INPUT=set.list
+TEST_OUTPUT=multicore.output
+TEST_TRUTH=multicore.truth
+IRIS_DIR=iris.templates
+IRIS_INPUT=iris.list
+TEST_PACK=set.pack
+
+cleanfiles()
+{
+	rm -f $TEST_OUTPUT $TEST_TRUTH $IRIS_INPUT $TEST_PACK
+	rm -rf $IRIS_DIR
+}
+
+prepare()
+{
+	cleanfiles
+}
+
+# iris template of 2048 bits: the code and mask bytes repeated.
+iris_template()
+{
+	{
+		echo "2048 0 0 0 0"
+		head -c 256 /dev/zero | tr '\0' "$2"
+		head -c 256 /dev/zero | tr '\0' "$3"
+	} > $IRIS_DIR/$1
+	echo $IRIS_DIR/$1 >> $IRIS_INPUT
+}
+
+run()
+{
+	# BITWISE counts the bytes that differ, as cmp -l does.
+	for a in `cat $TEST_INPUT`; do
+		for b in `cat $TEST_INPUT`; do
+			echo "$a	$b	`cmp -l $a $b 2>/dev/null | wc -l | tr -d ' '`"
+		done
+	done | sort > $TEST_TRUTH
+
+	for options in "" "-b 1" "-b 2 -c 2" "-c 3"; do
+		echo "BITWISE $options"
+		../src/allpairs_multicore $options $TEST_INPUT $TEST_INPUT BITWISE | sort > $TEST_OUTPUT
+		diff $TEST_TRUTH $TEST_OUTPUT || return 1
+	done
+
+	echo "BITWISE with a pack"
+	../src/allpairs_multicore --pack $TEST_INPUT $TEST_PACK || return 1
+	../src/allpairs_multicore -b 2 $TEST_PACK $TEST_PACK BITWISE | sort > $TEST_OUTPUT
+	diff $TEST_TRUTH $TEST_OUTPUT || return 1
+
+	echo "BITWISE --symmetric"
+	../src/allpairs_multicore -b 2 --symmetric $TEST_INPUT $TEST_INPUT BITWISE > $TEST_OUTPUT
+	[ `wc -l < $TEST_OUTPUT` = 6 ] || return 1
+
+	mkdir -p $IRIS_DIR
+	iris_template zero '\000' '\377'
+	iris_template ones '\377' '\377'
+	iris_template half '\360' '\377'
+	iris_template masked '\017' '\360'
+
+	echo "IRIS"
+	../src/allpairs_multicore $IRIS_INPUT $IRIS_INPUT IRIS > $TEST_OUTPUT
+	cat $TEST_OUTPUT
+	grep -q "zero	$IRIS_DIR/zero	0.000000" $TEST_OUTPUT || return 1
+	grep -q "ones	$IRIS_DIR/zero	1.000000" $TEST_OUTPUT || return 1
+	grep -q "half	$IRIS_DIR/zero	0.500000" $TEST_OUTPUT || return 1
+	grep -q "masked	$IRIS_DIR/zero	0.000000" $TEST_OUTPUT || return 1
+	grep -q "masked	$IRIS_DIR/half	1.000000" $TEST_OUTPUT || return 1
+
+	return 0
+}
+
+clean()
+{
+	cleanfiles
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
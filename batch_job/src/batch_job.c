@@ -10,6 +10,7 @@ See the file COPYING for details.
 
 #include "debug.h"
 #include "itable.h"
+#include "macros.h"
 #include "stringtools.h"
 #include "xxmalloc.h"
 
@@ -38,7 +39,7 @@ static struct batch_queue_module batch_queue_unknown = {
 
 	NULL, NULL, NULL, NULL,
 
-	{NULL, NULL, NULL},
+	{NULL, NULL, NULL, NULL},
 
 	{NULL, NULL, NULL, NULL, NULL, NULL, NULL},
 };
@@ -78,6 +79,7 @@ struct batch_queue *batch_queue_create(batch_queue_type_t type)
 	q->job_table = itable_create(0);
 	q->output_table = itable_create(0);
 	q->data = NULL;
+	q->async = NULL;
 
 	batch_queue_set_feature(q, "local_job_queue", "yes");
 	batch_queue_set_feature(q, "absolute_path", "yes");
@@ -112,6 +114,7 @@ void batch_queue_delete(struct batch_queue *q)
 
 		debug(D_BATCH, "deleting queue %p", q);
 
+		batch_job_async_delete(q);
 		q->module->free(q);
 
 		for (hash_table_firstkey(q->options); hash_table_nextkey(q->options, &key, (void **) &value); free(value))
@@ -170,6 +173,15 @@ void batch_queue_set_option (struct batch_queue *q, const char *what, const char
 		debug(D_BATCH, "cleared option `%s'", what);
 	}
 	free(current);
+
+	if(!strcmp(what, "async-submitters")) {
+		if(batch_queue_supports_feature(q, "async_submit")) {
+			batch_job_async_set_submitters(q, value ? atoi(value) : 0);
+		} else if(value && atoi(value) > 0) {
+			debug(D_NOTICE, "%s jobs cannot be submitted asynchronously, submitting one at a time.", q->module->typestr);
+		}
+	}
+
 	q->module->option_update(q, what, value);
 }
 
@@ -218,21 +230,61 @@ const char *batch_queue_type_string()
 
 batch_job_id_t batch_job_submit(struct batch_queue * q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources)
 {
+	if(batch_job_async_enabled(q))
+		return batch_job_async_submit(q, cmd, extra_input_files, extra_output_files, envlist, resources);
+
 	return q->module->job.submit(q, cmd, extra_input_files, extra_output_files, envlist, resources);
 }
 
+int batch_job_submit_array(struct batch_queue *q, int count, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources, batch_job_id_t *jobids)
+{
+	int submitted = 0;
+
+	if(q->module->job.submit_array && count > 1 && !batch_job_async_enabled(q)) {
+		while(submitted < count) {
+			int n = q->module->job.submit_array(q, MIN(count - submitted, BATCH_JOB_ARRAY_MAX), cmd, extra_input_files, extra_output_files, envlist, resources, jobids + submitted);
+			if(n < 1)
+				break;
+
+			submitted += n;
+		}
+
+		if(submitted > 0)
+			return submitted;
+
+		debug(D_BATCH, "array submission failed, submitting jobs one at a time.");
+	}
+
+	for(; submitted < count; submitted++) {
+		batch_job_id_t jobid = batch_job_submit(q, cmd, extra_input_files, extra_output_files, envlist, resources);
+		if(jobid < 1)
+			break;
+
+		jobids[submitted] = jobid;
+	}
+
+	return submitted;
+}
+
 batch_job_id_t batch_job_wait(struct batch_queue * q, struct batch_job_info * info)
 {
-	return q->module->job.wait(q, info, 0);
+	return batch_job_wait_timeout(q, info, 0);
 }
 
 batch_job_id_t batch_job_wait_timeout(struct batch_queue * q, struct batch_job_info * info, time_t stoptime)
 {
+	/* the provisional ids of asynchronous submissions are valid until their jobs are waited for. */
+	if(q->async)
+		return batch_job_async_wait(q, info, stoptime);
+
 	return q->module->job.wait(q, info, stoptime);
 }
 
 int batch_job_remove(struct batch_queue *q, batch_job_id_t jobid)
 {
+	if(q->async)
+		return batch_job_async_remove(q, jobid);
+
 	return q->module->job.remove(q, jobid);
 }
 
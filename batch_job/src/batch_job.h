@@ -74,9 +74,25 @@ struct batch_queue *batch_queue_create(batch_queue_type_t type);
 @param envlist The set of environment variables for the job, in a jx object.
 @param resources The computational resources needed by the job.
 @return On success, returns a unique identifier for the batch job.  On failure, returns a negative number.
+If the queue option <tt>async-submitters</tt> is set to N > 0, and the batch system supports it (Condor and the cluster types), the job is submitted in the background by one of up to N submitter processes, and the identifier returned is provisional. A failed submission is then reported by @ref batch_job_wait as a job that did not exit normally. Failed submissions are retried for up to <tt>submit-timeout</tt> seconds (default 0).
 */
 batch_job_id_t batch_job_submit(struct batch_queue *q, const char *cmdline, const char *input_files, const char *output_files, struct jx *envlist, const struct rmsummary *resources);
 
+/** Submit several identical batch jobs.
+Where the batch system supports it (SGE, PBS, Torque, SLURM, and Condor), the jobs are submitted as a single array job, with one call to the submit command, rather than one call per job. Otherwise, the jobs are submitted one at a time with @ref batch_job_submit.
+Each job of the array is waited for and removed individually.
+@param q The queue to submit to.
+@param count The number of jobs to submit.
+@param cmdline The command line to execute, as in @ref batch_job_submit.
+@param input_files A comma separated list of all input files that will be required by the jobs, as in @ref batch_job_submit.
+@param output_files A comma separated list of all output files to retrieve from the jobs, as in @ref batch_job_submit.
+@param envlist The set of environment variables for the jobs, in a jx object.
+@param resources The computational resources needed by each job.
+@param jobids An array of at least count elements, which will be filled with the identifiers of the submitted jobs.
+@return The number of jobs submitted, which may be less than count if there was a failure.
+*/
+int batch_job_submit_array(struct batch_queue *q, int count, const char *cmdline, const char *input_files, const char *output_files, struct jx *envlist, const struct rmsummary *resources, batch_job_id_t *jobids);
+
 /** Wait for any batch job to complete.
 Blocks until a batch job completes.
 @param q The queue to wait on.
@@ -707,6 +707,7 @@ const struct batch_queue_module batch_queue_amazon = {
 	 batch_job_amazon_submit,
 	 batch_job_amazon_wait,
 	 batch_job_amazon_remove,
+	 NULL,
 	 },
 
 	{
@@ -0,0 +1,484 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Asynchronous job submission.
+
+With batch systems such as Condor or SLURM, each submission runs an external
+command that may take from a fraction of a second to many seconds when the
+scheduler is busy. When the option "async-submitters" is set to N > 0 on a
+queue whose module supports the feature "async_submit", batch_job_submit
+returns immediately a provisional job id, and the actual submissions are done
+by up to N submitter processes running at the same time.
+
+Each submitter is forked with a snapshot of the queue options taken when
+batch_job_submit was called (callers such as makeflow change options like
+"batch-options" between submissions), calls the submit function of the
+module, retrying for up to "submit-timeout" seconds, and writes the id given
+by the batch system to a pipe. The parent then records the job in the job
+table of the module, so that the wait of the module finds it.
+
+Jobs are always reported to the caller with their provisional id. A
+submission that fails is reported by batch_job_wait as a job that did not
+exit normally.
+
+Modules that support this feature must keep in the parent no state about a
+job other than a struct batch_job_info in q->job_table, and must not write
+files with fixed names that may be written by two submitters at once.
+*/
+
+#include "batch_job.h"
+#include "batch_job_internal.h"
+
+#include "debug.h"
+#include "full_io.h"
+#include "itable.h"
+#include "jx.h"
+#include "list.h"
+#include "macros.h"
+#include "process.h"
+#include "rmsummary.h"
+#include "xxmalloc.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Provisional ids have bit 61 set, so that they never collide with the ids
+ * given by the batch system, or with ids of array elements. */
+#define BATCH_JOB_ASYNC_FLAG (((batch_job_id_t) 1) << 61)
+
+typedef enum {
+	ASYNC_WAITING,    /* not yet handed to a submitter. */
+	ASYNC_RUNNING,    /* a submitter process is submitting the job. */
+	ASYNC_SUBMITTED,  /* the job is in the batch system. */
+	ASYNC_FAILED      /* the submission failed, or the job was removed before being submitted. */
+} async_state_t;
+
+struct async_request {
+	batch_job_id_t id;
+	batch_job_id_t real_id;
+	async_state_t state;
+	int removed;
+
+	char *cmd;
+	char *inputs;
+	char *outputs;
+	struct jx *envlist;
+	struct rmsummary *resources;
+	struct hash_table *options;
+
+	time_t submitted;
+	pid_t pid;
+	int fd;
+};
+
+struct batch_job_async {
+	int max_submitters;
+	batch_job_id_t next_id;
+
+	struct list *waiting;      /* requests in ASYNC_WAITING, in order of submission. */
+	struct list *failed;       /* requests in ASYNC_FAILED, to be reported by wait. */
+	struct itable *running;    /* pid of submitter -> request in ASYNC_RUNNING. */
+	struct itable *requests;   /* provisional id -> request, until reported by wait. */
+	struct itable *by_real_id; /* batch system id -> request in ASYNC_SUBMITTED. */
+};
+
+static struct hash_table *options_copy(struct hash_table *options)
+{
+	struct hash_table *copy = hash_table_create(0, 0);
+
+	char *key;
+	char *value;
+	hash_table_firstkey(options);
+	while(hash_table_nextkey(options, &key, (void **) &value)) {
+		hash_table_insert(copy, key, xxstrdup(value));
+	}
+
+	return copy;
+}
+
+static void options_delete(struct hash_table *options)
+{
+	char *key;
+	char *value;
+	hash_table_firstkey(options);
+	while(hash_table_nextkey(options, &key, (void **) &value)) {
+		free(value);
+	}
+	hash_table_delete(options);
+}
+
+/* Free what is only needed to submit the job. */
+static void request_release(struct async_request *r)
+{
+	free(r->cmd);
+	free(r->inputs);
+	free(r->outputs);
+	r->cmd = r->inputs = r->outputs = NULL;
+
+	if(r->envlist)
+		jx_delete(r->envlist);
+	r->envlist = NULL;
+
+	if(r->resources)
+		rmsummary_delete(r->resources);
+	r->resources = NULL;
+
+	if(r->options)
+		options_delete(r->options);
+	r->options = NULL;
+}
+
+static void request_delete(struct async_request *r)
+{
+	request_release(r);
+	free(r);
+}
+
+static void request_fail(struct batch_job_async *a, struct async_request *r)
+{
+	request_release(r);
+	r->state = ASYNC_FAILED;
+	list_push_tail(a->failed, r);
+}
+
+static struct batch_job_async *async_create(void)
+{
+	struct batch_job_async *a = calloc(1, sizeof(*a));
+
+	a->next_id    = 1;
+	a->waiting    = list_create();
+	a->failed     = list_create();
+	a->running    = itable_create(0);
+	a->requests   = itable_create(0);
+	a->by_real_id = itable_create(0);
+
+	return a;
+}
+
+void batch_job_async_set_submitters(struct batch_queue *q, int submitters)
+{
+	if(!q->async)
+		q->async = async_create();
+
+	q->async->max_submitters = MAX(0, submitters);
+	debug(D_BATCH, "using %d submitter processes", q->async->max_submitters);
+}
+
+int batch_job_async_enabled(struct batch_queue *q)
+{
+	return q->async && q->async->max_submitters > 0;
+}
+
+/* Runs in the submitter process. Returns the id given by the batch system. */
+static batch_job_id_t async_submitter(struct batch_queue *q, struct async_request *r)
+{
+	/* the options of the queue in this process are not visible to the parent. */
+	q->options = r->options;
+	batch_queue_set_option(q, "async-submitter", "yes");
+
+	const char *timeout_option = batch_queue_get_option(q, "submit-timeout");
+	time_t stoptime = time(0) + (timeout_option ? atoi(timeout_option) : 0);
+
+	int delay = 1;
+	while(1) {
+		batch_job_id_t jobid = q->module->job.submit(q, r->cmd, r->inputs, r->outputs, r->envlist, r->resources);
+		if(jobid > 0)
+			return jobid;
+
+		if(time(0) + delay > stoptime)
+			return -1;
+
+		debug(D_BATCH, "couldn't submit job, will retry in %d seconds", delay);
+		sleep(delay);
+		delay = MIN(delay * 2, 60);
+	}
+}
+
+/* Fork submitters for waiting requests, up to the maximum allowed. */
+static void async_dispatch(struct batch_queue *q)
+{
+	struct batch_job_async *a = q->async;
+
+	while(list_size(a->waiting) > 0 && itable_size(a->running) < a->max_submitters) {
+		struct async_request *r = list_pop_head(a->waiting);
+
+		int fds[2];
+		if(pipe(fds) < 0) {
+			debug(D_BATCH, "couldn't create pipe for submitter: %s", strerror(errno));
+			list_push_head(a->waiting, r);
+			return;
+		}
+
+		pid_t pid = fork();
+		if(pid < 0) {
+			debug(D_BATCH, "couldn't fork submitter: %s", strerror(errno));
+			close(fds[0]);
+			close(fds[1]);
+			list_push_head(a->waiting, r);
+			return;
+		}
+
+		if(pid == 0) {
+			close(fds[0]);
+			batch_job_id_t jobid = async_submitter(q, r);
+			full_write(fds[1], &jobid, sizeof(jobid));
+			/* _exit, so that stdio buffers inherited from the parent are not flushed twice. */
+			_exit(jobid > 0 ? 0 : 1);
+		}
+
+		close(fds[1]);
+		/* so that the submit commands of other submitters do not inherit it. */
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+		r->state = ASYNC_RUNNING;
+		r->pid   = pid;
+		r->fd    = fds[0];
+		itable_insert(a->running, pid, r);
+
+		debug(D_BATCH, "submitter %d started for job %" PRIbjid, (int) pid, r->id);
+	}
+}
+
+/* Record the result of a submitter that has exited. */
+static void async_complete(struct batch_queue *q, struct async_request *r, struct process_info *p)
+{
+	struct batch_job_async *a = q->async;
+
+	batch_job_id_t jobid = -1;
+	if(full_read(r->fd, &jobid, sizeof(jobid)) != sizeof(jobid) || !WIFEXITED(p->status) || WEXITSTATUS(p->status) != 0) {
+		jobid = -1;
+	}
+	close(r->fd);
+
+	itable_remove(a->running, r->pid);
+
+	if(jobid < 1) {
+		debug(D_BATCH, "submission of job %" PRIbjid " failed", r->id);
+		request_fail(a, r);
+		return;
+	}
+
+	debug(D_BATCH, "job %" PRIbjid " submitted as %" PRIbjid, r->id, jobid);
+
+	request_release(r);
+	r->state   = ASYNC_SUBMITTED;
+	r->real_id = jobid;
+	itable_insert(a->by_real_id, jobid, r);
+
+	/* the wait of the module may have already seen the job in the batch log. */
+	if(!itable_lookup(q->job_table, jobid)) {
+		struct batch_job_info *info = calloc(1, sizeof(*info));
+		info->submitted = r->submitted;
+		itable_insert(q->job_table, jobid, info);
+	}
+
+	if(r->removed) {
+		q->module->job.remove(q, jobid);
+	}
+}
+
+/* Collect the submitters that have exited, without blocking. */
+static void async_collect(struct batch_queue *q)
+{
+	struct batch_job_async *a = q->async;
+
+	if(itable_size(a->running) < 1)
+		return;
+
+	struct list *done = list_create();
+
+	uint64_t pid;
+	struct async_request *r;
+	itable_firstkey(a->running);
+	while(itable_nextkey(a->running, &pid, (void **) &r)) {
+		struct process_info *p = process_waitpid(pid, 0);
+		if(p) {
+			list_push_tail(done, r);
+			list_push_tail(done, p);
+		}
+	}
+
+	while((r = list_pop_head(done))) {
+		struct process_info *p = list_pop_head(done);
+		async_complete(q, r, p);
+		free(p);
+	}
+
+	list_delete(done);
+}
+
+batch_job_id_t batch_job_async_submit(struct batch_queue *q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources)
+{
+	struct batch_job_async *a = q->async;
+
+	struct async_request *r = calloc(1, sizeof(*r));
+	r->id        = BATCH_JOB_ASYNC_FLAG | a->next_id++;
+	r->state     = ASYNC_WAITING;
+	r->cmd       = xxstrdup(cmd);
+	r->inputs    = extra_input_files ? xxstrdup(extra_input_files) : NULL;
+	r->outputs   = extra_output_files ? xxstrdup(extra_output_files) : NULL;
+	r->envlist   = envlist ? jx_copy(envlist) : NULL;
+	r->resources = resources ? rmsummary_copy(resources) : NULL;
+	r->options   = options_copy(q->options);
+	r->submitted = time(0);
+	r->pid       = -1;
+	r->fd        = -1;
+
+	itable_insert(a->requests, r->id, r);
+	list_push_tail(a->waiting, r);
+
+	async_collect(q);
+	async_dispatch(q);
+
+	debug(D_BATCH, "job %" PRIbjid " queued for submission", r->id);
+
+	return r->id;
+}
+
+batch_job_id_t batch_job_async_wait(struct batch_queue *q, struct batch_job_info *info, time_t stoptime)
+{
+	struct batch_job_async *a = q->async;
+
+	while(1) {
+		async_collect(q);
+		async_dispatch(q);
+
+		struct async_request *r = list_pop_head(a->failed);
+		if(r) {
+			batch_job_id_t jobid = r->id;
+
+			memset(info, 0, sizeof(*info));
+			info->submitted       = r->submitted;
+			info->finished        = time(0);
+			info->exited_normally = 0;
+			info->exit_signal     = r->removed ? SIGKILL : 0;
+
+			itable_remove(a->requests, jobid);
+			request_delete(r);
+
+			return jobid;
+		}
+
+		int in_flight = list_size(a->waiting) + itable_size(a->running);
+
+		/* while submissions are in flight, return often from the module to collect them. */
+		time_t module_stoptime = stoptime;
+		if(in_flight > 0 && (stoptime == 0 || stoptime > time(0) + 1)) {
+			module_stoptime = time(0) + 1;
+		}
+
+		batch_job_id_t jobid = q->module->job.wait(q, info, module_stoptime);
+
+		if(jobid > 0) {
+			r = itable_lookup(a->by_real_id, jobid);
+			if(!r && in_flight > 0) {
+				/* the job finished before we read its id from its submitter. */
+				async_collect(q);
+				r = itable_lookup(a->by_real_id, jobid);
+			}
+
+			if(r) {
+				itable_remove(a->by_real_id, jobid);
+				itable_remove(a->requests, r->id);
+				jobid = r->id;
+				request_delete(r);
+			}
+
+			return jobid;
+		}
+
+		if(in_flight < 1)
+			return jobid;
+
+		/* the module returned early only because of the submissions in
+		 * flight, so we keep waiting until the stoptime of the caller. */
+		if(stoptime != 0 && time(0) >= stoptime)
+			return -1;
+
+		if(jobid < 0 && process_pending()) {
+			/* a process finished: if not a submitter, the caller has to reap it. */
+			async_collect(q);
+			if(process_pending())
+				return -1;
+		} else if(jobid == 0) {
+			/* nothing in the batch system yet, wait for a submitter to finish. */
+			struct process_info *p = process_wait(1);
+			if(p)
+				process_putback(p);
+		}
+	}
+}
+
+int batch_job_async_remove(struct batch_queue *q, batch_job_id_t jobid)
+{
+	struct batch_job_async *a = q->async;
+
+	struct async_request *r = itable_lookup(a->requests, jobid);
+	if(!r)
+		return q->module->job.remove(q, jobid);
+
+	switch(r->state) {
+		case ASYNC_WAITING:
+			list_remove(a->waiting, r);
+			r->removed = 1;
+			request_fail(a, r);
+			return 1;
+		case ASYNC_RUNNING:
+			/* the job is removed when the submitter returns its id. */
+			r->removed = 1;
+			return 1;
+		case ASYNC_SUBMITTED:
+			r->removed = 1;
+			return q->module->job.remove(q, r->real_id);
+		case ASYNC_FAILED:
+		default:
+			return 0;
+	}
+}
+
+void batch_job_async_delete(struct batch_queue *q)
+{
+	struct batch_job_async *a = q->async;
+	if(!a)
+		return;
+
+	/* submissions in progress are interrupted. Their jobs may still reach the batch system. */
+	uint64_t pid;
+	struct async_request *r;
+	itable_firstkey(a->running);
+	while(itable_nextkey(a->running, &pid, (void **) &r)) {
+		debug(D_BATCH, "terminating submitter %d", (int) pid);
+		kill(pid, SIGTERM);
+		struct process_info *p = process_waitpid(pid, 5);
+		free(p);
+		close(r->fd);
+	}
+
+	uint64_t id;
+	itable_firstkey(a->requests);
+	while(itable_nextkey(a->requests, &id, (void **) &r)) {
+		request_delete(r);
+	}
+
+	list_delete(a->waiting);
+	list_delete(a->failed);
+	itable_delete(a->running);
+	itable_delete(a->requests);
+	itable_delete(a->by_real_id);
+	free(a);
+
+	q->async = NULL;
+}
+
+/* vim: set noexpandtab tabstop=4: */
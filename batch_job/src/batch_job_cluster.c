@@ -12,6 +12,7 @@ See the file COPYING for details.
 #include "process.h"
 #include "xxmalloc.h"
 #include "jx.h"
+#include "list.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -19,14 +20,38 @@ See the file COPYING for details.
 #include <errno.h>
 #include <ctype.h>
 
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+
 #include <sys/stat.h>
 
+#if defined(CCTOOLS_OPSYS_LINUX)
+#include <sys/inotify.h>
+#endif
+
 static char * cluster_name = NULL;
 static char * cluster_submit_cmd = NULL;
 static char * cluster_remove_cmd = NULL;
 static char * cluster_options = NULL;
 static char * cluster_jobname_var = NULL;
 
+/* Seconds between scans of the directory for status files, without events. */
+#define CLUSTER_SCAN_INTERVAL 1
+
+/* Seconds between scans of the directory for status files, with events. */
+#define CLUSTER_RESCAN_INTERVAL 30
+
+#define CLUSTER_EVENTS_BUFFER_SIZE (64*1024)
+
+struct cluster_state {
+	int inotify_fd;
+	time_t last_scan;
+	int scan_interval;
+	struct list *candidates;   /* ids of jobs whose status file has changed. */
+	struct list *scanned;      /* ids of jobs with a status file found by a scan. */
+};
+
 /*
 Principle of operation:
 Each batch job that we submit uses a wrapper file.
@@ -43,6 +68,15 @@ which batch_job_cluster_wait then periodically polls to observe completion.
 While this is not particularly elegant, there is no widely
 portable API for querying the state of a batch job in PBS-like systems.
 This method is simple, cheap, and reasonably effective.
+
+To find out which status files have changed, batch_job_cluster_wait
+uses inotify on the current directory where available, and only reads
+the status files named by its events. The directory is also listed every
+CLUSTER_RESCAN_INTERVAL seconds, or when events are lost, in case some were
+missed. Events are not generated for files written by other hosts on
+network filesystems, so once a listing finds a job finished that no event
+reported, or without inotify, the directory is listed every
+CLUSTER_SCAN_INTERVAL seconds instead.
 */
 
 /*
@@ -50,15 +84,19 @@ setup_batch_wrapper creates the wrapper file if necessary,
 returning true on success and false on failure.
 */
 
-static int setup_batch_wrapper(struct batch_queue *q, const char *sysname )
+static int setup_batch_wrapper(struct batch_queue *q, const char *sysname, int array )
 {
 	char wrapperfile[PATH_MAX];
-	snprintf(wrapperfile, PATH_MAX, "%s.wrapper", sysname);
+	snprintf(wrapperfile, PATH_MAX, array ? "%s.array.wrapper" : "%s.wrapper", sysname);
 
 	if(access(wrapperfile, R_OK | X_OK) == 0) return 1;
 
-	FILE *file = fopen(wrapperfile, "w");
+	// Written under a temporary name, as concurrent submitters may be creating it too.
+	char *tmpfile = string_format("%s.%d", wrapperfile, (int) getpid());
+
+	FILE *file = fopen(tmpfile, "w");
 	if(!file) {
+		free(tmpfile);
 		return 0;
 	}
 	fchmod(fileno(file), 0755);
@@ -68,7 +106,13 @@ static int setup_batch_wrapper(struct batch_queue *q, const char *sysname )
 	fprintf(file, "#!/bin/sh\n");
 	fprintf(file, "#$ -S /bin/sh\n");
 
-	if(q->type == BATCH_QUEUE_TYPE_SLURM){
+	if(array) {
+		// Elements of an array are named by the id of the array and their index.
+		// SGE sets JOB_ID to the id of the array. PBS_JOBID looks like 1234[5].server
+		fprintf(file, "[ -n \"${SLURM_ARRAY_JOB_ID}\" ] && JOB_ID=${SLURM_ARRAY_JOB_ID}\n");
+		fprintf(file, "[ -n \"${PBS_JOBID}\" ] && JOB_ID=`echo ${PBS_JOBID} | cut -d [ -f 1 | cut -d . -f 1`\n");
+		fprintf(file, "TASK_ID=${SGE_TASK_ID:-${SLURM_ARRAY_TASK_ID:-${PBS_ARRAY_INDEX:-${PBS_ARRAYID}}}}\n");
+	} else if(q->type == BATCH_QUEUE_TYPE_SLURM){
 		fprintf(file, "[ -n \"${SLURM_JOB_ID}\" ] && JOB_ID=`echo ${SLURM_JOB_ID} | cut -d . -f 1`\n");
 	} else {
 		// Some systems set PBS_JOBID, some set JOBID.
@@ -80,7 +124,11 @@ static int setup_batch_wrapper(struct batch_queue *q, const char *sysname )
 	}
 
 	// Each job writes out to its own log file.
-	fprintf(file, "logfile=%s.status.${JOB_ID}\n", sysname);
+	if(array) {
+		fprintf(file, "logfile=%s.status.${JOB_ID}.${TASK_ID}\n", sysname);
+	} else {
+		fprintf(file, "logfile=%s.status.${JOB_ID}\n", sysname);
+	}
 	fprintf(file, "starttime=`date +%%s`\n");
 	fprintf(file, "cat > $logfile <<EOF\n");
 	fprintf(file, "start $starttime\n");
@@ -96,36 +144,53 @@ static int setup_batch_wrapper(struct batch_queue *q, const char *sysname )
 	fprintf(file, "EOF\n");
 	fclose(file);
 
-	return 1;
-}
-
-static batch_job_id_t batch_job_cluster_submit (struct batch_queue * q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources )
-{
-	batch_job_id_t jobid;
-	struct batch_job_info *info;
-	const char *options = hash_table_lookup(q->options, "batch-options");
-
-	if(!setup_batch_wrapper(q, cluster_name)) {
-		debug(D_NOTICE|D_BATCH,"couldn't setup wrapper file: %s",strerror(errno));
-		return 0;
+	int result = rename(tmpfile, wrapperfile);
+	if(result < 0) {
+		unlink(tmpfile);
 	}
+	free(tmpfile);
 
-	/*
-	Use the basename of the first word in the command line as a name for the job.
-	Re the PBS qsub manpage, the -N name must start with a letter and be <= 15 characters long.
-	Unfortunately, work_queue_worker hits this limit.
-	*/
+	return result == 0;
+}
+
+/*
+Use the basename of the first word in the command line as a name for the job.
+Re the PBS qsub manpage, the -N name must start with a letter and be <= 15 characters long.
+Unfortunately, work_queue_worker hits this limit.
+*/
 
+static char *cluster_job_name(const char *cmd)
+{
 	char *firstword = strdup(cmd);
 
 	char *end = strchr(firstword, ' ');
 	if(end) *end = 0;
-		
+
 	char *submit_job_name = strdup(string_front(path_basename(firstword),15));
 	if(!isalpha(submit_job_name[0])) submit_job_name[0] = 'X';
 
 	free(firstword);
 
+	return submit_job_name;
+}
+
+/*
+Run the submit command, returning the id that the batch system gave to the
+job, or to the array of jobs.
+*/
+
+static batch_job_id_t cluster_submit_command(struct batch_queue *q, const char *cmd, struct jx *envlist, const char *array_option)
+{
+	batch_job_id_t jobid;
+	const char *options = hash_table_lookup(q->options, "batch-options");
+
+	if(!setup_batch_wrapper(q, cluster_name, array_option != NULL)) {
+		debug(D_NOTICE|D_BATCH,"couldn't setup wrapper file: %s",strerror(errno));
+		return -1;
+	}
+
+	char *submit_job_name = cluster_job_name(cmd);
+
 	/*
 	Experiment shows that passing environment variables
 	through the command-line doesn't work, due to multiple
@@ -143,13 +208,15 @@ static batch_job_id_t batch_job_cluster_submit (struct batch_queue * q, const ch
 	*/
 	setenv("BATCH_JOB_COMMAND", cmd, 1);
 
-	char *command = string_format("%s %s %s '%s' %s %s.wrapper",
+	char *command = string_format("%s %s %s '%s' %s %s %s%s",
 		cluster_submit_cmd,
 		cluster_options,
 		cluster_jobname_var,
 		submit_job_name,
+		array_option ? array_option : "",
 		options ? options : "",
-		cluster_name);
+		cluster_name,
+		array_option ? ".array.wrapper" : ".wrapper");
 
 	free(submit_job_name);
 
@@ -165,14 +232,10 @@ static batch_job_id_t batch_job_cluster_submit (struct batch_queue * q, const ch
 	char line[BATCH_JOB_LINE_MAX] = "";
 	while(fgets(line, sizeof(line), file)) {
 		if(sscanf(line, "Your job %" SCNbjid, &jobid) == 1
+		|| sscanf(line, "Your job-array %" SCNbjid, &jobid) == 1
 		|| sscanf(line, "Submitted batch job %" SCNbjid, &jobid) == 1
 		|| sscanf(line, "%" SCNbjid, &jobid) == 1 ) {
-			debug(D_BATCH, "job %" PRIbjid " submitted", jobid);
 			pclose(file);
-			info = malloc(sizeof(*info));
-			memset(info, 0, sizeof(*info));
-			info->submitted = time(0);
-			itable_insert(q->job_table, jobid, info);
 			return jobid;
 		}
 	}
@@ -186,48 +249,270 @@ static batch_job_id_t batch_job_cluster_submit (struct batch_queue * q, const ch
 	return -1;
 }
 
-static batch_job_id_t batch_job_cluster_wait (struct batch_queue * q, struct batch_job_info * info_out, time_t stoptime)
+static void cluster_add_job(struct batch_queue *q, batch_job_id_t jobid)
+{
+	struct batch_job_info *info = malloc(sizeof(*info));
+	memset(info, 0, sizeof(*info));
+	info->submitted = time(0);
+	itable_insert(q->job_table, jobid, info);
+}
+
+static batch_job_id_t batch_job_cluster_submit (struct batch_queue * q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources )
+{
+	batch_job_id_t jobid = cluster_submit_command(q, cmd, envlist, NULL);
+
+	if(jobid < 0)
+		return -1;
+
+	debug(D_BATCH, "job %" PRIbjid " submitted", jobid);
+	cluster_add_job(q, jobid);
+
+	return jobid;
+}
+
+/*
+Option that makes the submit command create an array of jobs with indices
+1 to count, or NULL if the batch system does not support arrays.
+*/
+
+static char *cluster_array_option(struct batch_queue *q, int count)
+{
+	switch(q->type) {
+		case BATCH_QUEUE_TYPE_SGE:
+		case BATCH_QUEUE_TYPE_TORQUE:
+			return string_format("-t 1-%d", count);
+		case BATCH_QUEUE_TYPE_PBS:
+			return string_format("-J 1-%d", count);
+		case BATCH_QUEUE_TYPE_SLURM:
+			return string_format("--array=1-%d", count);
+		default:
+			return NULL;
+	}
+}
+
+static int batch_job_cluster_submit_array (struct batch_queue *q, int count, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources, batch_job_id_t *jobids)
+{
+	/* PBS does not accept arrays of a single job. */
+	if(count == 1) {
+		jobids[0] = batch_job_cluster_submit(q, cmd, extra_input_files, extra_output_files, envlist, resources);
+		return jobids[0] < 0 ? -1 : 1;
+	}
+
+	char *array_option = cluster_array_option(q, count);
+	if(!array_option)
+		return -1;
+
+	batch_job_id_t arrayid = cluster_submit_command(q, cmd, envlist, array_option);
+	free(array_option);
+
+	if(arrayid < 0)
+		return -1;
+
+	debug(D_BATCH, "job array %" PRIbjid " of %d jobs submitted", arrayid, count);
+
+	int i;
+	for(i = 0; i < count; i++) {
+		jobids[i] = batch_job_array_element(arrayid, i + 1);
+		cluster_add_job(q, jobids[i]);
+	}
+
+	return count;
+}
+
+static char *cluster_status_file(batch_job_id_t jobid)
+{
+	if(batch_job_is_array_element(jobid)) {
+		return string_format("%s.status.%" PRIbjid ".%" PRIbjid, cluster_name, batch_job_array_of(jobid), batch_job_array_index(jobid));
+	} else {
+		return string_format("%s.status.%" PRIbjid, cluster_name, jobid);
+	}
+}
+
+/*
+Read the status file of a job, updating its info. Returns true if the job
+has finished.
+*/
+
+static int cluster_read_status(batch_job_id_t jobid, struct batch_job_info *info)
 {
-	struct batch_job_info *info;
-	batch_job_id_t jobid;
 	int t, c;
 
+	char *statusfile = cluster_status_file(jobid);
+	FILE *file = fopen(statusfile, "r");
+	if(!file) {
+		debug(D_BATCH, "could not open status file \"%s\"", statusfile);
+		free(statusfile);
+		return 0;
+	}
+
+	char line[BATCH_JOB_LINE_MAX];
+	while(fgets(line, sizeof(line), file)) {
+		if(sscanf(line, "start %d", &t)) {
+			info->started = t;
+		} else if(sscanf(line, "stop %d %d", &c, &t) == 2) {
+			debug(D_BATCH, "job %" PRIbjid " complete", jobid);
+			if(!info->started)
+				info->started = t;
+			info->finished = t;
+			info->exited_normally = 1;
+			info->exit_code = c;
+		}
+	}
+	fclose(file);
+
+	if(info->finished != 0) {
+		unlink(statusfile);
+	}
+
+	free(statusfile);
+
+	return info->finished != 0;
+}
+
+/* Returns the job id of a status file name, or -1 if name is not a status file. */
+static batch_job_id_t cluster_jobid_of_status_file(const char *name)
+{
+	batch_job_id_t jobid, index;
+	char *prefix = string_format("%s.status.", cluster_name);
+
+	int n = strlen(prefix);
+	int match = strncmp(name, prefix, n) == 0;
+	free(prefix);
+
+	if(!match)
+		return -1;
+
+	int fields = sscanf(name + n, "%" SCNbjid ".%" SCNbjid, &jobid, &index);
+	if(fields == 2)
+		return batch_job_array_element(jobid, index);
+	else if(fields == 1)
+		return jobid;
+	else
+		return -1;
+}
+
+static void cluster_add_candidate(struct batch_queue *q, struct list *candidates, batch_job_id_t jobid)
+{
+	if(jobid < 0 || !itable_lookup(q->job_table, jobid))
+		return;
+
+	batch_job_id_t *c = malloc(sizeof(*c));
+	*c = jobid;
+	list_push_tail(candidates, c);
+}
+
+/*
+Add the jobs that have a status file in the current directory to candidates,
+to find those whose events were missed or lost.
+*/
+
+static void cluster_scan_status_files(struct batch_queue *q, struct list *candidates)
+{
+	struct cluster_state *state = q->data;
+	state->last_scan = time(0);
+
+	DIR *dir = opendir(".");
+	if(!dir)
+		return;
+
+	struct dirent *d;
+	while((d = readdir(dir))) {
+		cluster_add_candidate(q, candidates, cluster_jobid_of_status_file(d->d_name));
+	}
+
+	closedir(dir);
+}
+
+/*
+Add the jobs that have written to their status files since the last call.
+*/
+
+static void cluster_read_events(struct batch_queue *q)
+{
+#if defined(CCTOOLS_OPSYS_LINUX)
+	struct cluster_state *state = q->data;
+	char buffer[CLUSTER_EVENTS_BUFFER_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	if(state->inotify_fd < 0)
+		return;
+
 	while(1) {
-		UINT64_T ujobid;
-		itable_firstkey(q->job_table);
-		while(itable_nextkey(q->job_table, &ujobid, (void **) &info)) {
-			jobid = ujobid;
-			char *statusfile = string_format("%s.status.%" PRIbjid, cluster_name, jobid);
-			FILE *file = fopen(statusfile, "r");
-			if(file) {
-				char line[BATCH_JOB_LINE_MAX];
-				while(fgets(line, sizeof(line), file)) {
-					if(sscanf(line, "start %d", &t)) {
-						info->started = t;
-					} else if(sscanf(line, "stop %d %d", &c, &t) == 2) {
-						debug(D_BATCH, "job %" PRIbjid " complete", jobid);
-						if(!info->started)
-							info->started = t;
-						info->finished = t;
-						info->exited_normally = 1;
-						info->exit_code = c;
-					}
-				}
-				fclose(file);
-
-				if(info->finished != 0) {
-					unlink(statusfile);
-					info = itable_remove(q->job_table, jobid);
-					*info_out = *info;
-					free(info);
-					free(statusfile);
-					return jobid;
-				}
-			} else {
-				debug(D_BATCH, "could not open status file \"%s\"", statusfile);
+		ssize_t n = read(state->inotify_fd, buffer, sizeof(buffer));
+		if(n <= 0) {
+			if(n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+
+		char *p;
+		for(p = buffer; p < buffer + n; ) {
+			struct inotify_event *ev = (struct inotify_event *) p;
+
+			if(ev->mask & IN_Q_OVERFLOW) {
+				debug(D_BATCH, "lost events for status files, scanning the directory.");
+				cluster_scan_status_files(q, state->candidates);
+			} else if(ev->len > 0) {
+				cluster_add_candidate(q, state->candidates, cluster_jobid_of_status_file(ev->name));
 			}
 
-			free(statusfile);
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+#endif
+}
+
+/*
+Read the status files of the jobs in candidates, until one has finished.
+Returns its id, or -1 if none has.
+*/
+
+static batch_job_id_t cluster_read_candidates(struct batch_queue *q, struct list *candidates, struct batch_job_info *info_out)
+{
+	struct batch_job_info *info;
+	batch_job_id_t *c;
+
+	while((c = list_pop_head(candidates))) {
+		batch_job_id_t jobid = *c;
+		free(c);
+
+		/* a job may be listed more than once, e.g. for its start and stop lines. */
+		info = itable_lookup(q->job_table, jobid);
+		if(!info)
+			continue;
+
+		if(cluster_read_status(jobid, info)) {
+			info = itable_remove(q->job_table, jobid);
+			*info_out = *info;
+			free(info);
+			return jobid;
+		}
+	}
+
+	return -1;
+}
+
+static batch_job_id_t batch_job_cluster_wait (struct batch_queue * q, struct batch_job_info * info_out, time_t stoptime)
+{
+	struct cluster_state *state = q->data;
+	batch_job_id_t jobid;
+
+	while(1) {
+		cluster_read_events(q);
+
+		jobid = cluster_read_candidates(q, state->candidates, info_out);
+		if(jobid >= 0)
+			return jobid;
+
+		if(time(0) - state->last_scan >= state->scan_interval)
+			cluster_scan_status_files(q, state->scanned);
+
+		jobid = cluster_read_candidates(q, state->scanned, info_out);
+		if(jobid >= 0) {
+			if(state->scan_interval > CLUSTER_SCAN_INTERVAL) {
+				debug(D_BATCH, "job %" PRIbjid " finished without an event, scanning for status files every %d seconds.", jobid, CLUSTER_SCAN_INTERVAL);
+				state->scan_interval = CLUSTER_SCAN_INTERVAL;
+			}
+			return jobid;
 		}
 
 		if(itable_size(q->job_table) <= 0)
@@ -239,7 +524,17 @@ static batch_job_id_t batch_job_cluster_wait (struct batch_queue * q, struct bat
 		if(process_pending())
 			return -1;
 
-		sleep(1);
+		/* wake up as soon as a status file is written, but at least once a
+		 * second to check on stoptime and pending processes. */
+		if(state->inotify_fd >= 0) {
+			struct pollfd pfd;
+			pfd.fd      = state->inotify_fd;
+			pfd.events  = POLLIN;
+			pfd.revents = 0;
+			poll(&pfd, 1, 1000);
+		} else {
+			sleep(1);
+		}
 	}
 
 	return -1;
@@ -260,7 +555,27 @@ static int batch_job_cluster_remove (struct batch_queue *q, batch_job_id_t jobid
 	info->exited_normally = 0;
 	info->exit_signal = 1;
 
-	char *command = string_format("%s %" PRIbjid, cluster_remove_cmd, jobid);
+	char *command;
+	if(batch_job_is_array_element(jobid)) {
+		batch_job_id_t arrayid = batch_job_array_of(jobid);
+		batch_job_id_t index   = batch_job_array_index(jobid);
+
+		switch(q->type) {
+			case BATCH_QUEUE_TYPE_SGE:
+				command = string_format("%s %" PRIbjid " -t %" PRIbjid, cluster_remove_cmd, arrayid, index);
+				break;
+			case BATCH_QUEUE_TYPE_SLURM:
+				command = string_format("%s %" PRIbjid "_%" PRIbjid, cluster_remove_cmd, arrayid, index);
+				break;
+			default:
+				command = string_format("%s '%" PRIbjid "[%" PRIbjid "]'", cluster_remove_cmd, arrayid, index);
+				break;
+		}
+	} else {
+		command = string_format("%s %" PRIbjid, cluster_remove_cmd, jobid);
+	}
+
+	debug(D_BATCH, "%s", command);
 	system(command);
 	free(command);
 
@@ -330,8 +645,33 @@ static int batch_queue_cluster_create (struct batch_queue *q)
 			return -1;
 	}
 
-	if(cluster_name && cluster_submit_cmd && cluster_remove_cmd && cluster_options && cluster_jobname_var)
+	if(cluster_name && cluster_submit_cmd && cluster_remove_cmd && cluster_options && cluster_jobname_var) {
+		struct cluster_state *state = malloc(sizeof(*state));
+		state->candidates    = list_create();
+		state->scanned       = list_create();
+		state->last_scan     = 0;
+		state->scan_interval = CLUSTER_SCAN_INTERVAL;
+		state->inotify_fd    = -1;
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+		state->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(state->inotify_fd >= 0 && inotify_add_watch(state->inotify_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			close(state->inotify_fd);
+			state->inotify_fd = -1;
+		}
+
+		if(state->inotify_fd < 0) {
+			debug(D_BATCH, "could not watch for status files, polling instead: %s", strerror(errno));
+		} else {
+			state->scan_interval = CLUSTER_RESCAN_INTERVAL;
+		}
+#endif
+
+		batch_queue_set_feature(q, "async_submit", "yes");
+
+		q->data = state;
 		return 0;
+	}
 
 	if(!cluster_name)
 		debug(D_NOTICE, "Environment variable BATCH_QUEUE_CLUSTER_NAME unset\n");
@@ -347,7 +687,26 @@ static int batch_queue_cluster_create (struct batch_queue *q)
 	return -1;
 }
 
-batch_queue_stub_free(cluster);
+static int batch_queue_cluster_free (struct batch_queue *q)
+{
+	struct cluster_state *state = q->data;
+	if(!state)
+		return 0;
+
+	if(state->inotify_fd >= 0)
+		close(state->inotify_fd);
+
+	list_free(state->candidates);
+	list_delete(state->candidates);
+	list_free(state->scanned);
+	list_delete(state->scanned);
+	free(state);
+
+	q->data = NULL;
+
+	return 0;
+}
+
 batch_queue_stub_port(cluster);
 batch_queue_stub_option_update(cluster);
 
@@ -372,6 +731,7 @@ const struct batch_queue_module batch_queue_cluster = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		NULL,
 	},
 
 	{
@@ -398,6 +758,7 @@ const struct batch_queue_module batch_queue_moab = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		NULL,
 	},
 
 	{
@@ -424,6 +785,7 @@ const struct batch_queue_module batch_queue_sge = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		batch_job_cluster_submit_array,
 	},
 
 	{
@@ -450,6 +812,7 @@ const struct batch_queue_module batch_queue_pbs = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		batch_job_cluster_submit_array,
 	},
 
 	{
@@ -476,6 +839,7 @@ const struct batch_queue_module batch_queue_torque = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		batch_job_cluster_submit_array,
 	},
 
 	{
@@ -502,6 +866,7 @@ const struct batch_queue_module batch_queue_slurm = {
 		batch_job_cluster_submit,
 		batch_job_cluster_wait,
 		batch_job_cluster_remove,
+		batch_job_cluster_submit_array,
 	},
 
 	{
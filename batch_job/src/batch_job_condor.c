@@ -19,6 +19,7 @@ See the file COPYING for details.
 #include <string.h>
 #include <signal.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 static int setup_condor_wrapper(const char *wrapperfile)
 {
@@ -27,18 +28,26 @@ static int setup_condor_wrapper(const char *wrapperfile)
 	if(access(wrapperfile, R_OK | X_OK) == 0)
 		return 0;
 
-	file = fopen(wrapperfile, "w");
-	if(!file)
+	/* written under a temporary name, as concurrent submitters may be creating it too. */
+	char *tmpfile = string_format("%s.%d", wrapperfile, (int) getpid());
+
+	file = fopen(tmpfile, "w");
+	if(!file) {
+		free(tmpfile);
 		return -1;
+	}
 
 	fprintf(file, "#!/bin/sh\n");
 	fprintf(file, "eval \"$@\"\n");
 	fprintf(file, "exit $?\n");
 	fclose(file);
 
-	chmod(wrapperfile, 0755);
+	chmod(tmpfile, 0755);
 
-	return 0;
+	int result = rename(tmpfile, wrapperfile);
+	free(tmpfile);
+
+	return result;
 }
 
 static char *blacklisted_expression(struct batch_queue *q) {
@@ -88,7 +97,12 @@ static char *blacklisted_expression(struct batch_queue *q) {
 }
 
 
-static batch_job_id_t batch_job_condor_submit (struct batch_queue *q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources )
+/*
+Submit count copies of the job as a single cluster, with one queue statement.
+Returns the id of the cluster, and the jobs in it are numbered 0 to count-1.
+*/
+
+static batch_job_id_t condor_submit_cluster (struct batch_queue *q, int count, const char *cmd, const char *extra_input_files, struct jx *envlist, const struct rmsummary *resources )
 {
 	FILE *file;
 	int njobs;
@@ -100,9 +114,18 @@ static batch_job_id_t batch_job_condor_submit (struct batch_queue *q, const char
 		return -1;
 	}
 
-	file = fopen("condor.submit", "w");
+	/* asynchronous submitters run at the same time, so each one needs its own submit file. */
+	char *submit_file;
+	if(hash_table_lookup(q->options, "async-submitter")) {
+		submit_file = string_format("condor.submit.%d", (int) getpid());
+	} else {
+		submit_file = xxstrdup("condor.submit");
+	}
+
+	file = fopen(submit_file, "w");
 	if(!file) {
-		debug(D_BATCH, "could not create condor.submit: %s", strerror(errno));
+		debug(D_BATCH, "could not create %s: %s", submit_file, strerror(errno));
+		free(submit_file);
 		return -1;
 	}
 
@@ -179,30 +202,79 @@ static batch_job_id_t batch_job_condor_submit (struct batch_queue *q, const char
 	if(options)
 		fprintf(file, "%s\n", options);
 
-	fprintf(file, "queue\n");
+	if(count > 1) {
+		fprintf(file, "queue %d\n", count);
+	} else {
+		fprintf(file, "queue\n");
+	}
 	fclose(file);
 
-	file = popen("condor_submit condor.submit", "r");
-	if(!file)
-		return -1;
+	char *command = string_format("condor_submit %s", submit_file);
+	file = popen(command, "r");
+	free(command);
 
-	char line[BATCH_JOB_LINE_MAX];
-	while(fgets(line, sizeof(line), file)) {
-		if(sscanf(line, "%d job(s) submitted to cluster %d", &njobs, &jobid) == 2) {
-			pclose(file);
-			debug(D_BATCH, "job %d submitted to condor", jobid);
-			struct batch_job_info *info;
-			info = malloc(sizeof(*info));
-			memset(info, 0, sizeof(*info));
-			info->submitted = time(0);
-			itable_insert(q->job_table, jobid, info);
-			return jobid;
+	jobid = -1;
+	if(file) {
+		char line[BATCH_JOB_LINE_MAX];
+		while(fgets(line, sizeof(line), file)) {
+			if(sscanf(line, "%d job(s) submitted to cluster %d", &njobs, &jobid) == 2) {
+				if(njobs != count) {
+					debug(D_BATCH, "%d jobs submitted to condor cluster %d, but %d were expected.", njobs, jobid, count);
+					jobid = -1;
+				}
+				break;
+			}
 		}
+		pclose(file);
 	}
 
-	pclose(file);
-	debug(D_BATCH, "failed to submit job to condor!");
-	return -1;
+	if(strcmp(submit_file, "condor.submit")) {
+		unlink(submit_file);
+	}
+	free(submit_file);
+
+	if(jobid < 0)
+		debug(D_BATCH, "failed to submit job to condor!");
+
+	return jobid;
+}
+
+static void condor_add_job(struct batch_queue *q, batch_job_id_t jobid)
+{
+	struct batch_job_info *info;
+	info = malloc(sizeof(*info));
+	memset(info, 0, sizeof(*info));
+	info->submitted = time(0);
+	itable_insert(q->job_table, jobid, info);
+}
+
+static batch_job_id_t batch_job_condor_submit (struct batch_queue *q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources )
+{
+	batch_job_id_t jobid = condor_submit_cluster(q, 1, cmd, extra_input_files, envlist, resources);
+	if(jobid < 0)
+		return -1;
+
+	debug(D_BATCH, "job %" PRIbjid " submitted to condor", jobid);
+	condor_add_job(q, jobid);
+
+	return jobid;
+}
+
+static int batch_job_condor_submit_array (struct batch_queue *q, int count, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources, batch_job_id_t *jobids)
+{
+	batch_job_id_t cluster = condor_submit_cluster(q, count, cmd, extra_input_files, envlist, resources);
+	if(cluster < 0)
+		return -1;
+
+	debug(D_BATCH, "%d jobs submitted to condor cluster %" PRIbjid, count, cluster);
+
+	int i;
+	for(i = 0; i < count; i++) {
+		jobids[i] = batch_job_array_element(cluster, i);
+		condor_add_job(q, jobids[i]);
+	}
+
+	return count;
 }
 
 static batch_job_id_t batch_job_condor_wait (struct batch_queue * q, struct batch_job_info * info_out, time_t stoptime)
@@ -242,6 +314,11 @@ static batch_job_id_t batch_job_condor_wait (struct batch_queue * q, struct batc
 
 				current = mktime(&tm);
 
+				/* jobs submitted with a multiple queue statement are identified by their cluster and proc. */
+				batch_job_id_t element = batch_job_array_element(jobid, proc);
+				if(itable_lookup(q->job_table, element))
+					jobid = element;
+
 				info = itable_lookup(q->job_table, jobid);
 				if(!info) {
 					info = malloc(sizeof(*info));
@@ -313,7 +390,12 @@ static batch_job_id_t batch_job_condor_wait (struct batch_queue * q, struct batc
 
 static int batch_job_condor_remove (struct batch_queue *q, batch_job_id_t jobid)
 {
-	char *command = string_format("condor_rm %" PRIbjid, jobid);
+	char *command;
+	if(batch_job_is_array_element(jobid)) {
+		command = string_format("condor_rm %" PRIbjid ".%" PRIbjid, batch_job_array_of(jobid), batch_job_array_index(jobid));
+	} else {
+		command = string_format("condor_rm %" PRIbjid, jobid);
+	}
 
 	debug(D_BATCH, "%s", command);
 	FILE *file = popen(command, "r");
@@ -336,6 +418,7 @@ static int batch_queue_condor_create (struct batch_queue *q)
 	batch_queue_set_feature(q, "output_directories", NULL);
 	batch_queue_set_feature(q, "batch_log_name", "%s.condorlog");
 	batch_queue_set_feature(q, "autosize", "yes");
+	batch_queue_set_feature(q, "async_submit", "yes");
 
 	return 0;
 }
@@ -365,6 +448,7 @@ const struct batch_queue_module batch_queue_condor = {
 		batch_job_condor_submit,
 		batch_job_condor_wait,
 		batch_job_condor_remove,
+		batch_job_condor_submit_array,
 	},
 
 	{
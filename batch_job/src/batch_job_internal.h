@@ -21,6 +21,22 @@ See the file COPYING for details.
 
 #define BATCH_JOB_LINE_MAX 8192
 
+/*
+A job that is part of an array is identified by the id the batch system
+gave to the array, and its index in the array. Bit 62 is set so that these
+ids never collide with the ids of single jobs. Arrays hold at most
+BATCH_JOB_ARRAY_MAX jobs, so that their indices fit whether they start at 0
+(condor) or at 1 (cluster).
+*/
+#define BATCH_JOB_ARRAY_FLAG       (((batch_job_id_t) 1) << 62)
+#define BATCH_JOB_ARRAY_INDEX_BITS 20
+#define BATCH_JOB_ARRAY_MAX        ((1 << BATCH_JOB_ARRAY_INDEX_BITS) - 1)
+
+#define batch_job_array_element(array, index) (BATCH_JOB_ARRAY_FLAG | (((batch_job_id_t) (array)) << BATCH_JOB_ARRAY_INDEX_BITS) | (index))
+#define batch_job_is_array_element(id)        (((id) & BATCH_JOB_ARRAY_FLAG) != 0)
+#define batch_job_array_of(id)                (((id) & ~BATCH_JOB_ARRAY_FLAG) >> BATCH_JOB_ARRAY_INDEX_BITS)
+#define batch_job_array_index(id)             ((id) & BATCH_JOB_ARRAY_MAX)
+
 struct batch_queue_module {
 	batch_queue_type_t type;
 	char typestr[128];
@@ -34,6 +50,7 @@ struct batch_queue_module {
 		batch_job_id_t (*submit) (struct batch_queue *Q, const char *command, const char *inputs, const char *outputs, struct jx *env_list, const struct rmsummary *resources);
 		batch_job_id_t (*wait) (struct batch_queue *Q, struct batch_job_info *info, time_t stoptime);
 		int (*remove) (struct batch_queue *Q, batch_job_id_t id);
+		int (*submit_array) (struct batch_queue *Q, int count, const char *command, const char *inputs, const char *outputs, struct jx *env_list, const struct rmsummary *resources, batch_job_id_t *ids); /* optional, NULL if the system has no job arrays. */
 	} job;
 
 	struct {
@@ -57,8 +74,17 @@ struct batch_queue {
 	struct itable *output_table;
 	void *data; /* module user data */
 	const struct batch_queue_module *module;
+	struct batch_job_async *async; /* NULL unless the option async-submitters was set. */
 };
 
+/* Asynchronous submission, see batch_job_async.c */
+void batch_job_async_set_submitters(struct batch_queue *q, int submitters);
+int batch_job_async_enabled(struct batch_queue *q);
+batch_job_id_t batch_job_async_submit(struct batch_queue *q, const char *cmd, const char *extra_input_files, const char *extra_output_files, struct jx *envlist, const struct rmsummary *resources);
+batch_job_id_t batch_job_async_wait(struct batch_queue *q, struct batch_job_info *info, time_t stoptime);
+int batch_job_async_remove(struct batch_queue *q, batch_job_id_t jobid);
+void batch_job_async_delete(struct batch_queue *q);
+
 #define batch_queue_stub_create(name)  static int batch_queue_##name##_create (struct batch_queue *Q) { return 0; }
 #define batch_queue_stub_free(name)  static int batch_queue_##name##_free (struct batch_queue *Q) { return 0; }
 #define batch_queue_stub_port(name)  static int batch_queue_##name##_port (struct batch_queue *Q) { return 0; }
@@ -158,6 +158,7 @@ const struct batch_queue_module batch_queue_local = {
 		batch_job_local_submit,
 		batch_job_local_wait,
 		batch_job_local_remove,
+		NULL,
 	},
 
 	{
@@ -392,6 +392,7 @@ const struct batch_queue_module batch_queue_mesos = {
 		batch_job_mesos_submit,
 		batch_job_mesos_wait,
 		batch_job_mesos_remove,
+		NULL,
 	},
 
 	{
@@ -278,6 +278,7 @@ const struct batch_queue_module batch_queue_wq = {
 		batch_job_wq_submit,
 		batch_job_wq_wait,
 		batch_job_wq_remove,
+		NULL,
 	},
 
 	{
@@ -26,6 +26,7 @@ See the file COPYING for details.
 #include "path.h"
 #include "buffer.h"
 #include "rmsummary.h"
+#include "work_queue_factory_forecast.h"
 
 #include "jx.h"
 #include "jx_parse.h"
@@ -76,6 +77,13 @@ static int autosize = 0;
 static int worker_timeout = 300;
 static int consider_capacity = 0;
 
+static int predictive = 0;
+static int scale_down_delay = 120;
+static struct factory_forecast *forecast = NULL;
+
+static const char *simulate_log = NULL;
+static int simulated_startup = 60;
+
 static char *project_regex = 0;
 static char *submission_regex = 0;
 static char *foremen_regex = 0;
@@ -253,6 +261,11 @@ static int count_workers_needed( struct list *masters_list, int only_waiting )
 		int capacity = MIN(capacity_weighted, master_workers_capacity(j));
 		int tasks = tr+tw+tl;
 
+		// size for the tasks expected when new workers connect, not for the current ones.
+		if(forecast && !only_waiting) {
+			tasks = MAX(0, tasks + factory_forecast_tasks(forecast, j));
+		}
+
 		// first assume one task per worker
 		int need;
 		if(only_waiting) {
@@ -326,7 +339,7 @@ static void set_worker_resources_options( struct batch_queue *queue )
 	buffer_free(&b);
 }
 
-static int submit_worker( struct batch_queue *queue )
+static int submit_worker_jobs( struct batch_queue *queue, int count, batch_job_id_t *jobids )
 {
 	char *cmd;
 	const char *worker = "./work_queue_worker";
@@ -379,9 +392,14 @@ static int submit_worker( struct batch_queue *queue )
 		files = newfiles;
 	}
 
-	debug(D_WQ,"submitting worker: %s",cmd);
+	debug(D_WQ,"submitting %d workers: %s",count,cmd);
+
+	int submitted = batch_job_submit_array(queue,count,cmd,files,"output.log",batch_env,resources,jobids);
 
-	return batch_job_submit(queue,cmd,files,"output.log",batch_env,resources);
+	free(cmd);
+	free(files);
+
+	return submitted;
 }
 
 static void update_blacklisted_workers( struct batch_queue *queue, struct list *masters_list ) {
@@ -430,17 +448,19 @@ static void update_blacklisted_workers( struct batch_queue *queue, struct list *
 
 static int submit_workers( struct batch_queue *queue, struct itable *job_table, int count )
 {
+	batch_job_id_t *jobids = malloc(count*sizeof(*jobids));
+
+	int submitted = submit_worker_jobs(queue,count,jobids);
+
 	int i;
-	for(i=0;i<count;i++) {
-		int jobid = submit_worker(queue);
-		if(jobid>0) {
-			debug(D_WQ,"worker job %d submitted",jobid);
-			itable_insert(job_table,jobid,(void*)1);
-		} else {
-			break;
-		}
+	for(i=0;i<submitted;i++) {
+		debug(D_WQ,"worker job %"PRIbjid" submitted",jobids[i]);
+		itable_insert(job_table,jobids[i],(void*)1);
 	}
-	return i;
+
+	free(jobids);
+
+	return submitted;
 }
 
 void remove_all_workers( struct batch_queue *queue, struct itable *job_table )
@@ -571,6 +591,10 @@ struct jx *factory_to_jx(struct list *masters, struct list *foremen, int submitt
 	}
 	jx_insert(j, jx_string("foremen"), fs);
 
+	if(forecast) {
+		jx_insert(j, jx_string("forecast"), factory_forecast_to_jx(forecast));
+	}
+
 	return j;
 }
 
@@ -634,6 +658,9 @@ int read_config_file(const char *config_file) {
 
 	assign_new_value(new_autosize_option, autosize, autosize, int, JX_INTEGER, integer_value)
 
+	assign_new_value(new_predictive, predictive, predictive, int, JX_INTEGER, integer_value)
+	assign_new_value(new_scale_down_delay, scale_down_delay, scale-down-delay, int, JX_INTEGER, integer_value)
+
 	assign_new_value(new_factory_timeout_option, factory_timeout, factory-timeout, int, JX_INTEGER, integer_value)
 
 	assign_new_value(new_tasks_per_worker, tasks_per_worker, tasks-per-worker, double, JX_INTEGER, integer_value)
@@ -664,6 +691,11 @@ int read_config_file(const char *config_file) {
 		error_found = 1;
 	}
 
+	if(new_scale_down_delay < 0) {
+		debug(D_NOTICE, "%s: scale down delay (%d) is less than zero.\n", config_file, new_scale_down_delay);
+		error_found = 1;
+	}
+
 	if(new_factory_timeout_option < 0) {
 		debug(D_NOTICE, "%s: factory timeout (%d) is less than zero.\n", config_file, new_factory_timeout_option);
 		error_found = 1;
@@ -681,6 +713,8 @@ int read_config_file(const char *config_file) {
 	autosize         = new_autosize_option;
 	factory_timeout  = new_factory_timeout_option;
 	consider_capacity = new_consider_capacity;
+	predictive       = new_predictive;
+	scale_down_delay = new_scale_down_delay;
 
 	resources->cores  = new_num_cores_option;
 	resources->memory = new_num_memory_option;
@@ -723,6 +757,9 @@ int read_config_file(const char *config_file) {
 
 	fprintf(stdout, "tasks-per-worker: %" PRId64 "\n", tasks_per_worker > 0 ? tasks_per_worker : (resources->cores > 0 ? resources->cores : 1));
 	fprintf(stdout, "timeout: %d s\n", worker_timeout);
+	if(predictive) {
+		fprintf(stdout, "predictive: yes, scale-down-delay: %d s\n", scale_down_delay);
+	}
 	fprintf(stdout, "cores: %" PRId64 "\n", resources->cores > 0 ? resources->cores : 1);
 
 	if(condor_requirements) {
@@ -752,6 +789,60 @@ end:
 	return !error_found;
 }
 
+/*
+Create or delete the forecast when the option changes.
+*/
+
+static void update_forecast()
+{
+	if(predictive && !forecast) {
+		forecast = factory_forecast_create(factory_period);
+	} else if(!predictive && forecast) {
+		factory_forecast_delete(forecast);
+		forecast = NULL;
+	}
+
+	if(forecast) {
+		factory_forecast_set_scale_down_delay(forecast, scale_down_delay);
+	}
+}
+
+static int apply_workers_limits( int workers_needed )
+{
+	if(workers_needed > workers_max) {
+		debug(D_WQ,"applying maximum of %d workers",workers_max);
+		workers_needed = workers_max;
+	}
+
+	if(workers_needed < workers_min) {
+		debug(D_WQ,"applying minimum of %d workers",workers_min);
+		workers_needed = workers_min;
+	}
+
+	return workers_needed;
+}
+
+/*
+Number of new workers to submit this cycle to reach workers_needed.
+*/
+
+static int count_new_workers( int workers_needed, int workers_submitted, int workers_connected )
+{
+	int new_workers_needed = workers_needed - workers_submitted;
+
+	if(workers_per_cycle > 0 && new_workers_needed > workers_per_cycle) {
+		debug(D_WQ,"applying maximum workers per cycle of %d",workers_per_cycle);
+		new_workers_needed = workers_per_cycle;
+	}
+
+	if(workers_per_cycle > 0 && workers_submitted > new_workers_needed + workers_connected) {
+		debug(D_WQ,"waiting for %d previously submitted workers to connect", workers_submitted - workers_connected);
+		new_workers_needed = 0;
+	}
+
+	return new_workers_needed;
+}
+
 /*
 Main loop of work queue pool.  Determine the number of workers needed by our
 current list of masters, compare it to the number actually submitted, then
@@ -768,6 +859,9 @@ static void mainloop( struct batch_queue *queue )
 
 	int64_t factory_timeout_start = time(0);
 
+	int last_workers_connected = 0;
+	int workers_exited = 0;
+
 	while(!abort_flag) {
 
 		if(config_file && !read_config_file(config_file)) {
@@ -775,6 +869,7 @@ static void mainloop( struct batch_queue *queue )
 		} else {
 			set_worker_resources_options( queue );
 			batch_queue_set_option(queue, "autosize", autosize ? "yes" : NULL);
+			update_forecast();
 		}
 
 		submission_regex = foremen_regex ? foremen_regex : project_regex;
@@ -786,6 +881,10 @@ static void mainloop( struct batch_queue *queue )
 			masters_list = do_direct_query(master_host,master_port);
 		}
 
+		if(forecast) {
+			factory_forecast_observe(forecast, masters_list, time(0));
+		}
+
 		if(masters_list && list_size(masters_list) > 0)
 		{
 			factory_timeout_start = time(0);
@@ -825,27 +924,19 @@ static void mainloop( struct batch_queue *queue )
 
 		debug(D_WQ,"raw workers needed: %d", workers_needed);
 
-		if(workers_needed > workers_max) {
-			debug(D_WQ,"applying maximum of %d workers",workers_max);
-			workers_needed = workers_max;
+		if(forecast) {
+			/* workers that exited since the last cycle hide workers that joined. */
+			int workers_joined = workers_connected - last_workers_connected + workers_exited;
+			factory_forecast_workers_joined(forecast, MAX(0, workers_joined), time(0));
+			workers_needed = factory_forecast_target(forecast, workers_needed, time(0));
 		}
 
-		if(workers_needed < workers_min) {
-			debug(D_WQ,"applying minimum of %d workers",workers_min);
-			workers_needed = workers_min;
-		}
-
-		int new_workers_needed = workers_needed - workers_submitted;
+		last_workers_connected = workers_connected;
+		workers_exited = 0;
 
-		if(workers_per_cycle > 0 && new_workers_needed > workers_per_cycle) {
-			debug(D_WQ,"applying maximum workers per cycle of %d",workers_per_cycle);
-			new_workers_needed = workers_per_cycle;
-		}
+		workers_needed = apply_workers_limits(workers_needed);
 
-		if(workers_per_cycle > 0 && workers_submitted > new_workers_needed + workers_connected) {
-			debug(D_WQ,"waiting for %d previously submitted workers to connect", workers_submitted - workers_connected);
-			new_workers_needed = 0;
-		}
+		int new_workers_needed = count_new_workers(workers_needed, workers_submitted, workers_connected);
 
 		debug(D_WQ,"workers needed: %d",    workers_needed);
 		debug(D_WQ,"workers submitted: %d", workers_submitted);
@@ -864,7 +955,12 @@ static void mainloop( struct batch_queue *queue )
 
 		if(new_workers_needed>0) {
 			debug(D_WQ,"submitting %d new workers to reach target",new_workers_needed);
-			workers_submitted += submit_workers(queue,job_table,new_workers_needed);
+			int submitted = submit_workers(queue,job_table,new_workers_needed);
+			workers_submitted += submitted;
+
+			if(forecast) {
+				factory_forecast_workers_submitted(forecast, submitted, time(0));
+			}
 		} else if(new_workers_needed<0) {
 			debug(D_WQ,"too many workers, will wait for some to exit");
 		} else {
@@ -883,6 +979,7 @@ static void mainloop( struct batch_queue *queue )
 					itable_remove(job_table,jobid);
 					debug(D_WQ,"worker job %"PRId64" exited",jobid);
 					workers_submitted--;
+					workers_exited++;
 				} else {
 					// it may have been a job from a previous run.
 				}
@@ -903,6 +1000,237 @@ static void mainloop( struct batch_queue *queue )
 	itable_delete(job_table);
 }
 
+/*
+Read the log of a master to simulate the factory. The log is either the
+statistics log of the master (work_queue_specify_log), with a header line
+naming the columns, or a sequence of master records as reported to the
+catalog server, one json object per line. Returns a list of records, each
+with its time in seconds in the field "time".
+*/
+
+static struct list *read_master_log( const char *filename )
+{
+	FILE *file = fopen(filename, "r");
+	if(!file) {
+		fprintf(stderr, "work_queue_factory: couldn't open %s: %s\n", filename, strerror(errno));
+		return NULL;
+	}
+
+	struct list *records = list_create();
+	struct list *columns = list_create();
+
+	char *line;
+	while((line = get_line(file))) {
+		string_chomp(line);
+
+		if(line[0] == '#') {
+			list_free(columns);
+			char *name = strtok(line + 1, " \t");
+			while(name) {
+				list_push_tail(columns, xxstrdup(name));
+				name = strtok(NULL, " \t");
+			}
+		} else if(line[0] == '{') {
+			struct jx *j = jx_parse_string(line);
+			if(j && jx_istype(j, JX_OBJECT)) {
+				if(!jx_lookup(j, "time")) {
+					jx_insert_integer(j, "time", jx_lookup_integer(j, "lastheardfrom"));
+				}
+				list_push_tail(records, j);
+			} else {
+				jx_delete(j);
+			}
+		} else if(list_size(columns) > 0) {
+			struct jx *j = jx_object(NULL);
+
+			char *name;
+			char *value = strtok(line, " \t");
+			list_first_item(columns);
+			while(value && (name = list_next_item(columns))) {
+				jx_insert_integer(j, name, atoll(value));
+				value = strtok(NULL, " \t");
+			}
+
+			/* timestamps of the statistics log are in microseconds. */
+			jx_insert_integer(j, "time", jx_lookup_integer(j, "timestamp") / 1000000);
+			list_push_tail(records, j);
+		}
+
+		free(line);
+	}
+
+	fclose(file);
+
+	list_free(columns);
+	list_delete(columns);
+
+	return records;
+}
+
+/* State of a simulated pool of workers. */
+struct simulated_pool {
+	struct list *pending;    /* times at which submitted workers connect. */
+	int connected;
+	int target;              /* workers needed after the forecast and the limits. */
+	time_t idle_since;
+
+	int64_t submitted;
+	int64_t idled_out;
+	int64_t shortfall;       /* worker-seconds needed but not connected. */
+	int64_t idle;            /* worker-seconds connected but not needed. */
+	int64_t provisioned;     /* worker-seconds connected. */
+};
+
+static void simulated_pool_cycle( struct simulated_pool *p, struct list *masters, int needed_now, time_t now )
+{
+	time_t *t;
+	int joined = 0;
+	while((t = list_peek_head(p->pending)) && *t <= now) {
+		free(list_pop_head(p->pending));
+		joined++;
+	}
+	p->connected += joined;
+
+	int workers_needed = needed_now;
+	if(forecast) {
+		factory_forecast_observe(forecast, masters, now);
+		factory_forecast_workers_joined(forecast, joined, now);
+		workers_needed = factory_forecast_target(forecast, count_workers_needed(masters, 0), now);
+	}
+
+	workers_needed = apply_workers_limits(workers_needed);
+	p->target = workers_needed;
+
+	int new_workers = count_new_workers(workers_needed, p->connected + list_size(p->pending), p->connected);
+
+	int i;
+	for(i = 0; i < new_workers; i++) {
+		t = malloc(sizeof(*t));
+		*t = now + simulated_startup;
+		list_push_tail(p->pending, t);
+	}
+
+	if(forecast && new_workers > 0) {
+		factory_forecast_workers_submitted(forecast, new_workers, now);
+	}
+
+	p->submitted   += MAX(0, new_workers);
+	p->shortfall   += MAX(0, needed_now - p->connected) * factory_period;
+	p->idle        += MAX(0, p->connected - needed_now) * factory_period;
+	p->provisioned += p->connected * factory_period;
+
+	/* idle workers exit after the worker timeout. */
+	if(p->connected > needed_now) {
+		if(!p->idle_since) {
+			p->idle_since = now;
+		} else if(now - p->idle_since >= worker_timeout) {
+			p->idled_out += p->connected - needed_now;
+			p->connected  = needed_now;
+			p->idle_since = 0;
+		}
+	} else {
+		p->idle_since = 0;
+	}
+}
+
+static void simulated_pool_report( const char *name, struct simulated_pool *p )
+{
+	printf("%-12s %10" PRId64 " %10" PRId64 " %14.1f %14.1f %14.1f\n", name,
+			p->submitted, p->idled_out,
+			p->provisioned / 3600.0, p->shortfall / 3600.0, p->idle / 3600.0);
+}
+
+/*
+Replay the log of a master, and compare the workers that the factory would
+request with and without the forecast. No workers are submitted. Submitted
+workers connect after simulated_startup seconds, and exit after being idle
+for worker_timeout seconds.
+*/
+
+static int simulate( const char *filename )
+{
+	struct list *records = read_master_log(filename);
+	if(!records) {
+		return 1;
+	}
+
+	if(list_size(records) < 1) {
+		fprintf(stderr, "work_queue_factory: no master records found in %s\n", filename);
+		list_delete(records);
+		return 1;
+	}
+
+	struct simulated_pool instant;
+	struct simulated_pool predicted;
+	memset(&instant, 0, sizeof(instant));
+	memset(&predicted, 0, sizeof(predicted));
+	instant.pending   = list_create();
+	predicted.pending = list_create();
+
+	struct factory_forecast *f = factory_forecast_create(factory_period);
+	factory_forecast_set_scale_down_delay(f, scale_down_delay);
+
+	struct jx *current = list_peek_head(records);
+	time_t start = jx_lookup_integer(current, "time");
+	time_t end   = jx_lookup_integer(list_peek_tail(records), "time");
+
+	struct list *masters = list_create();
+
+	printf("%8s %8s %8s %8s | %8s %8s | %8s %8s %8s\n", "time", "waiting", "running", "needed", "instant", "conn", "target", "forecast", "conn");
+
+	list_first_item(records);
+	struct jx *next = list_next_item(records);
+
+	time_t now;
+	for(now = start; now <= end; now += factory_period) {
+		while(next && jx_lookup_integer(next, "time") <= now) {
+			current = next;
+			next = list_next_item(records);
+		}
+
+		list_push_tail(masters, current);
+
+		forecast = NULL;
+		int needed_now = count_workers_needed(masters, 0);
+		simulated_pool_cycle(&instant, masters, needed_now, now);
+
+		forecast = f;
+		simulated_pool_cycle(&predicted, masters, needed_now, now);
+		forecast = NULL;
+
+		printf("%8" PRId64 " %8" PRId64 " %8" PRId64 " %8d | %8d %8d | %8d %8d %8d\n",
+				(int64_t) (now - start),
+				jx_lookup_integer(current, "tasks_waiting"),
+				jx_lookup_integer(current, "tasks_running"),
+				needed_now,
+				instant.connected + list_size(instant.pending), instant.connected,
+				predicted.target, predicted.connected + list_size(predicted.pending), predicted.connected);
+
+		list_pop_head(masters);
+	}
+
+	printf("\nstartup latency estimated: %.0f s (simulated: %d s)\n\n", factory_forecast_startup_latency(f), simulated_startup);
+	printf("%-12s %10s %10s %14s %14s %14s\n", "policy", "submitted", "idled_out", "worker_hours", "shortfall_hrs", "idle_hrs");
+	simulated_pool_report("instant", &instant);
+	simulated_pool_report("forecast", &predicted);
+
+	factory_forecast_delete(f);
+
+	list_free(instant.pending);
+	list_delete(instant.pending);
+	list_free(predicted.pending);
+	list_delete(predicted.pending);
+	list_delete(masters);
+
+	struct jx *j;
+	while((j = list_pop_head(records))) {
+		jx_delete(j);
+	}
+	list_delete(records);
+
+	return 0;
+}
+
 static void show_help(const char *cmd)
 {
 	printf("Use: work_queue_factory [options] <masterhost> <port>\nor\n     work_queue_factory [options] -M projectname\n");
@@ -930,6 +1258,10 @@ static void show_help(const char *cmd)
 	printf(" %-30s Exit after no master has been seen in <n> seconds.\n", "--factory-timeout");
 	printf(" %-30s Use this scratch dir for temporary files. (default is /tmp/wq-pool-$uid)\n","-S,--scratch-dir");
 	printf(" %-30s Use worker capacity reported by masters.\n","-c,--capacity");
+	printf(" %-30s Size the pool for the tasks expected when new workers connect, from the task rates of the masters and the startup latency of workers.\n","--predictive");
+	printf(" %-30s With --predictive, shrink the pool only after demand is low for this many seconds. (default=%d)\n","--scale-down-delay=<s>", scale_down_delay);
+	printf(" %-30s Do not submit workers. Replay this master log and compare the pools with and without --predictive.\n","--simulate=<log>");
+	printf(" %-30s Startup latency of workers when simulating. (default=%d)\n","--simulated-startup=<s>", simulated_startup);
 	printf(" %-30s Enable debugging for this subsystem.\n", "-d,--debug=<subsystem>");
 	printf(" %-30s Specify Amazon config file (for use with -T amazon)\n", "--amazon-config");
 	printf(" %-30s Wrap factory with this command prefix.\n","--wrapper");
@@ -960,7 +1292,11 @@ enum{   LONG_OPT_CORES = 255,
 		LONG_OPT_MESOS_PATH,
 		LONG_OPT_MESOS_PRELOAD,
 		LONG_OPT_CATALOG,
-		LONG_OPT_ENVIRONMENT_VARIABLE
+		LONG_OPT_ENVIRONMENT_VARIABLE,
+		LONG_OPT_PREDICTIVE,
+		LONG_OPT_SCALE_DOWN_DELAY,
+		LONG_OPT_SIMULATE,
+		LONG_OPT_SIMULATED_STARTUP
 	};
 
 static const struct option long_options[] = {
@@ -998,6 +1334,10 @@ static const struct option long_options[] = {
 	{"mesos-master", required_argument, 0, LONG_OPT_MESOS_MASTER},
 	{"mesos-path", required_argument, 0, LONG_OPT_MESOS_PATH},
 	{"mesos-preload", required_argument, 0, LONG_OPT_MESOS_PRELOAD},
+	{"predictive", no_argument, 0, LONG_OPT_PREDICTIVE},
+	{"scale-down-delay", required_argument, 0, LONG_OPT_SCALE_DOWN_DELAY},
+	{"simulate", required_argument, 0, LONG_OPT_SIMULATE},
+	{"simulated-startup", required_argument, 0, LONG_OPT_SIMULATED_STARTUP},
 	{0,0,0,0}
 };
 
@@ -1162,12 +1502,28 @@ int main(int argc, char *argv[])
 			case LONG_OPT_CATALOG:
 				catalog_host = xxstrdup(optarg);
 				break;
+			case LONG_OPT_PREDICTIVE:
+				predictive = 1;
+				break;
+			case LONG_OPT_SCALE_DOWN_DELAY:
+				scale_down_delay = MAX(0, atoi(optarg));
+				break;
+			case LONG_OPT_SIMULATE:
+				simulate_log = optarg;
+				break;
+			case LONG_OPT_SIMULATED_STARTUP:
+				simulated_startup = MAX(0, atoi(optarg));
+				break;
 			default:
 				show_help(argv[0]);
 				return EXIT_FAILURE;
 		}
 	}
 
+	if(simulate_log) {
+		return simulate(simulate_log);
+	}
+
 	if(config_file) {
 		char abs_path_name[PATH_MAX];
 
@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "work_queue_factory_forecast.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "macros.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Masters not seen for this many periods are forgotten. */
+#define FORECAST_STALE_PERIODS 10
+
+/* Rates are averaged over this many periods. */
+#define FORECAST_SMOOTHING_PERIODS 10
+
+/* Weight of a new latency measurement. */
+#define FORECAST_LATENCY_ALPHA 0.3
+
+struct master_rates {
+	time_t last_seen;
+	int64_t tasks_submitted;
+	int64_t tasks_done;
+	double arrival;      /* tasks per second. */
+	double completion;   /* tasks per second. */
+	int valid;           /* whether the rates have been measured. */
+};
+
+struct submission {
+	time_t when;
+	int count;
+};
+
+struct factory_forecast {
+	int period;
+	int delay;
+
+	struct hash_table *masters;   /* project:host:port -> struct master_rates */
+
+	struct list *submissions;     /* workers submitted that have not yet connected, oldest first. */
+	double latency;
+	int latency_measured;
+
+	int target;
+	time_t low_since;
+	int low_max;    /* largest demand seen since low_since. */
+};
+
+static char *master_key(struct jx *j)
+{
+	const char *project = jx_lookup_string(j, "project");
+	const char *name    = jx_lookup_string(j, "name");
+
+	return string_format("%s:%s:%d", project ? project : "", name ? name : "", (int) jx_lookup_integer(j, "port"));
+}
+
+struct factory_forecast *factory_forecast_create(int period)
+{
+	struct factory_forecast *f = calloc(1, sizeof(*f));
+
+	f->period      = MAX(1, period);
+	f->delay       = 120;
+	f->masters     = hash_table_create(0, 0);
+	f->submissions = list_create();
+
+	/* until measured, assume workers connect within a period. */
+	f->latency = f->period;
+
+	return f;
+}
+
+void factory_forecast_delete(struct factory_forecast *f)
+{
+	if(!f)
+		return;
+
+	char *key;
+	struct master_rates *m;
+	hash_table_firstkey(f->masters);
+	while(hash_table_nextkey(f->masters, &key, (void **) &m)) {
+		free(m);
+	}
+	hash_table_delete(f->masters);
+
+	list_free(f->submissions);
+	list_delete(f->submissions);
+
+	free(f);
+}
+
+void factory_forecast_set_scale_down_delay(struct factory_forecast *f, int delay)
+{
+	f->delay = MAX(0, delay);
+}
+
+static double forecast_horizon(struct factory_forecast *f)
+{
+	return f->latency + f->period;
+}
+
+static void update_rates(struct factory_forecast *f, struct master_rates *m, struct jx *j, time_t now)
+{
+	int64_t submitted = jx_lookup_integer(j, "tasks_submitted");
+	int64_t done      = jx_lookup_integer(j, "tasks_done");
+
+	if(m->last_seen > 0 && now > m->last_seen) {
+		if(submitted < m->tasks_submitted || done < m->tasks_done) {
+			/* the counters went back, the master was restarted. */
+			m->valid = 0;
+		} else {
+			double dt = now - m->last_seen;
+			double arrival    = (submitted - m->tasks_submitted) / dt;
+			double completion = (done - m->tasks_done) / dt;
+
+			if(m->valid) {
+				double w = 1 - exp(-dt / (FORECAST_SMOOTHING_PERIODS * f->period));
+				m->arrival    += w * (arrival - m->arrival);
+				m->completion += w * (completion - m->completion);
+			} else {
+				m->arrival    = arrival;
+				m->completion = completion;
+				m->valid      = 1;
+			}
+		}
+	}
+
+	if(now >= m->last_seen) {
+		m->last_seen       = now;
+		m->tasks_submitted = submitted;
+		m->tasks_done      = done;
+	}
+}
+
+void factory_forecast_observe(struct factory_forecast *f, struct list *masters, time_t now)
+{
+	struct jx *j;
+	if(masters) {
+		list_first_item(masters);
+		while((j = list_next_item(masters))) {
+			char *key = master_key(j);
+
+			struct master_rates *m = hash_table_lookup(f->masters, key);
+			if(!m) {
+				m = calloc(1, sizeof(*m));
+				hash_table_insert(f->masters, key, m);
+			}
+
+			update_rates(f, m, j, now);
+
+			debug(D_WQ, "master %s: %.3f tasks/s submitted, %.3f tasks/s done", key, m->arrival, m->completion);
+			free(key);
+		}
+	}
+
+	/* forget masters that are gone. */
+	struct list *stale = list_create();
+
+	char *key;
+	struct master_rates *m;
+	hash_table_firstkey(f->masters);
+	while(hash_table_nextkey(f->masters, &key, (void **) &m)) {
+		if(now - m->last_seen > FORECAST_STALE_PERIODS * f->period) {
+			list_push_tail(stale, xxstrdup(key));
+		}
+	}
+
+	while((key = list_pop_head(stale))) {
+		free(hash_table_remove(f->masters, key));
+		free(key);
+	}
+	list_delete(stale);
+}
+
+int factory_forecast_tasks(struct factory_forecast *f, struct jx *master)
+{
+	char *key = master_key(master);
+	struct master_rates *m = hash_table_lookup(f->masters, key);
+	free(key);
+
+	if(!m || !m->valid)
+		return 0;
+
+	return (int) lround((m->arrival - m->completion) * forecast_horizon(f));
+}
+
+void factory_forecast_workers_submitted(struct factory_forecast *f, int count, time_t now)
+{
+	if(count < 1)
+		return;
+
+	struct submission *s = malloc(sizeof(*s));
+	s->when  = now;
+	s->count = count;
+
+	list_push_tail(f->submissions, s);
+}
+
+void factory_forecast_workers_joined(struct factory_forecast *f, int joined, time_t now)
+{
+	/* workers connect in the order they were submitted, as far as we can tell. */
+	struct submission *s;
+	while(joined > 0 && (s = list_peek_head(f->submissions))) {
+		int n = MIN(joined, s->count);
+		double latency = now - s->when;
+
+		if(f->latency_measured) {
+			f->latency += FORECAST_LATENCY_ALPHA * (latency - f->latency);
+		} else {
+			f->latency = latency;
+			f->latency_measured = 1;
+		}
+
+		s->count -= n;
+		joined   -= n;
+
+		if(s->count < 1) {
+			free(list_pop_head(f->submissions));
+		}
+	}
+
+	/* workers that have not connected by now probably never will. */
+	double expire = MAX(3600, 10 * f->latency);
+	while((s = list_peek_head(f->submissions)) && now - s->when > expire) {
+		free(list_pop_head(f->submissions));
+	}
+
+	debug(D_WQ, "worker startup latency: %.0f s", f->latency);
+}
+
+int factory_forecast_target(struct factory_forecast *f, int needed, time_t now)
+{
+	if(needed >= f->target) {
+		f->target    = needed;
+		f->low_since = 0;
+		return f->target;
+	}
+
+	if(!f->low_since) {
+		f->low_since = now;
+		f->low_max   = needed;
+	}
+
+	f->low_max = MAX(f->low_max, needed);
+
+	/* lower only to the largest demand seen while waiting, so that a
+	 * single low sample does not shrink the pool. */
+	if(now - f->low_since >= f->delay) {
+		debug(D_WQ, "demand below %d workers for %d s, lowering target to %d", f->target, f->delay, f->low_max);
+		f->target    = f->low_max;
+		f->low_since = now;
+		f->low_max   = needed;
+	}
+
+	return f->target;
+}
+
+double factory_forecast_startup_latency(struct factory_forecast *f)
+{
+	return f->latency;
+}
+
+struct jx *factory_forecast_to_jx(struct factory_forecast *f)
+{
+	struct jx *j = jx_object(NULL);
+
+	jx_insert_integer(j, "startup_latency", (int64_t) f->latency);
+	jx_insert_integer(j, "horizon", (int64_t) forecast_horizon(f));
+	jx_insert_integer(j, "target", f->target);
+
+	struct jx *ms = jx_array(NULL);
+
+	char *key;
+	struct master_rates *m;
+	hash_table_firstkey(f->masters);
+	while(hash_table_nextkey(f->masters, &key, (void **) &m)) {
+		struct jx *r = jx_object(NULL);
+		jx_insert_string(r, "master", key);
+		jx_insert_double(r, "arrival_rate", m->arrival);
+		jx_insert_double(r, "completion_rate", m->completion);
+		jx_array_append(ms, r);
+	}
+
+	jx_insert(j, jx_string("masters"), ms);
+
+	return j;
+}
+
+/* vim: set noexpandtab tabstop=4: */
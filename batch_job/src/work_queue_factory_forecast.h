@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef WORK_QUEUE_FACTORY_FORECAST_H
+#define WORK_QUEUE_FACTORY_FORECAST_H
+
+#include <time.h>
+
+#include "jx.h"
+#include "list.h"
+
+/** @file work_queue_factory_forecast.h
+Forecast the demand of workers for work_queue_factory.
+
+Workers submitted now only connect to a master after the startup latency of
+the batch system. Instead of sizing the pool from the tasks the masters report
+at this moment, the forecast estimates, for each master, the rates at which
+tasks are submitted and completed (exponentially weighted moving averages of
+the cumulative counters tasks_submitted and tasks_done), and the change in the
+number of outstanding tasks expected by the time a new worker connects.
+
+The startup latency is measured from the time workers are submitted to the
+time they connect, assuming that they connect in the order they were submitted.
+
+The resulting target number of workers is subject to hysteresis: it grows as
+soon as the forecast grows, but only shrinks when the forecast has stayed below
+the target for a given time, and then only to the largest forecast seen in
+that time. This avoids submitting workers again right after a dip in demand.
+The delay should be shorter than the idle timeout of the workers, otherwise
+idle workers exit while the target is held, and are replaced.
+*/
+
+struct factory_forecast;
+
+/** Create a forecast.
+@param period The time in seconds between factory cycles.
+@return A new forecast.
+*/
+struct factory_forecast *factory_forecast_create(int period);
+
+/** Delete a forecast.
+@param f The forecast to delete.
+*/
+void factory_forecast_delete(struct factory_forecast *f);
+
+/** Configure the hysteresis of the target number of workers.
+@param f The forecast.
+@param delay The target shrinks only when the demand has been lower for this many seconds. (default 120)
+*/
+void factory_forecast_set_scale_down_delay(struct factory_forecast *f, int delay);
+
+/** Update the task rates of the masters.
+@param f The forecast.
+@param masters List of master records, as reported to the catalog server.
+@param now The time at which the records were observed.
+*/
+void factory_forecast_observe(struct factory_forecast *f, struct list *masters, time_t now);
+
+/** Expected change in the number of outstanding tasks of a master.
+@param f The forecast.
+@param master A master record given to @ref factory_forecast_observe.
+@return The net number of tasks expected to arrive before a worker submitted now connects. Negative if the master is draining.
+*/
+int factory_forecast_tasks(struct factory_forecast *f, struct jx *master);
+
+/** Record the submission of workers, to measure the startup latency.
+@param f The forecast.
+@param count Number of workers submitted.
+@param now Time of submission.
+*/
+void factory_forecast_workers_submitted(struct factory_forecast *f, int count, time_t now);
+
+/** Record workers that connected to the masters, to measure the startup latency.
+@param f The forecast.
+@param joined Number of workers that connected since the last call.
+@param now Time of the observation.
+*/
+void factory_forecast_workers_joined(struct factory_forecast *f, int joined, time_t now);
+
+/** Apply hysteresis to the number of workers needed.
+@param f The forecast.
+@param needed Number of workers needed according to the forecast.
+@param now Current time.
+@return The target number of workers.
+*/
+int factory_forecast_target(struct factory_forecast *f, int needed, time_t now);
+
+/** Get the current estimate of the startup latency of workers.
+@param f The forecast.
+@return The latency, in seconds.
+*/
+double factory_forecast_startup_latency(struct factory_forecast *f);
+
+/** Get the current status of the forecast.
+@param f The forecast.
+@return A jx object with the startup latency, forecast horizon, and the task rates of each master.
+*/
+struct jx *factory_forecast_to_jx(struct factory_forecast *f);
+
+#endif
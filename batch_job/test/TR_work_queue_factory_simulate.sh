@@ -0,0 +1,69 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+# the statistics log of a master whose demand grows by 10 tasks every 30 s up
+# to 100 tasks, at 330 s all but 10 of them complete.
+log=work_queue_factory_simulate.log
+out=work_queue_factory_simulate.out
+
+prepare()
+{
+	return 0
+}
+
+# target number of workers of the forecast at the given time of the log.
+target_at()
+{
+	awk -v t="$1" '$1 == t && $5 == "|" { print $9 }' "$out"
+}
+
+simulate()
+{
+	../src/work_queue_factory --simulate "$log" --simulated-startup 60 --scale-down-delay "$1" -w 0 -W 1000 --workers-per-cycle 0 > "$out"
+}
+
+expect()
+{
+	value=$(target_at "$1")
+	if [ "$value" != "$2" ]
+	then
+		echo "target at $1 s is '$value', expected $2"
+		cat "$out"
+		exit 1
+	fi
+}
+
+run()
+{
+	simulate 120 || return 1
+
+	grep -q "startup latency estimated: 60 s" "$out" || { cat "$out"; return 1; }
+
+	# 1 task every 3 s, for the startup latency of 60 s plus a factory
+	# period of 30 s, is 30 tasks more than the 100 waiting.
+	expect 300 130
+
+	# the target is held for the scale down delay after demand drops...
+	expect 330 130
+	expect 420 130
+
+	# ...and then lowered to the largest demand seen meanwhile.
+	expect 450 11
+
+	simulate 60 || return 1
+	expect 360 130
+	expect 390 11
+
+	return 0
+}
+
+clean()
+{
+	rm -f "$out"
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -22,6 +22,18 @@ locality and avoid thrashing. Because of this, you should be prepared for the
 results to come back in any order. If you want to further exploit the
 parallelism of executing All-Pairs workflows on multiple (multicore) machines,
 please refer to the MANPAGE(allpairs_master,1) utility.
+PARA
+With the internal functions, the matrix is divided into tiles small enough
+to stay in the processor cache, which a fixed pool of threads compares.
+The internal functions BITWISE and IRIS use the vector instructions of the
+processor when available. Use BOLD(-d all) to display the number of
+comparisons per second.
+PARA
+A set may also be given as a pack, written with BOLD(--pack). A pack is
+mapped into memory instead of reading each object for each block, and its
+pages are shared through the page cache by all the BOLD(allpairs_multicore)
+processes on the same machine that use it. The pack is in the byte order of
+the machine that wrote it.
 
 SECTION(OPTIONS)
 
@@ -30,6 +42,8 @@ OPTION_TRIPLET(-b, block-size, items)Block size: number of items to hold in memo
 OPTION_TRIPLET(-c, cores, cores)Number of cores to be used. (default: # of cores in machine)
 OPTION_TRIPLET(-e, extra-args, args)Extra arguments to pass to the comparison program.
 OPTION_TRIPLET(-d, debug, flag)Enable debugging for this subsystem.
+OPTION_PAIR(--min-score, score)With the internal function SWALIGN, only display alignments with at least this score.
+OPTION_ITEM(--pack)Instead of comparing, write the objects of PARAM(set A) into a single pack file named by the second argument. A pack can be given as PARAM(set A) or PARAM(set B) to the internal functions.
 OPTION_ITEM(`-v, --version')Show program version.
 OPTION_ITEM(`-h, --help')Display this message.
 OPTIONS_END
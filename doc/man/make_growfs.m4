@@ -15,6 +15,11 @@ Given a directory as an argument, it recursively visits all of
 the directories underneath and creates files named CODE(.__growfsdir)
 that summarize the metadata of all files in that directory.
 PARA
+It also writes a binary index of the same listing, CODE(.growfsindex),
+which MANPAGE(parrot_run,1) and BOLD(grow_fuse) map directly into memory
+instead of parsing the listing. The checksum of the index is added to
+CODE(.growfschecksum), after the checksum of the listing.
+PARA
 Once the directory files are generated, the files may be accessed
 through a web server as if there were on a full-fledged filesystem
 with complete metadata.
@@ -95,20 +95,25 @@ SECTION(OPTIONS)
 OPTIONS_BEGIN
 OPTION_TRIPLET(-d,debug,subsystem)Enable debugging for this subsystem.
 OPTION_TRIPLET(-o,debug-file,file)Write debugging output to this file. By default, debugging is sent to stderr (":stderr"). You may specify logs be sent to stdout (":stdout"), to the system syslog (":syslog"), or to the systemd journal (":journal").
-OPTION_TRIPLET(-i,interval,n)Interval between observations, in seconds (default=1).
+OPTION_TRIPLET(-i,interval,n)Interval between observations, in seconds. It may be fractional, e.g. 0.5 (default=5).
+OPTION_PAIR(--min-interval,n)Adaptive sampling. Observe as often as every <n> seconds (e.g. 0.01) when the monitored process starts and when processes are created or exit, or memory changes, doubling the interval up to --interval while the process tree is stable. Working directories and memory maps are measured at most once per --interval.
 OPTION_TRIPLET(-c,sh,str)Read command line from <str>, and execute as '/bin/sh -c <str>'.
 OPTION_TRIPLET(-l,limits-file,file)Use maxfile with list of var: value pairs for resource limits.
 OPTION_TRIPLET(-L,limits,string)String of the form `"var: value, var: value\' to specify resource limits. (Could be specified multiple times.)
 OPTION_ITEM(`-f, --child-in-foreground')Keep the monitored process in foreground (for interactive use).
 OPTION_TRIPLET(-O,with-output-files,template)Specify template for log files (default=resource-pid-<pid>).
 OPTION_ITEM(--with-time-series)Write resource time series to <template>.series.
+OPTION_ITEM(--binary-time-series)Write the time series to <template>.series in a compact binary format, in which each sample is encoded as the difference to the previous one. Implies --with-time-series. These files can be given directly to resource_monitor_histograms.
 OPTION_ITEM(--with-inotify)Write inotify statistics to <template>.files.
 OPTION_TRIPLET(-V,verbatim-to-summary,str)Include this string verbatim in a line in the summary. (Could be specified multiple times.)
 OPTION_ITEM(--follow-chdir)Follow processes' current working directories.
 OPTION_ITEM(--measure-dir=<dir>)Follow the size of <dir>. If not specified, follow the current directory. Can be specified multiple times.
+OPTION_ITEM(--incremental-disk)Measure the size of the working directories with a full walk only once, and then keep it up to date from inotify events, so that measurements do not slow down as directories grow. Falls back to full walks if there are not enough inotify watches for the directory tree (see /proc/sys/fs/inotify/max_user_watches).
 OPTION_ITEM(--without-time-series)Do not write the time-series log file.
 OPTION_ITEM(--without-opened-files)Do not write the list of opened files.
 OPTION_ITEM(--without-disk-footprint)Do not measure working directory footprint (default).
+OPTION_ITEM(--cgroup)Account for cpu and memory using a cgroup v2 created for the monitored process tree, rather than polling /proc for each process. Bytes read and written, and virtual memory, are still read from /proc, so that they match the values reported without --cgroup. As with VmRSS, resident memory is the anonymous memory and mapped files of the group (anon and file_mapped of memory.stat), without the page cache and kernel memory included in memory.current. Falls back to polling /proc if cgroups v2 or the memory controller are not available.
+OPTION_ITEM(--proc-events)Track the creation and termination of processes with the Linux proc connector, rather than only with the helper library. Children of statically linked executables are tracked, and the usage of a process since the last observation until it exited is included in the summary. Needs the CAP_NET_ADMIN capability.
 OPTION_ITEM(--snapshot-events=<file>)Configuration file for snapshots on file patterns. See below.
 OPTION_ITEM(`-v,--version')Show version string.
 OPTION_ITEM(`-h,--help')Show help text.
@@ -20,7 +20,7 @@ SECTION(ARGUMENTS)
 
 SUBSECTION(Input Options)
 OPTIONS_BEGIN
-OPTION_PAIR(-L, monitor_data_file_list)File with one summary file path per line.
+OPTION_PAIR(-L, monitor_data_file_list)File with one summary file path per line. Binary time series written with resource_monitor --binary-time-series may also be listed, and they are read as the maximum of their samples.
 OPTIONS_END
 
 SUBSECTION(Output Options)
@@ -48,6 +48,12 @@ virtual_memory
 wall_time
 LONGCODE_END
 
+SUBSECTION(Performance Options)
+OPTIONS_BEGIN
+OPTION_ITEM(-S)Streaming mode. Summaries are read in parallel and added to per category histograms as they are read, so that memory use depends on the number of categories rather than on the number of tasks. Only stats.json is written. It includes the mean, standard deviation, minimum, maximum, and mode of each field, the buckets of its histogram, and the maximum, min_waste, min_waste_naive, and max_throughput first allocations.
+OPTION_PAIR(-j,threads)Number of threads used to read the summaries. By default, one per core.
+OPTIONS_END
+
 SUBSECTION(Debugging Options)
 OPTIONS_BEGIN
 OPTION_TRIPLET(-d, debug, subsystem)Enable debugging for this subsystem.
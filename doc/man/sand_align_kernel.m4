@@ -32,6 +32,9 @@ OPTION_PAIR(-a,sw|ps|banded)Specify the type of alignment: sw (Smith-Waterman),
 OPTION_PAIR(-o,ovl|ovl_new|align|matrix)Specify how each alignment should be output: ovl (Celera V5, V6 OVL format), ovl_new (Celera V7 overlap format), align (display the sequences and alignment graphically) or matrix (display the dynamic programming matrix).  MANPAGE(sand_align_master,1) expects the ovl output format, which is the default.  The other formats are useful for debugging.
 OPTION_PAIR(-m,length)Minimum aligment length (default: 0).
 OPTION_PAIR(-q,quality)Minimum match quality (default: 1.00)
+OPTION_PAIR(-s,score)Minimum Smith-Waterman score (sw only, default: 0). The score of each pair is computed first without a traceback, and pairs below the minimum are not aligned.
+OPTION_PAIR(-k,avx2|sse2|scalar)Kernel used to compute the Smith-Waterman score. By default, the fastest kernel supported by the cpu.
+OPTION_PAIR(-M,full|linear)Memory used by ps and banded alignments: full keeps the whole dynamic programming matrix, linear keeps only the band (banded) or a few rows of scores (ps). Both give the same alignments. The matrix output format always uses the full matrix. (default: linear)
 OPTION_ITEM(-x)Delete input file after completion.
 OPTION_PAIR(-d,subsystem)Enable debugging for this subsystem.  (Try BOLD(-d all) to start.
 OPTION_ITEM(-v)Show program version.
@@ -29,6 +29,7 @@ the size dynamically by passing in d rather than a number.
 OPTION_PAIR(-r,file)A meryl file of repeat mers to be ignored.
 OPTION_PAIR(-k,size)The k-mer size to use in candidate selection (default is 22).
 OPTION_PAIR(-w,number)The minimizer window size to use in candidate selection (default is 22).
+OPTION_PAIR(-t,number)Number of threads to find minimizers with (default is the number of cores).
 OPTION_PAIR(-o,filename)The output file. Default is stdout.
 OPTION_PAIR(-d,subsystem)Enable debug messages for this subsystem.  Try BOLD(-d all) to start.
 OPTION_ITEM(-v)Show version string.
@@ -27,6 +27,8 @@ OPTIONS_BEGIN
 OPTION_ITEM(`-h, --help')Show this help screen
 OPTION_ITEM(`-v, --version')Show version string
 OPTION_TRIPLET(-d, debug, subsystem)Enable debugging for this subsystem. (Try -d all to start.)
+OPTION_ITEM(`-A, --adaptive-blocks')Adapt the block size while running, from the measured time per cell and dispatch time of each block.
+OPTION_TRIPLET(-b, block-size, size)Compute blocks of up to PARAM(size) by PARAM(size) cells in each task. (default is 1)
 OPTION_TRIPLET(-N, project-name, project)Set the project name to <project>
 OPTION_TRIPLET(-o,debug-file,file)Write debugging output to this file. By default, debugging is sent to stderr (":stderr"). You may specify logs be sent to stdout (":stdout"), to the system syslog (":syslog"), or to the systemd journal (":journal").
 OPTION_TRIPLET(-p, port, port)Port number for queue master to listen on.
@@ -82,6 +84,18 @@ LONGCODE_BEGIN
  ...
 LONGCODE_END
 
+If each cell is cheap to compute, most of the time is spent dispatching tasks.
+With CODE(-b) or CODE(-A), each task computes a block of cells on the worker,
+calling CODE(function) once per cell. The right column and top row of each
+block are kept in the cache of the worker, and the blocks that depend on them
+are preferably sent to the same worker. In this mode, the output of
+CODE(function) must be a single line. The master reports the number of cells
+computed per second:
+
+LONGCODE_BEGIN
+ % wavefront_master -A function 1000 1000 input.data output.data
+LONGCODE_END
+
 To speed up the process, run more MANPAGE(work_queue_worker,1) processes on
 other machines, or use MANPAGE(condor_submit_workers,1) or
 MANPAGE(sge_submit_workers,1) to start hundreds of workers in your local batch
@@ -70,6 +70,10 @@ OPTION_PAIR(--wrapper-input,Add this file needed by the wrapper.)
 OPTION_PAIR(--mesos-master, hostname) Specify the host name to mesos master node (for use with -T mesos)
 OPTION_PAIR(--mesos-path, filepath) Specify path to mesos python library (for use with -T mesos)
 OPTION_PAIR(--mesos-preload, library) Specify the linking libraries for running mesos(for use with -T mesos)
+OPTION_ITEM(--predictive)Size the pool from the forecast demand of the masters at the time new workers would connect, using the rates at which tasks are submitted and completed, and the measured startup latency of workers.
+OPTION_PAIR(--scale-down-delay, s)With --predictive, lower the target number of workers only after the demand has been lower for <s> seconds. Should be shorter than the worker timeout. (default 120)
+OPTION_PAIR(--simulate, log)Do not submit workers. Replay the statistics log of a master (or master records from the catalog, one per line) and compare the pools with and without --predictive.
+OPTION_PAIR(--simulated-startup, s)Startup latency of workers when simulating. (default 60)
 OPTION_ITEM(`-h, --help')Show this screen.
 OPTIONS_END
 
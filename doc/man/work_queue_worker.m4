@@ -59,6 +59,9 @@ OPTION_TRIPLET(-i, min-backoff, time)Set initial value for backoff interval when
 OPTION_TRIPLET(-b, max-backoff, time)Set maxmimum value for backoff interval when worker fails to connect to a master. (default=60s)
 OPTION_TRIPLET(-z, disk-threshold, size)Set available disk space threshold (in MB). When exceeded worker will clean up and reconnect. (default=100MB)
 OPTION_PAIR(--memory-threshold, size)Set available memory threshold (in MB). When exceeded worker will clean up and reconnect. (default=100MB)
+OPTION_PAIR(--cache-budget, size)Evict the least recently used cached files not needed by any task when the cache grows over this size (in MB). Files are also evicted to keep the available disk above the threshold. The master is told about every eviction, and sends the files again when needed. Nothing is evicted while connected to a master too old to be told. (default=no limit)
+OPTION_PAIR(--sandbox-strategy, strategy)How to place the input files of a task into its sandbox. With PARAM(link), files are hard linked, or cloned with a reflink if hard links fail, or symlinked as a last resort, and directories are linked by several threads. PARAM(reflink) clones files before trying hard links, so that tasks cannot modify the cached copy. PARAM(auto) is like PARAM(link), but when the worker may create mount namespaces (e.g., as root), cached directories are bind mounted read-only, unless the task has outputs inside them. (default=auto)
+OPTION_PAIR(--data-links, n)Open PARAM(n) additional connections to the master, on which the input files of a task are sent in parallel. This helps tasks with many small inputs, or links with high latency. Data links are not used when the master limits its bandwidth. (default=0)
 OPTION_TRIPLET(-A, arch, arch)Set the architecture string the worker reports to its supervisor. (default=the value reported by uname)
 OPTION_TRIPLET(-O, os, os)Set the operating system string the worker reports to its supervisor. (default=the value reported by uname)
 OPTION_TRIPLET(-s, workdir, path)Set the location where the worker should create its working directory. (default=/tmp)
@@ -161,6 +161,7 @@ static void category_clear_histogram(struct histogram *h) {
 		}
 	}
 
+	free(buckets);
 	histogram_clear(h);
 }
 
@@ -460,6 +461,12 @@ int64_t category_first_allocation(struct histogram *h, int assume_independence,
 	}
 
 int category_update_first_allocation(struct category *c, const struct rmsummary *max_worker) {
+	if(c->allocation_mode == CATEGORY_ALLOCATION_MODE_FIXED)
+		return 0;
+
+	if(c->total_tasks < 1)
+		return 0;
+
 	/* buffer used only for debug output. */
 	static buffer_t *b = NULL;
 	if(!b) {
@@ -467,12 +474,6 @@ int category_update_first_allocation(struct category *c, const struct rmsummary
 		buffer_init(b);
 	}
 
-	if(c->allocation_mode == CATEGORY_ALLOCATION_MODE_FIXED)
-		return 0;
-
-	if(c->total_tasks < 1)
-		return 0;
-
 	struct rmsummary *top = rmsummary_create(-1);
 	rmsummary_merge_override(top, max_worker);
 	rmsummary_merge_override(top, c->max_resources_seen);
@@ -588,6 +589,60 @@ int category_accumulate_summary(struct category *c, const struct rmsummary *rs,
 	return update;
 }
 
+static void category_merge_histogram(struct histogram *dest, struct histogram *src) {
+	histogram_merge(dest, src);
+
+	/* add the time accumulated per bucket, as category_inc_histogram_count_aux does. */
+	double *buckets = histogram_buckets(src);
+
+	int i;
+	for(i = 0; i < histogram_size(src); i++) {
+		double *src_accum = (double *) histogram_get_data(src, buckets[i]);
+		if(!src_accum)
+			continue;
+
+		double *time_accum = (double *) histogram_get_data(dest, buckets[i]);
+		if(!time_accum) {
+			time_accum = malloc(sizeof(double));
+			histogram_attach_data(dest, buckets[i], time_accum);
+
+			*time_accum = 0;
+		}
+
+		*time_accum += *src_accum;
+	}
+
+	free(buckets);
+}
+
+void category_merge(struct category *dest, struct category *src) {
+	category_merge_histogram(dest->cores_histogram,          src->cores_histogram);
+	category_merge_histogram(dest->cores_avg_histogram,      src->cores_avg_histogram);
+	category_merge_histogram(dest->wall_time_histogram,      src->wall_time_histogram);
+	category_merge_histogram(dest->cpu_time_histogram,       src->cpu_time_histogram);
+	category_merge_histogram(dest->max_concurrent_processes_histogram, src->max_concurrent_processes_histogram);
+	category_merge_histogram(dest->total_processes_histogram, src->total_processes_histogram);
+	category_merge_histogram(dest->memory_histogram,         src->memory_histogram);
+	category_merge_histogram(dest->swap_memory_histogram,    src->swap_memory_histogram);
+	category_merge_histogram(dest->virtual_memory_histogram, src->virtual_memory_histogram);
+	category_merge_histogram(dest->bytes_read_histogram,     src->bytes_read_histogram);
+	category_merge_histogram(dest->bytes_written_histogram,  src->bytes_written_histogram);
+	category_merge_histogram(dest->bytes_received_histogram, src->bytes_received_histogram);
+	category_merge_histogram(dest->bytes_sent_histogram,     src->bytes_sent_histogram);
+	category_merge_histogram(dest->bandwidth_histogram,      src->bandwidth_histogram);
+	category_merge_histogram(dest->total_files_histogram,    src->total_files_histogram);
+	category_merge_histogram(dest->disk_histogram,           src->disk_histogram);
+
+	rmsummary_merge_max(dest->max_resources_seen, src->max_resources_seen);
+
+	dest->total_tasks                  += src->total_tasks;
+	dest->completions_since_last_reset += src->completions_since_last_reset;
+
+	/* the first allocation of dest was computed without the tasks of src. */
+	rmsummary_delete(dest->first_allocation);
+	dest->first_allocation = NULL;
+}
+
 void categories_initialize(struct hash_table *categories, struct rmsummary *top, const char *summaries_file) {
 	struct list *summaries = rmsummary_parse_file_multiple(summaries_file);
 
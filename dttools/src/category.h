@@ -112,6 +112,9 @@ void categories_initialize(struct hash_table *categories, struct rmsummary *top,
 int category_accumulate_summary(struct category *c, const struct rmsummary *rs, const struct rmsummary *max_worker);
 int category_update_first_allocation(struct category *c, const struct rmsummary *max_worker);
 
+/* add the histograms and task counts of src to dest, e.g., when summaries are accumulated in parallel. The first allocation of dest is cleared, and should be computed again with category_update_first_allocation. */
+void category_merge(struct category *dest, struct category *src);
+
 int category_in_steady_state(struct category *c);
 
 category_allocation_t category_next_label(struct category *c, category_allocation_t current_label, int resource_overflow, struct rmsummary *user, struct rmsummary *measured);
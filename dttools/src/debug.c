@@ -16,6 +16,7 @@ See the file COPYING for details.
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdlib.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <string.h>
@@ -32,6 +33,13 @@ extern int debug_file_path (const char *path);
 extern void debug_file_rename (const char *suffix);
 extern int debug_file_reopen (void);
 
+extern int debug_async_start (void (*write) (INT64_T flags, const char *str), size_t size);
+extern void debug_async_stop (void);
+extern int debug_async_write (INT64_T flags, const char *str);
+extern void debug_async_flush (void);
+extern void debug_async_lock (void);
+extern void debug_async_unlock (void);
+
 #ifdef HAS_SYSLOG_H
 extern void debug_syslog_write (INT64_T flags, const char *str);
 extern void debug_syslog_config (const char *name);
@@ -46,6 +54,7 @@ static void (*debug_write) (INT64_T flags, const char *str) = debug_stderr_write
 static pid_t (*debug_getpid) (void) = getpid;
 static char debug_program_name[PATH_MAX];
 static INT64_T debug_flags = D_NOTICE|D_ERROR|D_FATAL;
+static int debug_async = 0;
 
 static char *terminal_path = "/dev/tty";
 static FILE *terminal_f    = NULL;
@@ -175,26 +184,55 @@ static const char *debug_flags_to_name(INT64_T flags)
 	return "debug";
 }
 
+static int debug_write_is_stream(void)
+{
+	return debug_write == debug_file_write || debug_write == debug_stderr_write || debug_write == debug_stdout_write;
+}
+
+/* The flusher of the asynchronous mode always writes to the current backend. */
+static void debug_write_current(INT64_T flags, const char *str)
+{
+	debug_write(flags, str);
+}
+
+/*
+Formatting the date with localtime is costly, so it is done once per second
+and thread, and only the hundredths are formatted for every message.
+*/
+
+static __thread time_t timestamp_second = -1;
+static __thread char timestamp_cache[64];
+
+static const char *debug_timestamp(time_t second)
+{
+	if(second != timestamp_second) {
+		struct tm tm;
+		localtime_r(&second, &tm);
+		snprintf(timestamp_cache, sizeof(timestamp_cache), "%04d/%02d/%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+		timestamp_second = second;
+	}
+	return timestamp_cache;
+}
+
 static void do_debug(INT64_T flags, const char *fmt, va_list args)
 {
 	buffer_t B;
 	char ubuf[1<<16];
+	pid_t pid = getpid();
 
 	buffer_init(&B);
 	buffer_ubuf(&B, ubuf, sizeof(ubuf));
 	buffer_max(&B, sizeof(ubuf));
 
-	if (debug_write == debug_file_write || debug_write == debug_stderr_write || debug_write == debug_stdout_write) {
+	if (debug_write_is_stream()) {
 		struct timeval tv;
-		struct tm *tm;
 		gettimeofday(&tv, 0);
-		tm = localtime(&tv.tv_sec);
 
-		buffer_putfstring(&B, "%04d/%02d/%02d %02d:%02d:%02d.%02ld ", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, (long) tv.tv_usec / 10000);
-		buffer_putfstring(&B, "%s[%d] ", debug_program_name, getpid());
+		buffer_putfstring(&B, "%s.%02ld ", debug_timestamp(tv.tv_sec), (long) tv.tv_usec / 10000);
+		buffer_putfstring(&B, "%s[%d] ", debug_program_name, pid);
 	}
 	/* Parrot prints debug messages for children: */
-	if (getpid() != debug_getpid()) {
+	if (pid != debug_getpid()) {
 		buffer_putfstring(&B, "<child:%d> ", (int)debug_getpid());
 	}
 	buffer_putfstring(&B, "%s: ", debug_flags_to_name(flags));
@@ -204,7 +242,8 @@ static void do_debug(INT64_T flags, const char *fmt, va_list args)
 		buffer_rewind(&B, buffer_pos(&B)-1); /* chomp whitespace */
 	buffer_putliteral(&B, "\n");
 
-	debug_write(flags, buffer_tostring(&B));
+	if(!(debug_async && debug_write_is_stream() && debug_async_write(flags, buffer_tostring(&B))))
+		debug_write(flags, buffer_tostring(&B));
 
 	if(terminal_available && (flags & (D_ERROR | D_NOTICE | D_FATAL))) {
 		if(debug_write != debug_stderr_write || !isatty(STDERR_FILENO)) {
@@ -275,10 +314,14 @@ void fatal(const char *fmt, ...)
 	do_debug(D_FATAL, fmt, args);
 	va_end(args);
 
+	debug_flush();
+
 	for(f = fatal_callback_list; f; f = f->next) {
 		f->callback();
 	}
 
+	debug_flush();
+
 	while(1) {
 		raise(SIGTERM);
 		raise(SIGKILL);
@@ -294,7 +337,8 @@ void debug_config_fatal(void (*callback) ())
 	fatal_callback_list = f;
 }
 
-int debug_config_file_e (const char *path)
+/* Must be called with debug_async_lock held, as the flusher uses debug_write. */
+static int debug_config_backend (const char *path)
 {
 	if(path == NULL || strcmp(path, ":stderr") == 0) {
 		debug_write = debug_stderr_write;
@@ -323,6 +367,15 @@ int debug_config_file_e (const char *path)
 	}
 }
 
+int debug_config_file_e (const char *path)
+{
+	debug_async_lock();
+	int rc = debug_config_backend(path);
+	debug_async_unlock();
+
+	return rc;
+}
+
 void debug_config_file (const char *path)
 {
 	if (debug_config_file_e(path) == -1) {
@@ -333,7 +386,39 @@ void debug_config_file (const char *path)
 
 void debug_config (const char *name)
 {
+	const char *async;
+
 	strncpy(debug_program_name, path_basename(name), sizeof(debug_program_name)-1);
+
+	async = getenv("CCTOOLS_DEBUG_ASYNC");
+	if(async && *async && strcmp(async, "0")) {
+		long long size = atoll(async);
+		debug_config_async(size > 1 ? size : DEBUG_ASYNC_DEFAULT_SIZE);
+	}
+}
+
+int debug_config_async (size_t size)
+{
+	if(size == 0) {
+		debug_async = 0;
+		debug_async_stop();
+		return 0;
+	}
+
+	if(debug_async)
+		return 0;
+
+	if(debug_async_start(debug_write_current, size) == -1)
+		return -1;
+
+	debug_async = 1;
+	return 0;
+}
+
+void debug_flush (void)
+{
+	if(debug_async)
+		debug_async_flush();
 }
 
 void debug_config_file_size (off_t size)
@@ -360,12 +445,18 @@ void debug_flags_restore(INT64_T fl)
 
 void debug_rename(const char *suffix)
 {
+	debug_async_lock();
 	debug_file_rename(suffix);
+	debug_async_unlock();
 }
 
 void debug_reopen(void)
 {
-	if (debug_file_reopen() == -1)
+	debug_async_lock();
+	int rc = debug_file_reopen();
+	debug_async_unlock();
+
+	if (rc == -1)
 		fatal("could not reopen debug log: %s", strerror(errno));
 }
 
@@ -123,6 +123,11 @@ modify the linker namespace we are using.
 #define debug_flags_restore    cctools_debug_flags_restore
 #define debug_set_flag_name    cctools_debug_set_flag_name
 #define debug_rename           cctools_debug_rename
+#define debug_config_async     cctools_debug_config_async
+#define debug_flush            cctools_debug_flush
+
+/** Default size in bytes of the per-thread buffers of @ref debug_config_async. */
+#define DEBUG_ASYNC_DEFAULT_SIZE (1<<18)
 
 /** Emit a debugging message.
 Logs a debugging message, if the given flags are active.
@@ -196,6 +201,25 @@ void debug_config_file_size(off_t size);
 
 void debug_config_fatal(void (*callback) (void));
 
+/** Write debug output asynchronously.
+Messages to a file, stderr, or stdout are appended to a buffer of the calling thread,
+and written in the order they were logged by a background thread, in batches.
+Pending messages are written on exit, on @ref fatal, on abort, and by @ref debug_flush.
+Asynchronous mode is also enabled by @ref debug_config when the environment variable
+<tt>CCTOOLS_DEBUG_ASYNC</tt> is set to 1, or to the size of the buffers in bytes.
+@param size Size in bytes of the buffer of each thread, or zero to write synchronously again.
+@return Zero on success, -1 if the background thread could not be started.
+*/
+
+int debug_config_async(size_t size);
+
+/** Write all the pending asynchronous debug messages.
+Does nothing if asynchronous mode is not enabled.
+@see debug_config_async
+*/
+
+void debug_flush(void);
+
 void debug_config_getpid (pid_t (*getpidf)(void));
 
 /** Set debugging flags to enable output.
@@ -0,0 +1,455 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Asynchronous debug output.
+
+Each thread that logs gets its own ring buffer, where it appends its
+messages without taking any lock: the thread is the only one that moves the
+head of its ring, and the flusher is the only one that moves the tail.
+Every message carries a global sequence number, so that the flusher writes
+the messages of all the threads in the order they were logged. As a thread
+takes its number before it publishes the message, each ring also announces
+a lower bound of the number being taken, and the flusher does not write
+past the lowest one until that message is published.
+
+The flusher is a background thread that wakes up periodically, or when a ring
+is half full, and writes all the pending messages with as few calls to the
+backend as possible. If a ring is full, the thread that logs waits for the
+flusher, rather than losing messages.
+
+debug_async_flush writes all the pending messages from the calling thread,
+and is used on exit, on fatal, on abort, on fork, and before the debug file
+changes. After a fork, the child logs synchronously, as the flusher thread is
+gone.
+*/
+
+#include "debug.h"
+
+#include "buffer.h"
+#include "xxmalloc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define DEBUG_ASYNC_INTERVAL_MS 100
+#define DEBUG_ASYNC_BATCH (1<<16)
+
+struct debug_async_record {
+	uint64_t seq;
+	uint32_t length;
+	uint32_t padding;
+};
+
+struct debug_async_ring {
+	char *data;
+	uint64_t size;
+	uint64_t head;     /* written by the owner thread only. */
+	uint64_t tail;     /* written by the consumer only. */
+	uint64_t pending;  /* at most the seq of the message being appended, or UINT64_MAX. */
+	int orphaned;      /* the owner thread exited. */
+	struct debug_async_ring *next;
+};
+
+static int async_enabled = 0;
+static uint64_t async_ring_size = DEBUG_ASYNC_DEFAULT_SIZE;
+static uint64_t async_seq = 0;
+static int async_stop = 0;
+
+static void (*async_write) (INT64_T flags, const char *str) = 0;
+
+static struct debug_async_ring *async_rings = 0;
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static pthread_t async_owner;
+static int async_owned = 0;
+static pthread_key_t async_key;
+static pthread_once_t async_once = PTHREAD_ONCE_INIT;
+
+static __thread struct debug_async_ring *thread_ring = 0;
+static __thread int thread_is_consumer = 0;
+
+void debug_async_stop(void);
+
+static uint64_t align8(uint64_t n)
+{
+	return (n + 7) & ~((uint64_t) 7);
+}
+
+static void ring_copy_out(struct debug_async_ring *r, uint64_t position, void *dst, uint64_t length)
+{
+	uint64_t offset = position % r->size;
+	uint64_t first = length < r->size - offset ? length : r->size - offset;
+
+	memcpy(dst, r->data + offset, first);
+	memcpy((char *) dst + first, r->data, length - first);
+}
+
+static void ring_copy_in(struct debug_async_ring *r, uint64_t position, const void *src, uint64_t length)
+{
+	uint64_t offset = position % r->size;
+	uint64_t first = length < r->size - offset ? length : r->size - offset;
+
+	memcpy(r->data + offset, src, first);
+	memcpy(r->data, (const char *) src + first, length - first);
+}
+
+static void thread_exited(void *arg)
+{
+	struct debug_async_ring *r = arg;
+	__atomic_store_n(&r->orphaned, 1, __ATOMIC_RELEASE);
+}
+
+static void create_key(void)
+{
+	pthread_key_create(&async_key, thread_exited);
+}
+
+static struct debug_async_ring *ring_get(void)
+{
+	if(thread_ring)
+		return thread_ring;
+
+	struct debug_async_ring *r = xxmalloc(sizeof(*r));
+	r->size = async_ring_size;
+	r->data = xxmalloc(r->size);
+	r->head = 0;
+	r->tail = 0;
+	r->pending = UINT64_MAX;
+	r->orphaned = 0;
+
+	pthread_once(&async_once, create_key);
+	pthread_setspecific(async_key, r);
+
+	pthread_mutex_lock(&async_mutex);
+	r->next = async_rings;
+	async_rings = r;
+	pthread_mutex_unlock(&async_mutex);
+
+	thread_ring = r;
+	return r;
+}
+
+/*
+Return the lowest seq that may not be published yet. The counter is read
+first, so that any message with a lower seq is either published, or still
+announced by its ring. The ring of the calling thread is skipped, as it
+cannot be appending while the thread drains, unless interrupted by a signal.
+*/
+
+static uint64_t published_limit(void)
+{
+	struct debug_async_ring *r;
+	uint64_t limit = __atomic_load_n(&async_seq, __ATOMIC_SEQ_CST);
+
+	for(r = async_rings; r; r = r->next) {
+		uint64_t pending = __atomic_load_n(&r->pending, __ATOMIC_SEQ_CST);
+		if(r != thread_ring && pending < limit)
+			limit = pending;
+	}
+
+	return limit;
+}
+
+/*
+Write out all the pending messages, in order. Must be called with async_mutex
+held. A message is only written once all the messages before it are
+published, waiting for the threads still appending them, which never take
+async_mutex while doing so. Rings of exited threads are freed once empty.
+*/
+
+static void drain(void)
+{
+	buffer_t B;
+	struct debug_async_ring *r, **p;
+	struct debug_async_record h;
+
+	async_owner = pthread_self();
+	async_owned = 1;
+	thread_is_consumer = 1;
+
+	buffer_init(&B);
+
+	while(1) {
+		struct debug_async_ring *best = 0;
+		uint64_t best_seq = 0;
+
+		/* Taken before the scan, so that every message below it shows in the scan. */
+		uint64_t limit = published_limit();
+
+		for(r = async_rings; r; r = r->next) {
+			uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+			if(head == r->tail)
+				continue;
+			ring_copy_out(r, r->tail, &h, sizeof(h));
+			if(!best || h.seq < best_seq) {
+				best = r;
+				best_seq = h.seq;
+			}
+		}
+
+		if(!best)
+			break;
+
+		if(best_seq >= limit) {
+			sched_yield();
+			continue;
+		}
+
+		ring_copy_out(best, best->tail, &h, sizeof(h));
+
+		char *message = xxmalloc(h.length + 1);
+		ring_copy_out(best, best->tail + sizeof(h), message, h.length);
+		message[h.length] = 0;
+		__atomic_store_n(&best->tail, best->tail + align8(sizeof(h) + h.length), __ATOMIC_RELEASE);
+
+		buffer_putlstring(&B, message, h.length);
+		free(message);
+
+		if(buffer_pos(&B) >= DEBUG_ASYNC_BATCH) {
+			async_write(0, buffer_tostring(&B));
+			buffer_rewind(&B, 0);
+		}
+	}
+
+	if(buffer_pos(&B) > 0)
+		async_write(0, buffer_tostring(&B));
+
+	buffer_free(&B);
+
+	for(p = &async_rings; (r = *p);) {
+		if(__atomic_load_n(&r->orphaned, __ATOMIC_ACQUIRE) && __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail) {
+			*p = r->next;
+			free(r->data);
+			free(r);
+		} else {
+			p = &r->next;
+		}
+	}
+
+	thread_is_consumer = 0;
+	async_owned = 0;
+}
+
+static void *flusher(void *arg)
+{
+	sigset_t all;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, 0);
+
+	pthread_mutex_lock(&async_mutex);
+	while(!async_stop) {
+		struct timeval now;
+		struct timespec deadline;
+
+		gettimeofday(&now, 0);
+		deadline.tv_sec = now.tv_sec;
+		deadline.tv_nsec = now.tv_usec * 1000 + DEBUG_ASYNC_INTERVAL_MS * 1000000L;
+		if(deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_cond_timedwait(&async_cond, &async_mutex, &deadline);
+		drain();
+	}
+	drain();
+	pthread_mutex_unlock(&async_mutex);
+
+	return 0;
+}
+
+/*
+Append a message to the ring of the calling thread. Returns zero if the
+message has to be written synchronously instead.
+*/
+
+int debug_async_write(INT64_T flags, const char *str)
+{
+	if(!__atomic_load_n(&async_enabled, __ATOMIC_ACQUIRE) || thread_is_consumer)
+		return 0;
+
+	struct debug_async_ring *r = ring_get();
+	struct debug_async_record h;
+	uint64_t length = strlen(str);
+	uint64_t needed = align8(sizeof(h) + length);
+
+	if(needed > r->size) {
+		/* Too large for the ring: write everything before it first. */
+		pthread_mutex_lock(&async_mutex);
+		drain();
+		async_write(flags, str);
+		pthread_mutex_unlock(&async_mutex);
+		return 1;
+	}
+
+	while(r->size - (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) < needed) {
+		if(!__atomic_load_n(&async_enabled, __ATOMIC_ACQUIRE))
+			return 0;
+		pthread_cond_signal(&async_cond);
+		sched_yield();
+	}
+
+	__atomic_store_n(&r->pending, __atomic_load_n(&async_seq, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	h.seq = __atomic_fetch_add(&async_seq, 1, __ATOMIC_SEQ_CST);
+	h.length = length;
+	h.padding = 0;
+
+	ring_copy_in(r, r->head, &h, sizeof(h));
+	ring_copy_in(r, r->head + sizeof(h), str, length);
+	__atomic_store_n(&r->head, r->head + needed, __ATOMIC_RELEASE);
+	__atomic_store_n(&r->pending, UINT64_MAX, __ATOMIC_SEQ_CST);
+
+	if(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->size / 2)
+		pthread_cond_signal(&async_cond);
+
+	return 1;
+}
+
+void debug_async_flush(void)
+{
+	if(!async_write)
+		return;
+
+	if(async_owned && pthread_equal(async_owner, pthread_self()))
+		return;
+
+	pthread_mutex_lock(&async_mutex);
+	drain();
+	pthread_mutex_unlock(&async_mutex);
+}
+
+/*
+Write the pending messages and keep the flusher from writing more, while the
+caller changes the backend. Messages logged meanwhile wait in the rings.
+*/
+
+void debug_async_lock(void)
+{
+	pthread_mutex_lock(&async_mutex);
+	if(async_write)
+		drain();
+}
+
+void debug_async_unlock(void)
+{
+	pthread_mutex_unlock(&async_mutex);
+}
+
+/*
+On abort, write what can be written without waiting: the flusher may be the
+thread that aborted, or hold the lock forever.
+*/
+
+static struct sigaction previous_abort;
+
+static void abort_handler(int sig)
+{
+	if(pthread_mutex_trylock(&async_mutex) == 0) {
+		drain();
+		pthread_mutex_unlock(&async_mutex);
+	}
+
+	sigaction(SIGABRT, &previous_abort, 0);
+	raise(sig);
+}
+
+static void exit_handler(void)
+{
+	debug_async_stop();
+}
+
+/*
+Write the pending messages before forking, so that they appear before the ones
+of the child, and keep the lock until the fork is done.
+*/
+
+static void fork_prepare(void)
+{
+	if(async_write) {
+		pthread_mutex_lock(&async_mutex);
+		drain();
+	}
+}
+
+static void fork_parent(void)
+{
+	if(async_write)
+		pthread_mutex_unlock(&async_mutex);
+}
+
+static void fork_child(void)
+{
+	/* The flusher did not survive the fork, so the child writes synchronously. */
+	async_enabled = 0;
+	async_write = 0;
+	async_rings = 0;
+	thread_ring = 0;
+	pthread_mutex_init(&async_mutex, 0);
+	pthread_cond_init(&async_cond, 0);
+}
+
+int debug_async_start(void (*write) (INT64_T flags, const char *str), size_t size)
+{
+	static int handlers_installed = 0;
+
+	if(async_enabled)
+		return 0;
+
+	if(size > 0)
+		async_ring_size = align8(size);
+
+	async_write = write;
+	async_stop = 0;
+
+	if(pthread_create(&async_thread, 0, flusher, 0) != 0) {
+		async_write = 0;
+		return -1;
+	}
+
+	if(!handlers_installed) {
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = abort_handler;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGABRT, &sa, &previous_abort);
+
+		atexit(exit_handler);
+		pthread_atfork(fork_prepare, fork_parent, fork_child);
+		handlers_installed = 1;
+	}
+
+	__atomic_store_n(&async_enabled, 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+void debug_async_stop(void)
+{
+	if(!async_enabled)
+		return;
+
+	__atomic_store_n(&async_enabled, 0, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&async_mutex);
+	async_stop = 1;
+	pthread_cond_signal(&async_cond);
+	pthread_mutex_unlock(&async_mutex);
+
+	pthread_join(async_thread, 0);
+
+	debug_async_flush();
+	async_write = 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -259,3 +259,47 @@ double histogram_min_value(struct histogram *h) {
 double histogram_mode(struct histogram *h) {
 	return h->mode;
 }
+
+void histogram_merge(struct histogram *dest, struct histogram *src) {
+
+	if(dest->bucket_size != src->bucket_size) {
+		fatal("Histograms with different bucket sizes cannot be merged: %lf and %lf", dest->bucket_size, src->bucket_size);
+	}
+
+	if(src->total_count < 1) {
+		return;
+	}
+
+	if(dest->total_count < 1 || src->max_value > dest->max_value) {
+		dest->max_value = src->max_value;
+	}
+
+	if(dest->total_count < 1 || src->min_value < dest->min_value) {
+		dest->min_value = src->min_value;
+	}
+
+	uint64_t key;
+	struct box_count *box;
+
+	itable_firstkey(src->buckets);
+	while(itable_nextkey(src->buckets, &key, (void **) &box)) {
+		struct box_count *dbox = itable_lookup(dest->buckets, key);
+		if(!dbox) {
+			dbox = calloc(1, sizeof(*dbox));
+			itable_insert(dest->buckets, key, dbox);
+		}
+
+		dbox->count       += box->count;
+		dest->total_count += box->count;
+	}
+
+	/* the mode may come from either histogram, or from a bucket present in both. */
+	int mode_count = 0;
+	itable_firstkey(dest->buckets);
+	while(itable_nextkey(dest->buckets, &key, (void **) &box)) {
+		if(box->count > mode_count) {
+			mode_count = box->count;
+			dest->mode = end_of(dest, key);
+		}
+	}
+}
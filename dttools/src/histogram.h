@@ -157,4 +157,13 @@ double histogram_min_value(struct histogram *h);
 
 double histogram_mode(struct histogram *h);
 
+/** Add the counts of a histogram to another.
+Both histograms should have the same bucket size. Data attached to the
+buckets of src is not copied, as histograms do not know how to combine it.
+@param dest A pointer to the histogram that is updated.
+@param src A pointer to the histogram whose counts are added to dest.
+*/
+
+void histogram_merge(struct histogram *dest, struct histogram *src);
+
 #endif
@@ -0,0 +1,420 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "path_disk_size_watch.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+#include <sys/inotify.h>
+#endif
+
+#include "debug.h"
+#include "hash_table.h"
+#include "itable.h"
+#include "list.h"
+#include "path.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+/* Large enough for many events per read. Must be aligned for struct inotify_event. */
+#define EVENTS_BUFFER_SIZE (64*1024)
+
+struct watched_dir {
+	int   wd;
+	char *path;
+	struct hash_table *entries;   /* name -> struct watched_entry */
+};
+
+struct watched_entry {
+	int64_t size;
+	int     is_dir;
+};
+
+struct path_disk_size_watch {
+	char *path;
+	int   fd;
+
+	int64_t byte_count;
+	int64_t file_count;
+
+	struct itable     *dirs_by_wd;
+	struct hash_table *dirs_by_path;
+	struct hash_table *dirty;     /* paths of files modified since the last measurement. */
+
+	int needs_rescan;             /* events were lost. */
+	int failed;                   /* could not add a watch. */
+};
+
+static struct watched_dir *watch_dir(struct path_disk_size_watch *w, const char *path);
+static void unwatch_dir(struct path_disk_size_watch *w, struct watched_dir *dir);
+
+static int64_t regular_size(struct stat *info)
+{
+	return S_ISREG(info->st_mode) ? (int64_t) info->st_size : 0;
+}
+
+/* Add name to dir, or update its size if already present. */
+static void add_entry(struct path_disk_size_watch *w, struct watched_dir *dir, const char *name, struct stat *info)
+{
+	struct watched_entry *e = hash_table_lookup(dir->entries, name);
+
+	if(e) {
+		int64_t size = regular_size(info);
+		w->byte_count += size - e->size;
+		e->size = size;
+		return;
+	}
+
+	e = malloc(sizeof(*e));
+	e->size   = regular_size(info);
+	e->is_dir = S_ISDIR(info->st_mode);
+
+	hash_table_insert(dir->entries, name, e);
+
+	w->file_count++;
+	w->byte_count += e->size;
+
+	if(e->is_dir) {
+		char *child = string_format("%s/%s", dir->path, name);
+		watch_dir(w, child);
+		free(child);
+	}
+}
+
+static void remove_entry(struct path_disk_size_watch *w, struct watched_dir *dir, const char *name)
+{
+	struct watched_entry *e = hash_table_remove(dir->entries, name);
+	if(!e)
+		return;
+
+	w->file_count--;
+	w->byte_count -= e->size;
+
+	if(e->is_dir) {
+		char *child_path = string_format("%s/%s", dir->path, name);
+		struct watched_dir *child = hash_table_lookup(w->dirs_by_path, child_path);
+		free(child_path);
+
+		if(child)
+			unwatch_dir(w, child);
+	}
+
+	free(e);
+}
+
+/* Add a watch to path and all its subdirectories, and add their entries to
+ * the counts. The counts of path itself are added by the caller. */
+static struct watched_dir *watch_dir(struct path_disk_size_watch *w, const char *path)
+{
+	struct watched_dir *dir = hash_table_lookup(w->dirs_by_path, path);
+	if(dir)
+		return dir;
+
+	int wd = inotify_add_watch(w->fd, path, WATCH_MASK);
+	if(wd < 0) {
+		if(errno != ENOENT && errno != ENOTDIR) {
+			debug(D_DEBUG, "could not watch directory %s: %s\n", path, strerror(errno));
+			w->failed = 1;
+		}
+		return NULL;
+	}
+
+	dir = malloc(sizeof(*dir));
+	dir->wd      = wd;
+	dir->path    = xxstrdup(path);
+	dir->entries = hash_table_create(0, 0);
+
+	itable_insert(w->dirs_by_wd, wd, dir);
+	hash_table_insert(w->dirs_by_path, dir->path, dir);
+
+	/* the watch is added before reading the directory, so that entries
+	 * created while reading generate events. add_entry ignores duplicates. */
+	DIR *d = opendir(path);
+	if(!d)
+		return dir;
+
+	struct dirent *entry;
+	struct stat info;
+	char composed_path[PATH_MAX];
+
+	while((entry = readdir(d))) {
+		if(strcmp(".", entry->d_name) == 0 || strcmp("..", entry->d_name) == 0)
+			continue;
+
+		snprintf(composed_path, PATH_MAX, "%s/%s", path, entry->d_name);
+		if(lstat(composed_path, &info) < 0)
+			continue;
+
+		add_entry(w, dir, entry->d_name, &info);
+	}
+
+	closedir(d);
+
+	return dir;
+}
+
+/* Remove the watch of dir and of its subdirectories, and subtract their entries from the counts. */
+static void unwatch_dir(struct path_disk_size_watch *w, struct watched_dir *dir)
+{
+	struct list *names = list_create();
+
+	char *name;
+	void *e;
+	hash_table_firstkey(dir->entries);
+	while(hash_table_nextkey(dir->entries, &name, &e)) {
+		list_push_tail(names, xxstrdup(name));
+	}
+
+	while((name = list_pop_head(names))) {
+		remove_entry(w, dir, name);
+		free(name);
+	}
+	list_delete(names);
+
+	/* fails if the directory was already deleted, in which case the kernel already removed the watch. */
+	inotify_rm_watch(w->fd, dir->wd);
+
+	itable_remove(w->dirs_by_wd, dir->wd);
+	hash_table_remove(w->dirs_by_path, dir->path);
+	hash_table_delete(dir->entries);
+	free(dir->path);
+	free(dir);
+}
+
+static int seed(struct path_disk_size_watch *w)
+{
+	struct watched_dir *root = hash_table_lookup(w->dirs_by_path, w->path);
+	if(root)
+		unwatch_dir(w, root);
+
+	hash_table_clear(w->dirty);
+
+	w->byte_count   = 0;
+	w->file_count   = 1;    /* count the root directory, as path_disk_size_info does. */
+	w->needs_rescan = 0;
+	w->failed       = 0;
+
+	if(!watch_dir(w, w->path) || w->failed)
+		return -1;
+
+	return 0;
+}
+
+struct path_disk_size_watch *path_disk_size_watch_create(const char *path)
+{
+	struct stat info;
+	if(stat(path, &info) < 0 || !S_ISDIR(info.st_mode)) {
+		return NULL;
+	}
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(fd < 0) {
+		debug(D_DEBUG, "could not initialize inotify: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	struct path_disk_size_watch *w = calloc(1, sizeof(*w));
+	w->path = xxstrdup(path);
+	path_remove_trailing_slashes(w->path);
+	w->fd   = fd;
+
+	w->dirs_by_wd   = itable_create(0);
+	w->dirs_by_path = hash_table_create(0, 0);
+	w->dirty        = hash_table_create(0, 0);
+
+	if(seed(w) < 0) {
+		path_disk_size_watch_delete(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+int path_disk_size_watch_fd(struct path_disk_size_watch *w)
+{
+	return w->fd;
+}
+
+static void handle_event(struct path_disk_size_watch *w, struct inotify_event *ev)
+{
+	if(ev->mask & IN_Q_OVERFLOW) {
+		debug(D_DEBUG, "inotify queue overflow on %s, measuring again.\n", w->path);
+		w->needs_rescan = 1;
+		return;
+	}
+
+	struct watched_dir *dir = itable_lookup(w->dirs_by_wd, ev->wd);
+	if(!dir)
+		return;
+
+	if(ev->len == 0) {
+		/* events on the directory itself. Moves and deletions of
+		 * subdirectories are handled by the events on their parent. Only
+		 * the root needs special handling. */
+		if((ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) && strcmp(dir->path, w->path) == 0) {
+			w->needs_rescan = 1;
+		}
+		return;
+	}
+
+	char *path = string_format("%s/%s", dir->path, ev->name);
+
+	if(ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		remove_entry(w, dir, ev->name);
+	} else if(ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+		struct stat info;
+		if(lstat(path, &info) == 0) {
+			add_entry(w, dir, ev->name, &info);
+		}
+	} else if(ev->mask & IN_MODIFY) {
+		/* files may be modified many times between measurements, so we
+		 * only stat them when a measurement is requested. */
+		hash_table_insert(w->dirty, path, w);
+	}
+
+	free(path);
+}
+
+int path_disk_size_watch_handle_events(struct path_disk_size_watch *w)
+{
+	char buffer[EVENTS_BUFFER_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	while(1) {
+		ssize_t n = read(w->fd, buffer, sizeof(buffer));
+
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+
+		if(n == 0)
+			break;
+
+		char *p;
+		for(p = buffer; p < buffer + n; ) {
+			struct inotify_event *ev = (struct inotify_event *) p;
+			handle_event(w, ev);
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+
+	return w->failed ? -1 : 0;
+}
+
+static void update_dirty(struct path_disk_size_watch *w)
+{
+	char *path;
+	void *dummy;
+	char dirname[PATH_MAX];
+
+	hash_table_firstkey(w->dirty);
+	while(hash_table_nextkey(w->dirty, &path, &dummy)) {
+		struct stat info;
+		if(lstat(path, &info) < 0)
+			continue;
+
+		path_dirname(path, dirname);
+		struct watched_dir *dir = hash_table_lookup(w->dirs_by_path, dirname);
+		if(!dir)
+			continue;
+
+		const char *name = path_basename(path);
+		if(hash_table_lookup(dir->entries, name)) {
+			add_entry(w, dir, name, &info);
+		}
+	}
+
+	hash_table_clear(w->dirty);
+}
+
+int path_disk_size_watch_get(struct path_disk_size_watch *w, int64_t *measured_size, int64_t *number_of_files)
+{
+	if(path_disk_size_watch_handle_events(w) < 0)
+		return -1;
+
+	if(w->needs_rescan && seed(w) < 0)
+		return -1;
+
+	update_dirty(w);
+
+	*measured_size   = w->byte_count;
+	*number_of_files = w->file_count;
+
+	return 0;
+}
+
+void path_disk_size_watch_delete(struct path_disk_size_watch *w)
+{
+	if(!w)
+		return;
+
+	struct watched_dir *root = hash_table_lookup(w->dirs_by_path, w->path);
+	if(root)
+		unwatch_dir(w, root);
+
+	/* if a watch failed in the middle of the tree, some directories may not
+	 * be reachable from the root. */
+	uint64_t wd;
+	struct watched_dir *dir;
+	itable_firstkey(w->dirs_by_wd);
+	while(itable_nextkey(w->dirs_by_wd, &wd, (void **) &dir)) {
+		unwatch_dir(w, dir);
+		itable_firstkey(w->dirs_by_wd);
+	}
+
+	close(w->fd);
+
+	itable_delete(w->dirs_by_wd);
+	hash_table_delete(w->dirs_by_path);
+	hash_table_delete(w->dirty);
+
+	free(w->path);
+	free(w);
+}
+
+#else
+
+struct path_disk_size_watch *path_disk_size_watch_create(const char *path)
+{
+	return NULL;
+}
+
+int path_disk_size_watch_fd(struct path_disk_size_watch *w)
+{
+	return -1;
+}
+
+int path_disk_size_watch_handle_events(struct path_disk_size_watch *w)
+{
+	return -1;
+}
+
+int path_disk_size_watch_get(struct path_disk_size_watch *w, int64_t *measured_size, int64_t *number_of_files)
+{
+	return -1;
+}
+
+void path_disk_size_watch_delete(struct path_disk_size_watch *w)
+{
+}
+
+#endif
+
+/* vim: set noexpandtab tabstop=4: */
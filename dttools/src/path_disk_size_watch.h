@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef PATH_DISK_SIZE_WATCH_H
+#define PATH_DISK_SIZE_WATCH_H
+
+#include "int_sizes.h"
+
+/** @file path_disk_size_watch.h
+Incrementally track the disk usage of a directory tree.
+
+The tree is walked once when the watch is created, and then the counts are
+updated from inotify events, so that the cost of a measurement is
+proportional to the number of changes rather than to the size of the tree.
+The counts are the same as the ones of @ref path_disk_size_info_get:
+the total size of regular files, and the number of files, directories, and
+symbolic links, including the root directory.
+
+Only available on Linux. Each directory in the tree uses one inotify watch,
+so the tree size is limited by /proc/sys/fs/inotify/max_user_watches.
+*/
+
+struct path_disk_size_watch;
+
+/** Start tracking the disk usage of path.
+@param path Directory to be measured.
+@return A watch on success, or NULL if inotify is not available, path is not a directory, or there are not enough inotify watches for the tree.
+*/
+struct path_disk_size_watch *path_disk_size_watch_create(const char *path);
+
+/** Get the file descriptor that becomes readable when there are changes in the tree.
+Calling @ref path_disk_size_watch_handle_events when readable keeps the
+inotify event queue from overflowing between measurements.
+@param w A watch created with @ref path_disk_size_watch_create.
+@return A file descriptor suitable for select.
+*/
+int path_disk_size_watch_fd(struct path_disk_size_watch *w);
+
+/** Process the pending events of the watch without blocking.
+@param w A watch created with @ref path_disk_size_watch_create.
+@return zero on success, -1 if the watch can no longer be kept up to date (e.g., out of inotify watches).
+*/
+int path_disk_size_watch_handle_events(struct path_disk_size_watch *w);
+
+/** Get the current disk usage of the tree.
+@param w A watch created with @ref path_disk_size_watch_create.
+@param *measured_size A pointer to an integer that will be filled with the total space in bytes.
+@param *number_of_files A pointer to an integer that will be filled with the total number of files, directories, and symbolic links.
+@return zero on success, -1 if the watch can no longer be kept up to date. In that case the watch should be deleted, and the tree measured with @ref path_disk_size_info_get_r.
+*/
+int path_disk_size_watch_get(struct path_disk_size_watch *w, int64_t *measured_size, int64_t *number_of_files);
+
+/** Stop tracking the tree and free the watch.
+@param w A watch created with @ref path_disk_size_watch_create.
+*/
+void path_disk_size_watch_delete(struct path_disk_size_watch *w);
+
+#endif
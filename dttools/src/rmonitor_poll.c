@@ -14,6 +14,7 @@ See the file COPYING for details.
 
 #include "debug.h"
 #include "path_disk_size_info.h"
+#include "path_disk_size_watch.h"
 #include "macros.h"
 #include "stringtools.h"
 #include "xxmalloc.h"
@@ -29,6 +30,16 @@ See the file COPYING for details.
 
 #define ANON_MAPS_NAME "[anon]"
 
+/* Maximum number of /proc files kept open between polls. Files of processes
+ * beyond this limit are opened and closed at each poll. */
+#define MAX_CACHED_PROC_FILES 300
+
+static int cached_proc_files = 0;
+
+static int rmonitor_read_cpu_time_usage(FILE *fstat,   struct rmonitor_cpu_time_info *cpu);
+static int rmonitor_read_mem_usage(     FILE *fstatus, struct rmonitor_mem_info *mem);
+static int rmonitor_read_sys_io_usage(  FILE *fio,     struct rmonitor_io_info *io);
+
 uint64_t usecs_since_epoch()
 {
 	uint64_t usecs;
@@ -127,19 +138,71 @@ void rmonitor_poll_all_fss_once(struct itable *filesysms, struct rmonitor_filesy
  * filesystem.
 ***/
 
+/* Return /proc/pid/filename, reusing *cached if it was already open. The
+ * contents of proc files are generated again when read from the start, so
+ * rewinding is enough to get new values, and saves an open and close per
+ * file per poll. */
+static FILE *reuse_proc_file(FILE **cached, pid_t pid, char *filename)
+{
+	if(*cached) {
+		rewind(*cached);
+		return *cached;
+	}
+
+	FILE *f = open_proc_file(pid, filename);
+
+	if(f && cached_proc_files < MAX_CACHED_PROC_FILES) {
+		*cached = f;
+		cached_proc_files++;
+	}
+
+	return f;
+}
+
+static void release_proc_file(FILE **cached, FILE *f)
+{
+	if(f && f != *cached)
+		fclose(f);
+}
+
+static void close_proc_file(FILE **cached)
+{
+	if(*cached) {
+		fclose(*cached);
+		*cached = NULL;
+		cached_proc_files--;
+	}
+}
+
 int rmonitor_poll_process_once(struct rmonitor_process_info *p)
 {
 	int status = 0;
+	FILE *f;
 
 	debug(D_RMON, "monitoring process: %d\n", p->pid);
 
-	status |= rmonitor_get_cpu_time_usage(p->pid, &p->cpu);
-	status |= rmonitor_get_mem_usage(p->pid, &p->mem);
-	status |= rmonitor_get_sys_io_usage(p->pid, &p->io);
+	f = reuse_proc_file(&p->fstat, p->pid, "stat");
+	status |= rmonitor_read_cpu_time_usage(f, &p->cpu);
+	release_proc_file(&p->fstat, f);
+
+	f = reuse_proc_file(&p->fstatus, p->pid, "status");
+	status |= rmonitor_read_mem_usage(f, &p->mem);
+	release_proc_file(&p->fstatus, f);
+
+	f = reuse_proc_file(&p->fio, p->pid, "io");
+	status |= rmonitor_read_sys_io_usage(f, &p->io);
+	release_proc_file(&p->fio, f);
 
 	return status;
 }
 
+void rmonitor_poll_process_close(struct rmonitor_process_info *p)
+{
+	close_proc_file(&p->fstat);
+	close_proc_file(&p->fstatus);
+	close_proc_file(&p->fio);
+}
+
 int rmonitor_poll_wd_once(struct rmonitor_wdir_info *d, int max_time_for_measurement)
 {
 	debug(D_RMON, "monitoring dir %s\n", d->path);
@@ -287,10 +350,20 @@ int rmonitor_get_cpu_time_usage(pid_t pid, struct rmonitor_cpu_time_info *cpu)
 {
 	/* /dev/proc/[pid]/stat */
 
-	uint64_t kernel, user;
+	FILE *fstat = open_proc_file(pid, "stat");
+	if(!fstat)
+		return 1;
 
+	int status = rmonitor_read_cpu_time_usage(fstat, cpu);
+	fclose(fstat);
+
+	return status;
+}
+
+static int rmonitor_read_cpu_time_usage(FILE *fstat, struct rmonitor_cpu_time_info *cpu)
+{
+	uint64_t kernel, user;
 
-	FILE *fstat = open_proc_file(pid, "stat");
 	if(!fstat)
 		return 1;
 
@@ -303,7 +376,6 @@ int rmonitor_get_cpu_time_usage(pid_t pid, struct rmonitor_cpu_time_info *cpu)
 			"%" SCNu64 /* kernel mode time (in clock ticks) */
 			/* .... */,
 			&kernel, &user);
-	fclose(fstat);
 
 	if(n != 2)
 		return 1;
@@ -344,6 +416,17 @@ int rmonitor_get_mem_usage(pid_t pid, struct rmonitor_mem_info *mem)
 	if(!fmem)
 		return 1;
 
+	int status = rmonitor_read_mem_usage(fmem, mem);
+	fclose(fmem);
+
+	return status;
+}
+
+static int rmonitor_read_mem_usage(FILE *fmem, struct rmonitor_mem_info *mem)
+{
+	if(!fmem)
+		return 1;
+
 	int status = 0;
 	/* in kB */
 	status |= rmonitor_get_int_attribute(fmem, "VmPeak:", &mem->virtual,  1);
@@ -355,8 +438,6 @@ int rmonitor_get_mem_usage(pid_t pid, struct rmonitor_mem_info *mem)
 	/* from smaps when reading maps. */
 	mem->swap = 0;
 
-	fclose(fmem);
-
 	/* in MB */
 	mem->virtual  = DIV_INT_ROUND_UP(mem->virtual,  1024);
 	mem->resident = DIV_INT_ROUND_UP(mem->resident, 1024);
@@ -597,6 +678,17 @@ int rmonitor_get_sys_io_usage(pid_t pid, struct rmonitor_io_info *io)
 	*/
 
 	FILE *fio = open_proc_file(pid, "io");
+
+	int status = rmonitor_read_sys_io_usage(fio, io);
+
+	if(fio)
+		fclose(fio);
+
+	return status;
+}
+
+static int rmonitor_read_sys_io_usage(FILE *fio, struct rmonitor_io_info *io)
+{
 	uint64_t cread, cwritten;
 	int rstatus, wstatus;
 
@@ -612,8 +704,6 @@ int rmonitor_get_sys_io_usage(pid_t pid, struct rmonitor_io_info *io)
 	rstatus  = rmonitor_get_int_attribute(fio, "rchar", &cread, 1);
 	wstatus  = rmonitor_get_int_attribute(fio, "write_bytes", &cwritten, 1);
 
-	fclose(fio);
-
 	if(rstatus || wstatus)
 		return 1;
 
@@ -702,6 +792,19 @@ void acc_dsk_usage(struct statfs *acc, struct statfs *other)
 
 int rmonitor_get_wd_usage(struct rmonitor_wdir_info *d, int max_time_for_measurement)
 {
+	if(d->watch) {
+		int64_t byte_count, files;
+		if(path_disk_size_watch_get(d->watch, &byte_count, &files) == 0) {
+			d->files      = files;
+			d->byte_count = byte_count;
+			return 0;
+		}
+
+		debug(D_RMON, "could not keep track of changes in %s, measuring with a full walk.\n", d->path);
+		path_disk_size_watch_delete(d->watch);
+		d->watch = NULL;
+	}
+
 	/* We need a pointer to a pointer, which it is not possible from a struct. Use a dummy variable. */
 	struct path_disk_size_info *state = d->state;
 	int status = path_disk_size_info_get_r(d->path, max_time_for_measurement, &state);
@@ -791,9 +894,11 @@ struct rmsummary *rmonitor_measure_process(pid_t pid) {
 	struct rmsummary *tr = rmsummary_create(-1);
 
 	struct rmonitor_process_info p;
+	bzero(&p, sizeof(p));
 	p.pid = pid;
 
 	err = rmonitor_poll_process_once(&p);
+	rmonitor_poll_process_close(&p);
 	if(err != 0)
 		return NULL;
 
@@ -806,7 +911,7 @@ struct rmsummary *rmonitor_measure_process(pid_t pid) {
 
 	if(n != -1)  {
 		cwd_org[n] = '\0';
-		d = malloc(sizeof(struct rmonitor_wdir_info));
+		d = calloc(1, sizeof(struct rmonitor_wdir_info));
 		d->path  = cwd_org;
 		d->state = NULL;
 
@@ -45,6 +45,8 @@ int rmonitor_poll_wd_once(     struct rmonitor_wdir_info    *d, int max_time_for
 int rmonitor_poll_fs_once(     struct rmonitor_filesys_info *f);
 int rmonitor_poll_maps_once(   struct itable *processes, struct rmonitor_mem_info *mem);
 
+void rmonitor_poll_process_close(struct rmonitor_process_info *p);
+
 void rmonitor_info_to_rmsummary(struct rmsummary *tr, struct rmonitor_process_info *p, struct rmonitor_wdir_info *d, struct rmonitor_filesys_info *f, uint64_t start_time);
 
 int rmonitor_get_cpu_time_usage(pid_t pid,        struct rmonitor_cpu_time_info *cpu);
@@ -17,7 +17,10 @@
 #include <sys/statvfs.h>
 #endif
 
+#include <stdio.h>
+
 #include "path_disk_size_info.h"
+#include "path_disk_size_watch.h"
 
 #include "int_sizes.h"
 
@@ -109,6 +112,7 @@ struct rmonitor_wdir_info
 	off_t    byte_count;
 
 	struct path_disk_size_info *state;
+	struct path_disk_size_watch *watch; /* if not NULL, used instead of walking the tree. */
 	struct rmonitor_filesys_info *fs;
 };
 
@@ -136,6 +140,11 @@ struct rmonitor_process_info
 	struct rmonitor_io_info       io;
 	struct rmonitor_load_info     load;
 	struct rmonitor_wdir_info    *wd;
+
+	/* /proc/pid files kept open between polls. NULL if not open. */
+	FILE *fstat;
+	FILE *fstatus;
+	FILE *fio;
 };
 
 #endif
@@ -1303,6 +1303,324 @@ struct rmsummary *rmsummary_get_snapshot(const struct rmsummary *s, int i) {
 	return s->snapshots[i];
 }
 
+/* Binary time series.
+ *
+ * The file starts with RMSUMMARY_SERIES_MAGIC and a version byte, followed
+ * by a header with the string fields of the summary (command, category,
+ * etc.) and the names of the integer fields in each sample. Each sample is
+ * then written as the difference to the previous sample, field by field,
+ * zigzag and varint encoded. Samples change little from one to the next, so
+ * most fields take a single byte. All integers in the file use the same
+ * encoding. */
+
+#define RMSUMMARY_SERIES_MAGIC   "RMSERIES"
+#define RMSUMMARY_SERIES_VERSION 1
+
+/* sanity limits when reading headers. */
+#define RMSUMMARY_SERIES_MAX_STRING (1 << 20)
+#define RMSUMMARY_SERIES_MAX_FIELDS 1024
+
+struct rmsummary_series {
+	FILE *stream;
+
+	struct rmsummary *info;  /* fields common to all samples (command, category, start, ...) */
+
+	int       field_count;
+	char    **fields;
+	int64_t  *last;          /* values of the previous sample, for delta encoding. */
+};
+
+static const char *series_info_fields[] = { "command", "category", "taskid", NULL };
+
+static void series_write_varint(FILE *stream, uint64_t n)
+{
+	while(n >= 0x80) {
+		fputc((n & 0x7f) | 0x80, stream);
+		n >>= 7;
+	}
+
+	fputc(n, stream);
+}
+
+/* returns 0 on success, -1 on end of file or malformed input. */
+static int series_read_varint(FILE *stream, uint64_t *n)
+{
+	int shift = 0;
+	int c;
+
+	*n = 0;
+	while((c = fgetc(stream)) != EOF) {
+		*n |= ((uint64_t) (c & 0x7f)) << shift;
+
+		if(!(c & 0x80))
+			return 0;
+
+		shift += 7;
+		if(shift > 63)
+			return -1;
+	}
+
+	return -1;
+}
 
+/* zigzag encoding, so that small negative deltas are also small numbers. */
+static void series_write_int(FILE *stream, int64_t n)
+{
+	series_write_varint(stream, (((uint64_t) n) << 1) ^ (uint64_t) (n >> 63));
+}
+
+static int series_read_int(FILE *stream, int64_t *n)
+{
+	uint64_t u;
+	if(series_read_varint(stream, &u) < 0)
+		return -1;
+
+	*n = (int64_t) ((u >> 1) ^ (~(u & 1) + 1));
+
+	return 0;
+}
+
+static void series_write_string(FILE *stream, const char *str)
+{
+	size_t n = strlen(str);
+	series_write_varint(stream, n);
+	fwrite(str, 1, n, stream);
+}
+
+static char *series_read_string(FILE *stream)
+{
+	uint64_t n;
+	if(series_read_varint(stream, &n) < 0 || n > RMSUMMARY_SERIES_MAX_STRING)
+		return NULL;
+
+	char *str = malloc(n + 1);
+	if(fread(str, 1, n, stream) != n) {
+		free(str);
+		return NULL;
+	}
+	str[n] = '\0';
+
+	return str;
+}
+
+static struct rmsummary_series *series_create(FILE *stream)
+{
+	struct rmsummary_series *series = calloc(1, sizeof(*series));
+	series->stream = stream;
+	series->info   = rmsummary_create(-1);
+
+	return series;
+}
+
+struct rmsummary_series *rmsummary_series_create(FILE *stream, const struct rmsummary *info, const char **fields)
+{
+	struct rmsummary_series *series = series_create(stream);
+
+	series->info->start = info->start;
+
+	const char **f;
+	for(f = series_info_fields; *f; f++) {
+		const char *value = rmsummary_get_char_field((struct rmsummary *) info, *f);
+		if(value)
+			rmsummary_assign_char_field(series->info, *f, (char *) value);
+	}
+
+	for(f = fields; *f; f++) {
+		series->field_count++;
+	}
+
+	series->fields = malloc(series->field_count * sizeof(char *));
+	series->last   = calloc(series->field_count, sizeof(int64_t));
+
+	int i;
+	for(i = 0; i < series->field_count; i++) {
+		series->fields[i] = xxstrdup(fields[i]);
+	}
+
+	fwrite(RMSUMMARY_SERIES_MAGIC, 1, strlen(RMSUMMARY_SERIES_MAGIC), stream);
+	fputc(RMSUMMARY_SERIES_VERSION, stream);
+
+	series_write_int(stream, series->info->start);
+
+	int count = 0;
+	for(f = series_info_fields; *f; f++) {
+		if(rmsummary_get_char_field(series->info, *f))
+			count++;
+	}
+
+	series_write_varint(stream, count);
+	for(f = series_info_fields; *f; f++) {
+		const char *value = rmsummary_get_char_field(series->info, *f);
+		if(value) {
+			series_write_string(stream, *f);
+			series_write_string(stream, value);
+		}
+	}
+
+	series_write_varint(stream, series->field_count);
+	for(i = 0; i < series->field_count; i++) {
+		series_write_string(stream, series->fields[i]);
+	}
+
+	if(ferror(stream)) {
+		rmsummary_series_delete(series);
+		return NULL;
+	}
+
+	return series;
+}
+
+int rmsummary_series_write(struct rmsummary_series *series, struct rmsummary *sample)
+{
+	int i;
+	for(i = 0; i < series->field_count; i++) {
+		int64_t value = rmsummary_get_int_field(sample, series->fields[i]);
+		series_write_int(series->stream, value - series->last[i]);
+		series->last[i] = value;
+	}
+
+	return ferror(series->stream) ? -1 : 0;
+}
+
+struct rmsummary_series *rmsummary_series_open(FILE *stream)
+{
+	char magic[sizeof(RMSUMMARY_SERIES_MAGIC)];
+	size_t n = strlen(RMSUMMARY_SERIES_MAGIC);
+
+	if(fread(magic, 1, n, stream) != n || memcmp(magic, RMSUMMARY_SERIES_MAGIC, n) != 0) {
+		return NULL;
+	}
+
+	int version = fgetc(stream);
+	if(version != RMSUMMARY_SERIES_VERSION) {
+		debug(D_NOTICE, "Unsupported version of binary time series: %d\n", version);
+		return NULL;
+	}
+
+	struct rmsummary_series *series = series_create(stream);
+
+	uint64_t count;
+	if(series_read_int(stream, &series->info->start) < 0 || series_read_varint(stream, &count) < 0)
+		goto failure;
+
+	uint64_t i;
+	for(i = 0; i < count; i++) {
+		char *key   = series_read_string(stream);
+		char *value = key ? series_read_string(stream) : NULL;
+
+		if(value)
+			rmsummary_assign_char_field(series->info, key, value);
+
+		free(key);
+		free(value);
+
+		if(!value)
+			goto failure;
+	}
+
+	if(series_read_varint(stream, &count) < 0 || count > RMSUMMARY_SERIES_MAX_FIELDS)
+		goto failure;
+
+	series->field_count = count;
+	series->fields = calloc(series->field_count, sizeof(char *));
+	series->last   = calloc(series->field_count, sizeof(int64_t));
+
+	for(i = 0; i < count; i++) {
+		series->fields[i] = series_read_string(stream);
+		if(!series->fields[i])
+			goto failure;
+	}
+
+	return series;
+
+failure:
+	debug(D_NOTICE, "Malformed header of binary time series.\n");
+	rmsummary_series_delete(series);
+	return NULL;
+}
+
+struct rmsummary *rmsummary_series_next(struct rmsummary_series *series)
+{
+	int64_t delta;
+	int i;
+
+	/* a truncated sample (e.g., the monitor was killed while writing) is
+	 * treated as the end of the series. */
+	for(i = 0; i < series->field_count; i++) {
+		if(series_read_int(series->stream, &delta) < 0)
+			return NULL;
+
+		series->last[i] += delta;
+	}
+
+	struct rmsummary *s = rmsummary_copy(series->info);
+
+	for(i = 0; i < series->field_count; i++) {
+		rmsummary_assign_int_field(s, series->fields[i], series->last[i]);
+	}
+
+	if(s->wall_time >= 0)
+		s->end = s->start + s->wall_time;
+
+	return s;
+}
+
+void rmsummary_series_delete(struct rmsummary_series *series)
+{
+	if(!series)
+		return;
+
+	int i;
+	for(i = 0; i < series->field_count; i++) {
+		free(series->fields[i]);
+	}
+
+	free(series->fields);
+	free(series->last);
+	rmsummary_delete(series->info);
+	free(series);
+}
+
+/* As cumulative fields only grow, the maximum of the samples is the same
+ * summary that resource_monitor writes at the end of the run, without the
+ * exit status. */
+struct rmsummary *rmsummary_series_max(struct rmsummary_series *series)
+{
+	struct rmsummary *s = rmsummary_copy(series->info);
+	struct rmsummary *sample;
+
+	while((sample = rmsummary_series_next(series))) {
+		rmsummary_merge_max(s, sample);
+		rmsummary_delete(sample);
+	}
+
+	if(s->wall_time > 0 && s->cpu_time >= 0) {
+		//in millicores
+		s->cores_avg = (s->cpu_time * 1000.0)/s->wall_time;
+	}
+
+	return s;
+}
+
+struct rmsummary *rmsummary_parse_series_file(const char *filename)
+{
+	FILE *stream = fopen(filename, "r");
+	if(!stream) {
+		debug(D_NOTICE, "Cannot open time series file: %s : %s\n", filename, strerror(errno));
+		return NULL;
+	}
+
+	struct rmsummary *s = NULL;
+	struct rmsummary_series *series = rmsummary_series_open(stream);
+
+	if(series) {
+		s = rmsummary_series_max(series);
+		rmsummary_series_delete(series);
+	}
+
+	fclose(stream);
+
+	return s;
+}
 
 /* vim: set noexpandtab tabstop=4: */
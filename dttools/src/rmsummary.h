@@ -134,4 +134,31 @@ int rmsummary_field_is_float(const char *key);
 
 struct rmsummary *rmsummary_get_snapshot(const struct rmsummary *s, int i);
 
+/* Binary time series of summaries. Each sample is written as the
+   difference to the previous one, with variable length integers. */
+struct rmsummary_series;
+
+/**  Start a new series in stream. String fields (command, category, etc.)
+     and start are taken from info. fields is a NULL terminated list of the
+     names of the integer fields written per sample. **/
+struct rmsummary_series *rmsummary_series_create(FILE *stream, const struct rmsummary *info, const char **fields);
+
+/**  Append the fields of sample to the series. Returns 0 on success. **/
+int rmsummary_series_write(struct rmsummary_series *series, struct rmsummary *sample);
+
+/**  Read the header of a series from stream. Returns NULL if stream is not a binary series. **/
+struct rmsummary_series *rmsummary_series_open(FILE *stream);
+
+/**  Read the next sample of the series, or NULL at the end of the series. **/
+struct rmsummary *rmsummary_series_next(struct rmsummary_series *series);
+
+/**  Free the series. The stream is not closed. **/
+void rmsummary_series_delete(struct rmsummary_series *series);
+
+/**  Read the rest of the samples of the series, and return their maximum. **/
+struct rmsummary *rmsummary_series_max(struct rmsummary_series *series);
+
+/**  Reads a binary series file, and returns the maximum of its samples. NULL if filename is not a binary series. **/
+struct rmsummary *rmsummary_parse_series_file(const char *filename);
+
 #endif
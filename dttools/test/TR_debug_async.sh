@@ -0,0 +1,124 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+exe="debug_async.test"
+
+prepare()
+{
+	gcc -I../src/ -g $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none ../src/libdttools.a -lpthread -lm <<EOF
+#include "debug.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 8
+#define MESSAGES 20000
+#define TURN_THREADS 4
+#define TURNS 20000
+
+static int turn = 0;
+
+static void *logger(void *arg)
+{
+	int i;
+	for(i = 0; i < MESSAGES; i++) {
+		debug(D_DEBUG, "thread %ld message %d", (long) arg, i);
+	}
+	return 0;
+}
+
+/*
+The threads take turns, so that each message is logged after the one of the
+previous turn was, by another thread.
+*/
+
+static void *taker(void *arg)
+{
+	int n;
+	for(n = (long) arg; n < TURNS; n += TURN_THREADS) {
+		while(__atomic_load_n(&turn, __ATOMIC_ACQUIRE) != n)
+			sched_yield();
+		debug(D_DEBUG, "turn %d", n);
+		__atomic_store_n(&turn, n + 1, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t threads[THREADS];
+	pthread_t takers[TURN_THREADS];
+	long i;
+
+	debug_config(argv[0]);
+	debug_config_file(argv[1]);
+	debug_config_file_size(0);
+	debug_flags_set("debug");
+
+	/* small buffers, so that the threads wait for the flusher. */
+	if(debug_config_async(4096) == -1)
+		return 1;
+
+	for(i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], 0, logger, (void *) i);
+	for(i = 0; i < TURN_THREADS; i++)
+		pthread_create(&takers[i], 0, taker, (void *) i);
+	for(i = 0; i < THREADS; i++)
+		pthread_join(threads[i], 0);
+	for(i = 0; i < TURN_THREADS; i++)
+		pthread_join(takers[i], 0);
+
+	debug(D_DEBUG, "%s", "a message larger than the buffer: " "$(head -c 8192 /dev/zero | tr '\0' x)");
+	debug(D_DEBUG, "last message before fatal");
+	fatal("fatal message");
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	rm -f debug_async.log
+	./"$exe" debug_async.log
+
+	# every message is written once, in the order of each thread.
+	for t in 0 1 2 3 4 5 6 7
+	do
+		sed -n "s/.* thread $t message \([0-9]*\)$/\1/p" debug_async.log > debug_async.thread
+		if ! seq 0 19999 | cmp -s - debug_async.thread
+		then
+			echo "messages of thread $t are missing or out of order"
+			return 1
+		fi
+	done
+
+	# the turns are written in the order they were logged, across threads.
+	sed -n "s/.* turn \([0-9]*\)$/\1/p" debug_async.log > debug_async.thread
+	if ! seq 0 19999 | cmp -s - debug_async.thread
+	then
+		echo "turns are missing or out of order"
+		return 1
+	fi
+
+	grep -q "a message larger than the buffer: xxxx" debug_async.log || return 1
+	tail -n 2 debug_async.log | head -n 1 | grep -q "last message before fatal" || return 1
+	tail -n 1 debug_async.log | grep -q "fatal: fatal message" || return 1
+
+	return 0
+}
+
+clean()
+{
+	rm -f "$exe" debug_async.log debug_async.log.old debug_async.thread
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
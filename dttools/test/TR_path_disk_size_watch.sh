@@ -0,0 +1,124 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+exe="path_disk_size_watch.test"
+dir="path_disk_size_watch.dir"
+
+prepare()
+{
+	gcc -g $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src ../src/libdttools.a -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "path_disk_size_info.h"
+#include "path_disk_size_watch.h"
+#include "stringtools.h"
+#include "unlink_recursive.h"
+
+const char *dir = "$dir";
+
+void write_file(const char *name, int size)
+{
+	char *path = string_format("%s/%s", dir, name);
+	FILE *f = fopen(path, "w");
+	int i;
+	for(i = 0; i < size; i++) {
+		fputc('x', f);
+	}
+	fclose(f);
+	free(path);
+}
+
+/* the watch should agree with a full walk of the tree. */
+void check(struct path_disk_size_watch *w, const char *step)
+{
+	int64_t size, files, expected_size, expected_files;
+
+	if(path_disk_size_watch_get(w, &size, &files) < 0) {
+		fprintf(stderr, "%s: watch failed\n", step);
+		exit(EXIT_FAILURE);
+	}
+
+	path_disk_size_info_get(dir, &expected_size, &expected_files);
+
+	if(size != expected_size || files != expected_files) {
+		fprintf(stderr, "%s: got %lld bytes %lld files, expected %lld bytes %lld files\n", step, (long long) size, (long long) files, (long long) expected_size, (long long) expected_files);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%s: %lld bytes %lld files\n", step, (long long) size, (long long) files);
+}
+
+int main(int argc, char *argv[])
+{
+	char *path;
+
+	mkdir(dir, 0755);
+	write_file("a", 100);
+	mkdir("$dir/sub", 0755);
+	write_file("sub/b", 200);
+
+	struct path_disk_size_watch *w = path_disk_size_watch_create(dir);
+	if(!w) {
+		fprintf(stderr, "could not create watch.\n");
+		return EXIT_FAILURE;
+	}
+
+	check(w, "initial");
+
+	write_file("c", 300);
+	check(w, "create");
+
+	write_file("a", 1000);
+	check(w, "modify");
+
+	mkdir("$dir/sub/deep", 0755);
+	write_file("sub/deep/d", 400);
+	check(w, "nested directory");
+
+	rename("$dir/sub", "$dir/moved");
+	write_file("moved/deep/e", 500);
+	check(w, "move directory");
+
+	symlink("a", "$dir/link");
+	unlink("$dir/c");
+	check(w, "delete");
+
+	path = string_format("%s/moved", dir);
+	unlink_recursive(path);
+	free(path);
+	check(w, "delete directory");
+
+	unlink_recursive(dir);
+	mkdir(dir, 0755);
+	write_file("f", 600);
+	check(w, "recreate root");
+
+	path_disk_size_watch_delete(w);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	rm -rf "$dir"
+	./"$exe"
+	return $?
+}
+
+clean()
+{
+	rm -rf "$exe" "$dir"
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
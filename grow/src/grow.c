@@ -6,6 +6,9 @@ See the file COPYING for details.
 
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "grow.h"
 #include "debug.h"
@@ -214,3 +217,416 @@ struct grow_dirent * grow_lookup(const char *path, struct grow_dirent *root, int
 	errno = ENOENT;
 	return 0;
 }
+
+struct grow_index {
+	char *data;
+	size_t length;
+	int mapped;
+};
+
+static uint32_t grow_hash( const char *name, size_t length ) {
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for(i=0;i<length;i++) {
+		h ^= (unsigned char) name[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/*
+Return the position of the object of size bytes at offset from base,
+or zero if it does not lie entirely between start and the end of the index.
+*/
+
+static uint64_t grow_index_target( struct grow_index *g, uint64_t start, uint64_t base, int64_t offset, uint64_t size ) {
+	if(offset < (int64_t) start - (int64_t) base) return 0;
+
+	uint64_t t = base + offset;
+	if(t>=g->length || size>g->length-t) return 0;
+
+	return t;
+}
+
+/*
+Check every entry, so that following the offsets of a mapped index
+never leaves it: the name, link and buckets lie after the entries, where
+strings cannot run past the null byte that ends the index, and the parent
+and children are entries, with the parent before and the children after
+the entry, as written breadth first.
+*/
+
+static int grow_index_check_entries( struct grow_index *g ) {
+	const struct grow_index_header *h = (const struct grow_index_header *) g->data;
+	const int64_t size = sizeof(struct grow_entry);
+	uint64_t end = h->entries + h->nentries*size;
+	uint64_t i;
+
+	for(i=0;i<h->nentries;i++) {
+		uint64_t base = h->entries + i*size;
+		const struct grow_entry *e = (const struct grow_entry *) (g->data + base);
+		uint64_t t;
+
+		if(!grow_index_target(g,end,base,e->name,1)) return 0;
+		if(e->linkname && !grow_index_target(g,end,base,e->linkname,1)) return 0;
+
+		if(i==0) {
+			if(e->parent) return 0;
+		} else {
+			if(e->parent>=0 || e->parent%size) return 0;
+			if(e->parent < -(int64_t) (i*size)) return 0;
+		}
+
+		if(e->nchildren) {
+			if(e->children<=0 || e->children%size) return 0;
+			t = i + e->children/size;
+			if(t>=h->nentries || e->nchildren>h->nentries-t) return 0;
+		}
+
+		if(e->nbuckets) {
+			if(e->nbuckets&(e->nbuckets-1)) return 0;
+			t = grow_index_target(g,end,base,e->buckets,e->nbuckets*(uint64_t)sizeof(uint32_t));
+			if(!t || t%sizeof(uint32_t)) return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int grow_index_check( struct grow_index *g ) {
+	const struct grow_index_header *h = (const struct grow_index_header *) g->data;
+
+	if(g->length < sizeof(*h) || memcmp(h->magic,GROW_INDEX_MAGIC,sizeof(h->magic))) {
+		debug(D_GROW,"index does not have a valid header");
+		return 0;
+	}
+
+	if(h->byte_order!=GROW_INDEX_BYTE_ORDER || h->entry_size!=sizeof(struct grow_entry)) {
+		debug(D_GROW,"index was written for a different architecture");
+		return 0;
+	}
+
+	if(h->length!=g->length || h->nentries<1 || h->entries<sizeof(*h) || h->entries%8 || h->entries>g->length || h->nentries>(g->length-h->entries)/sizeof(struct grow_entry) || g->data[g->length-1]) {
+		debug(D_GROW,"index is truncated or corrupted");
+		return 0;
+	}
+
+	if(!grow_index_check_entries(g)) {
+		debug(D_GROW,"index has an entry that refers outside of it");
+		return 0;
+	}
+
+	if(!S_ISDIR(grow_index_root(g)->mode)) {
+		debug(D_GROW,"index root is not a directory");
+		return 0;
+	}
+
+	return 1;
+}
+
+struct grow_index *grow_index_open( const char *filename ) {
+	struct stat info;
+
+	int fd = open(filename,O_RDONLY);
+	if(fd<0) return 0;
+
+	if(fstat(fd,&info)<0) {
+		close(fd);
+		return 0;
+	}
+
+	void *data = mmap(0,info.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+
+	if(data==MAP_FAILED) return 0;
+
+	struct grow_index *g = xxmalloc(sizeof(*g));
+	g->data = data;
+	g->length = info.st_size;
+	g->mapped = 1;
+
+	if(!grow_index_check(g)) {
+		grow_index_delete(g);
+		errno = EINVAL;
+		return 0;
+	}
+
+	debug(D_GROW,"mapped index %s with %" PRIu64 " entries",filename,((struct grow_index_header *)g->data)->nentries);
+
+	return g;
+}
+
+static uint32_t grow_index_buckets( uint32_t nchildren ) {
+	uint32_t n = 1;
+
+	if(!nchildren) return 0;
+	while(n<2*nchildren) n *= 2;
+
+	return n;
+}
+
+static uint64_t grow_dirent_count( struct grow_dirent *d ) {
+	uint64_t n = 0;
+
+	for(;d;d=d->next) {
+		n += 1 + grow_dirent_count(d->children);
+	}
+
+	return n;
+}
+
+/*
+Lay out a directory tree as an index, in the same way as make_growfs.
+The entries are first put in breadth first order, then written after
+the header, followed by the hash buckets of each directory, and the strings.
+*/
+
+static struct grow_index *grow_index_from_dirent( struct grow_dirent *root ) {
+	struct grow_dirent *c;
+	uint64_t i, next, nentries, nbuckets = 0, nstrings = 1;
+
+	nentries = 1 + grow_dirent_count(root->children);
+
+	struct grow_dirent **order = xxmalloc(nentries*sizeof(*order));
+	uint64_t *first = xxmalloc(nentries*sizeof(*first));
+	uint32_t *count = xxmalloc(nentries*sizeof(*count));
+
+	order[0] = root;
+	next = 1;
+
+	for(i=0;i<nentries;i++) {
+		uint32_t j = 0;
+
+		first[i] = next;
+		count[i] = 0;
+		for(c=order[i]->children;c;c=c->next) count[i]++;
+
+		/* The children were read in reverse order from the listing. */
+		for(c=order[i]->children;c;c=c->next) order[next+count[i]-1-j++] = c;
+		next += count[i];
+		nbuckets += grow_index_buckets(count[i]);
+		nstrings += strlen(order[i]->name)+1;
+		if(order[i]->linkname) nstrings += strlen(order[i]->linkname)+1;
+	}
+
+	uint64_t entries = sizeof(struct grow_index_header);
+	uint64_t buckets = entries + nentries*sizeof(struct grow_entry);
+	uint64_t strings = buckets + ((nbuckets*sizeof(uint32_t)+7)&~7);
+
+	struct grow_index *g = xxmalloc(sizeof(*g));
+	g->length = strings + nstrings;
+	g->data = xxcalloc(1,g->length);
+	g->mapped = 0;
+
+	struct grow_index_header *h = (struct grow_index_header *) g->data;
+	memcpy(h->magic,GROW_INDEX_MAGIC,sizeof(h->magic));
+	h->byte_order = GROW_INDEX_BYTE_ORDER;
+	h->entry_size = sizeof(struct grow_entry);
+	h->nentries = nentries;
+	h->entries = entries;
+	h->length = g->length;
+
+	struct grow_entry *e = (struct grow_entry *) (g->data + entries);
+	uint32_t *b = (uint32_t *) (g->data + buckets);
+	char *s = g->data + strings + 1;
+
+	for(i=0;i<nentries;i++) {
+		struct grow_dirent *d = order[i];
+
+		e[i].inode = i+2;
+		e[i].size = d->size;
+		e[i].mtime = d->mtime;
+		e[i].mode = d->mode;
+		strncpy(e[i].checksum,d->checksum,sizeof(e[i].checksum)-1);
+
+		e[i].name = s - (char *) &e[i];
+		strcpy(s,d->name);
+		s += strlen(s)+1;
+
+		if(d->linkname) {
+			e[i].linkname = s - (char *) &e[i];
+			strcpy(s,d->linkname);
+			s += strlen(s)+1;
+		}
+
+		e[i].nchildren = count[i];
+		if(!count[i]) continue;
+
+		e[i].children = (char *) &e[first[i]] - (char *) &e[i];
+		e[i].nbuckets = grow_index_buckets(count[i]);
+		e[i].buckets = (char *) b - (char *) &e[i];
+
+		uint32_t j, mask = e[i].nbuckets-1;
+		for(j=0;j<count[i];j++) {
+			const char *name = order[first[i]+j]->name;
+			uint32_t k = grow_hash(name,strlen(name)) & mask;
+			while(b[k]) k = (k+1) & mask;
+			b[k] = j+1;
+
+			e[first[i]+j].parent = (char *) &e[i] - (char *) &e[first[i]+j];
+		}
+		b += e[i].nbuckets;
+	}
+
+	free(order);
+	free(first);
+	free(count);
+
+	return g;
+}
+
+struct grow_index *grow_index_from_file( FILE *file ) {
+	struct grow_dirent *root = grow_from_file(file);
+	if(!root) return 0;
+
+	struct grow_index *g = grow_index_from_dirent(root);
+	grow_delete(root);
+
+	return g;
+}
+
+void grow_index_delete( struct grow_index *g ) {
+	if(!g) return;
+
+	if(g->mapped) {
+		munmap(g->data,g->length);
+	} else {
+		free(g->data);
+	}
+
+	free(g);
+}
+
+const struct grow_entry *grow_index_root( struct grow_index *g ) {
+	const struct grow_index_header *h = (const struct grow_index_header *) g->data;
+	return (const struct grow_entry *) (g->data + h->entries);
+}
+
+const char *grow_entry_name( const struct grow_entry *e ) {
+	return (const char *) e + e->name;
+}
+
+const char *grow_entry_linkname( const struct grow_entry *e ) {
+	if(!e->linkname) return "";
+	return (const char *) e + e->linkname;
+}
+
+const struct grow_entry *grow_entry_parent( const struct grow_entry *e ) {
+	if(!e->parent) return 0;
+	return (const struct grow_entry *) ((const char *) e + e->parent);
+}
+
+const struct grow_entry *grow_entry_child( const struct grow_entry *e, unsigned i ) {
+	return (const struct grow_entry *) ((const char *) e + e->children) + i;
+}
+
+void grow_entry_to_stat( const struct grow_entry *e, struct stat *s ) {
+	s->st_dev = 1;
+	s->st_ino = e->inode;
+	s->st_mode = e->mode;
+	s->st_nlink = 1;
+	s->st_uid = 0;
+	s->st_gid = 0;
+	s->st_rdev = 1;
+	s->st_size = e->size;
+	s->st_blksize = 65536;
+	s->st_blocks = 1+e->size/512;
+	s->st_atime = e->mtime;
+	s->st_mtime = e->mtime;
+	s->st_ctime = e->mtime;
+}
+
+/*
+Find the child of directory d named by the first length bytes of name,
+by probing its hash buckets.
+*/
+
+static const struct grow_entry *grow_entry_find_child( const struct grow_entry *d, const char *name, size_t length ) {
+	if(!d->nbuckets) return 0;
+
+	const uint32_t *buckets = (const uint32_t *) ((const char *) d + d->buckets);
+	uint32_t mask = d->nbuckets-1;
+	uint32_t k = grow_hash(name,length) & mask;
+	uint32_t probes;
+
+	for(probes=0;probes<d->nbuckets && buckets[k];probes++) {
+		if(buckets[k]<=d->nchildren) {
+			const struct grow_entry *c = grow_entry_child(d,buckets[k]-1);
+			const char *cname = grow_entry_name(c);
+			if(!strncmp(cname,name,length) && !cname[length]) return c;
+		}
+		k = (k+1) & mask;
+	}
+
+	return 0;
+}
+
+/*
+Same as grow_lookup, but on an index.
+*/
+
+const struct grow_entry *grow_entry_lookup( const char *path, const struct grow_entry *root, int link_count ) {
+	const struct grow_entry *e;
+
+	if(!path) path = "\0";
+	while(*path=='/') path++;
+
+	if( S_ISLNK(root->mode) && ( link_count>0 || path[0] ) ) {
+		if(link_count>100) {
+			errno = ELOOP;
+			return 0;
+		}
+
+		const char *linkname = grow_entry_linkname(root);
+
+		if(linkname[0]=='/') {
+			while((e = grow_entry_parent(root))) {
+				root = e;
+			}
+		} else {
+			root = grow_entry_parent(root);
+		}
+
+		if(root) root = grow_entry_lookup(linkname, root, link_count + 1);
+		if(!root) {
+			errno = ENOENT;
+			return 0;
+		}
+	}
+
+	if(!*path) return root;
+
+	if(!S_ISDIR(root->mode)) {
+		errno = ENOTDIR;
+		return 0;
+	}
+
+	size_t length = strcspn(path,"/");
+	const char *subpath = path+length;
+
+	if(length==1 && path[0]=='.') {
+		return grow_entry_lookup(subpath, root, link_count);
+	}
+
+	if(length==2 && path[0]=='.' && path[1]=='.') {
+		e = grow_entry_parent(root);
+		if(e) {
+			return grow_entry_lookup(subpath, e, link_count);
+		} else {
+			errno = ENOENT;
+			return 0;
+		}
+	}
+
+	e = grow_entry_find_child(root,path,length);
+	if(e) {
+		return grow_entry_lookup(subpath, e, link_count);
+	}
+
+	errno = ENOENT;
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -65,4 +65,111 @@ struct grow_dirent *grow_lookup(const char *path, struct grow_dirent *root, int
  */
 void grow_dirent_to_stat(struct grow_dirent *d, struct stat *s);
 
+/*
+The binary index (.growfsindex) is written by make_growfs next to the text
+listing, and is meant to be used with mmap, without any parsing:
+
+header | entries | hash buckets | strings
+
+The entries are stored breadth first starting with the root, so that the
+children of each directory are contiguous. Each directory has a hash table
+of its children, with a power of two number of buckets, at least twice the
+number of children. A bucket holds the position of a child in the directory
+plus one, or zero if empty. Collisions are resolved by linear probing, and
+names are hashed with 32 bit FNV-1a.
+
+All the references from an entry (name, link, parent, children, buckets) are
+offsets in bytes relative to the entry itself, so that no relocation is needed
+after mapping the index. make_growfs writes all numbers little-endian; an
+index with a different byte order is rejected, and the text listing is used
+instead.
+*/
+
+#define GROW_INDEX_FILE ".growfsindex"
+#define GROW_INDEX_MAGIC "GROWIDX1"
+#define GROW_INDEX_BYTE_ORDER 0x01020304
+
+struct grow_index_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t entry_size;
+	uint64_t nentries;
+	uint64_t entries;    /* offset of the root entry from the start of the index. */
+	uint64_t length;     /* length of the whole index. */
+};
+
+struct grow_entry {
+	uint64_t inode;
+	uint64_t size;
+	int64_t  mtime;
+	int64_t  name;       /* offsets relative to this entry, zero if none. */
+	int64_t  linkname;
+	int64_t  parent;
+	int64_t  children;
+	int64_t  buckets;
+	uint32_t mode;
+	uint32_t nchildren;
+	uint32_t nbuckets;
+	char checksum[SHA1_DIGEST_ASCII_LENGTH];
+	char padding[2];
+};
+
+struct grow_index;
+
+/**
+ * Map a binary index into memory.
+ * @param filename The index written by make_growfs.
+ * @returns The index, or NULL with errno set if it is missing or invalid.
+ */
+struct grow_index *grow_index_open(const char *filename);
+
+/**
+ * Build a binary index in memory from a text listing, for filesystems
+ * that do not have one.
+ * @param FILE A file stream open for reading.
+ * @returns The index, or NULL on error.
+ */
+struct grow_index *grow_index_from_file(FILE *file);
+
+/**
+ * Unmap or free an index.
+ */
+void grow_index_delete(struct grow_index *g);
+
+/**
+ * @returns The entry of the root directory of the index.
+ */
+const struct grow_entry *grow_index_root(struct grow_index *g);
+
+/**
+ * Resolve a path relative to a directory of an index.
+ * @param path The slash-delimited path to resolve.
+ * @param root The directory from which to resolve.
+ * @param link_count Set to 1 to follow symlinks, 0 otherwise.
+ * @returns The entry referred to by the path, or NULL with errno set.
+ */
+const struct grow_entry *grow_entry_lookup(const char *path, const struct grow_entry *root, int link_count);
+
+const char *grow_entry_name(const struct grow_entry *e);
+
+/**
+ * @returns The target of a symlink, or an empty string.
+ */
+const char *grow_entry_linkname(const struct grow_entry *e);
+
+/**
+ * @returns The parent directory of an entry, or NULL for the root.
+ */
+const struct grow_entry *grow_entry_parent(const struct grow_entry *e);
+
+/**
+ * @returns The child at position i, less than e->nchildren, of a directory.
+ */
+const struct grow_entry *grow_entry_child(const struct grow_entry *e, unsigned i);
+
+/**
+ * Given an entry, fill in a stat buffer.
+ */
+void grow_entry_to_stat(const struct grow_entry *e, struct stat *s);
+
 #endif
@@ -62,7 +62,8 @@ static const struct fuse_opt option_spec[] = {
 };
 
 struct fuse_root {
-	struct grow_dirent *metadata;
+	struct grow_index *metadata;
+	const struct grow_entry *top;
 	int fd;
 	int cache;
 };
@@ -70,7 +71,7 @@ struct fuse_root {
 static int cache_open(struct fuse_root *root, const char *path, int flags) {
 	unsigned retries = 0;
 	char cachepath[PATH_MAX];
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 1);
 	if (!e) return -errno;
 	if (flags&O_WRONLY || flags&O_RDWR) return -EROFS;
 
@@ -125,7 +126,7 @@ retry:
 static int deny_write(const char *path) {
 	stats_inc("grow.fuse.deny_write", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 1);
 	if (!e) return -errno;
 	return -EROFS;
 }
@@ -133,7 +134,7 @@ static int deny_write(const char *path) {
 static int deny_create(const char *path) {
 	stats_inc("grow.fuse.deny_create", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(basename(path), root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(basename(path), root->top, 1);
 	if (!e) return -errno;
 	if (!S_ISDIR(e->mode)) return -ENOTDIR;
 	return -EROFS;
@@ -155,16 +156,16 @@ static void grow_fuse_destroy(void *x) {
 static int grow_fuse_getattr(const char *path, struct stat *stbuf) {
 	stats_inc("grow.fuse.getattr", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 0);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 0);
 	if (!e) return -errno;
-	grow_dirent_to_stat(e, stbuf);
+	grow_entry_to_stat(e, stbuf);
 	return 0;
 }
 
 static int grow_fuse_access(const char *path, int mask) {
 	stats_inc("grow.fuse.access", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 1);
 	if (!e) return -errno;
 	if (mask&W_OK) return -EROFS;
 	return 0;
@@ -173,17 +174,17 @@ static int grow_fuse_access(const char *path, int mask) {
 static int grow_fuse_readlink(const char *path, char *buf, size_t size) {
 	stats_inc("grow.fuse.readlink", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 0);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 0);
 	if (!e) return -errno;
 	if (!S_ISLNK(e->mode)) return -EINVAL;
-	snprintf(buf, size, "%s", e->linkname);
+	snprintf(buf, size, "%s", grow_entry_linkname(e));
 	return 0;
 }
 
 static int grow_fuse_opendir(const char *path, struct fuse_file_info *fi) {
 	stats_inc("grow.fuse.opendir", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 1);
 	if (!e) return -errno;
 	if (!S_ISDIR(e->mode)) return -ENOTDIR;
 	return 0;
@@ -192,11 +193,11 @@ static int grow_fuse_opendir(const char *path, struct fuse_file_info *fi) {
 static int grow_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) {
 	stats_inc("grow.fuse.readdir", 1);
 	GETROOT
-	struct grow_dirent *e = grow_lookup(path, root->metadata, 1);
+	const struct grow_entry *e = grow_entry_lookup(path, root->top, 1);
 	if (!e) return -errno;
 	if (!S_ISDIR(e->mode)) return -ENOTDIR;
-	for (struct grow_dirent *c = e->children; c; c = c->next) {
-		if (filler(buf, c->name, NULL, 0)) return -ENOMEM;
+	for (unsigned i = 0; i < e->nchildren; i++) {
+		if (filler(buf, grow_entry_name(grow_entry_child(e, i)), NULL, 0)) return -ENOMEM;
 	}
 	return 0;
 }
@@ -230,9 +231,9 @@ static int grow_fuse_rename(const char *from, const char *to) {
 	stats_inc("grow.fuse.rename", 1);
 	GETROOT
 	// this isn't exactly correct, but rename has an annoying number of cases
-	struct grow_dirent *from_ent = grow_lookup(from, root->metadata, 1);
+	const struct grow_entry *from_ent = grow_entry_lookup(from, root->top, 1);
 	if (!from_ent) return -errno;
-	struct grow_dirent *to_ent = grow_lookup(to, root->metadata, 0);
+	const struct grow_entry *to_ent = grow_entry_lookup(to, root->top, 0);
 	if (to_ent) {
 		// should check if to is empty for -ENOTEMPTY
 		if (S_ISDIR(from_ent->mode) && S_ISDIR(to_ent->mode)) return -EROFS;
@@ -241,7 +242,7 @@ static int grow_fuse_rename(const char *from, const char *to) {
 		return -EROFS;
 
 	}
-	struct grow_dirent *parent_ent = grow_lookup(basename(to), root->metadata, 1);
+	const struct grow_entry *parent_ent = grow_entry_lookup(basename(to), root->top, 1);
 	if (parent_ent && S_ISDIR(parent_ent->mode)) {
 		return -EROFS;
 	} else if (parent_ent) {
@@ -424,19 +425,26 @@ int main(int argc, char *argv[]) {
 		if (root.fd < 0) {
 			fatal("failed to open base dir: %s", strerror(errno));
 		}
-		int index = openat(root.fd, ".growfsdir", O_RDONLY);
-		if (index < 0) {
-			fatal("failed to open GROW-FS index: %s", strerror(errno));
-		}
-		FILE *metadata = fdopen(index, "r");
-		if (!metadata) {
-			fatal("failed to get index FILE: %s", strerror(errno));
-		}
-		root.metadata = grow_from_file(metadata);
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", options.basedir, GROW_INDEX_FILE);
+		root.metadata = grow_index_open(path);
 		if (!root.metadata) {
-			fatal("failed to load GROW-FS index");
+			debug(D_GROW, "no binary index at %s (%s), loading the directory listing", path, strerror(errno));
+			int index = openat(root.fd, ".growfsdir", O_RDONLY);
+			if (index < 0) {
+				fatal("failed to open GROW-FS index: %s", strerror(errno));
+			}
+			FILE *metadata = fdopen(index, "r");
+			if (!metadata) {
+				fatal("failed to get index FILE: %s", strerror(errno));
+			}
+			root.metadata = grow_index_from_file(metadata);
+			if (!root.metadata) {
+				fatal("failed to load GROW-FS index");
+			}
+			fclose(metadata);
 		}
-		fclose(metadata);
+		root.top = grow_index_root(root.metadata);
 	}
 
 	return fuse_main(args.argc, args.argv, &grow_fuse_ops, &root);
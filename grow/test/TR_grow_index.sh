@@ -0,0 +1,168 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+exe="grow_index.test"
+fs="grow_index.fs"
+
+check_needed()
+{
+	which perl > /dev/null 2>&1 && which sha1sum > /dev/null 2>&1
+}
+
+prepare()
+{
+	mkdir -p $fs/dir/sub $fs/many $fs/empty
+	echo hello > $fs/file
+	echo world > $fs/dir/sub/file
+	dd if=/dev/zero of=$fs/dir/zeros bs=1024 count=10 2> /dev/null
+	for i in `seq 1 50`
+	do
+		echo $i > $fs/many/file.$i
+	done
+	ln -s dir/sub $fs/rel
+	ln -s /dir/sub/file $fs/abs
+	ln -s ../file $fs/dir/up
+	ln -s loop $fs/loop
+
+	../src/make_growfs -F $fs > /dev/null || return 1
+
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -I ../src -I ../../dttools/src -x c - -x none ../src/grow.o ../../dttools/src/libdttools.a -lm <<EOF2
+#include "grow.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Compare the index written by make_growfs with the one built from the text
+listing, entry by entry, in readdir order, and resolve some paths in both.
+Then check that indexes with offsets outside of them are rejected.
+*/
+
+static int compare( const struct grow_entry *a, const struct grow_entry *b, const struct grow_entry *root, const char *path )
+{
+	unsigned i;
+
+	if(strcmp(grow_entry_name(a),grow_entry_name(b)) || strcmp(grow_entry_linkname(a),grow_entry_linkname(b))
+	|| a->inode!=b->inode || a->size!=b->size || a->mtime!=b->mtime || a->mode!=b->mode
+	|| a->nchildren!=b->nchildren || strcmp(a->checksum,b->checksum)) {
+		fprintf(stderr,"entries of %s differ\n",path);
+		return 0;
+	}
+
+	if(grow_entry_lookup(path,root,0)!=a) {
+		fprintf(stderr,"could not look up %s\n",path);
+		return 0;
+	}
+
+	for(i=0;i<a->nchildren;i++) {
+		char subpath[GROW_LINE_MAX];
+		const struct grow_entry *c = grow_entry_child(a,i);
+		snprintf(subpath,sizeof(subpath),"%s/%s",path,grow_entry_name(c));
+		if(!compare(c,grow_entry_child(b,i),root,subpath)) return 0;
+	}
+
+	return 1;
+}
+
+static int lookup( const struct grow_entry *root, const char *path, int link_count, const char *target, int error )
+{
+	errno = 0;
+	const struct grow_entry *e = grow_entry_lookup(path,root,link_count);
+	const struct grow_entry *t = target ? grow_entry_lookup(target,root,0) : 0;
+
+	if(e!=t || (!e && errno!=error)) {
+		fprintf(stderr,"lookup of %s is wrong: %s\n",path,strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+static int check_corrupted( const char *filename, size_t offset, int64_t value )
+{
+	FILE *file = fopen(filename,"r");
+	if(!file) return 0;
+
+	char data[1<<16];
+	size_t length = fread(data,1,sizeof(data),file);
+	fclose(file);
+
+	memcpy(data+offset,&value,sizeof(value));
+
+	file = fopen("corrupted.index","w");
+	fwrite(data,1,length,file);
+	fclose(file);
+
+	struct grow_index *g = grow_index_open("corrupted.index");
+	if(g || errno!=EINVAL) {
+		fprintf(stderr,"corrupted index at %zu was not rejected\n",offset);
+		grow_index_delete(g);
+		return 0;
+	}
+
+	return 1;
+}
+
+int main( int argc, char *argv[] )
+{
+	struct grow_index *a = grow_index_open("$fs/.growfsindex");
+	if(!a) {
+		fprintf(stderr,"could not open index: %s\n",strerror(errno));
+		return 1;
+	}
+
+	FILE *file = fopen("$fs/.growfsdir","r");
+	struct grow_index *b = file ? grow_index_from_file(file) : 0;
+	if(!b) return 1;
+	fclose(file);
+
+	const struct grow_entry *root = grow_index_root(a);
+
+	if(!compare(root,grow_index_root(b),root,"")) return 1;
+
+	if(!lookup(root,"rel/file",1,"dir/sub/file",0)) return 1;
+	if(!lookup(root,"abs",1,"dir/sub/file",0)) return 1;
+	if(!lookup(root,"abs",0,"abs",0)) return 1;
+	if(!lookup(root,"dir/up",1,"file",0)) return 1;
+	if(!lookup(root,"/dir/../rel/./file",1,"dir/sub/file",0)) return 1;
+	if(!lookup(root,"many/file.37",0,"many/file.37",0)) return 1;
+	if(!lookup(root,"many/file.51",0,0,ENOENT)) return 1;
+	if(!lookup(root,"file/x",0,0,ENOTDIR)) return 1;
+	if(!lookup(root,"loop",1,0,ENOENT)) return 1;
+
+	grow_index_delete(a);
+	grow_index_delete(b);
+
+	size_t entries = sizeof(struct grow_index_header);
+	size_t second = entries + sizeof(struct grow_entry);
+
+	if(!check_corrupted("$fs/.growfsindex",entries+offsetof(struct grow_entry,children),1<<20)) return 1;
+	if(!check_corrupted("$fs/.growfsindex",entries+offsetof(struct grow_entry,buckets),-8)) return 1;
+	if(!check_corrupted("$fs/.growfsindex",second+offsetof(struct grow_entry,name),1<<20)) return 1;
+	if(!check_corrupted("$fs/.growfsindex",second+offsetof(struct grow_entry,parent),sizeof(struct grow_entry))) return 1;
+	if(!check_corrupted("$fs/.growfsindex",second+offsetof(struct grow_entry,linkname),-(1<<20))) return 1;
+
+	return 0;
+}
+EOF2
+	return $?
+}
+
+run()
+{
+	./"$exe"
+}
+
+clean()
+{
+	rm -rf "$exe" $fs corrupted.index
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -101,6 +101,7 @@ an example.
 static sig_atomic_t makeflow_abort_flag = 0;
 static int makeflow_failed_flag = 0;
 static int makeflow_submit_timeout = 3600;
+static int makeflow_submitters = 0;
 static int makeflow_retry_flag = 0;
 static int makeflow_retry_max = 5;
 
@@ -1284,6 +1285,7 @@ static void show_help_run(const char *cmd)
 	printf(" -R,--retry                     Retry failed batch jobs up to 5 times.\n");
 	printf(" -r,--retry-count=<n>           Retry failed batch jobs up to n times.\n");
 	printf(" -S,--submission-timeout=<#>    Time to retry failed batch job submission.\n");
+	printf("    --submitters=<#>            Submit batch jobs with up to # concurrent processes.\n");
 	printf(" -f,--summary-log=<file>        Write summary of workflow to this file at end.\n");
 	        /********************************************************************************/
 	printf("\nData Handling:\n");
@@ -1485,7 +1487,8 @@ int main(int argc, char *argv[])
 		LONG_OPT_ARCHIVE_WRITE_ONLY,
 		LONG_OPT_MESOS_MASTER,
 		LONG_OPT_MESOS_PATH,
-		LONG_OPT_MESOS_PRELOAD
+		LONG_OPT_MESOS_PRELOAD,
+		LONG_OPT_SUBMITTERS
 	};
 
 	static const struct option long_options_run[] = {
@@ -1534,6 +1537,7 @@ int main(int argc, char *argv[])
 		{"storage-limit", required_argument, 0, LONG_OPT_STORAGE_LIMIT},
 		{"storage-print", required_argument, 0, LONG_OPT_STORAGE_PRINT},
 		{"submission-timeout", required_argument, 0, 'S'},
+		{"submitters", required_argument, 0, LONG_OPT_SUBMITTERS},
 		{"summary-log", required_argument, 0, 'f'},
 		{"tickets", required_argument, 0, LONG_OPT_TICKETS},
 		{"version", no_argument, 0, 'v'},
@@ -1741,6 +1745,9 @@ int main(int argc, char *argv[])
 			case 'S':
 				makeflow_submit_timeout = atoi(optarg);
 				break;
+			case LONG_OPT_SUBMITTERS:
+				makeflow_submitters = atoi(optarg);
+				break;
 			case 't':
 				work_queue_keepalive_timeout = optarg;
 				break;
@@ -2136,6 +2143,12 @@ int main(int argc, char *argv[])
 	batch_queue_set_option(remote_queue, "working-dir", working_dir);
 	batch_queue_set_option(remote_queue, "master-preferred-connection", work_queue_preferred_connection);
 
+	if(makeflow_submitters > 0) {
+		/* submission failures are retried by the submitters, and reported as failed jobs. */
+		batch_queue_set_int_option(remote_queue, "submit-timeout", makeflow_submit_timeout);
+		batch_queue_set_int_option(remote_queue, "async-submitters", makeflow_submitters);
+	}
+
 	char *fa_multiplier = string_format("%f", wq_option_fast_abort_multiplier);
 	batch_queue_set_option(remote_queue, "fast-abort", fa_multiplier);
 	free(fa_multiplier);
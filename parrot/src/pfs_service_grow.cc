@@ -18,10 +18,12 @@ with aggressive caching and end-to-end integrity checks.
 To create a GROW filesystem, run make_growfs on the root of the
 filesystem, and export it via a web server.  This script creates
 a file .growfsdir that contains a complete directory listing and
-checksum of all data.  Upon first accessing the filesystem remotely,
-GROW-FS loads the directory listing into a tree form in memory.
-All metadata requests and directory lookups are handled using this
-data structure.
+checksum of all data, and a binary index .growfsindex of the same
+listing.  Upon first accessing the filesystem remotely, GROW-FS
+maps the index into memory, or, if there is none, converts the
+directory listing into one.  All metadata requests and directory
+lookups are handled using the index, which has a hash table of
+the entries of each directory.
 
 To access a file, GROW issues an HTTP request and reads the data
 sequentially into the pfs_file_cache.  A checksum is computed
@@ -32,7 +34,8 @@ This procedure is repeated with an exponentially repeating backoff
 until the filesystem becomes consistent.
 
 The integrity of the directory listing is ensured by fetching
-its checksum using https.  If the master checksum
+its checksum using https.  The checksum of the index follows it
+in the same file, so that older clients only see the first one.  If the master checksum
 and the directory listing are inconsistent, they are reloaded
 in the same way as files.
 
@@ -88,7 +91,7 @@ extern int pfs_cache_invalidate( pfs_name *name );
 
 static struct grow_filesystem * grow_filesystem_list = 0;
 
-static void grow_dirent_to_pfs_stat( struct grow_dirent *d, struct pfs_stat *s ) {
+static void grow_entry_to_pfs_stat( const struct grow_entry *d, struct pfs_stat *s ) {
 	s->st_dev = 1;
 	s->st_ino = d->inode;
 	s->st_mode = d->mode;
@@ -114,7 +117,8 @@ rooted at grow_filesystem_list
 struct grow_filesystem {
 	char hostport[PFS_PATH_MAX];
 	char path[PFS_PATH_MAX];
-	struct grow_dirent *root;
+	struct grow_index *index;
+	const struct grow_entry *root;
 	struct grow_filesystem *next;
 };
 
@@ -145,24 +149,92 @@ static const char *compare_path_prefix( const char *a, const char *b ) {
 	}
 }
 
+/*
+Get a local copy of the file name at the root of a grow filesystem,
+either directly for a local filesystem, or through the file cache,
+and check it against the given checksum.  Return true and fill in
+filename if it is consistent.
+*/
+
+static int grow_filesystem_fetch( const char *hostport, const char *path, const char *name, const char *checksum, char *filename, time_t stoptime )
+{
+	unsigned char digest[SHA1_DIGEST_LENGTH];
+	char url[GROW_LINE_MAX];
+	char txn[GROW_LINE_MAX];
+	int local_index = !strcmp(hostport, "local");
+
+	if (local_index) {
+		snprintf(filename, GROW_LINE_MAX, "%s/%s", path, name);
+	} else {
+		sprintf(url, "http://%s%s/%s", hostport, path, name);
+
+		if (file_cache_contains(pfs_file_cache, url, filename) != 0) {
+
+			debug(D_GROW, "fetching %s", url);
+
+			int fd = file_cache_begin(pfs_file_cache, url, txn);
+			if (fd >= 0) {
+				INT64_T size;
+				struct link *link = http_query_size(url, "GET", &size, stoptime, 1);
+				if (link) {
+					if (link_stream_to_fd(link, fd, size, stoptime) >= 0) {
+						file_cache_commit(pfs_file_cache, url, txn);
+					} else {
+						file_cache_abort(pfs_file_cache, url, txn);
+					}
+					link_close(link);
+				} else {
+					file_cache_abort(pfs_file_cache, url, txn);
+				}
+				close(fd);
+			}
+		} else {
+			debug(D_GROW, "%s is already cached", url);
+		}
+
+		if (file_cache_contains(pfs_file_cache, url, filename) != 0) {
+			return 0;
+		}
+	}
+
+	debug(D_GROW,"checksumming %s",filename);
+
+	if(!sha1_file(filename,digest)) {
+		debug(D_GROW,"couldn't checksum %s: %s",filename,strerror(errno));
+		return 0;
+	}
+
+	debug(D_GROW,"local checksum: %s",sha1_string(digest));
+
+	if(strcmp(checksum,sha1_string(digest))) {
+		debug(D_GROW,"checksum does not match, reloading...");
+		if (!local_index) file_cache_delete(pfs_file_cache, url);
+		return 0;
+	}
+
+	return 1;
+}
+
 /*
 Search for a grow filesystem rooted at the given host and path.
 If the required files (.growfsdir and .growfschecksum) exist, then
 create a grow filesystem struct and return it.  If the two
 are not consistent, delay and loop until they are.
+If the checksum file also lists a binary index, map it instead
+of loading the directory listing.
 Otherwise, return zero.
 */
 
 struct grow_filesystem * grow_filesystem_create( const char *hostport, const char *path )
 {
-	unsigned char digest[SHA1_DIGEST_LENGTH];
-	unsigned char checksum[SHA1_DIGEST_ASCII_LENGTH];
+	char checksum[GROW_LINE_MAX];
+	char index_checksum[GROW_LINE_MAX];
+	char index_name[GROW_LINE_MAX];
 	char line[GROW_LINE_MAX];
 	char url[GROW_LINE_MAX];
 	char filename[GROW_LINE_MAX];
-	char txn[GROW_LINE_MAX];
 	struct grow_filesystem *f;
-	struct grow_dirent *d;
+	struct grow_index *index;
 	FILE * file;
 	struct link *link;
 	int sleep_time = 1;
@@ -171,6 +243,9 @@ struct grow_filesystem * grow_filesystem_create( const char *hostport, const cha
 
 	retry:
 
+	index_checksum[0] = 0;
+	index = 0;
+
 	if (local_index) {
 		snprintf(filename, sizeof(filename), "%s/.growfschecksum", path);
 		debug(D_GROW, "opening checksum: %s", filename);
@@ -180,11 +255,16 @@ struct grow_filesystem * grow_filesystem_create( const char *hostport, const cha
 			debug(D_GROW, "couldn't get checksum at %s: %s", filename, strerror(errno));
 			return NULL;
 		}
-		if (!fscanf(file, "%s", checksum)) {
+		if (!fgets(line, sizeof(line), file) || sscanf(line, "%s", checksum) != 1) {
 			debug(D_GROW, "checksum is malformed");
 			fclose(file);
 			return NULL;
 		}
+		if (fgets(line, sizeof(line), file) && sscanf(line, "%s %s", index_checksum, index_name) == 2 && !strcmp(index_name, GROW_INDEX_FILE)) {
+			debug(D_GROW, "index checksum is %s", index_checksum);
+		} else {
+			index_checksum[0] = 0;
+		}
 		fclose(file);
 	} else {
 		sprintf(url, "http://%s%s/.growfschecksum", hostport, path);
@@ -197,12 +277,20 @@ struct grow_filesystem * grow_filesystem_create( const char *hostport, const cha
 					/* ok to continue */
 				} else {
 					debug(D_GROW, "checksum is malformed!");
+					link_close(link);
 					goto sleep_retry;
 				}
 			} else {
 				debug(D_GROW, "lost connection while fetching checksum!");
+				link_close(link);
 				goto sleep_retry;
 			}
+			if(link_readline(link, line, sizeof(line), stoptime) && sscanf(line, "%s %s", index_checksum, index_name) == 2 && !strcmp(index_name, GROW_INDEX_FILE)) {
+				debug(D_GROW, "index checksum is %s", index_checksum);
+			} else {
+				index_checksum[0] = 0;
+			}
+			link_close(link);
 		} else {
 			return 0;
 		}
@@ -210,75 +298,47 @@ struct grow_filesystem * grow_filesystem_create( const char *hostport, const cha
 
 	debug(D_GROW,"checksum is %s",checksum);
 
-	if (local_index) {
-		snprintf(filename, sizeof(filename), "%s/.growfsdir", path);
-	} else {
-		sprintf(url, "http://%s%s/.growfsdir", hostport, path);
-
-		if (file_cache_contains(pfs_file_cache, url, filename) != 0) {
-
-			debug(D_GROW, "fetching directory: %s", url);
-
-			int fd = file_cache_begin(pfs_file_cache, url, txn);
-			if (fd >= 0) {
-				INT64_T size;
-				struct link *link = http_query_size(url, "GET", &size, stoptime, 1);
-				if (link) {
-					if (link_stream_to_fd(link, fd, size, stoptime) >= 0) {
-						file_cache_commit(pfs_file_cache, url, txn);
-					} else {
-						file_cache_abort(pfs_file_cache, url, txn);
-					}
-					link_close(link);
-				} else {
-					file_cache_abort(pfs_file_cache, url, txn);
-				}
-				close(fd);
-			}
-		} else {
-			debug(D_GROW, "directory is already cached");
-		}
-
-		if (file_cache_contains(pfs_file_cache, url, filename) != 0) {
+	if(index_checksum[0]) {
+		if(!grow_filesystem_fetch(hostport, path, GROW_INDEX_FILE, index_checksum, filename, stoptime)) {
 			goto sleep_retry;
 		}
-	}
 
-	debug(D_GROW,"checksumming %s",filename);
-
-	if(!sha1_file(filename,digest)) {
-		debug(D_GROW,"couldn't checksum %s: %s",filename,strerror(errno));
-		goto sleep_retry;
+		index = grow_index_open(filename);
+		if(!index) {
+			debug(D_GROW,"couldn't map %s: %s, loading the directory listing instead",filename,strerror(errno));
+		}
 	}
 
-	debug(D_GROW,"local checksum: %s",sha1_string(digest));
+	if(!index) {
+		if(!grow_filesystem_fetch(hostport, path, ".growfsdir", checksum, filename, stoptime)) {
+			goto sleep_retry;
+		}
 
-	if(strcmp((char*)checksum,sha1_string(digest))) {
-		debug(D_GROW,"checksum does not match, reloading...");
-		if (!local_index) file_cache_delete(pfs_file_cache, url);
-		goto sleep_retry;
-	}
+		file = fopen(filename,"r");
+		if(!file) {
+			debug(D_GROW,"couldn't open %s: %s",filename,strerror(errno));
+			goto sleep_retry;
+		}
 
-	file = fopen(filename,"r");
-	if(!file) {
-		debug(D_GROW,"couldn't open %s: %s",filename,strerror(errno));
-		goto sleep_retry;
-	}
+		index = grow_index_from_file(file);
+		if(!index) {
+			debug(D_GROW,"%s is corrupted",filename);
+			fclose(file);
+			if (!local_index) {
+				sprintf(url, "http://%s%s/.growfsdir", hostport, path);
+				file_cache_delete(pfs_file_cache, url);
+			}
+			goto sleep_retry;
+		}
 
-	d = grow_from_file(file);
-	if(!d) {
-		debug(D_GROW,"%s is corrupted",filename);
 		fclose(file);
-		if (!local_index) file_cache_delete(pfs_file_cache, url);
-		goto sleep_retry;
 	}
 
-	fclose(file);
-
 	f = (struct grow_filesystem *) malloc(sizeof(*f));
 	strcpy(f->hostport,hostport);
 	strcpy(f->path,path);
-	f->root = d;
+	f->index = index;
+	f->root = grow_index_root(index);
 
 	return f;
 
@@ -304,7 +364,7 @@ Recursively destroy a grow filesystem.
 void grow_filesystem_delete( struct grow_filesystem *f )
 {
 	if(!f) return;
-	grow_delete(f->root);
+	grow_index_delete(f->index);
 	grow_filesystem_delete(f->next);
 	free(f);
 }
@@ -328,7 +388,7 @@ appropriate dirent.  If no filesystem record is found,
 then search for and load the needed filesystem.
 */
 
-struct grow_dirent * grow_dirent_lookup( pfs_name *name, int follow_links )
+const struct grow_entry * grow_filesystem_lookup( pfs_name *name, int follow_links )
 {
 	struct grow_filesystem *f;
 	char path[PFS_PATH_MAX];
@@ -347,7 +407,7 @@ struct grow_dirent * grow_dirent_lookup( pfs_name *name, int follow_links )
 					continue;
 				}
 			}
-			return grow_lookup(subpath,f->root,follow_links);
+			return grow_entry_lookup(subpath,f->root,follow_links);
 		}
 	}
 
@@ -358,7 +418,7 @@ struct grow_dirent * grow_dirent_lookup( pfs_name *name, int follow_links )
 			f->next = grow_filesystem_list;
 			grow_filesystem_list = f;
 			subpath = compare_path_prefix(f->path,name->rest);
-			return grow_lookup(subpath,f->root,follow_links);
+			return grow_entry_lookup(subpath,f->root,follow_links);
 		}
 		s = strrchr(path,'/');
 		if(s) {
@@ -381,11 +441,11 @@ private:
 	sha1_context_t context;
 
 public:
-	pfs_file_grow( pfs_name *n, struct link *l, int fd, struct grow_dirent *d ) : pfs_file(n) {
+	pfs_file_grow( pfs_name *n, struct link *l, int fd, const struct grow_entry *d ) : pfs_file(n) {
 		assert(!(l && (fd < 0)));
 		link = l;
 		local_fd = fd;
-		grow_dirent_to_pfs_stat(d,&info);
+		grow_entry_to_pfs_stat(d,&info);
 		if(pfs_checksum_files) {
 			sha1_init(&context);
 		}
@@ -401,8 +461,8 @@ public:
 			::close(local_fd);
 		}
 
-		struct grow_dirent *d;
-		d = grow_dirent_lookup(&name,1);
+		const struct grow_entry *d;
+		d = grow_filesystem_lookup(&name,1);
 
 		if(!d) {
 			debug(D_GROW,"%s is no longer valid, will reload...",name.rest);
@@ -486,11 +546,11 @@ public:
 		stats_inc("parrot.grow.open", 1);
 		debug(D_GROW, "open %s %d %d", name->rest, flags, (flags&O_CREAT) ? mode : 0);
 
-		struct grow_dirent *d;
+		const struct grow_entry *d;
 		char url[PFS_PATH_MAX];
 		int local_index = !strcmp(name->hostport, "local");
 
-		d = grow_dirent_lookup(name,1);
+		d = grow_filesystem_lookup(name,1);
 		if(!d) return 0;
 
 		if(S_ISDIR(d->mode)) {
@@ -546,9 +606,9 @@ public:
 		}
 
 
-		struct grow_dirent *d;
+		const struct grow_entry *d;
 
-		d = grow_dirent_lookup(name,1);
+		d = grow_filesystem_lookup(name,1);
 		if(!d) return 0;
 
 		if(!S_ISDIR(d->mode)) {
@@ -560,13 +620,13 @@ public:
 
 		dir->append(".");
 		++dirsize;
-		if(d->parent) {
+		if(grow_entry_parent(d)) {
 			dir->append("..");
 			++dirsize;
 		}
 
-		for(d=d->children;d;d=d->next) {
-			dir->append(d->name);
+		for(unsigned i=0;i<d->nchildren;i++) {
+			dir->append(grow_entry_name(grow_entry_child(d,i)));
 			++dirsize;
 		}
 
@@ -586,12 +646,12 @@ public:
 			return 0;
 		}
 
-		struct grow_dirent *d;
+		const struct grow_entry *d;
 
-		d = grow_dirent_lookup(name,0);
+		d = grow_filesystem_lookup(name,0);
 		if(!d) return -1;
 
-		grow_dirent_to_pfs_stat(d,info);
+		grow_entry_to_pfs_stat(d,info);
 
 		return 0;
 	}
@@ -608,12 +668,12 @@ public:
 			return 0;
 		}
 
-		struct grow_dirent *d;
+		const struct grow_entry *d;
 
-		d = grow_dirent_lookup(name,1);
+		d = grow_filesystem_lookup(name,1);
 		if(!d) return -1;
 
-		grow_dirent_to_pfs_stat(d,info);
+		grow_entry_to_pfs_stat(d,info);
 
 		return 0;
 	}
@@ -719,15 +779,16 @@ public:
 		stats_inc("parrot.grow.readlink", 1);
 		debug(D_GROW, "readlink %s %p %d", name->rest, buf, (int) bufsiz);
 
-		struct grow_dirent *d;
+		const struct grow_entry *d;
 
-		d = grow_dirent_lookup(name,0);
+		d = grow_filesystem_lookup(name,0);
 		if(!d) return -1;
 
 		if(S_ISLNK(d->mode)) {
 			int length;
-			strncpy(buf,d->linkname,bufsiz);
-			length = MIN((unsigned)bufsiz,strlen(d->linkname));
+			const char *linkname = grow_entry_linkname(d);
+			strncpy(buf,linkname,bufsiz);
+			length = MIN((unsigned)bufsiz,strlen(linkname));
 			buf[length] = 0;
 			stats_bin("parrot.grow.readlink.size", length);
 			return length;
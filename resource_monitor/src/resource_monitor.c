@@ -149,6 +149,8 @@ See the file COPYING for details.
 #include "rmonitor.h"
 #include "rmonitor_poll_internal.h"
 #include "rmonitor_file_watch.h"
+#include "rmonitor_cgroup.h"
+#include "rmonitor_proc_events.h"
 
 #define RESOURCE_MONITOR_USE_INOTIFY 1
 #if defined(RESOURCE_MONITOR_USE_INOTIFY)
@@ -164,10 +166,13 @@ See the file COPYING for details.
 
 #define ACTIVATE_DEBUG_FILE ".cctools_resource_monitor_debug"
 
-uint64_t interval = DEFAULT_INTERVAL;
+uint64_t interval     = DEFAULT_INTERVAL*USECOND; /* in usecs */
+uint64_t min_interval = 0;                        /* in usecs. If not zero, use adaptive sampling. */
 
 FILE  *log_summary = NULL;      /* Final statistics are written to this file. */
 FILE  *log_series  = NULL;      /* Resource events and samples are written to this file. */
+static struct rmsummary_series *log_series_binary = NULL; /* If not NULL, samples are written to log_series in binary. */
+static int binary_series = 0;   /* Write the time series in binary, rather than as text. */
 FILE  *log_inotify = NULL;      /* List of opened files is written to this file. */
 
 char *template_path = NULL;     /* Prefix of all output files names */
@@ -180,6 +185,7 @@ struct jx *verbatim_summary_fields; /* fields added to the summary without chang
 int    rmonitor_queue_fd = -1;  /* File descriptor of a datagram socket to which (great)
                                   grandchildren processes report to the monitor. */
 static int rmonitor_inotify_fd = -1;
+static int rmonitor_proc_events_fd = -1; /* Netlink socket for process events from the kernel. */
 
 pid_t  first_process_pid;                 /* pid of the process given at the command line */
 int    first_process_sigchild_status;     /* exit status flags of the process given at the command line */
@@ -193,6 +199,11 @@ struct hash_table *files;       /* Keeps track of which files have been opened.
 
 static int follow_chdir = 0;    /* Keep track of all the working directories per process. */
 static int pprint_summaries = 1; /* Pretty-print json summaries. */
+static int incremental_disk = 0; /* Track the size of working directories with inotify, instead of walking them. */
+
+static struct rmonitor_cgroup *cgroup = NULL; /* If not NULL, cgroup used to account for the process tree. */
+
+static struct rmonitor_process_info *exited_acc = NULL; /* Usage of processes since their last poll until they exited. */
 
 #if defined(RESOURCE_MONITOR_USE_INOTIFY)
 static char **inotify_watches;  /* Keeps track of created inotify watches. */
@@ -363,6 +374,19 @@ void parse_limit_string(struct rmsummary *limits, char *str)
 	free(pair);
 }
 
+/* intervals are given in seconds, possibly fractional, and returned in usecs. */
+uint64_t parse_interval(const char *str)
+{
+	double d;
+
+	if(!string_is_float(str, &d) || d*USECOND < 1) {
+		debug(D_FATAL, "invalid interval '%s'. It should be a positive number of seconds.", str);
+		exit(RM_MONITOR_ERROR);
+	}
+
+	return (uint64_t) (d*USECOND);
+}
+
 void parse_limits_file(struct rmsummary *limits, char *path)
 {
 	struct rmsummary *s;
@@ -529,6 +553,7 @@ int dec_wd_count(struct rmonitor_wdir_info *d)
         debug(D_RMON, "working directory '%s' is not monitored anymore.\n", d->path);
 
 		path_disk_size_info_delete_state(d->state);
+		path_disk_size_watch_delete(d->watch);
         hash_table_remove(wdirs, d->path);
 
         dec_fs_count((void *) d->fs);
@@ -577,6 +602,21 @@ struct rmonitor_filesys_info *lookup_or_create_fs(char *path)
     return inventory;
 }
 
+/* Measure the directory once, and from then on keep its size up to date from
+ * inotify events. If the watch cannot be created (e.g., not enough inotify
+ * watches for the tree), the directory is walked at every measurement as usual. */
+void rmonitor_watch_wd(struct rmonitor_wdir_info *d)
+{
+	if(!incremental_disk || d->watch)
+		return;
+
+	d->watch = path_disk_size_watch_create(d->path);
+
+	if(!d->watch) {
+		debug(D_RMON, "could not track changes in '%s', measuring with full walks.\n", d->path);
+	}
+}
+
 struct rmonitor_wdir_info *lookup_or_create_wd(struct rmonitor_wdir_info *previous, char const *path)
 {
     struct rmonitor_wdir_info *inventory;
@@ -593,9 +633,11 @@ struct rmonitor_wdir_info *lookup_or_create_wd(struct rmonitor_wdir_info *previo
         inventory = (struct rmonitor_wdir_info *) malloc(sizeof(struct rmonitor_wdir_info));
         inventory->path  = xxstrdup(path);
 		inventory->state = NULL;
+		inventory->watch = NULL;
         hash_table_insert(wdirs, inventory->path, (void *) inventory);
 
         inventory->fs = lookup_or_create_fs(inventory->path);
+		rmonitor_watch_wd(inventory);
     }
 
     if(inventory != previous)
@@ -808,9 +850,28 @@ int64_t average_bandwidth(int use_min_len) {
  * rmsummary's, computing current value, maximum, and minimums.
 ***/
 
+/* Fields of the binary time series, in the same order as the text columns. */
+static const char *series_fields[] = { "wall_time", "cpu_time", "cores", "max_concurrent_processes", "virtual_memory", "memory", "swap_memory", "bytes_read", "bytes_written", "bytes_received", "bytes_sent", "bandwidth", "machine_load", "total_files", "disk", NULL };
+
 void rmonitor_summary_header()
 {
-    if(log_series)
+    if(log_series && binary_series)
+    {
+		/* total_files and disk are the last fields, and are dropped if disk is not measured. */
+		int n = sizeof(series_fields)/sizeof(char *) - 1;
+		const char *fields[n + 1];
+		memcpy(fields, series_fields, sizeof(series_fields));
+		if(!resources_flags->disk) {
+			fields[n - 2] = NULL;
+		}
+
+		log_series_binary = rmsummary_series_create(log_series, summary, fields);
+		if(!log_series_binary) {
+			debug(D_FATAL, "could not write time series header.\n");
+			exit(RM_MONITOR_ERROR);
+		}
+    }
+    else if(log_series)
     {
 	    fprintf(log_series, "# Units:\n");
 	    fprintf(log_series, "# wall_clock and cpu_time in microseconds\n");
@@ -853,7 +914,7 @@ struct peak_cores_sample {
 int64_t peak_cores(int64_t wall_time, int64_t cpu_time) {
 	static struct list *samples = NULL;
 
-	int64_t max_separation = 60 + 2*interval; /* at least one minute and a complete interval */
+	int64_t max_separation = 60 + 2*DIV_INT_ROUND_UP(interval, USECOND); /* at least one minute and a complete interval */
 
 	if(!samples) {
 		samples = list_create();
@@ -970,9 +1031,32 @@ void rmonitor_find_max_tree(struct rmsummary *result, struct rmsummary *tr)
 	}
 }
 
+/* The cgroup peak includes spikes between samples, and from processes that
+ * already exited. It only updates the summary, as the series reports the
+ * values at each sample point. */
+void rmonitor_cgroup_peaks_to_summary(void)
+{
+	if(!cgroup)
+		return;
+
+	struct rmsummary *tr = rmsummary_create(-1);
+	tr->memory = (int64_t) cgroup->peak_memory;
+
+	rmsummary_merge_max_w_time(summary, tr);
+
+	rmsummary_delete(tr);
+}
+
 void rmonitor_log_row(struct rmsummary *tr)
 {
-	if(log_series)
+	if(log_series_binary)
+	{
+		rmsummary_series_write(log_series_binary, tr);
+
+		fflush(log_series);
+		fsync(fileno(log_series));
+	}
+	else if(log_series)
 	{
 		fprintf(log_series,  "%" PRId64, tr->wall_time + summary->start);
 		fprintf(log_series, " %" PRId64, tr->cpu_time);
@@ -1209,12 +1293,12 @@ int rmonitor_final_summary()
 			timeout.tv_usec  = 0;
 
 			FD_ZERO(&rset);
-			if (rmonitor_inotify_fd > 0)   FD_SET(rmonitor_inotify_fd, &rset);
+			if (rmonitor_inotify_fd >= 0)  FD_SET(rmonitor_inotify_fd, &rset);
 
 			count = select(nfds, &rset, NULL, NULL, &timeout);
 
 			if(count > 0)
-				if (FD_ISSET(rmonitor_inotify_fd, &rset)) {
+				if (rmonitor_inotify_fd >= 0 && FD_ISSET(rmonitor_inotify_fd, &rset)) {
 					rmonitor_handle_inotify();
 				}
 		} while(count > 0);
@@ -1294,6 +1378,28 @@ void rmonitor_untrack_process(uint64_t pid)
 		p->running = 0;
 }
 
+/* When the exit event of a process arrives, the process is a zombie not yet
+ * waited by its parent, and /proc/pid still has its final counters. We add
+ * the usage since the last poll, which otherwise would be lost. */
+void rmonitor_final_usage_process(struct rmonitor_process_info *p)
+{
+	if(!p->running)
+		return;
+
+	/* with cgroups, only io is read from /proc. */
+	if(cgroup) {
+		if(rmonitor_get_sys_io_usage(p->pid, &p->io) == 0)
+			acc_sys_io_usage(&exited_acc->io, &p->io);
+		return;
+	}
+
+	if(rmonitor_poll_process_once(p) != 0)
+		return;
+
+	acc_cpu_time_usage(&exited_acc->cpu, &p->cpu);
+	acc_sys_io_usage(&exited_acc->io, &p->io);
+}
+
 void cleanup_zombie(struct rmonitor_process_info *p)
 {
   debug(D_RMON, "cleaning process: %d\n", p->pid);
@@ -1301,6 +1407,8 @@ void cleanup_zombie(struct rmonitor_process_info *p)
   if(follow_chdir && p->wd)
     dec_wd_count(p->wd);
 
+  rmonitor_poll_process_close(p);
+
   itable_remove(processes, p->pid);
   free(p);
 }
@@ -1535,6 +1643,20 @@ void rmonitor_final_cleanup(int signum)
 
     cleanup_zombies();
 
+	if(cgroup) {
+		/* one last read, to get the peaks of processes that exited since the last sample. */
+		struct rmonitor_process_info p_acc;
+		struct rmonitor_mem_info     m_acc;
+		bzero(&p_acc, sizeof(p_acc));
+
+		if(rmonitor_cgroup_poll(cgroup, processes, &p_acc, &m_acc) == 0) {
+			rmonitor_cgroup_peaks_to_summary();
+		}
+
+		rmonitor_cgroup_delete(cgroup);
+		cgroup = NULL;
+	}
+
     if(lib_helper_extracted) {
 		cleanup_library();
 		lib_helper_extracted = 0;
@@ -1544,6 +1666,7 @@ void rmonitor_final_cleanup(int signum)
 
 	fclose(log_summary);
 
+    rmsummary_series_delete(log_series_binary);
     if(log_series)
 	    fclose(log_series);
     if(log_inotify)
@@ -1551,6 +1674,8 @@ void rmonitor_final_cleanup(int signum)
 
 	terminate_snapshot_watch_events();
 
+	rmonitor_proc_events_close(rmonitor_proc_events_fd);
+
     exit(status);
 }
 
@@ -1759,17 +1884,90 @@ int rmonitor_dispatch_msg(void)
 	}
 }
 
-int wait_for_messages(int interval)
+/* return 1 if a process was created or exited, 0 otherwise. */
+int rmonitor_dispatch_proc_events(void)
+{
+	struct rmonitor_proc_event ev;
+	struct rmonitor_process_info *p;
+
+	int urgent = 0;
+	while(rmonitor_proc_events_recv(rmonitor_proc_events_fd, &ev) > 0) {
+		switch(ev.type) {
+			case RMONITOR_PROC_EVENT_FORK:
+				if(!itable_lookup(processes, ev.parent))
+					break;
+				debug(D_RMON, "fork event %d -> %d\n", ev.parent, ev.pid);
+				rmonitor_track_process(ev.pid);
+				if(summary->max_concurrent_processes < itable_size(processes))
+					summary->max_concurrent_processes = itable_size(processes);
+				urgent = 1;
+				break;
+			case RMONITOR_PROC_EVENT_EXEC:
+				if(itable_lookup(processes, ev.pid))
+					debug(D_RMON, "exec event %d\n", ev.pid);
+				break;
+			case RMONITOR_PROC_EVENT_EXIT:
+				p = itable_lookup(processes, ev.pid);
+				if(!p)
+					break;
+				debug(D_RMON, "exit event %d: %d\n", ev.pid, ev.exit_code);
+				rmonitor_final_usage_process(p);
+				rmonitor_untrack_process(ev.pid);
+				urgent = 1;
+				break;
+		}
+	}
+
+	return urgent;
+}
+
+/* Add the file descriptors of the working directory watches to set. Returns the largest one, or -1 if none. */
+int rmonitor_wd_watches_set(fd_set *set)
+{
+	struct rmonitor_wdir_info *d;
+	char *path;
+	int max_fd = -1;
+
+	hash_table_firstkey(wdirs);
+	while(hash_table_nextkey(wdirs, &path, (void **) &d)) {
+		if(d->watch) {
+			int fd = path_disk_size_watch_fd(d->watch);
+			FD_SET(fd, set);
+			max_fd = MAX(max_fd, fd);
+		}
+	}
+
+	return max_fd;
+}
+
+void rmonitor_wd_watches_handle(fd_set *set)
+{
+	struct rmonitor_wdir_info *d;
+	char *path;
+
+	hash_table_firstkey(wdirs);
+	while(hash_table_nextkey(wdirs, &path, (void **) &d)) {
+		if(d->watch && FD_ISSET(path_disk_size_watch_fd(d->watch), set)) {
+			/* errors are reported, and the watch removed, on the next measurement. */
+			path_disk_size_watch_handle_events(d->watch);
+		}
+	}
+}
+
+/* return 1 if an urgent message arrived while waiting (e.g., a process was created), 0 otherwise. */
+int wait_for_messages(uint64_t interval /* in usecs */)
 {
 	struct timeval timeout;
-	timeout.tv_sec   = interval;
-	timeout.tv_usec  = 0;
+	timeout.tv_sec   = interval / USECOND;
+	timeout.tv_usec  = interval % USECOND;
+
+	int urgent = 0;
 
-	debug(D_RMON, "sleeping for: %d seconds\n", interval);
+	debug(D_RMON, "sleeping for: %" PRIu64 " usecs\n", interval);
 
 	//If grandchildren processes cannot talk to us, simply wait.
 	//Else, wait, and check socket for messages.
-	if (rmonitor_queue_fd < 0)
+	if (rmonitor_queue_fd < 0 && rmonitor_proc_events_fd < 0 && !incremental_disk)
 	{
 		/* wait for interval. */
 		select(1, NULL, NULL, NULL, &timeout);
@@ -1778,32 +1976,47 @@ int wait_for_messages(int interval)
 	{
 
 		/* Figure out the number of file descriptors to pass to select */
-		int nfds = 1 + MAX(rmonitor_queue_fd, rmonitor_inotify_fd);
+		int nfds = 1 + MAX(rmonitor_queue_fd, MAX(rmonitor_inotify_fd, rmonitor_proc_events_fd));
 		fd_set rset;
 
-		int urgent = 0;
 		int count  = 0;
 		do
 		{
 			FD_ZERO(&rset);
-			if (rmonitor_queue_fd > 0) {
+
+			/* drain the events of the working directories as they arrive, so
+			 * that the kernel queues do not overflow between measurements. */
+			nfds = MAX(nfds, 1 + rmonitor_wd_watches_set(&rset));
+			if (rmonitor_queue_fd >= 0) {
 				FD_SET(rmonitor_queue_fd,   &rset);
 			}
 
-			if (rmonitor_inotify_fd > 0) {
+			if (rmonitor_inotify_fd >= 0) {
 				FD_SET(rmonitor_inotify_fd, &rset);
 			}
 
+			if (rmonitor_proc_events_fd >= 0) {
+				FD_SET(rmonitor_proc_events_fd, &rset);
+			}
+
 			count = select(nfds, &rset, NULL, NULL, &timeout);
 
-			if (FD_ISSET(rmonitor_queue_fd, &rset)) {
+			if (rmonitor_queue_fd >= 0 && FD_ISSET(rmonitor_queue_fd, &rset)) {
 				urgent |= rmonitor_dispatch_msg();
 			}
 
-			if (FD_ISSET(rmonitor_inotify_fd, &rset)) {
+			if (rmonitor_inotify_fd >= 0 && FD_ISSET(rmonitor_inotify_fd, &rset)) {
 				urgent |= rmonitor_handle_inotify();
 			}
 
+			if (rmonitor_proc_events_fd >= 0 && FD_ISSET(rmonitor_proc_events_fd, &rset)) {
+				urgent |= rmonitor_dispatch_proc_events();
+			}
+
+			if (count > 0) {
+				rmonitor_wd_watches_handle(&rset);
+			}
+
 			if(urgent) {
 				timeout.tv_sec  = 0;
 				timeout.tv_usec = 0;
@@ -1811,7 +2024,21 @@ int wait_for_messages(int interval)
 		} while(count > 0);
 	}
 
-	return 0;
+	return urgent;
+}
+
+/* With adaptive sampling, we sample every min_interval when the process tree
+ * changes, and double the interval while the tree is stable, up to the
+ * regular interval. */
+uint64_t rmonitor_next_interval(uint64_t current, int changed)
+{
+	if(min_interval < 1)
+		return interval;
+
+	if(changed)
+		return min_interval;
+
+	return MIN(interval, 2*current);
 }
 
 /***
@@ -1912,6 +2139,11 @@ struct rmonitor_process_info *spawn_first_process(const char *executable, char *
     {
         setpgid(0, 0);
 
+		/* join the cgroup before exec, so that all descendants are created in it. */
+		if(cgroup && rmonitor_cgroup_add_process(cgroup, getpid()) != 0) {
+			debug(D_NOTICE, "could not add process to cgroup %s, resources may be undercounted.\n", cgroup->path);
+		}
+
         debug(D_RMON, "executing: %s\n", executable);
 
 		errno = 0;
@@ -1937,6 +2169,8 @@ static void show_help(const char *cmd)
     fprintf(stdout, "%-30s Show version string.\n", "-v,--version");
     fprintf(stdout, "\n");
     fprintf(stdout, "%-30s Interval between observations, in seconds. (default=%d)\n", "-i,--interval=<n>", DEFAULT_INTERVAL);
+    fprintf(stdout, "%-30s Adaptive sampling. Observe as often as every <n> seconds (e.g. 0.01)\n", "--min-interval=<n>");
+    fprintf(stdout, "%-30s at start and when processes change, backing off to --interval.\n", "");
     fprintf(stdout, "%-30s Read command line from <str>, and execute as '/bin/sh -c <str>'\n", "-c,--sh=<str>");
     fprintf(stdout, "\n");
     fprintf(stdout, "%-30s Use maxfile with list of var: value pairs for resource limits.\n", "-l,--limits-file=<maxfile>");
@@ -1948,15 +2182,20 @@ static void show_help(const char *cmd)
     fprintf(stdout, "%-30s Follow the size of processes' current working directories. \n", "--follow-chdir");
     fprintf(stdout, "%-30s Follow the size of <dir>. If not specified, follow the current directory.\n", "--measure-dir");
     fprintf(stdout, "%-30s Can be specified multiple times.\n", "");
+    fprintf(stdout, "%-30s Walk directories once, and then update their size from inotify events.\n", "--incremental-disk");
     fprintf(stdout, "\n");
     fprintf(stdout, "%-30s Specify filename template for log files (default=resource-pid-<pid>)\n", "-O,--with-output-files=<file>");
     fprintf(stdout, "%-30s Write resource time series to <template>.series\n", "--with-time-series");
+    fprintf(stdout, "%-30s Write the time series in a compact binary format. Implies --with-time-series.\n", "--binary-time-series");
     fprintf(stdout, "%-30s Write inotify statistics of opened files to default=<template>.files\n", "--with-inotify");
     fprintf(stdout, "%-30s Include this string verbatim in a line in the summary. \n", "-V,--verbatim-to-summary=<str>");
     fprintf(stdout, "%-30s (Could be specified multiple times.)\n", "");
     fprintf(stdout, "\n");
     fprintf(stdout, "%-30s Do not measure working directory footprint.\n", "--without-disk-footprint");
     fprintf(stdout, "%-30s Do not pretty-print summaries.\n", "--no-pprint");
+    fprintf(stdout, "%-30s Account for cpu, memory and io using a cgroup v2 created for the\n", "--cgroup");
+    fprintf(stdout, "%-30s process tree. Falls back to polling /proc if cgroups are not available.\n", "");
+    fprintf(stdout, "%-30s Track processes with the kernel proc connector (needs CAP_NET_ADMIN).\n", "--proc-events");
     fprintf(stdout, "\n");
     fprintf(stdout, "%-30s Configuration file for snapshots on file patterns.\n", "--snapshot-events=<file>");
     fprintf(stdout, "%-30s current resources, and delete <file>. If <file> has a non-empty first\n", "");
@@ -1964,7 +2203,7 @@ static void show_help(const char *cmd)
 }
 
 
-int rmonitor_resources(long int interval /*in seconds */)
+int rmonitor_resources(uint64_t interval /* in usecs */)
 {
     uint64_t round;
 
@@ -1975,6 +2214,11 @@ int rmonitor_resources(long int interval /*in seconds */)
 
     struct rmsummary    *resources_now = calloc(1, sizeof(struct rmsummary));
 
+	uint64_t current_interval = min_interval > 0 ? min_interval : interval;
+	uint64_t last_full_round  = 0;
+	uint64_t last_resident    = 0;
+	uint64_t last_processes   = 0;
+
     // Loop while there are processes to monitor, that is
     // itable_size(processes) > 0). The check is done again in a
     // if/break pair below to mitigate a race condition in which
@@ -1988,19 +2232,46 @@ int rmonitor_resources(long int interval /*in seconds */)
 
 		resources_now->last_error = 0;
 
+		/* smaps and working directories are expensive to read, and reading
+		 * smaps stalls the page faults of the process. They are read at most
+		 * once per regular interval, and no more than once per second. The
+		 * rounds in between use only /proc/pid/{stat,status,io}. */
+		uint64_t now    = usecs_since_epoch();
+		int full_round  = (now - last_full_round >= MAX(interval, USECOND));
+
 		ping_processes();
 
-		rmonitor_poll_all_processes_once(processes, p_acc);
-		rmonitor_poll_maps_once(processes, m_acc);
+		if(cgroup) {
+			rmonitor_cgroup_poll(cgroup, processes, p_acc, m_acc);
+		} else {
+			rmonitor_poll_all_processes_once(processes, p_acc);
 
-		if(resources_flags->disk)
-			rmonitor_poll_all_wds_once(wdirs, d_acc, MAX(1, interval/(MAX(1, hash_table_size(wdirs)))));
+			if(full_round) {
+				rmonitor_poll_maps_once(processes, m_acc);
+			} else {
+				/* rmonitor_collate_tree falls back to /proc/pid/status memory. */
+				bzero(m_acc, sizeof(*m_acc));
+			}
+		}
+
+		/* add the usage of processes that exited since the last round. */
+		acc_cpu_time_usage(&p_acc->cpu, &exited_acc->cpu);
+		acc_sys_io_usage(&p_acc->io, &exited_acc->io);
+		bzero(exited_acc, sizeof(*exited_acc));
+
+		/* measurements from watches are cheap, so we do them at every round. */
+		if(resources_flags->disk && (full_round || incremental_disk))
+			rmonitor_poll_all_wds_once(wdirs, d_acc, MAX(1, (interval/USECOND)/(MAX(1, hash_table_size(wdirs)))));
+
+		if(full_round)
+			last_full_round = now;
 
 		// rmonitor_fss_once(f); disabled until statfs fs id makes sense.
 
 		rmonitor_collate_tree(resources_now, p_acc, m_acc, d_acc, f_acc);
 		rmonitor_find_max_tree(summary,  resources_now);
 		rmonitor_find_max_tree(snapshot, resources_now);
+		rmonitor_cgroup_peaks_to_summary();
 		rmonitor_log_row(resources_now);
 
 		if(!rmonitor_check_limits(summary))
@@ -2020,7 +2291,18 @@ int rmonitor_resources(long int interval /*in seconds */)
 		if(itable_size(processes) < 1)
 			break;
 
-		wait_for_messages(interval);
+		/* memory changes of more than 10%, or a different number of processes,
+		 * count as a change in the tree. */
+		int changed = ((uint64_t) itable_size(processes) != last_processes)
+			|| (10*p_acc->mem.resident > 11*last_resident)
+			|| (10*p_acc->mem.resident <  9*last_resident);
+
+		last_processes = itable_size(processes);
+		last_resident  = p_acc->mem.resident;
+
+		changed |= wait_for_messages(current_interval);
+
+		current_interval = rmonitor_next_interval(current_interval, changed);
 
 		//cleanup processes which by terminating may have awaken
 		//select.
@@ -2052,6 +2334,8 @@ int main(int argc, char **argv) {
 
     int use_series   = 0;
     int use_inotify  = 0;
+    int use_cgroup   = 0;
+    int use_proc_events = 0;
     int child_in_foreground = 0;
 
     debug_config(argv[0]);
@@ -2062,6 +2346,7 @@ int main(int argc, char **argv) {
     signal(SIGTERM, rmonitor_final_cleanup);
 
     summary  = calloc(1, sizeof(struct rmsummary));
+    exited_acc = calloc(1, sizeof(struct rmonitor_process_info));
     snapshot = calloc(1, sizeof(struct rmsummary));
 
     summary->peak_times = rmsummary_create(-1);
@@ -2089,6 +2374,7 @@ int main(int argc, char **argv) {
 
 	enum {
 		LONG_OPT_TIME_SERIES = UCHAR_MAX+1,
+		LONG_OPT_BINARY_TIME_SERIES,
 		LONG_OPT_OPENED_FILES,
 		LONG_OPT_DISK_FOOTPRINT,
 		LONG_OPT_NO_DISK_FOOTPRINT,
@@ -2098,7 +2384,11 @@ int main(int argc, char **argv) {
 		LONG_OPT_MEASURE_DIR,
 		LONG_OPT_NO_PPRINT,
 		LONG_OPT_SNAPSHOT_FILE,
-		LONG_OPT_SNAPSHOT_WATCH_CONF
+		LONG_OPT_SNAPSHOT_WATCH_CONF,
+		LONG_OPT_CGROUP,
+		LONG_OPT_PROC_EVENTS,
+		LONG_OPT_MIN_INTERVAL,
+		LONG_OPT_INCREMENTAL_DISK
 	};
 
     static const struct option long_options[] =
@@ -2109,6 +2399,7 @@ int main(int argc, char **argv) {
 		    {"help",       required_argument, 0, 'h'},
 		    {"version",    no_argument,       0, 'v'},
 		    {"interval",   required_argument, 0, 'i'},
+		    {"min-interval", required_argument, 0, LONG_OPT_MIN_INTERVAL},
 		    {"limits",     required_argument, 0, 'L'},
 		    {"limits-file",required_argument, 0, 'l'},
 		    {"sh",         required_argument, 0, 'c'},
@@ -2118,9 +2409,13 @@ int main(int argc, char **argv) {
 		    {"follow-chdir", no_argument,       0,  LONG_OPT_FOLLOW_CHDIR},
 		    {"measure-dir",  required_argument, 0,  LONG_OPT_MEASURE_DIR},
 		    {"no-pprint",    no_argument,       0,  LONG_OPT_NO_PPRINT},
+		    {"cgroup",       no_argument,       0,  LONG_OPT_CGROUP},
+		    {"proc-events",  no_argument,       0,  LONG_OPT_PROC_EVENTS},
+		    {"incremental-disk", no_argument,   0,  LONG_OPT_INCREMENTAL_DISK},
 
 		    {"with-output-files",      required_argument, 0,  'O'},
 		    {"with-time-series",       no_argument, 0, LONG_OPT_TIME_SERIES},
+		    {"binary-time-series",     no_argument, 0, LONG_OPT_BINARY_TIME_SERIES},
 		    {"with-inotify",           no_argument, 0, LONG_OPT_OPENED_FILES},
 		    {"without-disk-footprint", no_argument, 0, LONG_OPT_NO_DISK_FOOTPRINT},
 
@@ -2158,11 +2453,10 @@ int main(int argc, char **argv) {
 				sh_cmd_line = xxstrdup(optarg);
 				break;
 			case 'i':
-				interval = strtoll(optarg, NULL, 10);
-				if(interval < 1) {
-					debug(D_FATAL, "interval cannot be set to less than one second.");
-					exit(RM_MONITOR_ERROR);
-				}
+				interval = parse_interval(optarg);
+				break;
+			case LONG_OPT_MIN_INTERVAL:
+				min_interval = parse_interval(optarg);
 				break;
 			case 'l':
 				parse_limits_file(resources_limits, optarg);
@@ -2184,6 +2478,10 @@ int main(int argc, char **argv) {
 			case  LONG_OPT_TIME_SERIES:
 				use_series  = 1;
 				break;
+			case  LONG_OPT_BINARY_TIME_SERIES:
+				use_series    = 1;
+				binary_series = 1;
+				break;
 			case  LONG_OPT_OPENED_FILES:
 				use_inotify = 1;
 				break;
@@ -2203,6 +2501,15 @@ int main(int argc, char **argv) {
 			case LONG_OPT_NO_PPRINT:
 				pprint_summaries = 0;
 				break;
+			case LONG_OPT_CGROUP:
+				use_cgroup = 1;
+				break;
+			case LONG_OPT_PROC_EVENTS:
+				use_proc_events = 1;
+				break;
+			case LONG_OPT_INCREMENTAL_DISK:
+				incremental_disk = 1;
+				break;
 			case LONG_OPT_SNAPSHOT_FILE:
 				fatal("This option has been replaced with --snapshot-events. Please consult the manual of resource_monitor.");
 				break;
@@ -2216,6 +2523,10 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if(min_interval > interval) {
+		min_interval = interval;
+	}
+
 	if( follow_chdir && hash_table_size(wdirs) > 0) {
 		debug(D_FATAL, "Options --follow-chdir and --measure-dir as mutually exclusive.");
 		exit(RM_MONITOR_ERROR);
@@ -2304,6 +2615,16 @@ int main(int argc, char **argv) {
 		lookup_or_create_wd(NULL, cwd);
 	}
 
+	/* directories given with --measure-dir may have been added before --incremental-disk was parsed. */
+	if(incremental_disk) {
+		struct rmonitor_wdir_info *d;
+		char *path;
+		hash_table_firstkey(wdirs);
+		while(hash_table_nextkey(wdirs, &path, (void **) &d)) {
+			rmonitor_watch_wd(d);
+		}
+	}
+
 	executable = xxstrdup(argv[optind]);
 
 	if( rmonitor_determine_exec_type(executable) ) {
@@ -2313,6 +2634,25 @@ int main(int argc, char **argv) {
 
 	set_snapshot_watch_events();
 
+	if(use_cgroup) {
+		char *cgroup_name = string_format("resource_monitor.%d", getpid());
+		cgroup = rmonitor_cgroup_create(cgroup_name);
+		free(cgroup_name);
+
+		if(!cgroup) {
+			debug(D_NOTICE, "cgroups v2 not available, polling /proc instead.\n");
+		}
+	}
+
+	if(use_proc_events) {
+		/* subscribe before spawning, so that no fork of the tree is missed. */
+		rmonitor_proc_events_fd = rmonitor_proc_events_open();
+
+		if(rmonitor_proc_events_fd < 0) {
+			debug(D_NOTICE, "process events not available, relying on the helper library to track processes.\n");
+		}
+	}
+
 	spawn_first_process(executable, argv + optind, child_in_foreground);
     rmonitor_resources(interval);
     rmonitor_final_cleanup(SIGTERM);
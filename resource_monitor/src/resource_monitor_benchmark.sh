@@ -0,0 +1,99 @@
+#!/bin/bash
+
+# Measures the overhead of resource_monitor for different sampling intervals.
+#
+# For each interval, the workload is run under resource_monitor, and we
+# report the wall time, and the cpu time used by the monitor itself (the cpu
+# time of the whole run, minus the cpu time of running the workload without
+# the monitor). The workload forks many short processes, which is the worst
+# case for the monitor.
+
+# Benchmark Parameters
+
+# Path to resource_monitor
+monitor=${RESOURCE_MONITOR:-$(dirname $0)/resource_monitor}
+
+# Intervals to test, in seconds. Entries of the form "a:b" use adaptive
+# sampling with --interval=a and --min-interval=b.
+intervals=( 5 1 0.1 0.01 "5:0.01" "1:0.001" )
+
+# Workload: number of short processes, and the size in MB of the memory
+# touched by each of them.
+processes=500
+memory=10
+
+# Number of repetitions per interval
+repetitions=3
+
+# Functions
+getfield () {
+	echo $1 | awk -F':' '{print $'$2'}'
+}
+
+calc () {
+	awk "BEGIN { printf \"%.3f\", $* }"
+}
+
+workload () {
+	for i in $(seq $processes)
+	do
+		head -c ${memory}M /dev/zero | tail -c 1 > /dev/null
+	done
+}
+
+# prints the wall time, and the cpu time (user + sys) of a command, in seconds.
+measure () {
+	local TIMEFORMAT="%R %U %S"
+	{ time "$@" > /dev/null 2>&1 ; } 2>&1 | awk '{ print $1, $2 + $3 }'
+}
+
+export -f workload
+export processes memory
+
+if [ ! -x "$monitor" ]; then
+	echo "Could not find resource_monitor at $monitor. Set RESOURCE_MONITOR." 1>&2
+	exit 1
+fi
+
+tmpdir=$(mktemp -d)
+trap "rm -rf $tmpdir" EXIT
+
+base_wall=0
+base_cpu=0
+for r in $(seq $repetitions)
+do
+	set -- $(measure bash -c workload)
+	base_wall=$(calc "$base_wall + $1")
+	base_cpu=$(calc "$base_cpu + $2")
+done
+base_wall=$(calc "$base_wall / $repetitions")
+base_cpu=$(calc "$base_cpu / $repetitions")
+
+printf "%-12s %12s %12s %16s\n" "interval" "wall(s)" "cpu(s)" "monitor_cpu(s)"
+printf "%-12s %12s %12s %16s\n" "none" $base_wall $base_cpu 0
+
+for spec in "${intervals[@]}"
+do
+	interval=$(getfield $spec 1)
+	min_interval=$(getfield $spec 2)
+
+	args="--interval=$interval"
+	if [ -n "$min_interval" ]; then
+		args="$args --min-interval=$min_interval"
+	fi
+
+	wall=0
+	cpu=0
+	for r in $(seq $repetitions)
+	do
+		set -- $(measure $monitor $args -O $tmpdir/bench -- bash -c workload)
+		wall=$(calc "$wall + $1")
+		cpu=$(calc "$cpu + $2")
+	done
+	wall=$(calc "$wall / $repetitions")
+	cpu=$(calc "$cpu / $repetitions")
+
+	printf "%-12s %12s %12s %16s\n" $spec $wall $cpu $(calc "$cpu - $base_cpu")
+done
+
+# vim: set noexpandtab tabstop=4:
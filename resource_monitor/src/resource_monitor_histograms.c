@@ -1547,6 +1547,319 @@ void write_webpage(char *workflow_name)
 	}
 }
 
+/* Streaming mode. Summaries are added to the histograms of their category as
+ * soon as they are read, and then discarded, so that memory is bounded by the
+ * number of categories rather than by the number of tasks. Summary files are
+ * read in parallel, each thread accumulating into its own categories, which
+ * are merged once all the files have been read. Only statistics that can be
+ * computed from the histograms are reported. */
+
+#define FIELD_COUNT (sizeof(field_order)/sizeof(field_order[0]) - 1)
+
+struct stream_stats {
+	int64_t tasks;
+
+	/* per field, in the order of field_order. mean and m2 are updated as in
+	 * Welford's algorithm, so that partial results can be merged. */
+	int64_t count[FIELD_COUNT];
+	double  mean[FIELD_COUNT];
+	double  m2[FIELD_COUNT];
+	int64_t min[FIELD_COUNT];
+	int64_t max[FIELD_COUNT];
+};
+
+struct hash_table *stream_stats_table;
+
+static struct stream_stats *stream_stats_lookup_or_create(struct hash_table *table, const char *name)
+{
+	struct stream_stats *st = hash_table_lookup(table, name);
+
+	if(!st) {
+		st = calloc(1, sizeof(*st));
+		hash_table_insert(table, name, st);
+	}
+
+	return st;
+}
+
+static void stream_stats_add(struct stream_stats *st, struct rmsummary *s)
+{
+	st->tasks++;
+
+	unsigned int i;
+	for(i = 0; i < FIELD_COUNT; i++) {
+		int64_t value = rmsummary_get_int_field(s, field_order[i]);
+		if(value < 0)
+			continue;
+
+		if(st->count[i] == 0 || value < st->min[i])
+			st->min[i] = value;
+
+		if(st->count[i] == 0 || value > st->max[i])
+			st->max[i] = value;
+
+		st->count[i]++;
+
+		double delta = value - st->mean[i];
+		st->mean[i] += delta/st->count[i];
+		st->m2[i]   += delta*(value - st->mean[i]);
+	}
+}
+
+static void stream_stats_merge(struct stream_stats *dest, const struct stream_stats *src)
+{
+	dest->tasks += src->tasks;
+
+	unsigned int i;
+	for(i = 0; i < FIELD_COUNT; i++) {
+		if(src->count[i] == 0)
+			continue;
+
+		if(dest->count[i] == 0 || src->min[i] < dest->min[i])
+			dest->min[i] = src->min[i];
+
+		if(dest->count[i] == 0 || src->max[i] > dest->max[i])
+			dest->max[i] = src->max[i];
+
+		int64_t n    = dest->count[i] + src->count[i];
+		double delta = src->mean[i] - dest->mean[i];
+
+		dest->mean[i] += delta*src->count[i]/n;
+		dest->m2[i]   += src->m2[i] + delta*delta*((double) dest->count[i])*src->count[i]/n;
+		dest->count[i] = n;
+	}
+}
+
+#define category_field_histogram(c, field, name) if(strcmp((field), #name) == 0) return (c)->name##_histogram;
+
+static struct histogram *category_histogram_of_field(struct category *c, const char *field)
+{
+	category_field_histogram(c, field, cores);
+	category_field_histogram(c, field, cores_avg);
+	category_field_histogram(c, field, disk);
+	category_field_histogram(c, field, memory);
+	category_field_histogram(c, field, virtual_memory);
+	category_field_histogram(c, field, swap_memory);
+	category_field_histogram(c, field, wall_time);
+	category_field_histogram(c, field, cpu_time);
+	category_field_histogram(c, field, bytes_read);
+	category_field_histogram(c, field, bytes_written);
+	category_field_histogram(c, field, bytes_received);
+	category_field_histogram(c, field, bytes_sent);
+	category_field_histogram(c, field, bandwidth);
+	category_field_histogram(c, field, total_files);
+	category_field_histogram(c, field, max_concurrent_processes);
+	category_field_histogram(c, field, total_processes);
+
+	return NULL;
+}
+
+/* Merge the categories and stats of one thread into the global ones, and free them. */
+static void stream_merge_thread(struct hash_table *thread_categories, struct hash_table *thread_stats)
+{
+	char *name;
+	struct category *c;
+	struct stream_stats *st;
+
+	hash_table_firstkey(thread_categories);
+	while(hash_table_nextkey(thread_categories, &name, (void **) &c)) {
+		category_merge(category_lookup_or_create(categories, name), c);
+		category_delete(thread_categories, name);
+		hash_table_firstkey(thread_categories);
+	}
+	hash_table_delete(thread_categories);
+
+	hash_table_firstkey(thread_stats);
+	while(hash_table_nextkey(thread_stats, &name, (void **) &st)) {
+		stream_stats_merge(stream_stats_lookup_or_create(stream_stats_table, name), st);
+		free(st);
+	}
+	hash_table_delete(thread_stats);
+}
+
+void stream_summaries_from_filelist(char *input_list)
+{
+	FILE *flist = open_summary_filelist(input_list);
+
+	stream_stats_table = hash_table_create(0, 0);
+
+	/* initialize lazily created tables before the threads start. The
+	 * categories of each thread are created in fixed allocation mode, so
+	 * that category_accumulate_summary never reaches
+	 * category_update_first_allocation, which uses a static buffer. Global
+	 * tables are only modified inside the critical sections below. */
+	field_is_active("cores");
+	field_is_cumulative("cores");
+	rmsummary_to_external_unit("cores", 0);
+
+	#pragma omp parallel
+	{
+		struct hash_table *thread_categories = hash_table_create(0, 0);
+		struct hash_table *thread_stats      = hash_table_create(0, 0);
+
+		struct list *summaries = list_create();
+		char file_summ[MAX_LINE];
+
+		while(1) {
+			int more;
+
+			#pragma omp critical(stream_filelist)
+			more = next_summary_filename(flist, file_summ);
+
+			if(!more)
+				break;
+
+			parse_summary_file(summaries, file_summ, thread_categories);
+
+			struct rmsummary *s;
+			while((s = list_pop_head(summaries))) {
+				struct category *c = category_lookup_or_create(thread_categories, s->category);
+				category_accumulate_summary(c, s, NULL);
+
+				stream_stats_add(stream_stats_lookup_or_create(thread_stats, s->category), s);
+				stream_stats_add(stream_stats_lookup_or_create(thread_stats, ALL_SUMMARIES_CATEGORY), s);
+
+				rmsummary_delete(s);
+			}
+		}
+
+		list_delete(summaries);
+
+		#pragma omp critical(stream_merge)
+		stream_merge_thread(thread_categories, thread_stats);
+	}
+
+	if(flist != stdin)
+		fclose(flist);
+}
+
+static int64_t stream_first_allocation(struct category *c, const char *field, category_mode_t mode, int independence)
+{
+	c->allocation_mode       = mode;
+	c->time_peak_independece = independence;
+
+	category_update_first_allocation(c, NULL);
+
+	if(!c->first_allocation)
+		return -1;
+
+	return rmsummary_get_int_field(c->first_allocation, field);
+}
+
+static void stream_insert_policy(struct jx *policies, const char *policy, const char *field, int64_t value)
+{
+	if(value < 0)
+		return;
+
+	struct jx *j = jx_object(NULL);
+	jx_insert_double(j, "allocation", rmsummary_to_external_unit(field, value));
+
+	jx_insert(policies, jx_string(policy), j);
+}
+
+static struct jx *stream_histogram_to_json(struct histogram *h)
+{
+	struct jx *j = jx_object(NULL);
+	jx_insert_double(j, "bucket_size", histogram_bucket_size(h));
+
+	struct jx *buckets = jx_array(NULL);
+	double *starts     = histogram_buckets(h);
+
+	int i;
+	for(i = 0; i < histogram_size(h); i++) {
+		struct jx *b = jx_array(NULL);
+		jx_array_append(b, jx_double(starts[i]));
+		jx_array_append(b, jx_integer(histogram_count(h, starts[i])));
+		jx_array_append(buckets, b);
+	}
+	free(starts);
+
+	jx_insert(j, jx_string("buckets"), buckets);
+
+	return j;
+}
+
+struct jx *stream_category_to_json(const char *name)
+{
+	struct category     *c  = category_lookup_or_create(categories, name);
+	struct stream_stats *st = hash_table_lookup(stream_stats_table, name);
+
+	struct jx *j = jx_object(NULL);
+	jx_insert_integer(j, "count", st->tasks);
+
+	/* as in set_first_allocations_of_category, all resources are considered,
+	 * bounded by the maximum seen. */
+	rmsummary_delete(c->autolabel_resource);
+	c->autolabel_resource = rmsummary_create(1);
+
+	if(!c->max_allocation)
+		c->max_allocation = rmsummary_create(-1);
+
+	struct jx *resources = jx_object(NULL);
+
+	unsigned int i;
+	for(i = 0; i < FIELD_COUNT; i++) {
+		const char *field_name = field_order[i];
+
+		if(!field_is_active(field_name) || st->count[i] < 1) {
+			continue;
+		}
+
+		rmsummary_assign_int_field(c->max_allocation, field_name, st->max[i]);
+	}
+
+	for(i = 0; i < FIELD_COUNT; i++) {
+		const char *field_name = field_order[i];
+
+		if(!field_is_active(field_name) || st->count[i] < 1) {
+			continue;
+		}
+
+		struct histogram *h = category_histogram_of_field(c, field_name);
+
+		struct jx *f = jx_object(NULL);
+		jx_insert_string(f, "units",   rmsummary_unit_of(field_name));
+		jx_insert_double(f, "mean",    st->mean[i]);
+		jx_insert_double(f, "std-dev", st->count[i] > 1 ? sqrt(st->m2[i]/(st->count[i] - 1)) : -1);
+		jx_insert_double(f, "min",     st->min[i]);
+		jx_insert_double(f, "max",     st->max[i]);
+		jx_insert_double(f, "mode",    histogram_mode(h));
+
+		struct jx *policies = jx_object(NULL);
+		stream_insert_policy(policies, "maximum",         field_name, st->max[i]);
+		stream_insert_policy(policies, "min_waste",       field_name, stream_first_allocation(c, field_name, CATEGORY_ALLOCATION_MODE_MIN_WASTE, 0));
+		stream_insert_policy(policies, "min_waste_naive", field_name, stream_first_allocation(c, field_name, CATEGORY_ALLOCATION_MODE_MIN_WASTE, 1));
+		stream_insert_policy(policies, "max_throughput",  field_name, stream_first_allocation(c, field_name, CATEGORY_ALLOCATION_MODE_MAX_THROUGHPUT, 0));
+		jx_insert(f, jx_string("policies"), policies);
+
+		jx_insert(f, jx_string("histogram"), stream_histogram_to_json(h));
+
+		jx_insert(resources, jx_string(field_name), f);
+	}
+
+	jx_insert(j, jx_string("resources"), resources);
+
+	struct jx *overheads = jx_object(NULL);
+	jx_insert_double(overheads, "input", rmsummary_to_external_unit("wall_time", input_overhead));
+	jx_insert(j, jx_string("overheads"), overheads);
+
+	return j;
+}
+
+struct jx *stream_report(void)
+{
+	struct jx *report = jx_object(NULL);
+
+	char *name;
+	struct stream_stats *st;
+	hash_table_firstkey(stream_stats_table);
+	while(hash_table_nextkey(stream_stats_table, &name, (void **) &st)) {
+		jx_insert(report, jx_string(name), stream_category_to_json(name));
+	}
+
+	return report;
+}
+
 static void show_usage(const char *cmd)
 {
 	fprintf(stdout, "\nUse: %s [options] output_directory [workflow_name]\n\n", cmd);
@@ -1554,9 +1867,13 @@ static void show_usage(const char *cmd)
 	fprintf(stdout, "%-20s Enable debugging for this subsystem.\n", "-d <subsystem>");
 	fprintf(stdout, "%-20s Send debugging to this file. (can also be :stderr, :stdout, :syslog, or :journal)\n", "-o <file>");
 	fprintf(stdout, "%-20s Read summaries filenames from file <list>.\n", "-L <list>");
+	fprintf(stdout, "%-20s (Binary time series from --binary-time-series may also be listed.)\n", "");
 	fprintf(stdout, "%-20s Split on task categories.\n", "-s");
 	fprintf(stdout, "%-20s Use brute force to compute proposed resource allocations. (slow)\n", "-b");
 	fprintf(stdout, "%-20s Do not plot histograms.\n", "-n");
+	fprintf(stdout, "%-20s Streaming mode. Read summaries in parallel, keeping only per category histograms in memory.\n", "-S");
+	fprintf(stdout, "%-20s (Implies -n. Percentile and brute force allocations are not computed.)\n", "");
+	fprintf(stdout, "%-20s Number of threads to use. (Default is the number of cores.)\n", "-j <threads>");
 	fprintf(stdout, "%-20s Select these fields for the histograms.     (Default is: cores,memory,disk).\n\n", "-f <fields>");
 	fprintf(stdout, "%-20s Show this message.\n", "-h,--help");
 }
@@ -1565,11 +1882,12 @@ int main(int argc, char **argv)
 {
 	char *input_list      = NULL;
 	char *workflow_name   = NULL;
+	int   streaming       = 0;
 
 	debug_config(argv[0]);
 
 	signed char c;
-	while( (c = getopt(argc, argv, "bd:f:j:hL:no:")) > -1 )
+	while( (c = getopt(argc, argv, "bd:f:j:hL:no:S")) > -1 )
 	{
 		switch(c)
 		{
@@ -1594,6 +1912,10 @@ int main(int argc, char **argv)
 			case 'n':
 				webpage_mode = 0;
 				break;
+			case 'S':
+				streaming    = 1;
+				webpage_mode = 0;
+				break;
 			case 'h':
 				show_usage(argv[0]);
 				exit(0);
@@ -1645,6 +1967,23 @@ int main(int argc, char **argv)
 
 	category_tune_bucket_size("category-steady-n-tasks", 10000000000);
 
+	if(streaming)
+	{
+		stream_summaries_from_filelist(input_list);
+		input_overhead = timestamp_get() - input_overhead;
+
+		struct jx *report = stream_report();
+
+		char *output_file = string_format("%s/stats.json", output_directory);
+		FILE *f_stats  = open_file(output_file);
+		jx_pretty_print_stream(report, f_stats);
+		fclose(f_stats);
+		free(output_file);
+		jx_delete(report);
+
+		return 0;
+	}
+
 	if(input_list)
 	{
 		parse_summary_from_filelist(all_summaries, input_list, categories);
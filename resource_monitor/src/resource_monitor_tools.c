@@ -136,21 +136,29 @@ void parse_fields_options(const char *field_str)
 	free(fields);
 }
 
-struct rmsummary *parse_summary(struct jx_parser *p, char *filename, struct hash_table *categories)
+static struct rmsummary *add_summary_defaults(struct rmsummary *so, char *filename, struct hash_table *categories)
 {
-	static struct jx_parser *last_p = NULL;
-	static int summ_id     = 1;
-
-	if(last_p != p)
-	{
-		last_p  = p;
-		summ_id = 1;
+	if(!so->taskid) {
+		so->taskid = get_rule_number(filename);
 	}
-	else
-	{
-		summ_id++;
+
+	if(!so->category) {
+		if(so->command) {
+			so->category   = xxstrdup(parse_executable_name(so->command));
+		} else {
+			so->category   = xxstrdup(DEFAULT_CATEGORY);
+			so->command    = xxstrdup(DEFAULT_CATEGORY);
+		}
 	}
 
+	struct category *c = category_lookup_or_create(categories, ALL_SUMMARIES_CATEGORY);
+	category_accumulate_summary(c, so, NULL);
+
+	return so;
+}
+
+struct rmsummary *parse_summary(struct jx_parser *p, char *filename, struct hash_table *categories)
+{
 	struct jx *j = jx_parser_yield(p);
 
 	if(!j)
@@ -162,26 +170,69 @@ struct rmsummary *parse_summary(struct jx_parser *p, char *filename, struct hash
 	if(!so)
 		return NULL;
 
-	if(!so->taskid) {
-		so->taskid = get_rule_number(filename);
+	return add_summary_defaults(so, filename, categories);
+}
+
+/* Binary time series are reduced to the maximum of their samples, without
+ * going through json. */
+struct rmsummary *parse_summary_series(struct rmsummary_series *series, char *filename, struct hash_table *categories)
+{
+	struct rmsummary *so = rmsummary_series_max(series);
+
+	return add_summary_defaults(so, filename, categories);
+}
+
+void parse_summary_file(struct list *dest, char *filename, struct hash_table *categories)
+{
+	struct rmsummary *s;
+
+	FILE *stream = fopen(filename, "r");
+	if(!stream)
+		fatal("Cannot open resources summary file: %s : %s\n", filename, strerror(errno));
+
+	struct rmsummary_series *series = rmsummary_series_open(stream);
+	if(series) {
+		s = parse_summary_series(series, filename, categories);
+		list_push_tail(dest, s);
+
+		rmsummary_series_delete(series);
+		fclose(stream);
+		return;
 	}
 
-	if(!so->category) {
-		if(so->command) {
-			so->category   = parse_executable_name(so->command);
-		} else {
-			so->category   = xxstrdup(DEFAULT_CATEGORY);
-			so->command    = xxstrdup(DEFAULT_CATEGORY);
+	rewind(stream);
+
+	struct jx_parser *p = jx_parser_create(0);
+	jx_parser_read_stream(p, stream);
+
+	while((s = parse_summary(p, filename, categories)))
+		list_push_tail(dest, s);
+
+	jx_parser_delete(p);
+	fclose(stream);
+}
+
+/* Read the next filename from the list, without the trailing newline. Returns 0 at the end of the list. */
+int next_summary_filename(FILE *flist, char *file_summ)
+{
+	while((fgets(file_summ, MAX_LINE, flist)))
+	{
+		int n = strlen(file_summ);
+		if(n < 1)
+			continue;
+
+		if(file_summ[n - 1] == '\n')
+		{
+			file_summ[n - 1] = '\0';
 		}
-	}
 
-	struct category *c = category_lookup_or_create(categories, ALL_SUMMARIES_CATEGORY);
-	category_accumulate_summary(c, so, NULL);
+		return 1;
+	}
 
-	return so;
+	return 0;
 }
 
-void parse_summary_from_filelist(struct rmsummary_set *dest, char *filename, struct hash_table *categories)
+FILE *open_summary_filelist(char *filename)
 {
 	FILE *flist;
 
@@ -196,33 +247,17 @@ void parse_summary_from_filelist(struct rmsummary_set *dest, char *filename, str
 			fatal("Cannot open resources summary list: %s : %s\n", filename, strerror(errno));
 	}
 
-	struct rmsummary *s;
-	char   file_summ[MAX_LINE];
-	while((fgets(file_summ, MAX_LINE, flist)))
-	{
-		FILE *stream;
-
-		int n = strlen(file_summ);
-		if(n < 1)
-			continue;
-
-		if(file_summ[n - 1] == '\n')
-		{
-			file_summ[n - 1] = '\0';
-		}
-
-		stream = fopen(file_summ, "r");
-		if(!stream)
-			fatal("Cannot open resources summary file: %s : %s\n", file_summ, strerror(errno));
-
-		struct jx_parser *p = jx_parser_create(0);
-		jx_parser_read_stream(p, stream);
+	return flist;
+}
 
-		while((s = parse_summary(p, file_summ, categories)))
-			list_push_tail(dest->summaries, s);
+void parse_summary_from_filelist(struct rmsummary_set *dest, char *filename, struct hash_table *categories)
+{
+	FILE *flist = open_summary_filelist(filename);
 
-		jx_parser_delete(p);
-		fclose(stream);
+	char   file_summ[MAX_LINE];
+	while(next_summary_filename(flist, file_summ))
+	{
+		parse_summary_file(dest->summaries, file_summ, categories);
 	}
 }
 
@@ -72,6 +72,9 @@ int field_is_cumulative(const char *key);
 void parse_fields_options(const char *field_str);
 char *parse_executable_name(char *command);
 
+FILE *open_summary_filelist(char *filename);
+int next_summary_filename(FILE *flist, char *file_summ);
+void parse_summary_file(struct list *dest, char *filename, struct hash_table *categories);
 void parse_summary_from_filelist(struct rmsummary_set *dest, char *filename, struct hash_table *categories);
 void parse_summary_recursive(struct rmsummary_set *dest, char *dirname, struct hash_table *categories);
 
@@ -0,0 +1,335 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "debug.h"
+#include "full_io.h"
+#include "macros.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#include "rmonitor_cgroup.h"
+#include "rmonitor_poll_internal.h"
+
+#define CGROUP_READ_MAX 8192
+
+/* Find the mount point of the cgroup2 hierarchy. It is /sys/fs/cgroup in
+ * unified systems, and usually /sys/fs/cgroup/unified in hybrid ones. */
+static char *cgroup_mount_point(void)
+{
+	FILE *f = fopen("/proc/self/mounts", "r");
+	if(!f)
+		return NULL;
+
+	char line[PATH_MAX];
+	char dev[PATH_MAX];
+	char mnt[PATH_MAX];
+	char type[PATH_MAX];
+
+	char *result = NULL;
+	while(fgets(line, sizeof(line), f)) {
+		if(sscanf(line, "%s %s %s", dev, mnt, type) != 3)
+			continue;
+
+		if(strcmp(type, "cgroup2") == 0) {
+			result = xxstrdup(mnt);
+			break;
+		}
+	}
+
+	fclose(f);
+
+	return result;
+}
+
+/* cgroup of the calling process, relative to the mount point. In v2, it is
+ * given by the line of /proc/self/cgroup of the form 0::/some/path */
+static char *cgroup_self(void)
+{
+	FILE *f = fopen("/proc/self/cgroup", "r");
+	if(!f)
+		return NULL;
+
+	char line[PATH_MAX];
+
+	char *result = NULL;
+	while(fgets(line, sizeof(line), f)) {
+		if(strncmp(line, "0::", 3) == 0) {
+			string_chomp(line);
+			result = xxstrdup(line + 3);
+			break;
+		}
+	}
+
+	fclose(f);
+
+	return result;
+}
+
+static int cgroup_open(struct rmonitor_cgroup *cg, const char *filename)
+{
+	char *path = string_format("%s/%s", cg->path, filename);
+	int fd = open(path, O_RDONLY);
+
+	if(fd < 0) {
+		debug(D_RMON, "could not open %s : %s\n", path, strerror(errno));
+	}
+
+	free(path);
+
+	return fd;
+}
+
+static int cgroup_write(const char *dir, const char *filename, const char *value)
+{
+	char *path = string_format("%s/%s", dir, filename);
+	int fd = open(path, O_WRONLY);
+
+	int status = -1;
+	if(fd >= 0) {
+		if(full_write(fd, value, strlen(value)) == (ssize_t) strlen(value)) {
+			status = 0;
+		}
+		close(fd);
+	}
+
+	if(status) {
+		debug(D_RMON, "could not write '%s' to %s : %s\n", value, path, strerror(errno));
+	}
+
+	free(path);
+
+	return status;
+}
+
+/* Read the whole contents of an open cgroup file into buffer. Counters
+ * files are regenerated on every read, so we always read from offset 0. */
+static int cgroup_read(int fd, char *buffer)
+{
+	if(fd < 0)
+		return -1;
+
+	ssize_t n = pread(fd, buffer, CGROUP_READ_MAX - 1, 0);
+	if(n < 0)
+		return -1;
+
+	buffer[n] = '\0';
+
+	return 0;
+}
+
+static int cgroup_read_int(int fd, uint64_t *value)
+{
+	char buffer[CGROUP_READ_MAX];
+
+	if(cgroup_read(fd, buffer) < 0)
+		return -1;
+
+	if(sscanf(buffer, "%" SCNu64, value) != 1)
+		return -1;
+
+	return 0;
+}
+
+/* Find the value of key in buffer, which has "key value" lines, such as the
+ * contents of cpu.stat or memory.stat. */
+static int cgroup_find_key(const char *buffer, const char *key, uint64_t *value)
+{
+	int n = strlen(key);
+	const char *line = buffer;
+	while(line && *line) {
+		if(strncmp(line, key, n) == 0 && line[n] == ' ') {
+			if(sscanf(line + n, "%" SCNu64, value) == 1)
+				return 0;
+		}
+
+		line = strchr(line, '\n');
+		if(line)
+			line++;
+	}
+
+	return -1;
+}
+
+static int cgroup_read_keyed(int fd, const char *key, uint64_t *value)
+{
+	char buffer[CGROUP_READ_MAX];
+
+	if(cgroup_read(fd, buffer) < 0)
+		return -1;
+
+	return cgroup_find_key(buffer, key, value);
+}
+
+/* Memory of the group comparable to the VmRSS of its processes. memory.current
+ * also counts the page cache and kernel memory (slab, sockets, stacks), which
+ * can be much larger than what the processes have mapped. As in VmRSS, we only
+ * count anonymous memory and file pages mapped into some process. file_mapped
+ * includes mapped shared memory, but not the tmpfs files nobody maps. */
+static int cgroup_read_resident(int fd, uint64_t *value)
+{
+	char buffer[CGROUP_READ_MAX];
+	uint64_t anon, file_mapped;
+
+	if(cgroup_read(fd, buffer) < 0)
+		return -1;
+
+	if(cgroup_find_key(buffer, "anon", &anon) < 0 || cgroup_find_key(buffer, "file_mapped", &file_mapped) < 0)
+		return -1;
+
+	*value = anon + file_mapped;
+
+	return 0;
+}
+
+struct rmonitor_cgroup *rmonitor_cgroup_create(const char *name)
+{
+	char *mnt  = cgroup_mount_point();
+	char *self = cgroup_self();
+
+	if(!mnt || !self) {
+		debug(D_RMON, "cgroups v2 are not available.\n");
+		free(mnt);
+		free(self);
+		return NULL;
+	}
+
+	char *parent = string_format("%s%s", mnt, self);
+
+	free(mnt);
+	free(self);
+
+	/* Try to delegate the controllers we need to our children. This fails
+	 * when the controllers are not available to the parent, or when the
+	 * parent has processes and it is not the root of the hierarchy. In that
+	 * case we check below whether the controllers are present anyway. */
+	cgroup_write(parent, "cgroup.subtree_control", "+memory");
+
+	struct rmonitor_cgroup *cg = calloc(1, sizeof(*cg));
+	cg->path = string_format("%s/%s", parent, name);
+	free(parent);
+
+	cg->memory_stat_fd = -1;
+	cg->memory_swap_fd = -1;
+	cg->cpu_stat_fd    = -1;
+
+	if(mkdir(cg->path, 0755) < 0 && errno != EEXIST) {
+		debug(D_RMON, "could not create cgroup %s : %s\n", cg->path, strerror(errno));
+		free(cg->path);
+		free(cg);
+		return NULL;
+	}
+
+	cg->memory_stat_fd = cgroup_open(cg, "memory.stat");
+	cg->cpu_stat_fd    = cgroup_open(cg, "cpu.stat");
+
+	/* memory.stat and cpu.stat are required to give the same
+	 * measurements as polling /proc. */
+	if(cg->memory_stat_fd < 0 || cg->cpu_stat_fd < 0) {
+		debug(D_RMON, "memory or cpu accounting not available on cgroup %s\n", cg->path);
+		rmonitor_cgroup_delete(cg);
+		return NULL;
+	}
+
+	cg->memory_swap_fd = cgroup_open(cg, "memory.swap.current");
+
+	debug(D_RMON, "using cgroup %s for accounting.\n", cg->path);
+
+	return cg;
+}
+
+int rmonitor_cgroup_add_process(struct rmonitor_cgroup *cg, pid_t pid)
+{
+	char *value = string_format("%d", pid);
+	int status  = cgroup_write(cg->path, "cgroup.procs", value);
+	free(value);
+
+	return status;
+}
+
+int rmonitor_cgroup_poll(struct rmonitor_cgroup *cg, struct itable *processes, struct rmonitor_process_info *acc, struct rmonitor_mem_info *mem)
+{
+	uint64_t usage_usec, resident, swap;
+
+	/* acc keeps the accumulated values across polls, to compute deltas. */
+	uint64_t cpu_before     = acc->cpu.accumulated;
+
+	if(cgroup_read_keyed(cg->cpu_stat_fd, "usage_usec", &usage_usec) < 0)
+		return 1;
+
+	if(cgroup_read_resident(cg->memory_stat_fd, &resident) < 0)
+		return 1;
+
+	bzero(acc, sizeof(struct rmonitor_process_info));
+	bzero(mem, sizeof(struct rmonitor_mem_info));
+
+	acc->cpu.accumulated = usage_usec;
+	acc->cpu.delta       = usage_usec - MIN(usage_usec, cpu_before);
+
+	/* cgroup values are in bytes, we report MB. memory.peak is not used, as
+	 * it is the peak of memory.current, which includes the page cache. */
+	mem->resident = DIV_INT_ROUND_UP(resident, ONE_MEGABYTE);
+	cg->peak_memory = MAX(cg->peak_memory, mem->resident);
+
+	if(cgroup_read_int(cg->memory_swap_fd, &swap) == 0) {
+		mem->swap = DIV_INT_ROUND_UP(swap, ONE_MEGABYTE);
+	}
+
+	/* io.stat only counts block device io, while the /proc backend reports
+	 * rchar, which includes reads from the page cache, pipes and sockets.
+	 * To report the same values, io is read from /proc, as is virtual
+	 * memory, which is not accounted by cgroups. */
+	uint64_t pid;
+	struct rmonitor_process_info *p;
+	itable_firstkey(processes);
+	while(itable_nextkey(processes, &pid, (void **) &p)) {
+		if(rmonitor_get_mem_usage(p->pid, &p->mem) == 0) {
+			mem->virtual += p->mem.virtual;
+		}
+
+		if(rmonitor_get_sys_io_usage(p->pid, &p->io) == 0) {
+			acc_sys_io_usage(&acc->io, &p->io);
+		}
+	}
+
+	acc->mem.virtual  = mem->virtual;
+	acc->mem.resident = mem->resident;
+	acc->mem.swap     = mem->swap;
+
+	rmonitor_get_loadavg(&acc->load);
+
+	return 0;
+}
+
+void rmonitor_cgroup_delete(struct rmonitor_cgroup *cg)
+{
+	if(!cg)
+		return;
+
+	if(cg->memory_stat_fd > -1) close(cg->memory_stat_fd);
+	if(cg->memory_swap_fd > -1) close(cg->memory_swap_fd);
+	if(cg->cpu_stat_fd > -1)    close(cg->cpu_stat_fd);
+
+	if(rmdir(cg->path) < 0) {
+		debug(D_RMON, "could not remove cgroup %s : %s\n", cg->path, strerror(errno));
+	}
+
+	free(cg->path);
+	free(cg);
+}
+
+/* vim: set noexpandtab tabstop=4: */
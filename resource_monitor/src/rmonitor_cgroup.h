@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef RMONITOR_CGROUP_H
+#define RMONITOR_CGROUP_H
+
+#include <sys/types.h>
+
+#include "itable.h"
+#include "rmonitor_types.h"
+
+/* Accounting of the monitored process tree through a cgroup v2 created for
+ * it. The kernel aggregates memory and cpu counters for all the processes in
+ * the group, including the ones that exited between polls, so that
+ * per-process reads of /proc are not needed for these values. */
+
+struct rmonitor_cgroup {
+	char *path;            /* absolute path of the cgroup directory. */
+
+	int memory_stat_fd;    /* file descriptors kept open, read with pread. */
+	int memory_swap_fd;
+	int cpu_stat_fd;
+
+	uint64_t peak_memory;  /* peak resident memory of the group, in MB. */
+};
+
+/* Create a new cgroup named name as a child of the cgroup of the calling
+ * process. Returns NULL if cgroups v2 are not available, or if the memory
+ * controller cannot be used on the new group. */
+struct rmonitor_cgroup *rmonitor_cgroup_create(const char *name);
+
+/* Move pid into the cgroup. Children of pid are created in the cgroup
+ * automatically. Returns 0 on success. */
+int rmonitor_cgroup_add_process(struct rmonitor_cgroup *cg, pid_t pid);
+
+/* Fill acc and mem with the aggregated values of the cgroup, in the same
+ * units rmonitor_poll_all_processes_once and rmonitor_poll_maps_once use.
+ * Virtual memory is not tracked by cgroups, and it is read from /proc for
+ * the processes in the table, as are the bytes read and written, so that they
+ * match the values of the /proc backend. Returns 0 on success. */
+int rmonitor_cgroup_poll(struct rmonitor_cgroup *cg, struct itable *processes, struct rmonitor_process_info *acc, struct rmonitor_mem_info *mem);
+
+/* Remove the cgroup directory. It only succeeds once all processes in the
+ * group have exited. */
+void rmonitor_cgroup_delete(struct rmonitor_cgroup *cg);
+
+#endif
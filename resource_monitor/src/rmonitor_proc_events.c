@@ -0,0 +1,171 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#endif
+
+#include "debug.h"
+
+#include "rmonitor_proc_events.h"
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+
+/* Netlink messages are aligned to 4 bytes, so we use an int array as
+ * buffer. The largest proc event is well under this size. */
+#define PROC_EVENTS_BUFFER_SIZE 1024
+
+static int proc_events_listen(int fd, enum proc_cn_mcast_op op)
+{
+	int buffer[PROC_EVENTS_BUFFER_SIZE/sizeof(int)];
+	memset(buffer, 0, sizeof(buffer));
+
+	struct nlmsghdr *hdr = (struct nlmsghdr *) buffer;
+	struct cn_msg   *msg = (struct cn_msg *) NLMSG_DATA(hdr);
+
+	hdr->nlmsg_len  = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+	hdr->nlmsg_type = NLMSG_DONE;
+	hdr->nlmsg_pid  = getpid();
+
+	msg->id.idx = CN_IDX_PROC;
+	msg->id.val = CN_VAL_PROC;
+	msg->len    = sizeof(enum proc_cn_mcast_op);
+	memcpy(msg->data, &op, sizeof(op));
+
+	if(send(fd, hdr, hdr->nlmsg_len, 0) < 0) {
+		debug(D_RMON, "could not subscribe to process events: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int rmonitor_proc_events_open(void)
+{
+	int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if(fd < 0) {
+		debug(D_RMON, "could not open netlink connector socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	addr.nl_pid    = getpid();
+
+	if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		debug(D_RMON, "could not bind to the process events connector: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if(proc_events_listen(fd, PROC_CN_MCAST_LISTEN) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int rmonitor_proc_events_recv(int fd, struct rmonitor_proc_event *event)
+{
+	int buffer[PROC_EVENTS_BUFFER_SIZE/sizeof(int)];
+
+	while(1) {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+		if(n < 0) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			} else if(errno == ENOBUFS) {
+				/* the kernel dropped events because we did not read fast
+				 * enough. ping_processes will catch the exits we missed. */
+				debug(D_RMON, "process events were dropped.\n");
+				continue;
+			} else if(errno == EINTR) {
+				continue;
+			}
+
+			debug(D_RMON, "error reading process events: %s\n", strerror(errno));
+			return -1;
+		}
+
+		struct nlmsghdr *hdr;
+		for(hdr = (struct nlmsghdr *) buffer; NLMSG_OK(hdr, n); hdr = NLMSG_NEXT(hdr, n)) {
+			if(hdr->nlmsg_type == NLMSG_ERROR || hdr->nlmsg_type == NLMSG_NOOP)
+				continue;
+
+			struct cn_msg *msg = (struct cn_msg *) NLMSG_DATA(hdr);
+			if(msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC)
+				continue;
+
+			struct proc_event *ev = (struct proc_event *) msg->data;
+
+			switch(ev->what) {
+				case PROC_EVENT_FORK:
+					/* threads also generate fork events. */
+					if(ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid)
+						continue;
+					event->type   = RMONITOR_PROC_EVENT_FORK;
+					event->pid    = ev->event_data.fork.child_tgid;
+					event->parent = ev->event_data.fork.parent_tgid;
+					return 1;
+				case PROC_EVENT_EXEC:
+					event->type = RMONITOR_PROC_EVENT_EXEC;
+					event->pid  = ev->event_data.exec.process_tgid;
+					return 1;
+				case PROC_EVENT_EXIT:
+					if(ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid)
+						continue;
+					event->type      = RMONITOR_PROC_EVENT_EXIT;
+					event->pid       = ev->event_data.exit.process_tgid;
+					event->exit_code = ev->event_data.exit.exit_code;
+					return 1;
+				default:
+					continue;
+			}
+		}
+	}
+}
+
+void rmonitor_proc_events_close(int fd)
+{
+	if(fd < 0)
+		return;
+
+	proc_events_listen(fd, PROC_CN_MCAST_IGNORE);
+	close(fd);
+}
+
+#else
+
+int rmonitor_proc_events_open(void)
+{
+	return -1;
+}
+
+int rmonitor_proc_events_recv(int fd, struct rmonitor_proc_event *event)
+{
+	return -1;
+}
+
+void rmonitor_proc_events_close(int fd)
+{
+}
+
+#endif
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,41 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef RMONITOR_PROC_EVENTS_H
+#define RMONITOR_PROC_EVENTS_H
+
+#include <sys/types.h>
+
+/* Process creation and termination events from the Linux proc connector.
+ * Unlike the helper library, the connector reports every fork, exec and
+ * exit in the system, including those of statically linked executables. It
+ * needs the CAP_NET_ADMIN capability. */
+
+typedef enum {
+	RMONITOR_PROC_EVENT_FORK,
+	RMONITOR_PROC_EVENT_EXEC,
+	RMONITOR_PROC_EVENT_EXIT
+} rmonitor_proc_event_t;
+
+struct rmonitor_proc_event {
+	rmonitor_proc_event_t type;
+	pid_t pid;        /* new process for FORK, process that exec'd or exited otherwise. */
+	pid_t parent;     /* only for FORK. */
+	int   exit_code;  /* only for EXIT, as given by wait. */
+};
+
+/* Open a connector socket and subscribe to process events. Returns the file
+ * descriptor of the socket, or -1 if the connector is not available. */
+int rmonitor_proc_events_open(void);
+
+/* Read the next process event without blocking. Thread events are skipped.
+ * Returns 1 if an event was read, 0 if there are no more events pending, and
+ * -1 on error. */
+int rmonitor_proc_events_recv(int fd, struct rmonitor_proc_event *event);
+
+void rmonitor_proc_events_close(int fd);
+
+#endif
@@ -0,0 +1,44 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+output=binary_series
+
+prepare()
+{
+	exit 0
+}
+
+run()
+{
+	# do not run the test if not on linux.
+	[ -d /proc ] || exit 0
+
+	../src/resource_monitor --no-pprint --binary-time-series -i 1 -O $output -- sh -c 'head -c 10000000 /dev/zero | sleep 2' || exit 1
+
+	# the series should not be text
+	grep -q '^#' $output.series && exit 1
+
+	echo $output.series > $output.list
+	../src/resource_monitor_histograms -n -L $output.list $output.hist || exit 1
+
+	# with a single task, the mean memory of the histogram is the peak memory of the summary.
+	expected=$(sed -n 's/.*"memory":\[\([0-9]*\),.*/\1/p' $output.summary)
+	result=$(awk '/"memory":/ { m = 1 } m && /"mean":/ { gsub(/[^0-9]/, "", $0); print; exit }' $output.hist/stats.json)
+
+	echo "summary: $expected series: $result"
+
+	[ -n "$expected" ] && [ "$expected" = "$result" ] || exit 1
+
+	exit 0
+}
+
+clean()
+{
+	rm -rf $output.summary $output.series $output.list $output.hist
+	exit 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
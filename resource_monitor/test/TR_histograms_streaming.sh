@@ -0,0 +1,66 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+output=histograms_streaming
+
+prepare()
+{
+	mkdir -p $output.summaries
+
+	i=0
+	while [ $i -lt 300 ]
+	do
+		memory=$(( (i * 37) % 900 + 10 ))
+		printf '{"command":"cmd%d","category":"cat%d","exit_type":"normal","wall_time":[%d,"s"],"cpu_time":[%d,"s"],"cores":[%d,"cores"],"memory":[%d,"MB"],"disk":[%d,"MB"]}\n' \
+			$((i % 3)) $((i % 3)) $((i % 50 + 1)) $((i % 40)) $((i % 4 + 1)) $memory $((memory / 2)) > $output.summaries/$i.summary
+		i=$((i + 1))
+	done
+
+	ls $output.summaries/*.summary > $output.list
+
+	exit 0
+}
+
+# print the value of a key inside a field of a category of stats.json
+value_of()
+{
+	awk -v category="\"$2\":" -v field="\"$3\":" -v key="\"$4\":" '
+		$1 == category { c = 1 }
+		c && $1 == field { f = 1 }
+		c && f && $1 ~ "^" key { sub("^" key, "", $1); sub(",$", "", $1); print $1; exit }' $1
+}
+
+run()
+{
+	../src/resource_monitor_histograms -n -L $output.list $output.memory || exit 1
+	../src/resource_monitor_histograms -S -j 4 -L $output.list $output.streaming || exit 1
+
+	for category in '(all)' cat0 cat1 cat2
+	do
+		for field in memory disk cores
+		do
+			for key in mean std-dev
+			do
+				expected=$(value_of $output.memory/stats.json "$category" $field $key)
+				result=$(value_of $output.streaming/stats.json "$category" $field $key)
+
+				echo "$category $field $key: $expected $result"
+
+				[ -n "$expected" ] && [ "$expected" = "$result" ] || exit 1
+			done
+		done
+	done
+
+	exit 0
+}
+
+clean()
+{
+	rm -rf $output.summaries $output.list $output.memory $output.streaming
+	exit 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
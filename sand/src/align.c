@@ -9,8 +9,14 @@ See the file COPYING for details.
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
 #include <sys/time.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ALIGN_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 #include "align.h"
 #include "macros.h"
 #include "matrix.h"
@@ -20,12 +26,45 @@ See the file COPYING for details.
 #define TRACEBACK_DIAG '\\'
 #define TRACEBACK_END  'X'
 
+#define BRACKET( a, x, b ) MIN(MAX((a),(x)),(b))
+
 // XXX need to pass these in all the way from the beginning
 static const int score_match = 2;
 static const int score_mismatch = -1;
 static const int score_gap = -1;
 
-static void choose_best(struct matrix *m, int * i, int * j, int istart, int iend, int jstart, int jend );
+typedef int (*score_kernel_t)( struct align_workspace *w, const char *a, int alength, const char *b, int blength );
+
+struct align_workspace {
+	score_kernel_t kernel;
+	const char *kernel_name;
+
+	// Query profile and two columns of scores for the striped kernels.
+	void *buffer;
+	size_t buffer_size;
+
+	// Matrix for alignments that need a traceback.
+	struct matrix *matrix;
+	size_t matrix_cells;
+};
+
+/*
+The traceback and the choice of the best cell only read the cells of the
+alignment, so they work on any storage through a cell_reader_t.
+*/
+
+typedef struct cell (*cell_reader_t)( const void *storage, int i, int j );
+
+static struct cell matrix_reader( const void *storage, int i, int j )
+{
+	const struct matrix *m = storage;
+	return matrix(m,i,j);
+}
+
+static void choose_best(cell_reader_t reader, const void *storage, int width, int height, int * i, int * j, int istart, int iend, int jstart, int jend );
+static int alignment_trace(struct alignment *aln, int *length, cell_reader_t reader, const void *storage, int *i, int *j, int jstop, const char *a, const char *b );
+static struct alignment * alignment_create( int width, int height );
+static void alignment_finish( struct alignment *aln, int length, int i, int j, int istart, int jstart, int score );
 static struct alignment * alignment_traceback(struct matrix *m, int i, int j, const char *a, const char *b );
 
 /*
@@ -36,24 +75,24 @@ BUT, the string indexes are [0:length), and are set one off from the matrix.
 So, note that the value of matrix[i][j] evaluates string values a[i-1] and b[j-1].
 */
 
-static inline struct cell score_cell( struct matrix *m, int i, int j, const char *a, const char *b, int is_smith_waterman )
+static inline struct cell score_neighbors( int diag, int left, int up, char ca, char cb, int is_smith_waterman )
 {
 	struct cell result;
 
 	// Compute the score from the diagonal.
-	int diagscore = matrix(m,i-1,j-1).score + ((a[i-1]==b[j-1]) ? score_match : score_mismatch);
+	int diagscore = diag + ((ca==cb) ? score_match : score_mismatch);
 	result.score = diagscore;
 	result.traceback = TRACEBACK_DIAG;
 
 	// Compute the score from the left, and accept if greater.
-	int leftscore = matrix(m,i-1,j).score + score_gap;
+	int leftscore = left + score_gap;
 	if(leftscore>result.score) {
 		result.score = leftscore;
 		result.traceback = TRACEBACK_LEFT;
 	}
 
 	// Compute the score from above, and accept if greater.
-	int upscore = matrix(m,i,j-1).score + score_gap;
+	int upscore = up + score_gap;
 	if(upscore>result.score) {
 		result.score = upscore;
 		result.traceback = TRACEBACK_UP;
@@ -72,6 +111,11 @@ static inline struct cell score_cell( struct matrix *m, int i, int j, const char
 	return result;
 }
 
+static inline struct cell score_cell( struct matrix *m, int i, int j, const char *a, const char *b, int is_smith_waterman )
+{
+	return score_neighbors(matrix(m,i-1,j-1).score, matrix(m,i-1,j).score, matrix(m,i,j-1).score, a[i-1], b[j-1], is_smith_waterman);
+}
+
 struct alignment * align_smith_waterman( struct matrix *m, const char * a, const char * b )
 {
 	int width = m->width;
@@ -114,6 +158,337 @@ struct alignment * align_smith_waterman( struct matrix *m, const char * a, const
 	return alignment_traceback(m, best_i, best_j, a, b );
 }
 
+/*
+Score-only Smith-Waterman kernels. They keep a single column of scores
+instead of the whole matrix, so they can be used to discard pairs that
+do not align well before paying for the traceback.
+
+The striped kernels follow Farrar (Bioinformatics, 2007): the query a is
+split into V segments, one per vector lane, so that lane l of vector k
+holds position l*seglen+k. The dependencies along the query (gaps in b)
+are resolved by a second, lazy pass that is usually very short.
+Scores are 16 bit saturated. If the best score saturates, the scalar
+kernel computes it again with full precision.
+*/
+
+static int score_kernel_scalar( struct align_workspace *w, const char *a, int alength, const char *b, int blength )
+{
+	int *h = align_workspace_buffer(w, (alength+1)*sizeof(int), sizeof(int));
+	int i, j;
+	int best = 0;
+
+	memset(h, 0, (alength+1)*sizeof(int));
+
+	for(j=1; j<=blength; j++) {
+		int diag = 0;
+		int left = 0;
+		char c = b[j-1];
+
+		for(i=1; i<=alength; i++) {
+			int up = h[i];
+
+			int s = diag + ((a[i-1]==c) ? score_match : score_mismatch);
+			s = MAX(s, up + score_gap);
+			s = MAX(s, left + score_gap);
+			s = MAX(s, 0);
+
+			diag = up;
+			left = s;
+			h[i] = s;
+
+			if(s>best) best = s;
+		}
+	}
+
+	return best;
+}
+
+#ifdef ALIGN_X86_KERNELS
+
+/*
+Fill the query profile: for every distinct symbol of b, the score of
+matching it against each position of a, in striped order. Sets profile
+to map each symbol of b to its scores, and columns to two zeroed columns
+of scores, all within the workspace buffer.
+*/
+
+static void striped_profile( struct align_workspace *w, const char *a, int alength, const char *b, int blength, int lanes, int seglen, int16_t **profile, int16_t **columns )
+{
+	unsigned char symbols[256];
+	int nsymbols = 0;
+	int present[256] = {0};
+	int i, k, l;
+
+	for(i=0; i<blength; i++) {
+		unsigned char c = b[i];
+		if(!present[c]) {
+			present[c] = 1;
+			symbols[nsymbols++] = c;
+		}
+	}
+
+	size_t vector = lanes*sizeof(int16_t);
+	size_t column = seglen*vector;
+	int16_t *data = align_workspace_buffer(w, (nsymbols+2)*column, vector);
+
+	for(i=0; i<nsymbols; i++) {
+		int16_t *p = data + i*seglen*lanes;
+		profile[symbols[i]] = p;
+
+		for(k=0; k<seglen; k++) {
+			for(l=0; l<lanes; l++) {
+				int pos = l*seglen + k;
+				if(pos<alength) {
+					p[k*lanes+l] = (a[pos]==symbols[i]) ? score_match : score_mismatch;
+				} else {
+					// Padding past the end of a never scores.
+					p[k*lanes+l] = SHRT_MIN/2;
+				}
+			}
+		}
+	}
+
+	*columns = data + nsymbols*seglen*lanes;
+	memset(*columns, 0, 2*column);
+}
+
+__attribute__((target("sse2")))
+static int score_kernel_sse2( struct align_workspace *w, const char *a, int alength, const char *b, int blength )
+{
+	const int lanes = 8;
+	int seglen = (alength + lanes - 1) / lanes;
+	int16_t *profile[256];
+	int16_t *columns;
+	int j, k;
+
+	striped_profile(w, a, alength, b, blength, lanes, seglen, profile, &columns);
+
+	__m128i *hload  = (__m128i *) columns;
+	__m128i *hstore = hload + seglen;
+
+	const __m128i vgap  = _mm_set1_epi16(-score_gap);
+	const __m128i vzero = _mm_setzero_si128();
+	__m128i vmax = vzero;
+
+	for(j=0; j<blength; j++) {
+		const __m128i *p = (const __m128i *) profile[(unsigned char) b[j]];
+
+		// The diagonal of the first segment comes from the last segment of the previous column.
+		__m128i vh = _mm_slli_si128(hstore[seglen-1], 2);
+		__m128i vf = vzero;
+
+		__m128i *t = hload;
+		hload  = hstore;
+		hstore = t;
+
+		for(k=0; k<seglen; k++) {
+			vh = _mm_adds_epi16(vh, p[k]);
+			vh = _mm_max_epi16(vh, _mm_subs_epi16(hload[k], vgap));
+			vh = _mm_max_epi16(vh, vf);
+			vh = _mm_max_epi16(vh, vzero);
+			vmax = _mm_max_epi16(vmax, vh);
+			hstore[k] = vh;
+
+			vf = _mm_subs_epi16(vh, vgap);
+			vh = hload[k];
+		}
+
+		// Carry the gaps in b across segments until they no longer improve any score.
+		vf = _mm_slli_si128(vf, 2);
+		k = 0;
+		while(_mm_movemask_epi8(_mm_cmpgt_epi16(vf, hstore[k]))) {
+			hstore[k] = _mm_max_epi16(hstore[k], vf);
+			vf = _mm_subs_epi16(vf, vgap);
+			if(++k>=seglen) {
+				k = 0;
+				vf = _mm_slli_si128(vf, 2);
+			}
+		}
+	}
+
+	int16_t lanes_max[8];
+	_mm_storeu_si128((__m128i *) lanes_max, vmax);
+
+	int best = 0;
+	for(k=0; k<lanes; k++) {
+		best = MAX(best, lanes_max[k]);
+	}
+
+	if(best>=SHRT_MAX) {
+		return score_kernel_scalar(w, a, alength, b, blength);
+	}
+
+	return best;
+}
+
+/* Shift a vector up by one 16 bit lane, across the two 128 bit halves. */
+#define avx2_shift_lane(v) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 14)
+
+__attribute__((target("avx2")))
+static int score_kernel_avx2( struct align_workspace *w, const char *a, int alength, const char *b, int blength )
+{
+	const int lanes = 16;
+	int seglen = (alength + lanes - 1) / lanes;
+	int16_t *profile[256];
+	int16_t *columns;
+	int j, k;
+
+	striped_profile(w, a, alength, b, blength, lanes, seglen, profile, &columns);
+
+	__m256i *hload  = (__m256i *) columns;
+	__m256i *hstore = hload + seglen;
+
+	const __m256i vgap  = _mm256_set1_epi16(-score_gap);
+	const __m256i vzero = _mm256_setzero_si256();
+	__m256i vmax = vzero;
+
+	for(j=0; j<blength; j++) {
+		const __m256i *p = (const __m256i *) profile[(unsigned char) b[j]];
+
+		__m256i vh = avx2_shift_lane(hstore[seglen-1]);
+		__m256i vf = vzero;
+
+		__m256i *t = hload;
+		hload  = hstore;
+		hstore = t;
+
+		for(k=0; k<seglen; k++) {
+			vh = _mm256_adds_epi16(vh, p[k]);
+			vh = _mm256_max_epi16(vh, _mm256_subs_epi16(hload[k], vgap));
+			vh = _mm256_max_epi16(vh, vf);
+			vh = _mm256_max_epi16(vh, vzero);
+			vmax = _mm256_max_epi16(vmax, vh);
+			hstore[k] = vh;
+
+			vf = _mm256_subs_epi16(vh, vgap);
+			vh = hload[k];
+		}
+
+		vf = avx2_shift_lane(vf);
+		k = 0;
+		while(_mm256_movemask_epi8(_mm256_cmpgt_epi16(vf, hstore[k]))) {
+			hstore[k] = _mm256_max_epi16(hstore[k], vf);
+			vf = _mm256_subs_epi16(vf, vgap);
+			if(++k>=seglen) {
+				k = 0;
+				vf = avx2_shift_lane(vf);
+			}
+		}
+	}
+
+	int16_t lanes_max[16];
+	_mm256_storeu_si256((__m256i *) lanes_max, vmax);
+
+	int best = 0;
+	for(k=0; k<lanes; k++) {
+		best = MAX(best, lanes_max[k]);
+	}
+
+	if(best>=SHRT_MAX) {
+		return score_kernel_scalar(w, a, alength, b, blength);
+	}
+
+	return best;
+}
+
+#endif
+
+struct align_workspace * align_workspace_create( const char *kernel )
+{
+	struct align_workspace *w = malloc(sizeof(*w));
+	memset(w,0,sizeof(*w));
+
+	w->kernel = score_kernel_scalar;
+	w->kernel_name = "scalar";
+
+	if(kernel && !strcmp(kernel,"scalar")) {
+		return w;
+	}
+
+#ifdef ALIGN_X86_KERNELS
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2") && (!kernel || !strcmp(kernel,"avx2"))) {
+		w->kernel = score_kernel_avx2;
+		w->kernel_name = "avx2";
+	} else if(__builtin_cpu_supports("sse2") && (!kernel || !strcmp(kernel,"sse2"))) {
+		w->kernel = score_kernel_sse2;
+		w->kernel_name = "sse2";
+	}
+#endif
+
+	return w;
+}
+
+const char * align_workspace_kernel( struct align_workspace *w )
+{
+	return w->kernel_name;
+}
+
+void * align_workspace_buffer( struct align_workspace *w, size_t size, size_t alignment )
+{
+	if(size + alignment > w->buffer_size) {
+		free(w->buffer);
+		w->buffer_size = size + alignment;
+		w->buffer = malloc(w->buffer_size);
+		if(!w->buffer) {
+			fprintf(stderr,"align: out of memory for %lu bytes.\n",(unsigned long) w->buffer_size);
+			exit(1);
+		}
+	}
+
+	uintptr_t p = (uintptr_t) w->buffer;
+	p = (p + alignment - 1) / alignment * alignment;
+
+	return (void *) p;
+}
+
+struct matrix * align_workspace_matrix( struct align_workspace *w, int width, int height )
+{
+	size_t cells = (size_t) (width+1) * (height+1);
+
+	if(cells > w->matrix_cells) {
+		if(w->matrix) matrix_delete(w->matrix);
+		w->matrix = matrix_create(width, height);
+		w->matrix_cells = cells;
+	}
+
+	w->matrix->width = width;
+	w->matrix->height = height;
+
+	return w->matrix;
+}
+
+void align_workspace_delete( struct align_workspace *w )
+{
+	if(!w) return;
+
+	if(w->matrix) matrix_delete(w->matrix);
+	free(w->buffer);
+	free(w);
+}
+
+int align_smith_waterman_score( struct align_workspace *w, const char *a, const char *b )
+{
+	int alength = strlen(a);
+	int blength = strlen(b);
+
+	if(alength==0 || blength==0) return 0;
+
+	return w->kernel(w, a, alength, b, blength);
+}
+
+struct alignment * align_smith_waterman_threshold( struct align_workspace *w, const char *a, const char *b, int min_score )
+{
+	if(min_score>0 && align_smith_waterman_score(w, a, b) < min_score) {
+		return 0;
+	}
+
+	struct matrix *m = align_workspace_matrix(w, strlen(a), strlen(b));
+
+	return align_smith_waterman(m, a, b);
+}
+
 struct alignment * align_prefix_suffix( struct matrix *m, const char * a, const char * b, int min_align )
 {
 	int width = m->width;
@@ -144,7 +519,7 @@ struct alignment * align_prefix_suffix( struct matrix *m, const char * a, const
 	}
 
 	// Find the maximum of the last row and last column.
-	choose_best(m, &best_i, &best_j, min_align, width, min_align, height);
+	choose_best(matrix_reader, m, width, height, &best_i, &best_j, min_align, width, min_align, height);
 
 	// Start traceback from best position and go until we hit the top or left edge.
 	return alignment_traceback(m, best_i, best_j, a, b );
@@ -187,8 +562,6 @@ struct alignment * align_banded( struct matrix *m, const char *a, const char *b,
 		}
 	}
 
-	#define BRACKET( a, x, b ) MIN(MAX((a),(x)),(b))
-
 	// For each row, sweep out the valid range of columns.
 	for(j=1;j<=MIN(height,width-offset+k);j++) {
 
@@ -201,7 +574,7 @@ struct alignment * align_banded( struct matrix *m, const char *a, const char *b,
 	}
 
 	// Choose the best value on the valid ranges of the alignment.
-	choose_best(m, &best_i, &best_j,
+	choose_best(matrix_reader, m, width, height, &best_i, &best_j,
 			   BRACKET(0,height+offset-k,width),
 			   BRACKET(0,height+offset+k,width),
 			   BRACKET(0,width-offset-k,height),
@@ -211,7 +584,386 @@ struct alignment * align_banded( struct matrix *m, const char *a, const char *b,
 	return alignment_traceback(m, best_i, best_j, a, b );
 }
 
-static void choose_best(struct matrix *m, int * best_i, int * best_j, int istart, int iend, int jstart, int jend )
+/*
+Banded alignment with band storage. Each row j keeps only the columns
+offset+j-k-1 to offset+j+k+1: the band and the two diagonals that guard
+it. Columns 0 and 1 are kept for every row, as the full matrix also
+fills them when the band falls off the left edge. The cells, the best
+cell and the traceback are the same as those of align_banded.
+*/
+
+struct band {
+	int offset;
+	int k;
+	int stride;
+	struct cell *rows;
+	struct cell *columns;
+};
+
+static inline struct cell * band_cell( const struct band *band, int i, int j )
+{
+	if(i<=1) {
+		return &band->columns[2*j+i];
+	}
+
+	int x = i - (band->offset + j - band->k - 1);
+	if(x<0 || x>=band->stride) {
+		return 0;
+	}
+
+	return &band->rows[(size_t) j*band->stride + x];
+}
+
+static struct cell band_reader( const void *storage, int i, int j )
+{
+	struct cell *c = band_cell(storage, i, j);
+	if(c) {
+		return *c;
+	} else {
+		// Outside of the band, which is only the top border of the matrix.
+		struct cell border = { 0, TRACEBACK_LEFT };
+		return border;
+	}
+}
+
+struct alignment * align_banded_compact( struct align_workspace *w, const char *a, const char *b, int astart, int bstart, int k )
+{
+	int width = strlen(a);
+	int height = strlen(b);
+	int i,j;
+	int best_i = 0;
+	int best_j = 0;
+
+	struct band band;
+	band.offset = astart - bstart;
+	band.k = k;
+	band.stride = 2*k + 3;
+
+	int offset = band.offset;
+
+	size_t cells = (size_t) (height+1) * (band.stride + 2);
+	band.rows = align_workspace_buffer(w, cells*sizeof(struct cell), sizeof(struct cell));
+	band.columns = band.rows + (size_t) (height+1) * band.stride;
+	memset(band.rows, 0, cells*sizeof(struct cell));
+
+	// Zero out the top border.
+	for(i=MAX(0,offset-k-1);i<=MIN(width,offset+k+1);i++) {
+		band_cell(&band,i,0)->score = 0;
+		band_cell(&band,i,0)->traceback = TRACEBACK_LEFT;
+	}
+	band_cell(&band,1,0)->traceback = TRACEBACK_LEFT;
+
+	// Zero out the left border.
+	for(j=0;j<=height;j++) {
+		band_cell(&band,0,j)->score = 0;
+		band_cell(&band,0,j)->traceback = TRACEBACK_UP;
+	}
+
+	// Set the diagonals to a large small number so that the
+	// traceback never wanders off the band.
+	for(j=0;j<=height;j++) {
+		i = offset + k + j + 1;
+		if(i>=0 && i<=width) {
+			band_cell(&band,i,j)->score = SHRT_MIN + 100;
+			band_cell(&band,i,j)->traceback = TRACEBACK_LEFT;
+		}
+		i = offset - k + j - 1;
+		if(i>=0 && i<=width) {
+			band_cell(&band,i,j)->score = SHRT_MIN + 100;
+			band_cell(&band,i,j)->traceback = TRACEBACK_UP;
+		}
+	}
+
+	// For each row, sweep out the valid range of columns.
+	for(j=1;j<=MIN(height,width-offset+k);j++) {
+
+		int istart = BRACKET(1,offset+j-k,width);
+		int istop  = BRACKET(1,offset+j+k,width);
+
+		// Row j-1 starts one column before row j, so (i,j-1) is at x+1 in the previous row.
+		struct cell *cur  = band.rows + (size_t) j*band.stride;
+		struct cell *prev = cur - band.stride;
+		int lo = offset + j - k - 1;
+
+		for(i=istart;i<=istop;i++) {
+			if(i<=2) {
+				*band_cell(&band,i,j) = score_neighbors(
+						band_reader(&band,i-1,j-1).score,
+						band_reader(&band,i-1,j).score,
+						band_reader(&band,i,j-1).score,
+						a[i-1], b[j-1], 0);
+			} else {
+				int x = i - lo;
+				cur[x] = score_neighbors(prev[x].score, cur[x-1].score, prev[x+1].score, a[i-1], b[j-1], 0);
+			}
+		}
+	}
+
+	// Choose the best value on the valid ranges of the alignment.
+	choose_best(band_reader, &band, width, height, &best_i, &best_j,
+			   BRACKET(0,height+offset-k,width),
+			   BRACKET(0,height+offset+k,width),
+			   BRACKET(0,width-offset-k,height),
+			   BRACKET(0,width-offset+k,height) );
+
+	// Run the traceback back to the edges of the matrix.
+	struct alignment *aln = alignment_create(width, height);
+
+	int length = 0;
+	i = best_i;
+	j = best_j;
+	alignment_trace(aln, &length, band_reader, &band, &i, &j, 0, a, b);
+	alignment_finish(aln, length, i, j, best_i, best_j, band_reader(&band,best_i,best_j).score);
+
+	return aln;
+}
+
+/*
+Prefix-suffix alignment in linear space. A first pass keeps only one row
+of scores, and records the last column and the last row, where the best
+cell is found. The traceback then divides the rows above the best cell
+into LINEAR_FANOUT segments, saving the scores of the first row of each
+segment, and traces each segment from the bottom up, dividing it again
+until a segment fits in LINEAR_LEAF_CELLS cells. Only the columns left
+of the traceback are computed again. Memory is proportional to the
+length of a times the number of levels, and the cells and traceback are
+the same as those of align_prefix_suffix.
+*/
+
+#define LINEAR_LEAF_CELLS (1<<16)
+#define LINEAR_FANOUT 16
+
+struct linear_ps {
+	const char *a;
+	const char *b;
+	struct align_workspace *w;
+	struct alignment *aln;
+	int length;
+};
+
+struct linear_edges {
+	int width;
+	int height;
+	const short *last_row;
+	const short *last_column;
+	int corner;             // the score of (corner,corner), chosen when no score is positive.
+	int corner_score;
+};
+
+struct linear_block {
+	const struct cell *cells;
+	int stride;
+	int first_row;
+};
+
+static struct cell linear_edges_reader( const void *storage, int i, int j )
+{
+	const struct linear_edges *e = storage;
+	struct cell c = { 0, TRACEBACK_LEFT };
+
+	if(i==e->width) {
+		c.score = e->last_column[j];
+	} else if(j==e->height) {
+		c.score = e->last_row[i];
+	} else if(i==e->corner && j==e->corner) {
+		c.score = e->corner_score;
+	}
+
+	return c;
+}
+
+static struct cell linear_block_reader( const void *storage, int i, int j )
+{
+	const struct linear_block *b = storage;
+	return b->cells[(size_t) (j - b->first_row)*b->stride + i];
+}
+
+static inline void linear_next_row( const short *prev, short *cur, int n, const char *a, char cb )
+{
+	int i;
+	cur[0] = 0;
+	for(i=1;i<=n;i++) {
+		cur[i] = score_neighbors(prev[i-1], cur[i-1], prev[i], a[i-1], cb, 0).score;
+	}
+}
+
+static int linear_trace( struct linear_ps *ps, const short *first, int first_row, int *i, int *j );
+
+/*
+Trace the segments of step rows that start at first_row, from the
+bottom up. The first row of segment s>0 is saved at saved+(s-1)*stride.
+*/
+
+static int linear_trace_segments( struct linear_ps *ps, const short *first, int first_row, const short *saved, size_t stride, int step, int segments, int *i, int *j )
+{
+	int ended = 0;
+	int s;
+
+	for(s=segments-1;s>=0 && !ended;s--) {
+		int row = first_row + s*step;
+		if(*j > row) {
+			ended = linear_trace(ps, s ? saved + (s-1)*stride : first, row, i, j);
+		}
+	}
+
+	return ended;
+}
+
+/*
+Trace from cell (*i,*j) up to row first_row, given the scores of
+first_row. Returns true if the alignment reached the top or left edge.
+*/
+
+static int linear_trace( struct linear_ps *ps, const short *first, int first_row, int *i, int *j )
+{
+	int rows = *j - first_row;
+	int n = *i;
+
+	if((size_t) (rows+1)*(n+1) <= LINEAR_LEAF_CELLS || rows <= LINEAR_FANOUT) {
+		struct cell *cells = align_workspace_buffer(ps->w, (size_t) (rows+1)*(n+1)*sizeof(struct cell), sizeof(struct cell));
+		int r, x;
+
+		for(x=0;x<=n;x++) {
+			cells[x].score = first[x];
+			cells[x].traceback = TRACEBACK_LEFT;
+		}
+
+		for(r=1;r<=rows;r++) {
+			struct cell *prev = cells + (size_t) (r-1)*(n+1);
+			struct cell *cur  = cells + (size_t) r*(n+1);
+			char cb = ps->b[first_row+r-1];
+
+			cur[0].score = 0;
+			cur[0].traceback = TRACEBACK_UP;
+
+			for(x=1;x<=n;x++) {
+				cur[x] = score_neighbors(prev[x-1].score, cur[x-1].score, prev[x].score, ps->a[x-1], cb, 0);
+			}
+		}
+
+		struct linear_block block = { cells, n+1, first_row };
+
+		return alignment_trace(ps->aln, &ps->length, linear_block_reader, &block, i, j, first_row, ps->a, ps->b);
+	}
+
+	// Save the first row of each segment but the first, and two rows to compute the others.
+	int step = (rows + LINEAR_FANOUT - 1) / LINEAR_FANOUT;
+	int segments = (rows + step - 1) / step;
+
+	short *saved = malloc((size_t) (segments+1)*(n+1)*sizeof(short));
+	if(!saved) {
+		fprintf(stderr,"align: out of memory for the traceback.\n");
+		exit(1);
+	}
+
+	short *spare[2] = { saved + (size_t) (segments-1)*(n+1), saved + (size_t) segments*(n+1) };
+	const short *prev = first;
+	int r, t = 0;
+
+	for(r=1;r<=(segments-1)*step;r++) {
+		short *cur;
+		if(r%step == 0) {
+			cur = saved + (size_t) (r/step-1)*(n+1);
+		} else {
+			t ^= 1;
+			cur = spare[t];
+		}
+
+		linear_next_row(prev, cur, n, ps->a, ps->b[first_row+r-1]);
+		prev = cur;
+	}
+
+	int ended = linear_trace_segments(ps, first, first_row, saved, n+1, step, segments, i, j);
+
+	free(saved);
+
+	return ended;
+}
+
+struct alignment * align_prefix_suffix_linear( struct align_workspace *w, const char *a, const char *b, int min_align )
+{
+	int width = strlen(a);
+	int height = strlen(b);
+	int i,j;
+	int best_i = 0;
+	int best_j = 0;
+
+	min_align = MIN(min_align,MIN(width,height));
+
+	// The first pass also saves the first row of each segment of the traceback.
+	int step = (height + LINEAR_FANOUT - 1) / LINEAR_FANOUT;
+	int segments = step ? (height + step - 1) / step : 1;
+
+	short *rows = calloc((size_t) (segments+1)*(width+1), sizeof(short));
+	short *last_column = malloc((height+1)*sizeof(short));
+	if(!rows || !last_column) {
+		fprintf(stderr,"align: out of memory for the alignment.\n");
+		exit(1);
+	}
+
+	struct linear_edges edges;
+	edges.width = width;
+	edges.height = height;
+	edges.corner = min_align;
+	edges.corner_score = 0;
+
+	// Sweep the matrix keeping only the last row, and the saved rows.
+	short *saved = rows + 2*(width+1);
+	short *spare[2] = { rows, rows + width + 1 };
+	short *top = calloc(width+1, sizeof(short));
+	const short *prev = top;
+	int t = 0;
+
+	last_column[0] = 0;
+
+	for(j=1;j<=height;j++) {
+		short *cur;
+		if(j%step == 0 && j/step < segments) {
+			cur = saved + (size_t) (j/step-1)*(width+1);
+		} else {
+			t ^= 1;
+			cur = spare[t];
+		}
+
+		linear_next_row(prev, cur, width, a, b[j-1]);
+
+		last_column[j] = cur[width];
+		if(j==min_align) {
+			edges.corner_score = cur[min_align];
+		}
+
+		prev = cur;
+	}
+
+	edges.last_row = prev;
+	edges.last_column = last_column;
+
+	// Find the maximum of the last row and last column.
+	choose_best(linear_edges_reader, &edges, width, height, &best_i, &best_j, min_align, width, min_align, height);
+
+	int score = linear_edges_reader(&edges, best_i, best_j).score;
+
+	// Start traceback from best position and go until we hit the top or left edge.
+	struct linear_ps ps;
+	ps.a = a;
+	ps.b = b;
+	ps.w = w;
+	ps.aln = alignment_create(width, height);
+	ps.length = 0;
+
+	i = best_i;
+	j = best_j;
+	linear_trace_segments(&ps, top, 0, saved, width+1, step, segments, &i, &j);
+	alignment_finish(ps.aln, ps.length, i, j, best_i, best_j, score);
+
+	free(top);
+	free(rows);
+	free(last_column);
+
+	return ps.aln;
+}
+
+static void choose_best(cell_reader_t reader, const void *storage, int width, int height, int * best_i, int * best_j, int istart, int iend, int jstart, int jend )
 {
 	int i, j;
 	double best_score = 0;
@@ -227,9 +979,10 @@ static void choose_best(struct matrix *m, int * best_i, int * best_j, int istart
 
 	// Find the best in the last column
 	if(jstart!=jend) {
-		for (i=m->width, j=jstart; j <= jend; j++) {
-			if ( matrix(m,i,j).score > best_score) {
-					best_score =  matrix(m,i,j).score;
+		for (i=width, j=jstart; j <= jend; j++) {
+			int score = reader(storage,i,j).score;
+			if ( score > best_score) {
+					best_score =  score;
 					*best_i = i;
 					*best_j = j;
 			}
@@ -238,9 +991,10 @@ static void choose_best(struct matrix *m, int * best_i, int * best_j, int istart
 
 	// Find the best in the last row
 	if(istart!=iend) {
-		for (i=istart, j=m->height; i <= iend; i++) {
-			if ( matrix(m,i,j).score > best_score) {
-				best_score =  matrix(m,i,j).score;
+		for (i=istart, j=height; i <= iend; i++) {
+			int score = reader(storage,i,j).score;
+			if ( score > best_score) {
+				best_score =  score;
 				*best_i = i;
 				*best_j = j;
 			}
@@ -248,23 +1002,41 @@ static void choose_best(struct matrix *m, int * best_i, int * best_j, int istart
 	}
 }
 
-static struct alignment * alignment_traceback(struct matrix *m, int istart, int jstart, const char *a, const char *b )
+static struct alignment * alignment_create( int width, int height )
 {
 	struct alignment * aln = malloc(sizeof(*aln));
 	memset(aln,0,sizeof(*aln));
 
-	int max_traceback_length = m->width + m->height + 4;
+	int max_traceback_length = width + height + 4;
 	aln->traceback = malloc(max_traceback_length*sizeof(*aln->traceback));
 
-	int i = istart;
-	int j = jstart;
+	aln->length1 = width;
+	aln->length2 = height;
+
+	return aln;
+}
+
+/*
+Follow the traceback from cell (i,j) until reaching the top or left edge,
+or row jstop, appending to the reversed traceback of aln. Returns true
+if the alignment ended before row jstop.
+*/
+
+static int alignment_trace(struct alignment *aln, int *length, cell_reader_t reader, const void *storage, int *ip, int *jp, int jstop, const char *a, const char *b )
+{
+	int i = *ip;
+	int j = *jp;
 	int dir = 0;
-	int length = 0;
+	int ended = 0;
 
 	while ( (i>0) && (j>0) ) {
 
-		dir = matrix(m,i,j).traceback;
-		aln->traceback[length++] = dir;
+		if(j<=jstop) {
+			break;
+		}
+
+		dir = reader(storage,i,j).traceback;
+		aln->traceback[(*length)++] = dir;
 
 		if(dir==TRACEBACK_DIAG) {
 			if(a[i-1]!=b[j-1]) {
@@ -279,7 +1051,8 @@ static struct alignment * alignment_traceback(struct matrix *m, int istart, int
 			j--;
 			aln->gap_count++;
 		} else if(dir==TRACEBACK_END) {
-			length--;
+			(*length)--;
+			ended = 1;
 			break;
 		} else {
 			fprintf(stderr,"traceback corrupted at i=%d j=%d\n",i,j);
@@ -287,6 +1060,14 @@ static struct alignment * alignment_traceback(struct matrix *m, int istart, int
 		}
 	}
 
+	*ip = i;
+	*jp = j;
+
+	return ended || i<=0 || j<=0;
+}
+
+static void alignment_finish( struct alignment *aln, int length, int i, int j, int istart, int jstart, int score )
+{
 	aln->traceback[length] = 0;
 
 	// Reverse the traceback and resize the allocation as needed.
@@ -307,10 +1088,20 @@ static struct alignment * alignment_traceback(struct matrix *m, int istart, int
 	aln->start2 = j;
 	aln->end1 = istart-1;
 	aln->end2 = jstart-1;
-	aln->length1 = m->width;
-	aln->length2 = m->height;
-	aln->score = matrix(m,istart,jstart).score;
+	aln->score = score;
 	aln->quality = (double)(aln->gap_count + aln->mismatch_count) / MIN(aln->end1-aln->start1,aln->end2-aln->start2);
+}
+
+static struct alignment * alignment_traceback(struct matrix *m, int istart, int jstart, const char *a, const char *b )
+{
+	struct alignment * aln = alignment_create(m->width, m->height);
+
+	int i = istart;
+	int j = jstart;
+	int length = 0;
+
+	alignment_trace(aln, &length, matrix_reader, m, &i, &j, 0, a, b);
+	alignment_finish(aln, length, i, j, istart, jstart, matrix(m,istart,jstart).score);
 
 	return aln;
 }
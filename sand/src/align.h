@@ -26,10 +26,48 @@ struct alignment {
 	char ori;
 };
 
+/*
+A workspace holds the buffers used to align many pairs of sequences,
+so that they are not allocated again for each pair. A workspace must
+not be shared between threads.
+
+The score-only kernel is chosen when the workspace is created: avx2 or
+sse2 when the cpu supports them, scalar otherwise. Pass a kernel name
+to force one, or 0 to choose the fastest.
+*/
+
+struct align_workspace;
+
+struct align_workspace * align_workspace_create( const char *kernel );
+const char * align_workspace_kernel( struct align_workspace *w );
+void * align_workspace_buffer( struct align_workspace *w, size_t size, size_t alignment );
+struct matrix * align_workspace_matrix( struct align_workspace *w, int width, int height );
+void align_workspace_delete( struct align_workspace *w );
+
+/*
+Compute only the best Smith-Waterman score of a and b, without a traceback.
+align_smith_waterman_threshold returns the full alignment when the score
+is at least min_score, and 0 otherwise. The alignment is computed in the
+matrix of the workspace, which is valid until the next call.
+*/
+
+int align_smith_waterman_score( struct align_workspace *w, const char *a, const char *b );
+struct alignment * align_smith_waterman_threshold( struct align_workspace *w, const char *a, const char *b, int min_score );
+
 struct alignment * align_prefix_suffix( struct matrix *m, const char *a, const char *b, int min_align );
 struct alignment * align_smith_waterman( struct matrix *m, const char *a, const char *b );
 struct alignment * align_banded( struct matrix *m, const char *a, const char *b, int astart, int bstart, int k );
 
+/*
+Variants of align_prefix_suffix and align_banded that give the same
+alignments without a full matrix. align_prefix_suffix_linear keeps a
+few rows of scores, and computes parts of the matrix again for the
+traceback. align_banded_compact keeps only the cells of the band.
+*/
+
+struct alignment * align_prefix_suffix_linear( struct align_workspace *w, const char *a, const char *b, int min_align );
+struct alignment * align_banded_compact( struct align_workspace *w, const char *a, const char *b, int astart, int bstart, int k );
+
 void alignment_print( FILE * file, const char * str1, const char * str2, struct alignment *a );
 void alignment_delete( struct alignment *a );
 
@@ -23,6 +23,6 @@ struct matrix * matrix_create( int width, int height );
 void            matrix_delete( struct matrix *m );
 void            matrix_print( struct matrix *m, const char *a, const char *b );
 
-#define matrix(m,i,j) ( (m)->data[(m->width*(j) + i)] )
+#define matrix(m,i,j) ( (m)->data[((m)->width+1)*(j) + (i)] )
 
 #endif
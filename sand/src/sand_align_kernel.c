@@ -24,6 +24,8 @@ See the file COPYING for details.
 
 static int min_align = 0;
 static double min_qual = 1.0;
+static int min_score = 0;
+static const char *memory_layout = "linear";
 
 static const char *output_format = "ovl";
 static const char *align_type = "banded";
@@ -36,6 +38,9 @@ static void show_help(const char *cmd)
 	printf(" -o <format>    Output format: ovl, ovl_new, align, or matrix. (default: %s)\n",output_format);
 	printf(" -m <integer>	Minimum aligment length (default: %d).\n", min_align);
 	printf(" -q <integer>	Minimum match quality (default: %.2lf)\n",min_qual);
+	printf(" -s <integer>	Minimum Smith-Waterman score, checked before the traceback (sw only, default: %d).\n",min_score);
+	printf(" -k <kernel>	Smith-Waterman scoring kernel: avx2, sse2, or scalar. (default: fastest available)\n");
+	printf(" -M <layout>	Memory for ps and banded alignments: full (matrix) or linear. (default: %s)\n",memory_layout);
 	printf(" -x         	Delete input file after completion.\n");
 	printf(" -d <flag>	Enable debugging for this subsystem.\n");
 	printf(" -v         	Show program version.\n");
@@ -50,8 +55,9 @@ int main(int argc, char ** argv)
 	signed char c;
 	int fileindex;
 	int del_input=0;
+	const char *kernel = 0;
 
-	while((c = getopt(argc, argv, "a:o:k:m:q:xd:vh")) > -1) {
+	while((c = getopt(argc, argv, "a:o:k:m:M:q:s:xd:vh")) > -1) {
 		switch (c) {
 		case 'a':
 			align_type = optarg;
@@ -65,6 +71,15 @@ int main(int argc, char ** argv)
 		case 'q':
 			min_qual = atof(optarg);
 			break;
+		case 's':
+			min_score = atoi(optarg);
+			break;
+		case 'k':
+			kernel = optarg;
+			break;
+		case 'M':
+			memory_layout = optarg;
+			break;
 		case 'x':
 			del_input = 1;
 			break;
@@ -96,6 +111,17 @@ int main(int argc, char ** argv)
 		input = stdin;
 	}
 
+	if(strcmp(memory_layout,"full") && strcmp(memory_layout,"linear")) {
+		fprintf(stderr,"sand_align_kernel: unknown memory layout: %s\n",memory_layout);
+		exit(1);
+	}
+
+	// The matrix output needs the whole matrix.
+	int full_matrix = !strcmp(memory_layout,"full") || !strcmp(output_format,"matrix");
+
+	struct align_workspace *workspace = align_workspace_create(kernel);
+	debug(D_DEBUG,"using %s smith-waterman kernel",align_workspace_kernel(workspace));
+
 	struct cseq *c1, *c2;
 
 	if(!strcmp(output_format,"ovl") || !strcmp(output_format, "ovl_new")) {
@@ -139,21 +165,28 @@ int main(int argc, char ** argv)
 			ori = 'N';
 		}
 
-		struct matrix *m = matrix_create(s1->num_bases,s2->num_bases);
-		if(!m) {
-			fprintf(stderr,"sand_align_kernel: out of memory when creating alignment matrix.\n");
-			exit(1);
+		struct matrix *m = 0;
+		if(full_matrix) {
+			m = align_workspace_matrix(workspace,s1->num_bases,s2->num_bases);
 		}
 
 		struct alignment *aln;
 
 		if(!strcmp(align_type,"sw")) {
 
-			aln = align_smith_waterman(m,s1->data,s2->data);
+			aln = align_smith_waterman_threshold(workspace,s1->data,s2->data,min_score);
+			if(!aln) {
+				seq_free(s2);
+				continue;
+			}
 
 		} else if(!strcmp(align_type,"ps")) {
 
-			aln = align_prefix_suffix(m,s1->data,s2->data, min_align);
+			if(full_matrix) {
+				aln = align_prefix_suffix(m,s1->data,s2->data, min_align);
+			} else {
+				aln = align_prefix_suffix_linear(workspace,s1->data,s2->data, min_align);
+			}
 
 		} else if(!strcmp(align_type,"banded")) {
 			if(metadata_valid<3) {
@@ -166,7 +199,11 @@ int main(int argc, char ** argv)
 			int k = 2 + min_qual * MIN(s1->num_bases,s2->num_bases) / 2.0;
 			if(k<5) k = 5;
 
-			aln = align_banded(m,s1->data, s2->data, start1, start2, k);
+			if(full_matrix) {
+				aln = align_banded(m,s1->data, s2->data, start1, start2, k);
+			} else {
+				aln = align_banded_compact(workspace,s1->data, s2->data, start1, start2, k);
+			}
 		} else {
 			fprintf(stderr,"unknown alignment type: %s\n",align_type);
 			exit(1);
@@ -191,7 +228,6 @@ int main(int argc, char ** argv)
 			}
 		}
 
-		matrix_delete(m);
 		seq_free(s2);
 		alignment_delete(aln);
 	  }
@@ -199,6 +235,7 @@ int main(int argc, char ** argv)
 	}
 
 	fclose(input);
+	align_workspace_delete(workspace);
 
 	if(!strcmp(output_format,"ovl") || !strcmp(output_format, "ovl_new")) {
 		overlap_write_end(stdout);
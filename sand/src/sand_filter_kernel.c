@@ -15,6 +15,7 @@ See the file COPYING for details.
 
 #include "cctools.h"
 #include "host_memory_info.h"
+#include "load_average.h"
 #include "debug.h"
 #include "macros.h"
 
@@ -24,6 +25,7 @@ static char *progname = "sand_filter_kernel";
 static int num_seqs;
 static int kmer_size = 22;
 static int window_size = 22;
+static int num_threads = 0;
 static unsigned long max_mem_kb = ULONG_MAX;
 
 static char *repeat_filename = 0;
@@ -57,6 +59,7 @@ static void show_help(const char *cmd)
 	printf(" -r <file>      A meryl file of repeat mers to be filtered out.\n");
 	printf(" -k <number>    The k-mer size to use in candidate selection (default is 22).\n");
 	printf(" -w <number>    The minimizer window size to use in candidate selection (default is 22).\n");
+	printf(" -t <number>    Number of threads to find minimizers with (default is the number of cores).\n");
 	printf(" -o <filename>  The output file. Default is stdout.\n");
 	printf("                output file to indicate it has ended (default is nothing)\n");
 	printf(" -d <subsys>    Enable debug messages for this subsystem.  Try 'd -all' to start .\n");
@@ -68,7 +71,7 @@ static void get_options(int argc, char **argv, const char *progname)
 {
 	signed char c;
 
-	while((c = getopt(argc, argv, "d:r:s:k:w:f:o:vh")) > -1) {
+	while((c = getopt(argc, argv, "d:r:s:k:w:f:o:t:vh")) > -1) {
 		switch (c) {
 		case 'r':
 			repeat_filename = optarg;
@@ -92,6 +95,9 @@ static void get_options(int argc, char **argv, const char *progname)
 		case 'w':
 			window_size = atoi(optarg);
 			break;
+		case 't':
+			num_threads = atoi(optarg);
+			break;
 		case 'o':
 			output_filename = optarg;
 			break;
@@ -159,6 +165,7 @@ int main(int argc, char **argv)
 
 	set_k(kmer_size);
 	set_window_size(window_size);
+	set_num_threads(num_threads > 0 ? num_threads : load_average_get_cpus());
 
 	// If we only give one file, do an all vs. all
 	// on them.
@@ -10,9 +10,12 @@ See the file COPYING for details.
 #include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "sequence_filter.h"
 #include "itable.h"
+#include "debug.h"
 
 #define EVEN_MASK 0xCCCCCCCCCCCCCCCCULL
 #define ODD_MASK  0x3333333333333333ULL
@@ -35,36 +38,39 @@ static mer_t repeat_mask = 0;
 
 #define MER_VALUE(mer) ( (mer & (EVEN_MASK & k_mask)) | ((~mer) & (ODD_MASK & k_mask)) )
 
-struct mer_list_elem_s
+// The mer table is a flat array of minimizer occurrences, in the order
+// the sequences are loaded.  To generate candidates, the occurrences are
+// radix sorted by mer, and each run of the same mer gives the sequences
+// that share it.
+
+struct mer_occurrence_s
 {
+	mer_t mer;
 	int seq_num;
 	short loc;
 	char dir;
-	struct mer_list_elem_s * next;
 };
+typedef struct mer_occurrence_s mer_occurrence;
 
-typedef struct mer_list_elem_s mer_list_element;
-
-struct mer_hash_element_s
+struct mer_buffer_s
 {
-	mer_t mer;
-	mer_list_element * mle;
-	unsigned char count;
-	struct mer_hash_element_s * next;
+	mer_occurrence * data;
+	size_t count;
+	size_t size;
 };
-typedef struct mer_hash_element_s mer_hash_element;
+typedef struct mer_buffer_s mer_buffer;
 
-struct cand_list_element_s
+// Radix sort items: key, and the position of what is sorted.
+struct sort_item_s
 {
-	int cand1;
-	int cand2;
-	char dir;
-	int count;
-	short loc1;
-	short loc2;
-	struct cand_list_element_s * next;
+	UINT64_T key;
+	UINT32_T value;
+	UINT32_T length;
 };
-typedef struct cand_list_element_s cand_list_element;
+typedef struct sort_item_s sort_item;
+
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
 
 /* These are globals referenced directly by sand_filter_mer_seq. */
 /* This needs to be cleaned up. */
@@ -77,10 +83,19 @@ unsigned long total_cand = 0;
 static int MER_TABLE_BUCKETS = 5000011; //20000003;
 static int CAND_TABLE_BUCKETS= 5000011; //20000003;
 static struct cseq ** all_seqs = 0;
-static cand_list_element ** candidates;
-static mer_hash_element ** mer_table;
 static struct itable * repeat_mer_table = 0;
 static int num_seqs = 0;
+static int num_threads = 1;
+
+static mer_buffer mer_table = { 0, 0, 0 };
+
+// Candidates in the order they were found, indexed by an open
+// addressing table of positions in candidates plus one.
+static candidate_t * candidates = 0;
+static size_t cand_count = 0;
+static size_t cand_size = 0;
+static UINT32_T * cand_slots = 0;
+static size_t cand_slot_count = 0;
 
 static int start_x = 0;
 static int end_x = 0;
@@ -90,52 +105,40 @@ static int same_rect;
 
 #define in_range(x, s, e) (  ((s) <= (x)) && ((x) < (e))   )
 
-void add_sequence_to_mer(mer_t mer, int i, char dir, short loc);
-mer_hash_element * find_mer(mer_t mer);
-void free_mer_table();
-void free_mer_hash_element(mer_hash_element * mhe);
+void add_sequence_to_mer(mer_buffer * b, mer_t mer, int i, char dir, short loc);
 void free_mer_table();
 void free_cand_table();
-mer_list_element * create_mer_list_element(int seq_num, char dir, short loc);
-mer_hash_element * get_mer_hash_element(mer_t mer);
-void free_mer_list_element(mer_list_element * mle);
-void mer_generate_cands(mer_hash_element * mhe);
+sort_item * sort_mer_runs(size_t * total_runs, sort_item ** occurrences);
+int load_mer_run(sort_item * occurrences, sort_item * run, mer_occurrence * list);
 void print_8mer(unsigned short mer);
 void set_k_mask();
 mer_t make_mer(const char * str);
 
 void add_candidate(int seq, int cand, char dir, mer_t mer, short loc1, short loc2);
-void free_cand_list_element(cand_list_element * cle);
 
-void find_all_kmers(int seq_num);
-void find_minimizers(int seq_num);
+void find_all_kmers(mer_buffer * b, int seq_num);
+void find_minimizers(mer_buffer * b, int seq_num);
 minimizer get_minimizer(int seq_num, int window_start);
 mer_t get_kmer(struct cseq *c, int i);
 void print_16mer(mer_t mer16);
 mer_t rev_comp_mer(mer_t mer);
 
-void print_mhe(FILE * file, mer_hash_element * mhe);
-
+// The number of buckets is kept only as a hint of the number of candidates.
 void init_cand_table( int buckets )
 {
-	int i;
 	CAND_TABLE_BUCKETS = buckets;
-	candidates = malloc(CAND_TABLE_BUCKETS * sizeof(cand_list_element *));
-	for (i=0; i < CAND_TABLE_BUCKETS; i++)
-	{
-		candidates[i] = 0;
-	}
 }
 
+// Mers are visited bucket by bucket, as the chained table used to do,
+// so that the location of each candidate comes from the same mer.
 void init_mer_table( int buckets )
 {
-	int i;
 	MER_TABLE_BUCKETS = buckets;
-	mer_table = malloc(MER_TABLE_BUCKETS * sizeof(mer_hash_element *));
-	for (i=0; i < MER_TABLE_BUCKETS; i++)
-	{
-		mer_table[i] = 0;
-	}
+}
+
+void set_num_threads(int n)
+{
+	num_threads = n > 0 ? n : 1;
 }
 
 int load_seqs(FILE * input )
@@ -276,118 +279,189 @@ int output_candidate_list( FILE * file, candidate_t * list, int total_output )
 	return total_printed;
 }
 
-candidate_t * retrieve_candidates(int * total_cand_ret)
+// Stable LSD radix sort by key.
+static void radix_sort(sort_item * items, size_t n)
 {
-	int curr_index;
-	int total_output = 0;
+	size_t count[RADIX_BUCKETS];
+	UINT64_T all = 0;
+	size_t i;
+	int shift;
 
-	cand_list_element * cle;
+	for (i=0; i<n; i++) all |= items[i].key;
 
-	candidate_t * candidate_list = malloc(total_cand*sizeof(struct candidate_s));
+	sort_item * scratch = malloc(n*sizeof(sort_item));
+	sort_item * from = items;
+	sort_item * to = scratch;
 
-	for (curr_index = 0; curr_index < CAND_TABLE_BUCKETS; curr_index++)
+	for (shift = 0; shift < 64 && (all >> shift); shift += RADIX_BITS)
 	{
-		cle = candidates[curr_index];
-		while (cle)
+		memset(count, 0, sizeof(count));
+		for (i=0; i<n; i++) count[(from[i].key >> shift) & (RADIX_BUCKETS-1)]++;
+
+		size_t offset = 0;
+		int d;
+		for (d=0; d<RADIX_BUCKETS; d++)
 		{
-			if (cle->count >= 1)
-			{
-				candidate_list[total_output].cand1 = cle->cand1;
-				candidate_list[total_output].cand2 = cle->cand2;
-				candidate_list[total_output].dir = cle->dir;
-				candidate_list[total_output].loc1 = cle->loc1;
-				candidate_list[total_output].loc2 = cle->loc2;
-				total_output++;
-			}
-			cle = cle->next;
+			size_t c = count[d];
+			count[d] = offset;
+			offset += c;
 		}
-		free_cand_list_element(candidates[curr_index]);
-		candidates[curr_index] = 0;
-	}
 
-	*total_cand_ret = total_output;
-	qsort(candidate_list, total_output, sizeof(struct candidate_s), compare_cand);
-	return candidate_list;
+		for (i=0; i<n; i++) to[count[(from[i].key >> shift) & (RADIX_BUCKETS-1)]++] = from[i];
+
+		sort_item * t = from;
+		from = to;
+		to = t;
+	}
 
+	if (from != items) memcpy(items, from, n*sizeof(sort_item));
+	free(scratch);
 }
 
-void generate_candidates()
+candidate_t * retrieve_candidates(int * total_cand_ret)
 {
-	int curr_bucket;
+	size_t i;
+	candidate_t * candidate_list = malloc((cand_count ? cand_count : 1)*sizeof(struct candidate_s));
 
-	mer_hash_element * mhe, *old_mhe;
+	// Sort by pair, the pairs found last first, so a pair found in both
+	// directions is listed as it was from the chained table.
+	sort_item * order = malloc((cand_count ? cand_count : 1)*sizeof(sort_item));
+	for (i=0; i<cand_count; i++)
+	{
+		candidate_t * c = &candidates[cand_count - i - 1];
+		order[i].key = ((UINT64_T) c->cand1 << 32) | c->cand2;
+		order[i].value = cand_count - i - 1;
+	}
+	radix_sort(order, cand_count);
 
-	for(curr_bucket = 0; curr_bucket < MER_TABLE_BUCKETS; curr_bucket++)
+	for (i=0; i<cand_count; i++)
 	{
-		mhe = mer_table[curr_bucket];
-		while (mhe)
-		{
-			mer_generate_cands(mhe);
-			old_mhe = mhe;
-			mhe = mhe->next;
-			free(old_mhe);
-		}
-		mer_table[curr_bucket] = 0;
+		candidate_list[i] = candidates[order[i].value];
 	}
+	free(order);
+
+	*total_cand_ret = cand_count;
+	free_cand_table();
+	return candidate_list;
+
 }
 
-void mer_generate_cands(mer_hash_element * mhe)
+// Sort the occurrences by mer, the latest first within a mer, and return
+// the runs of each mer shared by more than one occurrence, in the order to
+// visit them.  The value of a run is its start in occurrences.
+sort_item * sort_mer_runs(size_t * total_runs, sort_item ** occurrences)
 {
-	if (!mhe) return;
+	size_t n = mer_table.count;
+	size_t i, j;
 
-	mer_list_element *head, *curr;
+	sort_item * occ = malloc((n ? n : 1)*sizeof(sort_item));
+	for (i=0; i<n; i++)
+	{
+		occ[i].key = mer_table.data[n - i - 1].mer;
+		occ[i].value = n - i - 1;
+	}
+	radix_sort(occ, n);
 
-	head = mhe->mle;
+	size_t nruns = 0;
+	sort_item * runs = malloc((n/2 + 1)*sizeof(sort_item));
+	for (i=0; i<n; i=j)
+	{
+		for (j=i+1; j<n && occ[j].key == occ[i].key; j++) { }
+		if (j - i < 2) continue;
+
+		// The chained table kept the mers of a bucket newest first.
+		UINT32_T first = occ[j-1].value;
+		runs[nruns].key = ((occ[i].key % MER_TABLE_BUCKETS) << 32) | (0xffffffff - first);
+		runs[nruns].value = i;
+		runs[nruns].length = j - i;
+		nruns++;
+	}
+	radix_sort(runs, nruns);
+
+	*total_runs = nruns;
+	*occurrences = occ;
+	return runs;
+}
+
+// Copy the occurrences of a run to list, keeping only the first occurrence
+// of each sequence.  Since the occurrences of a sequence are consecutive
+// and sorted latest first, that is the last of each group.
+int load_mer_run(sort_item * occ, sort_item * run, mer_occurrence * list)
+{
+	UINT32_T i;
+	int n = 0;
 
-	while (head)
+	for (i=0; i<run->length; i++)
 	{
-		curr = head->next;
-		while (curr)
-		{
-			add_candidate(head->seq_num, curr->seq_num, head->dir * curr->dir, mhe->mer, head->loc, curr->loc);
-			curr = curr->next;
-		}
-		head = head->next;
+		mer_occurrence * o = &mer_table.data[occ[run->value + i].value];
+		if (i+1 < run->length && mer_table.data[occ[run->value + i + 1].value].seq_num == o->seq_num) continue;
+		list[n++] = *o;
 	}
 
-	free_mer_list_element(mhe->mle);
-	mhe->mle = 0;
+	return n;
 }
 
-void print_mer_table(FILE * file)
+void generate_candidates()
 {
-	int curr_bucket;
-	mer_hash_element * mhe;
-	for (curr_bucket = 0; curr_bucket < MER_TABLE_BUCKETS; curr_bucket++)
+	size_t nruns, r;
+	sort_item * occ;
+	sort_item * runs = sort_mer_runs(&nruns, &occ);
+
+	size_t list_size = 0;
+	mer_occurrence * list = 0;
+
+	for (r=0; r<nruns; r++)
 	{
-		mhe = mer_table[curr_bucket];
-		while (mhe)
+		if (runs[r].length > list_size)
+		{
+			list_size = runs[r].length;
+			list = realloc(list, list_size*sizeof(mer_occurrence));
+		}
+
+		int n = load_mer_run(occ, &runs[r], list);
+		int head, curr;
+
+		for (head=0; head<n; head++)
 		{
-			print_mhe(file, mhe);
-			mhe = mhe->next;
+			for (curr=head+1; curr<n; curr++)
+			{
+				add_candidate(list[head].seq_num, list[curr].seq_num, list[head].dir * list[curr].dir, list[head].mer, list[head].loc, list[curr].loc);
+			}
 		}
 	}
+
+	free(list);
+	free(runs);
+	free(occ);
+	free_mer_table();
 }
 
-void print_mhe(FILE * file, mer_hash_element * mhe)
+void print_mer_table(FILE * file)
 {
-	if (!mhe) return;
-
-	mer_list_element *head, *curr;
-	head = mhe->mle;
+	size_t nruns, r;
+	sort_item * occ;
+	sort_item * runs = sort_mer_runs(&nruns, &occ);
 	char mer_str[k+1];
 
-	while(head)
+	for (r=0; r<nruns; r++)
 	{
-		curr = head->next;
-		while (curr)
+		mer_occurrence * list = malloc(runs[r].length*sizeof(mer_occurrence));
+		int n = load_mer_run(occ, &runs[r], list);
+		int head, curr;
+
+		translate_kmer(list[0].mer, mer_str, k);
+		for (head=0; head<n; head++)
 		{
-			translate_kmer(mhe->mer, mer_str, k);
-			fprintf(file, "%s\t%d\t%s\t%s\t%d\n", mer_str, mhe->count, all_seqs[head->seq_num]->name, all_seqs[curr->seq_num]->name, (int) (head->dir * curr->dir));
-			curr = curr->next;
+			for (curr=head+1; curr<n; curr++)
+			{
+				fprintf(file, "%s\t%d\t%s\t%s\t%d\n", mer_str, n, all_seqs[list[head].seq_num]->name, all_seqs[list[curr].seq_num]->name, (int) (list[head].dir * list[curr].dir));
+			}
 		}
-		head = head->next;
+		free(list);
 	}
+
+	free(runs);
+	free(occ);
 }
 
 mer_t rev_comp_mer(mer_t mer)
@@ -407,7 +481,7 @@ mer_t rev_comp_mer(mer_t mer)
 }
 
 
-void find_all_kmers(int seq_num)
+void find_all_kmers(mer_buffer * b, int seq_num)
 {
 	mer_t mer16;
 	int i;
@@ -416,7 +490,7 @@ void find_all_kmers(int seq_num)
 	for (i = 0; i<end; i+=8)
 	{
 		mer16 = get_kmer(all_seqs[seq_num], i);
-		add_sequence_to_mer(mer16, seq_num, (char) 1, (short) i);
+		add_sequence_to_mer(b, mer16, seq_num, (char) 1, (short) i);
 	}
 }
 
@@ -426,7 +500,7 @@ void find_all_kmers(int seq_num)
 //    If so, set it as the new one.
 // 2. Is the current absolute minimizer now outside the window?
 //    If so, check the window to find a NEW absolute minimizer, and add it.
-void find_minimizers(int seq_num)
+void find_minimizers(mer_buffer * b, int seq_num)
 {
 	int i;
 	int end = all_seqs[seq_num]->num_bases - k + 1;
@@ -472,7 +546,7 @@ void find_minimizers(int seq_num)
 	}
 
 	// Add the absolute minimizer for the first window.
-	add_sequence_to_mer(abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
+	add_sequence_to_mer(b, abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
 
 	for (i = WINDOW_SIZE; i < end; i++)
 	{
@@ -507,7 +581,7 @@ void find_minimizers(int seq_num)
 			// If so, set it as the new absolute minimizer and add this sequence to the mer table
 			abs_min = window[index];
 			abs_min_index = index;
-			add_sequence_to_mer(abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
+			add_sequence_to_mer(b, abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
 		}
 		// Now, check if the current absolute minimizer is out of the window
 		// We just replaced index, so if abs_min_index == index, we just evicted
@@ -528,7 +602,7 @@ void find_minimizers(int seq_num)
 				}
 			}
 			// Add the new current minimizer to the mer table.
-			add_sequence_to_mer(abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
+			add_sequence_to_mer(b, abs_min.mer, seq_num, abs_min.dir, abs_min.loc);
 		}
 	}
 }
@@ -759,129 +833,34 @@ void translate_kmer(mer_t mer, char * str, int length)
 }
 
 
-void add_sequence_to_mer(mer_t mer, int seq_num, char dir, short loc)
+void add_sequence_to_mer(mer_buffer * b, mer_t mer, int seq_num, char dir, short loc)
 {
 	// Store the sequence and its reverse complement as the same key.
 
 	if (repeat_mer_table && itable_lookup(repeat_mer_table, mer)) return;
 
-	mer_list_element * mle, * new_mle;
-
-	// This will create it if it doesn't exist.
-	mer_hash_element * mhe = get_mer_hash_element(mer);
-
-	// Check that the list exists.
-	if (!mhe->mle)
-	{
-		// If not, create it, increment the count and we're done.
-		new_mle = create_mer_list_element(seq_num, dir, loc);
-		mhe->mle = new_mle;
-		mhe->count++;
-		return;
-	}
-
-	// If a list does exist, add this sequence it.
-
-	mle = mhe->mle;
-
-	// Because we add one sequence at a time, this will be at the front
-	// if it has ever had this mer before, so we don't add it twice.
-	if (mle->seq_num == seq_num) return;
-
-	new_mle = create_mer_list_element(seq_num, dir, loc);
-	new_mle->next = mle;
-	mhe->mle = new_mle;
-	mhe->count++;
-
-}
-
-mer_list_element * create_mer_list_element(int seq_num, char dir, short loc)
-{
-	mer_list_element * new_mle = malloc(sizeof(*new_mle));
-	new_mle->seq_num = seq_num;
-	new_mle->dir = dir;
-	new_mle->loc = loc;
-	new_mle->next = 0;
-
-	return new_mle;
-}
-
-mer_hash_element * get_mer_hash_element(mer_t mer)
-{
-	int bucket = mer % MER_TABLE_BUCKETS;
-	mer_hash_element * mhe;
-
-	// If there are no hash elements in this bucket
-	// Add a new one.
-	if (!mer_table[bucket])
-	{
-		mhe = malloc(sizeof(*mhe));
-		mhe->mer = mer;
-		mhe->count = 0;
-		mhe->mle = 0;
-		mhe->next = 0;
-		mer_table[bucket] = mhe;
-		return mhe;
-	}
-
-	mhe = find_mer(mer);
-
-	// If this bucket is not empty, but does not contain this mer, add it.
-	if (!mhe) {
-		mer_hash_element * new_mhe = malloc(sizeof(*new_mhe));
-		new_mhe->mer = mer;
-		new_mhe->count = 0;
-		new_mhe->mle = 0;
-		new_mhe->next = mer_table[bucket];
-		mer_table[bucket] = new_mhe;
-		return new_mhe;
-	} else {
-		return mhe;
-	}
-}
-
-mer_hash_element * find_mer(mer_t mer)
-{
-	int bucket = mer % MER_TABLE_BUCKETS;
-
-	mer_hash_element * mhe = mer_table[bucket];
-
-	while (mhe)
+	// If this sequence had this mer before, it is dropped when the
+	// candidates are generated.
+	if (b->count == b->size)
 	{
-		if (mhe->mer == mer) { return mhe; }
-		mhe = mhe->next;
+		b->size = b->size ? b->size*2 : 1024;
+		b->data = realloc(b->data, b->size*sizeof(mer_occurrence));
+		if (!b->data) fatal("could not allocate %lu mer occurrences", (unsigned long) b->size);
 	}
 
-	return 0;
+	mer_occurrence * o = &b->data[b->count++];
+	o->mer = mer;
+	o->seq_num = seq_num;
+	o->loc = loc;
+	o->dir = dir;
 }
 
 void free_mer_table()
 {
-	int curr_mhe = 0;
-
-	for (; curr_mhe < MER_TABLE_BUCKETS; curr_mhe++)
-	{
-		free_mer_hash_element(mer_table[curr_mhe]);
-	}
-}
-
-void free_mer_hash_element(mer_hash_element * mhe)
-{
-	if (!mhe) return;
-
-	free_mer_list_element(mhe->mle);
-	mer_hash_element * n = mhe->next;
-	free(mhe);
-	free_mer_hash_element(n);
-}
-
-void free_mer_list_element(mer_list_element * mle)
-{
-	if (!mle) return;
-
-	mer_list_element * n = mle->next;
-	free(mle);
-	free_mer_list_element(n);
+	free(mer_table.data);
+	mer_table.data = 0;
+	mer_table.count = 0;
+	mer_table.size = 0;
 }
 
 void set_k(int new_k)
@@ -922,6 +901,30 @@ void load_mer_table()
 	load_mer_table_subset(curr_col, end_col, curr_row, end_row, (curr_rect_x == curr_rect_y));
 }
 
+struct load_range
+{
+	int count_x;
+	int count;
+	int start;
+	int end;
+	mer_buffer buffer;
+};
+
+// Sequences are numbered in the order they are loaded: the columns, then the rows.
+static void * load_range_mers(void * arg)
+{
+	struct load_range * r = arg;
+	int i;
+
+	for (i = r->start; i < r->end; i++)
+	{
+		int seq_num = (i < r->count_x) ? start_x + i : start_y + i - r->count_x;
+		find_minimizers(&r->buffer, seq_num);
+	}
+
+	return 0;
+}
+
 void load_mer_table_subset(int curr_col, int end_col, int curr_row, int end_row, int is_same_rect)
 {
 
@@ -940,43 +943,81 @@ void load_mer_table_subset(int curr_col, int end_col, int curr_row, int end_row,
 	// This is an imaginary matrix, but we're loading all the sequences
 	// on a given rectangle, defined by curr_rect_x, curr_rect_y and rectangle_size.
 	// Load the mers in each of these sequences, then we'll output any matches.
+	// If we are on the diagonal, don't need to add both, because they are the same.
+
+	struct load_range range;
+	range.count_x = end_col - curr_col;
+	range.count = range.count_x + (is_same_rect ? 0 : end_row - curr_row);
 
-	for ( ;	curr_col < end_col; curr_col++ )
+	int nthreads = num_threads;
+	if (nthreads > range.count) nthreads = range.count;
+	if (nthreads < 1) nthreads = 1;
+
+	struct load_range ranges[nthreads];
+	pthread_t threads[nthreads];
+	int i;
+
+	// Each thread loads a consecutive range of sequences, so that joining
+	// the buffers in order keeps the order in which the sequences are loaded.
+	for (i=0; i<nthreads; i++)
 	{
-		find_minimizers(curr_col);
-	}
+		ranges[i] = range;
+		ranges[i].start = (long) range.count * i / nthreads;
+		ranges[i].end = (long) range.count * (i+1) / nthreads;
+		memset(&ranges[i].buffer, 0, sizeof(mer_buffer));
 
-	// If we are on the diagonal, don't need to add both, because they are the same.
-	if (is_same_rect) { return; }
+		if (nthreads == 1)
+		{
+			load_range_mers(&ranges[i]);
+		}
+		else
+		{
+			int err = pthread_create(&threads[i], 0, load_range_mers, &ranges[i]);
+			if (err) fatal("could not create thread: %s", strerror(err));
+		}
+	}
 
-	for ( ;	curr_row < end_row; curr_row++ )
+	for (i=0; i<nthreads; i++)
 	{
-		find_minimizers(curr_row);
+		if (nthreads > 1) pthread_join(threads[i], 0);
+
+		mer_buffer * b = &ranges[i].buffer;
+		if (mer_table.count + b->count > mer_table.size)
+		{
+			mer_table.size = mer_table.count + b->count;
+			mer_table.data = realloc(mer_table.data, mer_table.size*sizeof(mer_occurrence));
+			if (!mer_table.data) fatal("could not allocate %lu mer occurrences", (unsigned long) mer_table.size);
+		}
+		memcpy(&mer_table.data[mer_table.count], b->data, b->count*sizeof(mer_occurrence));
+		mer_table.count += b->count;
+		free(b->data);
 	}
 }
 
-cand_list_element * create_new_cle(int seq1, int seq2, int dir, int loc1, int loc2)
+static UINT32_T cand_hash(unsigned int cand1, unsigned int cand2, char dir)
 {
-	cand_list_element * new_cle = malloc(sizeof(*new_cle));
-	if (seq1 < seq2)
-	{
-		new_cle->cand1 = seq1;
-		new_cle->cand2 = seq2;
-		new_cle->loc1 = loc1;
-		new_cle->loc2 = loc2;
-	}
-	else
+	UINT64_T key = (((UINT64_T) cand1 << 32) | cand2) ^ (dir < 0 ? 0x5555555555555555ULL : 0);
+	return (key * 0x9e3779b97f4a7c15ULL) >> 32;
+}
+
+static void cand_table_grow()
+{
+	size_t i;
+
+	cand_slot_count = cand_slot_count ? cand_slot_count*2 : 1024;
+	while (cand_slot_count < (size_t) CAND_TABLE_BUCKETS) cand_slot_count *= 2;
+
+	free(cand_slots);
+	cand_slots = calloc(cand_slot_count, sizeof(UINT32_T));
+	if (!cand_slots) fatal("could not allocate %lu candidate slots", (unsigned long) cand_slot_count);
+
+	for (i=0; i<cand_count; i++)
 	{
-		new_cle->cand2 = seq1;
-		new_cle->cand1 = seq2;
-		new_cle->loc2 = loc1;
-		new_cle->loc1 = loc2;
+		candidate_t * c = &candidates[i];
+		size_t slot = cand_hash(c->cand1, c->cand2, c->dir) & (cand_slot_count-1);
+		while (cand_slots[slot]) slot = (slot+1) & (cand_slot_count-1);
+		cand_slots[slot] = i+1;
 	}
-	new_cle->dir = dir;
-	new_cle->next = 0;
-	new_cle->count = 1;
-
-	return new_cle;
 }
 
 int should_compare_cands(int c1, int c2)
@@ -1001,64 +1042,51 @@ void add_candidate(int seq, int cand, char dir, mer_t min, short loc1, short loc
 
 	if (!should_compare_cands(seq, cand)) return;
 
-	int index = (seq*cand*499);
-	if (index < 0) { index *= -1; }
-	index = index % CAND_TABLE_BUCKETS;
-
-	cand_list_element * cle = candidates[index];
-	// There are no candidate pairs in this bucket
-	if (!cle)
+	// Keep the pair in order, with the locations of the first mer that found it.
+	if (seq > cand)
 	{
-		candidates[index] = create_new_cle(seq, cand, dir, loc1, loc2);
+		int t = seq; seq = cand; cand = t;
+		short l = loc1; loc1 = loc2; loc2 = l;
+	}
 
-		total_cand++;
-		return;
+	if (2*(cand_count+1) > cand_slot_count) cand_table_grow();
+
+	size_t slot = cand_hash(seq, cand, dir) & (cand_slot_count-1);
+	while (cand_slots[slot])
+	{
+		candidate_t * c = &candidates[cand_slots[slot]-1];
+		// If ours is already here just leave, because we've already found it.
+		if ((c->cand1 == (unsigned) seq) && (c->cand2 == (unsigned) cand) && (c->dir == dir)) return;
+		slot = (slot+1) & (cand_slot_count-1);
 	}
 
-	// This bucket has candidate pairs, if ours is one of them just leave
-	// because we've already printed it out.
-	while (cle)
+	if (cand_count == cand_size)
 	{
-		if ((cle->cand1 == seq) && (cle->cand2 == cand) && (cle->dir == dir))
-		{
-			cle->count++;
-			return;
-		}
-		else if ((cle->cand2 == seq) && (cle->cand1 == cand) && (cle->dir == dir))
-		{
-			cle->count++;
-			return;
-		}
-		cle = cle->next;
+		cand_size = cand_size ? cand_size*2 : 1024;
+		candidates = realloc(candidates, cand_size*sizeof(candidate_t));
+		if (!candidates) fatal("could not allocate %lu candidates", (unsigned long) cand_size);
 	}
 
-	// If we made it this far, we did not find this candidate pair, so add it.
-	cand_list_element * new_cle = create_new_cle(seq, cand, dir, loc1, loc2);
-	new_cle->next = candidates[index];
-	candidates[index] = new_cle;
-	total_cand++;
-	return;
+	candidate_t * c = &candidates[cand_count];
+	c->cand1 = seq;
+	c->cand2 = cand;
+	c->dir = dir;
+	c->loc1 = loc1;
+	c->loc2 = loc2;
 
+	cand_slots[slot] = ++cand_count;
+	total_cand++;
 }
 
 void free_cand_table()
 {
-	int i;
-
-	for (i = 0; i < CAND_TABLE_BUCKETS; i++)
-	{
-		free_cand_list_element(candidates[i]);
-		candidates[i] = 0;
-	}
-}
-
-void free_cand_list_element(cand_list_element * cle)
-{
-	if (!cle) return;
-
-	cand_list_element * n = cle->next;
-	free(cle);
-	free_cand_list_element(n);
+	free(candidates);
+	free(cand_slots);
+	candidates = 0;
+	cand_slots = 0;
+	cand_count = 0;
+	cand_size = 0;
+	cand_slot_count = 0;
 }
 
 
@@ -55,6 +55,7 @@ void test_mers();
 void print_mer_table(FILE * file);
 void set_k(int new_k);
 void set_window_size(int new_size);
+void set_num_threads(int n);
 int get_next_minimizer(int seq_num, minimizer * next_minimizer);
 void print_kmer(FILE * file, mer_t mer);
 void translate_kmer(mer_t mer, char * str, int length);
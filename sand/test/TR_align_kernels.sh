@@ -0,0 +1,189 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+exe="align_kernels.test"
+
+prepare()
+{
+	gcc -O3 $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libsandtools.a ../../dttools/src/libdttools.a -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "align.h"
+#include "matrix.h"
+#include "sequence.h"
+#include "stringtools.h"
+#include "timestamp.h"
+
+#define MAX_SEQUENCES 1000
+
+/*
+Check that the score-only kernels agree with the full matrix, and that
+the linear memory alignments are the same as those of the full matrix,
+and compare their speed on all the pairs of the test sequences.
+*/
+
+int same_alignment(struct alignment *x, struct alignment *y)
+{
+	return x->start1 == y->start1 && x->end1 == y->end1 && x->start2 == y->start2 && x->end2 == y->end2
+		&& x->score == y->score && x->gap_count == y->gap_count && x->mismatch_count == y->mismatch_count
+		&& !strcmp(x->traceback, y->traceback);
+}
+
+void report(const char *name, int pairs, timestamp_t elapsed)
+{
+	printf("%-24s %8d pairs %10.3f ms %10.0f pairs/s\n", name, pairs, elapsed / 1000.0, pairs / (elapsed / 1000000.0));
+}
+
+int main(int argc, char *argv[])
+{
+	struct seq *s[MAX_SEQUENCES];
+	int n = 0;
+	int i, j, k;
+
+	FILE *file = fopen(argv[1], "r");
+	if(!file) {
+		fprintf(stderr, "could not open %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	while(n < MAX_SEQUENCES && (s[n] = seq_read(file))) {
+		n++;
+	}
+	fclose(file);
+
+	int *expected = malloc(n * n * sizeof(int));
+
+	timestamp_t start = timestamp_get();
+	for(i = 0; i < n; i++) {
+		for(j = 0; j < n; j++) {
+			struct matrix *m = matrix_create(s[i]->num_bases, s[j]->num_bases);
+			struct alignment *aln = align_smith_waterman(m, s[i]->data, s[j]->data);
+			expected[i * n + j] = aln->score;
+			alignment_delete(aln);
+			matrix_delete(m);
+		}
+	}
+	timestamp_t elapsed = timestamp_get() - start;
+
+	report("sw matrix", n * n, elapsed);
+
+	const char *kernels[] = { "scalar", "sse2", "avx2" };
+
+	for(k = 0; k < 3; k++) {
+		struct align_workspace *w = align_workspace_create(kernels[k]);
+
+		if(strcmp(align_workspace_kernel(w), kernels[k])) {
+			printf("sw %-13s not supported\n", kernels[k]);
+			align_workspace_delete(w);
+			continue;
+		}
+
+		start = timestamp_get();
+		for(i = 0; i < n; i++) {
+			for(j = 0; j < n; j++) {
+				int score = align_smith_waterman_score(w, s[i]->data, s[j]->data);
+				if(score != expected[i * n + j]) {
+					fprintf(stderr, "%s: pair %d %d scored %d, expected %d\n", kernels[k], i, j, score, expected[i * n + j]);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+		elapsed = timestamp_get() - start;
+
+		char *name = string_format("sw %s", kernels[k]);
+		report(name, n * n, elapsed);
+		free(name);
+
+		align_workspace_delete(w);
+	}
+
+	/* prefix-suffix alignments with several minimum overlaps, and banded
+	 * alignments with narrow bands and bands off the main diagonal. */
+	struct {
+		const char *name;
+		int banded;
+		int min_align;
+		int astart;
+		int bstart;
+		int k;
+	} cases[] = {
+		{ "ps",               0,   0,   0,   0,   0 },
+		{ "ps min 10",        0,  10,   0,   0,   0 },
+		{ "ps min 40",        0,  40,   0,   0,   0 },
+		{ "banded",           1,   0,   0,   0,  50 },
+		{ "banded k 1",       1,   0,   0,   0,   1 },
+		{ "banded a 12",      1,   0,  12,   0,   8 },
+		{ "banded b 25",      1,   0,   0,  25,   4 },
+		{ "banded a 30 b 17", 1,   0,  30,  17,   2 },
+		{ "banded a 100",     1,   0, 100,   0,   5 },
+	};
+
+	struct align_workspace *w = align_workspace_create(0);
+	struct alignment **full = malloc(n * n * sizeof(struct alignment *));
+
+	for(k = 0; k < (int) (sizeof(cases) / sizeof(cases[0])); k++) {
+		int banded    = cases[k].banded;
+		int min_align = cases[k].min_align;
+		int astart    = cases[k].astart;
+		int bstart    = cases[k].bstart;
+		int band      = cases[k].k;
+
+		start = timestamp_get();
+		for(i = 0; i < n; i++) {
+			for(j = 0; j < n; j++) {
+				struct matrix *m = matrix_create(s[i]->num_bases, s[j]->num_bases);
+				full[i * n + j] = banded ? align_banded(m, s[i]->data, s[j]->data, astart, bstart, band) : align_prefix_suffix(m, s[i]->data, s[j]->data, min_align);
+				matrix_delete(m);
+			}
+		}
+		elapsed = timestamp_get() - start;
+
+		char *name = string_format("%s full", cases[k].name);
+		report(name, n * n, elapsed);
+		free(name);
+
+		start = timestamp_get();
+		for(i = 0; i < n; i++) {
+			for(j = 0; j < n; j++) {
+				struct alignment *aln = banded ? align_banded_compact(w, s[i]->data, s[j]->data, astart, bstart, band) : align_prefix_suffix_linear(w, s[i]->data, s[j]->data, min_align);
+				if(!same_alignment(aln, full[i * n + j])) {
+					fprintf(stderr, "%s: pair %d %d differs from the full matrix\n", cases[k].name, i, j);
+					return EXIT_FAILURE;
+				}
+				alignment_delete(aln);
+				alignment_delete(full[i * n + j]);
+			}
+		}
+		elapsed = timestamp_get() - start;
+
+		name = string_format("%s linear", cases[k].name);
+		report(name, n * n, elapsed);
+		free(name);
+	}
+
+	align_workspace_delete(w);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" sand_sanity/test.fa
+	return $?
+}
+
+clean()
+{
+	rm -f "$exe"
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
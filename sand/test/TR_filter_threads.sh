@@ -0,0 +1,35 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+comp=threads.cfa
+cand1=threads.1.cand
+cand4=threads.4.cand
+
+prepare()
+{
+	clean
+	../src/sand_compress_reads < sand_sanity/test.fa > "$comp"
+	return $?
+}
+
+run()
+{
+	# The candidates must not depend on how the sequences are split among threads.
+	../src/sand_filter_kernel -t 1 -s 7 -o "$cand1" "$comp" || return 1
+	../src/sand_filter_kernel -t 4 -s 7 -o "$cand4" "$comp" || return 1
+
+	[ -s "$cand1" ] || return 1
+	cmp "$cand1" "$cand4"
+	return $?
+}
+
+clean()
+{
+	rm -f "$comp" "$cand1" "$cand4"
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
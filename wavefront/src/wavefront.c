@@ -24,6 +24,7 @@ See the file COPYING for details.
 #include "timestamp.h"
 #include "stringtools.h"
 #include "getopt_aux.h"
+#include "wavefront_model.h"
 
 #define WAVEFRONT_TASK_STATE_COMPLETE   MAKE_RGBA(0,0,255,0)
 #define WAVEFRONT_TASK_STATE_RUNNING    MAKE_RGBA(0,255,0,0)
@@ -201,62 +202,6 @@ void wavefront_task_complete( struct bitmap *b, struct list *list, struct wavefr
 	wavefront_task_delete(t);
 }
 
-static double wavefront_multicore_model( int size, int cpus, double tasktime )
-{
-	int slices = 2*size-1;
-
-	double runtime=0;
-	int slicesize = 0;
-	int i;
-
-	for(i=0;i<slices;i++) {
-
-		if(i<size) {
-			slicesize = i+1;
-		} else {
-			slicesize = 2*size-i-1;
-		}
-
-		while(slicesize>cpus) {
-			slicesize -= cpus;
-			runtime += tasktime;
-		}
-
-		if(slicesize>0) {
-			runtime += tasktime;
-		}
-	}
-
-	return runtime;
-}
-
-static double wavefront_distributed_model( int size, int nodes, int cpus_per_node, double tasktime, int blocksize, double dispatchtime )
-{
-	double blocktime = wavefront_multicore_model(blocksize,cpus_per_node,tasktime);
-	double runtime = wavefront_multicore_model( size/blocksize,nodes,blocktime+dispatchtime);
-	debug(D_DEBUG,"model: runtime=%.02lf for size=%d nodes=%d cpus=%d tasktime=%.02lf blocksize=%d dispatchtime=%.02lf",runtime,size,nodes,cpus_per_node,tasktime,blocksize,dispatchtime);
-	return runtime;
-}
-
-static int find_best_block_size( int size, int nodes, int cpus_per_node, double task_time, double dispatch_time )
-{
-	double t=0;
-	double lasttime=10000000;
-	int b;
-
-	for(b=1;b<(xsize/4);b++) {
-		t = wavefront_distributed_model(size,nodes,cpus_per_node,task_time,b,dispatch_time);
-		if(t>lasttime) {
-			b--;
-			break;
-		}
-
-		lasttime = t;
-	}
-
-	return b;
-}
-
 void save_status( struct bitmap *b, struct list *ready_list, struct itable *running_table )
 {
 	static time_t last_saved = 0;
@@ -489,7 +434,7 @@ int main( int argc, char *argv[] )
 		double task_time = measure_task_time();
 		printf("Each function takes %.02lfs to run.\n",task_time);
 
-		block_size = find_best_block_size(xsize,1000,2,task_time,average_dispatch_time);
+		block_size = wavefront_best_block_size(xsize,1000,2,task_time,average_dispatch_time);
 		double distributed_time = wavefront_distributed_model(xsize,1000,2,task_time,block_size,average_dispatch_time);
 		double multicore_time = wavefront_multicore_model(xsize,ncpus,task_time);
 		double ideal_multicore_time = wavefront_multicore_model(xsize,xsize,task_time);
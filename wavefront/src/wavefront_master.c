@@ -14,6 +14,7 @@ See the file COPYING for details.
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/stat.h>
 
 #include "cctools.h"
 #include "debug.h"
@@ -23,6 +24,13 @@ See the file COPYING for details.
 #include "macros.h"
 #include "getopt_aux.h"
 #include "bitmap.h"
+#include "buffer.h"
+#include "create_dir.h"
+#include "set.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "unlink_recursive.h"
+#include "wavefront_model.h"
 
 #define WAVEFRONT_LINE_MAX 1024
 
@@ -51,6 +59,68 @@ static double sequential_run_time = 7.75;
 static time_t start_time = 0;
 static time_t last_display_time = 0;
 
+/*
+In block mode, each task computes a block of cells sequentially with the
+wavefront_block script below. Its inputs are the cells just left and below
+the block, and it writes its right column and top row to the edge files
+"right" and "top". These are cached at the worker, so that the blocks that
+depend on them are scheduled, by files, where their edges already are.
+*/
+
+struct wavefront_block {
+	int x;
+	int y;
+	int width;
+	int height;
+	char *right;
+	char *top;
+};
+
+static int block_size = 1;
+static int block_mode = 0;
+static int block_size_adaptive = 0;
+static struct wavefront_block **block_owner = 0;
+static char *block_dir = 0;
+static char *block_script = 0;
+static int blocks_measured = 0;
+static double average_cell_time = 1.0;
+static double average_dispatch_time = 1.0;
+static time_t last_adapt_time = 0;
+
+static const char *block_script_text =
+"#!/bin/sh\n"
+"# wavefront_block <function> <x> <y> <width> <height>\n"
+"function=$1\n"
+"x0=$2\n"
+"y0=$3\n"
+"w=$4\n"
+"h=$5\n"
+"mkdir -p cells || exit 1\n"
+"cat edge* | while read x y v\n"
+"do\n"
+"\techo \"$v\" > cells/$x.$y\n"
+"done\n"
+": > right\n"
+": > top\n"
+"j=0\n"
+"while [ $j -lt $h ]\n"
+"do\n"
+"\ty=$((y0+j))\n"
+"\ti=0\n"
+"\twhile [ $i -lt $w ]\n"
+"\tdo\n"
+"\t\tx=$((x0+i))\n"
+"\t\t./$function $x $y cells/$((x-1)).$y cells/$x.$((y-1)) cells/$((x-1)).$((y-1)) > cells/$x.$y || exit 1\n"
+"\t\tline=\"$x $y `cat cells/$x.$y`\"\n"
+"\t\techo \"$line\"\n"
+"\t\t[ $((i+1)) -eq $w ] && echo \"$line\" >> right\n"
+"\t\t[ $((j+1)) -eq $h ] && echo \"$line\" >> top\n"
+"\t\ti=$((i+1))\n"
+"\tdone\n"
+"\tj=$((j+1))\n"
+"done\n"
+"exit 0\n";
+
 static int task_consider( int x, int y )
 {
 	char command[WAVEFRONT_LINE_MAX];
@@ -113,6 +183,247 @@ static void task_prime()
 	}
 }
 
+static int cell_scheduled( int x, int y )
+{
+	return block_owner[y*xsize+x] || text_array_get(array,x,y);
+}
+
+static void block_add_edge( struct set *edges, buffer_t *values, int x, int y, int right )
+{
+	struct wavefront_block *b = block_owner[y*xsize+x];
+
+	if(!b) {
+		buffer_printf(values,"%d %d %s\n",x,y,text_array_get(array,x,y));
+	} else if(right && x==b->x+b->width-1) {
+		set_insert(edges,b->right);
+	} else {
+		set_insert(edges,b->top);
+	}
+}
+
+static void block_submit( struct wavefront_block *b )
+{
+	char command[WAVEFRONT_LINE_MAX];
+	char tag[WAVEFRONT_LINE_MAX];
+	int i,j;
+
+	struct set *edges = set_create(0);
+	buffer_t values;
+	buffer_init(&values);
+
+	block_add_edge(edges,&values,b->x-1,b->y-1,1);
+	for(j=0;j<b->height;j++) block_add_edge(edges,&values,b->x-1,b->y+j,1);
+	for(i=0;i<b->width;i++) block_add_edge(edges,&values,b->x+i,b->y-1,0);
+
+	sprintf(command,"./wavefront_block %s %d %d %d %d",function,b->x,b->y,b->width,b->height);
+	sprintf(tag,"%d %d",b->x,b->y);
+
+	struct work_queue_task *t = work_queue_task_create(command);
+	work_queue_task_specify_tag(t,tag);
+	work_queue_task_specify_algorithm(t,WORK_QUEUE_SCHEDULE_FILES);
+	work_queue_task_specify_file(t,block_script,"wavefront_block",WORK_QUEUE_INPUT,WORK_QUEUE_CACHE);
+	work_queue_task_specify_file(t,function,function,WORK_QUEUE_INPUT,WORK_QUEUE_CACHE);
+	work_queue_task_specify_buffer(t,buffer_tostring(&values),buffer_pos(&values),"edges",WORK_QUEUE_NOCACHE);
+
+	const char *edge;
+	int n = 0;
+	set_first_element(edges);
+	while((edge = set_next_element(edges))) {
+		char remote[WAVEFRONT_LINE_MAX];
+		sprintf(remote,"edge.%d",n++);
+		work_queue_task_specify_file(t,edge,remote,WORK_QUEUE_INPUT,WORK_QUEUE_CACHE);
+	}
+
+	work_queue_task_specify_file(t,b->right,"right",WORK_QUEUE_OUTPUT,WORK_QUEUE_CACHE);
+	work_queue_task_specify_file(t,b->top,"top",WORK_QUEUE_OUTPUT,WORK_QUEUE_CACHE);
+	work_queue_submit(queue,t);
+
+	debug(D_DEBUG,"block %d %d (%dx%d) reads %d edge files",b->x,b->y,b->width,b->height,n);
+
+	for(j=0;j<b->height;j++) {
+		for(i=0;i<b->width;i++) {
+			block_owner[(b->y+j)*xsize+b->x+i] = b;
+			if(bmap)
+				bitmap_set(bmap, b->x+i, b->y+j, WAVEFRONT_TASK_STATE_READY);
+		}
+	}
+
+	buffer_free(&values);
+	set_delete(edges);
+}
+
+/*
+A cell may start a block once its left, bottom, and diagonal neighbors are
+complete. The block then extends up and to the right over the cells whose
+inputs are complete, and that are not yet part of another block.
+*/
+
+static void block_consider( int x, int y )
+{
+	int i,j;
+
+	if(x>=xsize || y>=ysize) return;
+	if(cell_scheduled(x,y)) return;
+
+	if(!text_array_get(array,x-1,y) || !text_array_get(array,x,y-1) || !text_array_get(array,x-1,y-1)) return;
+
+	for(i=1;i<block_size && x+i<xsize;i++) {
+		if(!text_array_get(array,x+i,y-1) || cell_scheduled(x+i,y)) break;
+	}
+
+	for(j=1;j<block_size && y+j<ysize;j++) {
+		if(!text_array_get(array,x-1,y+j) || cell_scheduled(x,y+j)) break;
+	}
+
+	struct wavefront_block *b = xxmalloc(sizeof(*b));
+	b->x = x;
+	b->y = y;
+	b->width = i;
+	b->height = j;
+	b->right = string_format("%s/right.%d.%d",block_dir,x,y);
+	b->top = string_format("%s/top.%d.%d",block_dir,x,y);
+
+	block_submit(b);
+}
+
+/*
+Measure the time per cell and the dispatch time of each block, and choose the
+block size that the distributed model predicts to be the fastest for the
+workers currently connected.
+*/
+
+static void block_adapt( struct wavefront_block *b, struct work_queue_task *t )
+{
+	double cell_time = t->time_workers_execute_last/1000000.0/(b->width*b->height);
+	double dispatch_time = ((t->time_when_commit_end-t->time_when_commit_start)+(t->time_when_done-t->time_when_retrieval))/1000000.0;
+
+	if(blocks_measured++) {
+		average_cell_time = 0.75*average_cell_time + 0.25*cell_time;
+		average_dispatch_time = 0.75*average_dispatch_time + 0.25*dispatch_time;
+	} else {
+		average_cell_time = cell_time;
+		average_dispatch_time = dispatch_time;
+	}
+
+	if(!block_size_adaptive || time(0)==last_adapt_time) return;
+	last_adapt_time = time(0);
+
+	struct work_queue_stats info;
+	work_queue_get_stats(queue,&info);
+
+	int nodes = MAX(1,info.workers_connected);
+	int size = MAX(xsize,ysize)-1;
+	int best = wavefront_best_block_size(size,nodes,1,MAX(average_cell_time,0.000001),average_dispatch_time);
+
+	if(best!=block_size) {
+		debug(D_DEBUG,"block size %d -> %d for %d workers, %.06lfs per cell, %.06lfs dispatch",block_size,best,nodes,average_cell_time,average_dispatch_time);
+		block_size = best;
+	}
+}
+
+static int block_complete( struct work_queue_task *t )
+{
+	int x,y,i,j;
+
+	if(sscanf(t->tag,"%d %d",&x,&y)!=2) return 0;
+
+	struct wavefront_block *b = block_owner[y*xsize+x];
+	if(!b || b->x!=x || b->y!=y) return 0;
+
+	int count = 0;
+	char *line = t->output;
+	while(line && *line) {
+		char *next = strchr(line,'\n');
+		if(next) *next++ = 0;
+
+		char value[WAVEFRONT_LINE_MAX];
+		if(sscanf(line,"%d %d %[^\n]",&i,&j,value)==3 && i>=b->x && i<b->x+b->width && j>=b->y && j<b->y+b->height) {
+			text_array_set(array,i,j,value);
+			fprintf(logfile,"%d %d %s\n",i,j,value);
+			if(bmap)
+				bitmap_set(bmap, i, j, WAVEFRONT_TASK_STATE_COMPLETE);
+			count++;
+		}
+
+		line = next;
+	}
+	fflush(logfile);
+
+	if(count!=b->width*b->height) return 0;
+
+	cells_complete += count;
+	tasks_done += count;
+
+	block_adapt(b,t);
+
+	for(j=0;j<b->height;j++) block_consider(b->x+b->width,b->y+j);
+	for(i=0;i<b->width;i++) block_consider(b->x+i,b->y+b->height);
+
+	return 1;
+}
+
+static void block_prime()
+{
+	int i,j;
+	for(j=1;j<ysize;j++) {
+		for(i=1;i<xsize;i++) {
+			if(text_array_get(array,i,j)) {
+				if(bmap)
+					bitmap_set(bmap, i, j, WAVEFRONT_TASK_STATE_COMPLETE);
+				cells_complete++;
+			} else {
+				block_consider(i,j);
+			}
+		}
+	}
+}
+
+static int block_setup()
+{
+	block_dir = string_format("%s.blocks",outfile);
+	unlink_recursive(block_dir);
+	if(!create_dir(block_dir,0755)) {
+		fprintf(stderr,"couldn't create %s: %s\n",block_dir,strerror(errno));
+		return 0;
+	}
+
+	block_script = string_format("%s/wavefront_block",block_dir);
+	FILE *file = fopen(block_script,"w");
+	if(!file || fputs(block_script_text,file)<0 || fclose(file)!=0 || chmod(block_script,0755)<0) {
+		fprintf(stderr,"couldn't write %s: %s\n",block_script,strerror(errno));
+		return 0;
+	}
+
+	block_owner = xxcalloc(xsize*ysize,sizeof(*block_owner));
+
+	return 1;
+}
+
+static void block_cleanup()
+{
+	struct set *blocks = set_create(0);
+	struct wavefront_block *b;
+	int i;
+
+	for(i=0;i<xsize*ysize;i++) {
+		if(block_owner[i]) set_insert(blocks,block_owner[i]);
+	}
+
+	set_first_element(blocks);
+	while((b = set_next_element(blocks))) {
+		free(b->right);
+		free(b->top);
+		free(b);
+	}
+
+	set_delete(blocks);
+	free(block_owner);
+
+	unlink_recursive(block_dir);
+	free(block_script);
+	free(block_dir);
+}
+
 static void show_help(const char *cmd)
 {
 	fprintf(stdout, "Use: %s [options] <command> <xsize> <ysize> <inputdata> <outputdata>\n", cmd);
@@ -120,6 +431,8 @@ static void show_help(const char *cmd)
 	fprintf(stdout, " %-30s Show program version.\n", "-v,--version");
 	fprintf(stdout, " %-30s Enable debugging for this subsystem.  (Try -d all to start.)\n", "-d,--debug=<flag>");
 	fprintf(stdout, " %-30s Advertise the master information to a catalog server.\n", "-a,--advertise");
+	fprintf(stdout, " %-30s Compute blocks of <size> by <size> cells per task. (default is 1)\n", "-b,--block-size=<size>");
+	fprintf(stdout, " %-30s Adapt the block size to the measured task and dispatch times.\n", "-A,--adaptive-blocks");
 	fprintf(stdout, " %-30s Set the project name to <project>\n", "-N,--project-name=<project>");
 	fprintf(stdout, " %-30s Send debugging to this file. (can also be :stderr, :stdout, :syslog, or :journal)\n", "-o,--debug-file=<file>");
 	fprintf(stdout, " %-30s The port that the master will be listening on. (default 9068)\n", "-p,--port=<port>");
@@ -139,8 +452,9 @@ static void display_progress( struct work_queue *q )
 		current++;
 
 	double speedup = (sequential_run_time*tasks_done)/(current-start_time);
+	double cells_per_second = (double)tasks_done/(current-start_time);
 
-	printf("%2.02lf%% %6d %6ds %4d %4d %4d %4d %4d %4d %.02lf\n",100.0*cells_complete/cells_total,cells_complete,(int)(time(0)-start_time),info.workers_init,info.workers_ready,info.workers_busy,info.tasks_waiting,info.tasks_running,info.tasks_complete,speedup);
+	printf("%2.02lf%% %6d %6ds %4d %4d %4d %4d %4d %4d %.02lf %.02lf cells/s %3d\n",100.0*cells_complete/cells_total,cells_complete,(int)(time(0)-start_time),info.workers_init,info.workers_ready,info.workers_busy,info.tasks_waiting,info.tasks_running,info.tasks_complete,speedup,cells_per_second,block_size);
 
 		if(bmap) {
 			bitmap_save_bmp(bmap,progress_bitmap_file);
@@ -185,6 +499,8 @@ int main( int argc, char *argv[] )
 		{"version", no_argument, 0, 'v'},
 		{"debug", required_argument, 0, 'd'},
 		{"advertise", no_argument, 0, 'a'},
+		{"adaptive-blocks", no_argument, 0, 'A'},
+		{"block-size", required_argument, 0, 'b'},
 		{"project-name", required_argument, 0, 'N'},
 		{"debug-file", required_argument, 0, 'o'},
 		{"port", required_argument, 0, 'p'},
@@ -196,10 +512,20 @@ int main( int argc, char *argv[] )
 		{0,0,0,0}
 	};
 
-	while((c=getopt_long(argc,argv,"aB:d:hN:p:P:o:v:Z:", long_options, NULL)) >= 0) {
+	while((c=getopt_long(argc,argv,"aAb:B:d:hN:p:P:o:v:Z:", long_options, NULL)) >= 0) {
 		switch(c) {
 			case 'a':
 			break;
+		case 'A':
+			block_size_adaptive = 1;
+			break;
+		case 'b':
+			block_size = atoi(optarg);
+			if(block_size<1) {
+				fprintf(stderr,"%s: block size must be at least 1\n",progname);
+				return 1;
+			}
+			break;
 		case 'd':
 			debug_flags_set(optarg);
 			break;
@@ -315,7 +641,14 @@ int main( int argc, char *argv[] )
 	}
 
 
-	task_prime();
+	block_mode = block_size>1 || block_size_adaptive;
+
+	if(block_mode) {
+		if(!block_setup()) return 1;
+		block_prime();
+	} else {
+		task_prime();
+	}
 
 	struct work_queue_task *t;
 
@@ -325,7 +658,11 @@ int main( int argc, char *argv[] )
 		t = work_queue_wait(queue,WORK_QUEUE_WAITFORTASK);
 		if(!t) break;
 
-		if(t->return_status==0) {
+		if(block_mode) {
+			if(t->result!=WORK_QUEUE_RESULT_SUCCESS || t->return_status!=0 || !block_complete(t)) {
+				fprintf(stderr,"block %s failed return value (%i) result (%i) on host %s. output:\n%s\n",t->tag,t->return_status,t->result,t->host,t->output);
+			}
+		} else if(t->return_status==0) {
 			int x,y;
 			if(sscanf(t->tag,"%d %d",&x,&y)==2) {
 				text_array_set(array,x,y,t->output);
@@ -345,6 +682,13 @@ int main( int argc, char *argv[] )
 	}
 
 	display_progress(queue);
+
+	time_t elapsed = MAX(1,time(0)-start_time);
+	printf("%d cells in %ds: %.02lf cells/s\n",tasks_done,(int)elapsed,(double)tasks_done/elapsed);
+
+	if(block_mode)
+		block_cleanup();
+
 	return 0;
 }
 
@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "wavefront_model.h"
+
+#include "debug.h"
+#include "macros.h"
+
+double wavefront_multicore_model( int size, int cpus, double tasktime )
+{
+	int slices = 2*size-1;
+	double runtime = 0;
+	int i;
+
+	for(i=0;i<slices;i++) {
+		int slicesize = i<size ? i+1 : 2*size-i-1;
+		runtime += tasktime*((slicesize+cpus-1)/cpus);
+	}
+
+	return runtime;
+}
+
+double wavefront_distributed_model( int size, int nodes, int cpus_per_node, double tasktime, int blocksize, double dispatchtime )
+{
+	double blocktime = wavefront_multicore_model(blocksize,cpus_per_node,tasktime);
+	double runtime = wavefront_multicore_model((size+blocksize-1)/blocksize,nodes,blocktime+dispatchtime);
+	debug(D_DEBUG,"model: runtime=%.02lf for size=%d nodes=%d cpus=%d tasktime=%.02lf blocksize=%d dispatchtime=%.02lf",runtime,size,nodes,cpus_per_node,tasktime,blocksize,dispatchtime);
+	return runtime;
+}
+
+int wavefront_best_block_size( int size, int nodes, int cpus_per_node, double task_time, double dispatch_time )
+{
+	double t;
+	double lasttime = wavefront_distributed_model(size,nodes,cpus_per_node,task_time,1,dispatch_time);
+	int b;
+
+	for(b=2;b<=MAX(1,size/4);b++) {
+		t = wavefront_distributed_model(size,nodes,cpus_per_node,task_time,b,dispatch_time);
+		if(t>lasttime) break;
+		lasttime = t;
+	}
+
+	return b-1;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,19 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef WAVEFRONT_MODEL_H
+#define WAVEFRONT_MODEL_H
+
+/* Estimated time to run a size x size wavefront on cpus, with each cell taking tasktime. */
+double wavefront_multicore_model( int size, int cpus, double tasktime );
+
+/* Estimated time to run a size x size wavefront in blocks of blocksize x blocksize cells, each block dispatched to a node in dispatchtime. */
+double wavefront_distributed_model( int size, int nodes, int cpus_per_node, double tasktime, int blocksize, double dispatchtime );
+
+/* The block size with the shortest estimated time, between 1 and size/4. */
+int wavefront_best_block_size( int size, int nodes, int cpus_per_node, double task_time, double dispatch_time );
+
+#endif
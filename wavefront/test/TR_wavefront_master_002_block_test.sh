@@ -0,0 +1,93 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+PATH=../src:../../work_queue/src:$PATH
+
+TEST_INPUT=test.wmaster.block.input
+TEST_OUTPUT=test.wmaster.block.output
+PORT_FILE=master.block.port
+MASTER_PID=master.block.pid
+MASTER_LOG=master.block.log
+MASTER_OUTPUT=master.block.output
+
+cleanfiles()
+{
+	rm -f $TEST_INPUT
+	rm -f $TEST_OUTPUT
+	rm -f $PORT_FILE
+	rm -f $MASTER_PID
+	rm -f $MASTER_LOG
+	rm -f $MASTER_OUTPUT
+	rm -rf $TEST_OUTPUT.blocks
+}
+
+run_blocks()
+{
+	rm -f $TEST_OUTPUT $PORT_FILE
+
+	echo "starting wavefront master with options $@"
+	wavefront_master -d all -o $MASTER_LOG -Z $PORT_FILE "$@" ./sum_wfm.sh 10 10 $TEST_INPUT $TEST_OUTPUT > $MASTER_OUTPUT &
+	pid=$!
+	echo $pid > $MASTER_PID
+
+	echo "waiting for port file to be created"
+	wait_for_file_creation $PORT_FILE 5
+
+	echo "running workers"
+	work_queue_worker --timeout 2 localhost `cat $PORT_FILE` &
+	work_queue_worker --timeout 2 localhost `cat $PORT_FILE`
+	wait $pid || return 1
+
+	value=`sed -n 's/^9 9 \([[:digit:]]*\)/\1/p' $TEST_OUTPUT`
+	echo "computed value is $value"
+
+	if [ X$value != X1854882 ]
+	then
+		echo "result is incorrect"
+		return 1
+	fi
+
+	if [ `wc -l < $TEST_OUTPUT` != 81 ]
+	then
+		echo "results are missing"
+		return 1
+	fi
+
+	grep "cells/s" $MASTER_OUTPUT > /dev/null || return 1
+
+	return 0
+}
+
+prepare()
+{
+	cleanfiles
+	./gen_ints_wfm.sh $TEST_INPUT 10
+}
+
+run()
+{
+	run_blocks -b 3 || exit 1
+
+	# blocks after the first one read the edges written by their neighbors
+	grep "block .* reads [1-9][0-9]* edge files" $MASTER_LOG > /dev/null || exit 1
+
+	run_blocks --adaptive-blocks || exit 1
+
+	exit 0
+}
+
+clean()
+{
+	if [ -f $MASTER_PID ]
+	then
+		kill -9 `cat $MASTER_PID` 2> /dev/null
+	fi
+
+	cleanfiles
+	exit 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -14,6 +14,7 @@ The following major problems must be fixed:
 #include "work_queue_protocol.h"
 #include "work_queue_internal.h"
 #include "work_queue_resources.h"
+#include "work_queue_compress.h"
 
 #include "cctools.h"
 #include "int_sizes.h"
@@ -52,12 +53,14 @@ The following major problems must be fixed:
 #include <unistd.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -85,6 +88,17 @@ The following major problems must be fixed:
 #define RESOURCE_MONITOR_REMOTE_NAME "cctools-monitor"
 #define RESOURCE_MONITOR_REMOTE_NAME_EVENTS RESOURCE_MONITOR_REMOTE_NAME "events.json"
 
+// Files smaller than this are never compressed on transfer.
+#define WORK_QUEUE_COMPRESS_MIN_SIZE (64*1024)
+// Guesses for the zlib throughput (bytes/s) and ratio, until enough has been compressed.
+#define WORK_QUEUE_COMPRESS_DEFAULT_RATE (50*MEGABYTE)
+#define WORK_QUEUE_COMPRESS_DEFAULT_RATIO 2.0
+// Compress one in this many transfers that would not be, to refresh the estimates.
+#define WORK_QUEUE_COMPRESS_PROBE 32
+
+// Retrieval threads running at once with async-transfers.
+#define WORK_QUEUE_DEFAULT_MAX_RETRIEVALS 16
+
 #define MAX_TASK_STDOUT_STORAGE (1*GIGABYTE)
 
 #define MAX_NEW_WORKERS 10
@@ -112,6 +126,7 @@ typedef enum {
 	WORKER_DISCONNECT_UNKNOWN  = 0,
 	WORKER_DISCONNECT_EXPLICIT,
 	WORKER_DISCONNECT_STATUS_WORKER,
+	WORKER_DISCONNECT_DATA_LINK,
 	WORKER_DISCONNECT_IDLE_OUT,
 	WORKER_DISCONNECT_FAST_ABORT,
 	WORKER_DISCONNECT_FAILURE
@@ -173,6 +188,16 @@ struct work_queue {
 	int transfer_outlier_factor;
 	int default_transfer_rate;
 
+	int compress_transfers;                               /* treat every file as WORK_QUEUE_COMPRESS. */
+	int compress_skipped;                                 /* transfers not compressed since the last one that was. */
+	struct work_queue_compress_stats compress_stats;      /* deflate throughput and ratio seen so far. */
+
+	int async_transfers;            /* retrieve outputs in a thread per worker. */
+	int max_retrievals;             /* retrieval threads running at once. */
+	struct list *retrievals;        /* workers with a retrieval in progress. */
+	int retrieval_pipe[2];          /* written by a retrieval thread when it is done. */
+	struct link *retrieval_link;    /* read end of retrieval_pipe, polled with the workers. */
+
 	char *catalog_hosts;
 
 	time_t catalog_last_update_time;
@@ -196,6 +221,7 @@ struct work_queue {
 	char *monitor_summary_filename;
 
 	char *monitor_exe;
+	struct work_queue_compressor *monitor_compressor;
 	struct rmsummary *measured_local_resources;
 	struct rmsummary *current_max_worker;
 
@@ -211,6 +237,7 @@ struct work_queue_worker {
 	char addrport[WORKER_ADDRPORT_MAX];
 	char hashkey[WORKER_HASHKEY_MAX];
 	int  foreman;                             // 0 if regular worker, 1 if foreman
+	int  compression;                         // 1 if the worker accepts gzip compressed transfers
 	struct work_queue_stats     *stats;
 	struct work_queue_resources *resources;
 
@@ -218,6 +245,11 @@ struct work_queue_worker {
 
 	struct hash_table *current_files;
 	struct link *link;
+	struct list *data_links;                  // extra connections from the worker, used to send inputs in parallel
+	struct list *staged_files;                // if not NULL, inputs are queued here to be sent on the data links
+	char *data_link_of;                       // if not NULL, this is a data link of the worker with this id
+	int  data_links_expected;                 // number of data links the worker opens, used once all are attached
+	struct retrieval *retrieval;              // if not NULL, outputs are being retrieved, and the link is not ours
 	struct itable *current_tasks;
 	struct itable *current_tasks_boxes;
 	int finished_tasks;
@@ -285,6 +317,13 @@ static int update_task_result(struct work_queue_task *t, work_queue_result_t new
 static work_queue_msg_code_t process_workqueue(struct work_queue *q, struct work_queue_worker *w, const char *line);
 static work_queue_msg_code_t process_queue_status(struct work_queue *q, struct work_queue_worker *w, const char *line, time_t stoptime);
 static work_queue_msg_code_t process_resource(struct work_queue *q, struct work_queue_worker *w, const char *line);
+static work_queue_msg_code_t process_datalink(struct work_queue *q, struct work_queue_worker *w, const char *line);
+static void attach_data_links(struct work_queue *q, struct work_queue_worker *w);
+static work_queue_msg_code_t dispatch_worker_msg(struct work_queue *q, struct work_queue_worker *w, char *line, time_t stoptime);
+
+static int retrieval_queue_msg(struct work_queue_worker *w, const char *msg);
+static void retrieval_wait(struct work_queue *q, struct work_queue_worker *w);
+static void retrieval_abort(struct work_queue *q, struct work_queue_worker *w);
 
 static struct jx * queue_to_jx( struct work_queue *q, struct link *foreman_uplink );
 static struct jx * queue_lean_to_jx( struct work_queue *q, struct link *foreman_uplink );
@@ -513,6 +552,14 @@ static int send_worker_msg( struct work_queue *q, struct work_queue_worker *w, c
 	buffer_putvfstring(B, fmt, va);
 	va_end(va);
 
+	// The link belongs to the retrieval thread until it is done, so the
+	// message is sent when the retrieval is complete.
+	if(retrieval_queue_msg(w, buffer_tostring(B))) {
+		int length = buffer_pos(B);
+		buffer_free(B);
+		return length;
+	}
+
 	debug(D_WQ, "tx to %s (%s): %s", w->hostname, w->addrport, buffer_tostring(B));
 
 	//If foreman, then we wait until foreman gives the master some attention.
@@ -585,16 +632,108 @@ work_queue_msg_code_t process_info(struct work_queue *q, struct work_queue_worke
 	} else if(string_prefix_is(field, "end_of_resource_update")) {
 		count_worker_resources(q, w);
 		write_transaction_worker_resources(q, w);
+	} else if(string_prefix_is(field, "compression")) {
+		w->compression = !strcmp(value, "gzip");
+	} else if(string_prefix_is(field, "cache-invalidate")) {
+		// Workers only evict files once told that we handle cache-invalidate.
+		send_worker_msg(q, w, "cache-invalidate accepted\n");
 	} else if(string_prefix_is(field, "worker-id")) {
 		free(w->workerid);
 		w->workerid = xxstrdup(value);
 		write_transaction_worker(q, w, 0, 0);
+		attach_data_links(q, w);
 	}
 
 	//Note we always mark info messages as processed, as they are optional.
 	return MSG_PROCESSED;
 }
 
+/*
+A worker evicted a file from its cache. Forget it, so that it is sent again
+to the tasks that need it, and the worker is not preferred for them.
+*/
+
+static work_queue_msg_code_t process_cache_invalidate(struct work_queue *q, struct work_queue_worker *w, char *line)
+{
+	char cached_name[WORK_QUEUE_LINE_MAX];
+
+	if(sscanf(line, "cache-invalidate %s", cached_name) != 1)
+		return MSG_FAILURE;
+
+	debug(D_WQ, "%s (%s) evicted %s from its cache", w->hostname, w->addrport, cached_name);
+	free(hash_table_remove(w->current_files, cached_name));
+
+	return MSG_PROCESSED;
+}
+
+
+/*
+Move the data links waiting for the worker w to it, once its id is known.
+*/
+
+static void attach_data_links(struct work_queue *q, struct work_queue_worker *w)
+{
+	struct list *links = list_create();
+	struct work_queue_worker *l;
+	char *key;
+
+	hash_table_firstkey(q->worker_table);
+	while(hash_table_nextkey(q->worker_table, &key, (void **) &l)) {
+		if(l->data_link_of && !strcmp(l->data_link_of, w->workerid))
+			list_push_tail(links, l);
+	}
+
+	while((l = list_pop_head(links))) {
+		debug(D_WQ, "%s (%s) has data link %s", w->hostname, w->addrport, l->addrport);
+		list_push_tail(w->data_links, l->link);
+		w->data_links_expected = l->data_links_expected;
+		l->link = NULL;
+		remove_worker(q, l, WORKER_DISCONNECT_DATA_LINK);
+	}
+
+	list_delete(links);
+}
+
+/*
+A worker opened an additional connection to receive its inputs in parallel
+to the ones sent on its main link. The message may arrive before the worker
+has sent its id, in which case the link waits for it. The data links are used
+only once all of them are attached, as the worker reads every one of them
+for each batch of files.
+*/
+
+static work_queue_msg_code_t process_datalink(struct work_queue *q, struct work_queue_worker *target, const char *line)
+{
+	char workerid[WORK_QUEUE_LINE_MAX];
+	int count;
+
+	if(sscanf(line, "datalink %s %d", workerid, &count) != 2 || count < 1)
+		return MSG_FAILURE;
+
+	free(target->hostname);
+	target->hostname = xxstrdup("DATA_LINK");
+
+	//do not count a data link as a worker
+	q->stats->workers_joined--;
+	q->stats->workers_removed--;
+
+	free(target->data_link_of);
+	target->data_link_of = xxstrdup(workerid);
+	target->data_links_expected = count;
+
+	struct work_queue_worker *w;
+	char *key;
+
+	hash_table_firstkey(q->worker_table);
+	while(hash_table_nextkey(q->worker_table, &key, (void **) &w)) {
+		if(w->workerid && !strcmp(w->workerid, workerid)) {
+			attach_data_links(q, w);
+			break;
+		}
+	}
+
+	return MSG_PROCESSED;
+}
 
 /**
  * This function receives a message from worker and records the time a message is successfully
@@ -620,6 +759,18 @@ static work_queue_msg_code_t recv_worker_msg(struct work_queue *q, struct work_q
 
 	debug(D_WQ, "rx from %s (%s): %s", w->hostname, w->addrport, line);
 
+	return dispatch_worker_msg(q, w, line, stoptime);
+}
+
+/*
+Consume the status updates in line, or return MSG_NOT_PROCESSED for the caller
+to handle it. Retrievals also leave here the updates read on their way.
+*/
+
+static work_queue_msg_code_t dispatch_worker_msg(struct work_queue *q, struct work_queue_worker *w, char *line, time_t stoptime)
+{
+	work_queue_msg_code_t result;
+
 	// Check for status updates that can be consumed here.
 	if(string_prefix_is(line, "alive")) {
 		result = MSG_PROCESSED;
@@ -642,6 +793,10 @@ static work_queue_msg_code_t recv_worker_msg(struct work_queue *q, struct work_q
 		result = process_name(q, w, line);
 	} else if (string_prefix_is(line, "info")) {
 		result = process_info(q, w, line);
+	} else if (string_prefix_is(line, "cache-invalidate")) {
+		result = process_cache_invalidate(q, w, line);
+	} else if (string_prefix_is(line, "datalink")) {
+		result = process_datalink(q, w, line);
 	} else {
 		// Message is not a status update: return it to the user.
 		result = MSG_NOT_PROCESSED;
@@ -705,7 +860,7 @@ Two exceptions are made:
   between the master and the workers that it serves.
 */
 
-static int get_transfer_wait_time(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, int64_t length)
+static double get_tolerable_transfer_rate(struct work_queue *q, struct work_queue_worker *w)
 {
 	double avg_transfer_rate; // bytes per second
 	char *data_source;
@@ -720,24 +875,87 @@ static int get_transfer_wait_time(struct work_queue *q, struct work_queue_worker
 
 	debug(D_WQ,"%s (%s) using %s average transfer rate of %.2lf MB/s\n", w->hostname, w->addrport, data_source, avg_transfer_rate/MEGABYTE);
 
-	double tolerable_transfer_rate = avg_transfer_rate / q->transfer_outlier_factor; // bytes per second
+	free(data_source);
 
-	int timeout = length / tolerable_transfer_rate;
+	return avg_transfer_rate / q->transfer_outlier_factor; // bytes per second
+}
 
+static int get_minimum_transfer_timeout(struct work_queue *q, struct work_queue_worker *w)
+{
 	if(w->foreman) {
 		// A foreman must have a much larger minimum timeout, b/c it does not respond immediately to the master.
-		timeout = MAX(q->foreman_transfer_timeout,timeout);
+		return q->foreman_transfer_timeout;
 	} else {
 		// An ordinary master has a lower minimum timeout b/c it responds immediately to the master.
-		timeout = MAX(q->minimum_transfer_timeout,timeout);
+		return q->minimum_transfer_timeout;
 	}
+}
+
+static int transfer_wait_time(const char *hostname, const char *addrport, double tolerable_transfer_rate, int minimum_timeout, int64_t length)
+{
+	int timeout = length / tolerable_transfer_rate;
 
-	debug(D_WQ, "%s (%s) will try up to %d seconds to transfer this %.2lf MB file.", w->hostname, w->addrport, timeout, length/1000000.0);
+	timeout = MAX(minimum_timeout, timeout);
+
+	debug(D_WQ, "%s (%s) will try up to %d seconds to transfer this %.2lf MB file.", hostname, addrport, timeout, length/1000000.0);
 
-	free(data_source);
 	return timeout;
 }
 
+static int get_transfer_wait_time(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, int64_t length)
+{
+	return transfer_wait_time(w->hostname, w->addrport, get_tolerable_transfer_rate(q, w), get_minimum_transfer_timeout(q, w), length);
+}
+
+/*
+Decide whether to compress a transfer of length bytes to or from a worker.
+Compressing pays off when the time spent in zlib plus the time to move the
+compressed bytes is less than the time to move the bytes as they are:
+1/C + 1/(rB) < 1/B, with C the compression throughput and r the compression
+ratio seen so far, and B the transfer rate of the queue. Until enough has been
+compressed, C and r are guessed. As a poor ratio would stop compression for
+good, one in WORK_QUEUE_COMPRESS_PROBE transfers that would be compressed with
+the guessed ratio is compressed anyway, to keep the ratio current.
+*/
+static int compress_transfer(struct work_queue *q, struct work_queue_worker *w, int flags, int64_t length)
+{
+	if(!w->compression)
+		return 0;
+
+	if(!(flags & WORK_QUEUE_COMPRESS) && !q->compress_transfers)
+		return 0;
+
+	// A negative length is not known yet.
+	if(length >= 0 && length < WORK_QUEUE_COMPRESS_MIN_SIZE)
+		return 0;
+
+	struct work_queue_compress_stats *s = &q->compress_stats;
+
+	double compress_rate = WORK_QUEUE_COMPRESS_DEFAULT_RATE;
+	if(s->deflate_time > 1000000 && s->deflate_bytes > 0)
+		compress_rate = 1000000.0 * s->deflate_bytes / s->deflate_time;
+
+	double ratio = WORK_QUEUE_COMPRESS_DEFAULT_RATIO;
+	if(s->bytes_out > MEGABYTE)
+		ratio = (double) s->bytes_in / s->bytes_out;
+
+	double transfer_rate = get_queue_transfer_rate(q, NULL);
+
+	int compress = (1/compress_rate + 1/(ratio*transfer_rate)) < 1/transfer_rate;
+
+	if(!compress && (1/compress_rate + 1/(WORK_QUEUE_COMPRESS_DEFAULT_RATIO*transfer_rate)) < 1/transfer_rate) {
+		if(++q->compress_skipped >= WORK_QUEUE_COMPRESS_PROBE)
+			compress = 1;
+	}
+
+	if(compress)
+		q->compress_skipped = 0;
+
+	debug(D_WQ, "%s (%s) %s transfer (link %.2lf MB/s, zlib %.2lf MB/s, ratio %.2lf)", w->hostname, w->addrport, compress ? "compressing" : "not compressing", transfer_rate/MEGABYTE, compress_rate/MEGABYTE, ratio);
+
+	return compress;
+}
+
 void update_catalog(struct work_queue *q, struct link *foreman_uplink, int force_update )
 {
 	// Only advertise if we have a name.
@@ -771,6 +989,7 @@ static void clean_task_state(struct work_queue_task *t) {
 		t->time_when_retrieval    = 0;
 
 		t->time_workers_execute_last = 0;
+		t->time_workers_sandbox_last = 0;
 
 		t->bytes_sent = 0;
 		t->bytes_received = 0;
@@ -871,6 +1090,8 @@ static void remove_worker(struct work_queue *q, struct work_queue_worker *w, wor
 
 	debug(D_WQ, "worker %s (%s) removed", w->hostname, w->addrport);
 
+	retrieval_abort(q, w);
+
 	q->stats->workers_removed++;
 
 	write_transaction_worker(q, w, 1, reason);
@@ -885,12 +1106,18 @@ static void remove_worker(struct work_queue *q, struct work_queue_worker *w, wor
 	if(w->link)
 		link_close(w->link);
 
+	struct link *data_link;
+	while((data_link = list_pop_head(w->data_links)))
+		link_close(data_link);
+	list_delete(w->data_links);
+
 	itable_delete(w->current_tasks);
 	itable_delete(w->current_tasks_boxes);
 	hash_table_delete(w->current_files);
 	work_queue_resources_delete(w->resources);
 
 	free(w->workerid);
+	free(w->data_link_of);
 	free(w->stats);
 	free(w->hostname);
 	free(w->os);
@@ -908,6 +1135,9 @@ static int release_worker(struct work_queue *q, struct work_queue_worker *w)
 {
 	if(!w) return 0;
 
+	// Only done when the master is going away, so that waiting for the
+	// link is better than a worker that is not told to release.
+	retrieval_wait(q, w);
 
 	send_worker_msg(q,w,"release\n");
 
@@ -962,6 +1192,7 @@ static void add_worker(struct work_queue *q)
 	w->foreman = 0;
 	w->link = link;
 	w->current_files = hash_table_create(0, 0);
+	w->data_links = list_create();
 	w->current_tasks = itable_create(0);
 	w->current_tasks_boxes = itable_create(0);
 	w->finished_tasks = 0;
@@ -984,19 +1215,113 @@ static void add_worker(struct work_queue *q)
 	return;
 }
 
+/*
+The retrieval of the outputs of a task from a worker. The master prepares and
+finishes it, while the transfer in between only touches the retrieval itself,
+so that with async-transfers it runs in a thread of its own while the master
+keeps scheduling. Meanwhile, the master does not poll or write the link of the
+worker, and does not give it any other task.
+*/
+
+struct retrieval_file {
+	struct work_queue_file *f;
+	int gzip;
+	int keep_gzip;
+	int preexist;                               /* the output was already at its destination. */
+	int64_t bytes;
+	timestamp_t time;
+	work_queue_result_code_t result;
+};
+
+struct retrieval {
+	int taskid;
+	struct link *link;
+	char *hostname;
+	char *addrport;
+
+	struct retrieval_file *files;
+	int nfiles;
+
+	double transfer_rate;                       /* slowest rate tolerated, in bytes per second. */
+	int minimum_timeout;
+	int message_timeout;
+	int64_t bandwidth;
+
+	struct list *deferred;                      /* status updates read during the transfer. */
+	struct list *pending;                       /* messages of the master, sent once the link is back. */
+	struct work_queue_compress_stats compress_stats;
+	int output_missing;
+	work_queue_result_code_t result;
+
+	/* progress of the transfer, reported by status queries. */
+	pthread_mutex_t mutex;
+	const char *current_file;
+	int64_t bytes_received;
+	timestamp_t start;
+	int done;
+
+	int threaded;
+	int joined;
+	int wake_fd;
+	pthread_t thread;
+};
+
+__attribute__ (( format(printf,2,3) ))
+static int retrieval_send( struct retrieval *r, const char *fmt, ... )
+{
+	va_list va;
+	buffer_t B[1];
+	buffer_init(B);
+	buffer_abortonfailure(B, 1);
+	buffer_max(B, WORK_QUEUE_LINE_MAX);
+
+	va_start(va, fmt);
+	buffer_putvfstring(B, fmt, va);
+	va_end(va);
+
+	debug(D_WQ, "tx to %s (%s): %s", r->hostname, r->addrport, buffer_tostring(B));
+
+	int result = link_putlstring(r->link, buffer_tostring(B), buffer_pos(B), time(0) + r->message_timeout);
+
+	buffer_free(B);
+
+	return result;
+}
+
+/*
+Read the next response to the retrieval. Status updates the worker sent before
+it received the request are kept for the master, which consumes them once the
+retrieval is finished.
+*/
+static int retrieval_recv( struct retrieval *r, char *line, size_t length )
+{
+	while(link_readline(r->link, line, length, time(0) + r->message_timeout)) {
+		debug(D_WQ, "rx from %s (%s): %s", r->hostname, r->addrport, line);
+
+		if(string_prefix_is(line, "alive") || string_prefix_is(line, "available_results") || string_prefix_is(line, "resource") || string_prefix_is(line, "info") || string_prefix_is(line, "cache-invalidate")) {
+			list_push_tail(r->deferred, xxstrdup(line));
+			continue;
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
 /*
 Get a single file from a remote worker.
 */
-static work_queue_result_code_t get_file( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, const char *local_name, int64_t length, int64_t * total_bytes)
+static work_queue_result_code_t get_file( struct retrieval *r, const char *local_name, int64_t length, int gzip, int keep_gzip, int64_t * total_bytes)
 {
 	// If a bandwidth limit is in effect, choose the effective stoptime.
 	timestamp_t effective_stoptime = 0;
-	if(q->bandwidth) {
-		effective_stoptime = (length/q->bandwidth)*1000000 + timestamp_get();
+	if(r->bandwidth) {
+		effective_stoptime = (length/r->bandwidth)*1000000 + timestamp_get();
 	}
 
 	// Choose the actual stoptime.
-	time_t stoptime = time(0) + get_transfer_wait_time(q, w, t, length);
+	time_t stoptime = time(0) + transfer_wait_time(r->hostname, r->addrport, r->transfer_rate, r->minimum_timeout, length);
 
 	// If necessary, create parent directories of the file.
 	char dirname[WORK_QUEUE_LINE_MAX];
@@ -1004,13 +1329,13 @@ static work_queue_result_code_t get_file( struct work_queue *q, struct work_queu
 	if(strchr(local_name,'/')) {
 		if(!create_dir(dirname, 0777)) {
 			debug(D_WQ, "Could not create directory - %s (%s)", dirname, strerror(errno));
-			link_soak(w->link, length, stoptime);
+			link_soak(r->link, length, stoptime);
 			return APP_FAILURE;
 		}
 	}
 
 	// Create the local file.
-	debug(D_WQ, "Receiving file %s (size: %"PRId64" bytes) from %s (%s) ...", local_name, length, w->addrport, w->hostname);
+	debug(D_WQ, "Receiving file %s (size: %"PRId64" bytes) from %s (%s) ...", local_name, length, r->addrport, r->hostname);
 	// Check if there is space for incoming file at master
 	if(!check_disk_space_for_filesize(dirname, length, disk_avail_threshold)) {
 		debug(D_WQ, "Could not recieve file %s, not enough disk space (%"PRId64" bytes needed)\n", local_name, length);
@@ -1020,22 +1345,50 @@ static work_queue_result_code_t get_file( struct work_queue *q, struct work_queu
 	int fd = open(local_name, O_WRONLY | O_TRUNC | O_CREAT, 0777);
 	if(fd < 0) {
 		debug(D_NOTICE, "Cannot open file %s for writing: %s", local_name, strerror(errno));
-		link_soak(w->link, length, stoptime);
+		link_soak(r->link, length, stoptime);
 		return APP_FAILURE;
 	}
 
-	// Write the data on the link to file.
-	int64_t actual = link_stream_to_fd(w->link, fd, length, stoptime);
+	int64_t received;
 
-	close(fd);
+	if(gzip) {
+		// Write the decompressed data, or the gzip stream itself, to file.
+		struct work_queue_compress_stats stats = {0, 0, 0, 0};
+		int64_t actual = work_queue_compress_recv(r->link, fd, !keep_gzip, stoptime, &stats);
 
-	if(actual != length) {
-		debug(D_WQ, "Received item size (%"PRId64") does not match the expected size - %"PRId64" bytes.", actual, length);
-		unlink(local_name);
-		return WORKER_FAILURE;
+		close(fd);
+
+		if(actual < 0 || (!keep_gzip && actual != length)) {
+			debug(D_WQ, "Received compressed item size (%"PRId64") does not match the expected size - %"PRId64" bytes.", actual, length);
+			unlink(local_name);
+			return WORKER_FAILURE;
+		}
+
+		// The worker's zlib time is not known, so only the ratio is kept.
+		r->compress_stats.bytes_in  += stats.bytes_in;
+		r->compress_stats.bytes_out += stats.bytes_in ? stats.bytes_out : 0;
+
+		received = stats.bytes_out;
+	} else {
+		// Write the data on the link to file.
+		int64_t actual = link_stream_to_fd(r->link, fd, length, stoptime);
+
+		close(fd);
+
+		if(actual != length) {
+			debug(D_WQ, "Received item size (%"PRId64") does not match the expected size - %"PRId64" bytes.", actual, length);
+			unlink(local_name);
+			return WORKER_FAILURE;
+		}
+
+		received = length;
 	}
 
-	*total_bytes += length;
+	*total_bytes += received;
+
+	pthread_mutex_lock(&r->mutex);
+	r->bytes_received += received;
+	pthread_mutex_unlock(&r->mutex);
 
 	// If the transfer was too fast, slow things down.
 	timestamp_t current_time = timestamp_get();
@@ -1054,14 +1407,19 @@ that indicate the entire contents of the directory.
 This makes it efficient to move deep directory hierarchies with
 high throughput and low latency.
 */
-static work_queue_result_code_t get_file_or_directory( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, const char *remote_name, const char *local_name, int64_t * total_bytes)
+static work_queue_result_code_t get_file_or_directory( struct retrieval *r, const char *remote_name, const char *local_name, int gzip, int keep_gzip, int64_t * total_bytes)
 {
 	// Remember the length of the specified remote path so it can be chopped from the result.
 	int remote_name_len = strlen(remote_name);
 
 	// Send the name of the file/dir name to fetch
-	debug(D_WQ, "%s (%s) sending back %s to %s", w->hostname, w->addrport, remote_name, local_name);
-	send_worker_msg(q,w, "get %s 1\n",remote_name);
+	debug(D_WQ, "%s (%s) sending back %s to %s", r->hostname, r->addrport, remote_name, local_name);
+	if(gzip) {
+		// Workers that do not know about gzip ignore it, and send the files as they are.
+		retrieval_send(r, "get %s 1 gzip %d\n",remote_name, keep_gzip ? 0 : WORK_QUEUE_COMPRESS_MIN_SIZE);
+	} else {
+		retrieval_send(r, "get %s 1\n",remote_name);
+	}
 
 	work_queue_result_code_t result = SUCCESS; //return success unless something fails below
 
@@ -1069,10 +1427,12 @@ static work_queue_result_code_t get_file_or_directory( struct work_queue *q, str
 	while(1) {
 		char line[WORK_QUEUE_LINE_MAX];
 		char tmp_remote_path[WORK_QUEUE_LINE_MAX];
+		char encoding[WORK_QUEUE_LINE_MAX];
 		int64_t length;
 		int errnum;
+		int n;
 
-		if(recv_worker_msg_retry(q, w, line, sizeof(line)) == MSG_FAILURE) {
+		if(!retrieval_recv(r, line, sizeof(line))) {
 			result = WORKER_FAILURE;
 			break;
 		}
@@ -1087,9 +1447,12 @@ static work_queue_result_code_t get_file_or_directory( struct work_queue *q, str
 				break;
 			}
 			free(tmp_local_name);
-		} else if(sscanf(line,"file %s %"SCNd64, tmp_remote_path, &length)==2) {
-			char *tmp_local_name = string_format("%s%s",local_name,&tmp_remote_path[remote_name_len]);
-			result = get_file(q,w,t,tmp_local_name,length,total_bytes);
+		} else if((n = sscanf(line,"file %s %"SCNd64" %s", tmp_remote_path, &length, encoding))>=2) {
+			// A compressed file may be kept compressed, with the .gz extension.
+			int gzipped = (n == 3 && !strcmp(encoding, "gzip"));
+			int kept = gzipped && keep_gzip;
+			char *tmp_local_name = string_format("%s%s%s",local_name,&tmp_remote_path[remote_name_len], kept ? ".gz" : "");
+			result = get_file(r,tmp_local_name,length,gzipped,kept,total_bytes);
 			free(tmp_local_name);
 			//Return if worker failure. Else wait for end message from worker.
 			if(result == WORKER_FAILURE) break;
@@ -1097,8 +1460,8 @@ static work_queue_result_code_t get_file_or_directory( struct work_queue *q, str
 			// If the output file is missing, we make a note of that in the task result,
 			// but we continue and consider the transfer a 'success' so that other
 			// outputs are transferred and the task is given back to the caller.
-			debug(D_WQ, "%s (%s): could not access requested file %s (%s)",w->hostname,w->addrport,remote_name,strerror(errnum));
-			update_task_result(t, WORK_QUEUE_RESULT_OUTPUT_MISSING);
+			debug(D_WQ, "%s (%s): could not access requested file %s (%s)",r->hostname,r->addrport,remote_name,strerror(errnum));
+			r->output_missing = 1;
 		} else if(!strcmp(line,"end")) {
 			// We have to return on receiving an end message.
 			if (result == SUCCESS) {
@@ -1107,7 +1470,7 @@ static work_queue_result_code_t get_file_or_directory( struct work_queue *q, str
 				break;
 			}
 		} else {
-			debug(D_WQ, "%s (%s): sent invalid response to get: %s",w->hostname,w->addrport,line);
+			debug(D_WQ, "%s (%s): sent invalid response to get: %s",r->hostname,r->addrport,line);
 			result = WORKER_FAILURE; //signal sys-level failure
 			break;
 		}
@@ -1116,9 +1479,9 @@ static work_queue_result_code_t get_file_or_directory( struct work_queue *q, str
 	// If we failed to *transfer* the output file, then that is a hard
 	// failure which causes this function to return failure and the task
 	// to be returned to the queue to be attempted elsewhere.
-	debug(D_WQ, "%s (%s) failed to return output %s to %s", w->addrport, w->hostname, remote_name, local_name);
+	debug(D_WQ, "%s (%s) failed to return output %s to %s", r->addrport, r->hostname, remote_name, local_name);
 	if(result == APP_FAILURE) {
-		update_task_result(t, WORK_QUEUE_RESULT_OUTPUT_MISSING);;
+		r->output_missing = 1;
 	}
 	return result;
 }
@@ -1194,14 +1557,14 @@ to a third-party location, which can be either a remote filesystem
 (WORK_QUEUE_FS_PATH) or a command to run (WORK_QUEUE_FS_CMD).
 Returns 1 on success at worker and 0 on invalid message from worker.
 */
-static int do_thirdput( struct work_queue *q, struct work_queue_worker *w,  const char *cached_name, const char *payload, int command )
+static int do_thirdput( struct retrieval *r, const char *cached_name, const char *payload, int command )
 {
 	char line[WORK_QUEUE_LINE_MAX];
 	int result;
 
-	send_worker_msg(q,w,"thirdput %d %s %s\n",command,cached_name,payload);
+	retrieval_send(r,"thirdput %d %s %s\n",command,cached_name,payload);
 
-	if(recv_worker_msg_retry(q, w, line, WORK_QUEUE_LINE_MAX) == MSG_FAILURE)
+	if(!retrieval_recv(r, line, WORK_QUEUE_LINE_MAX))
 		return WORKER_FAILURE;
 
 	if(sscanf(line, "thirdput-complete %d", &result)) {
@@ -1212,101 +1575,214 @@ static int do_thirdput( struct work_queue *q, struct work_queue_worker *w,  cons
 	}
 }
 
+/*
+The debug and series files of the resource monitor are only kept compressed,
+so workers are asked to compress them before sending them back.
+*/
+static int is_monitor_log( struct work_queue *q, struct work_queue_file *f )
+{
+	if(q->monitor_mode != MON_FULL)
+		return 0;
+
+	return !strcmp(f->remote_name, RESOURCE_MONITOR_REMOTE_NAME ".series") || !strcmp(f->remote_name, RESOURCE_MONITOR_REMOTE_NAME ".debug");
+}
+
 /*
 Get a single output file, located at the worker under 'cached_name'.
 */
-static work_queue_result_code_t get_output_file( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, struct work_queue_file *f )
+static work_queue_result_code_t get_output_file( struct retrieval *r, struct retrieval_file *rf )
 {
+	struct work_queue_file *f = rf->f;
 	int64_t total_bytes = 0;
 	work_queue_result_code_t result = SUCCESS; //return success unless something fails below.
 
+	pthread_mutex_lock(&r->mutex);
+	r->current_file = f->remote_name;
+	pthread_mutex_unlock(&r->mutex);
+
 	timestamp_t open_time = timestamp_get();
 
 	if(f->flags & WORK_QUEUE_THIRDPUT) {
 		if(!strcmp(f->cached_name, f->payload)) {
 			debug(D_WQ, "output file %s already on shared filesystem", f->cached_name);
-			f->flags |= WORK_QUEUE_PREEXIST;
+			rf->preexist = 1;
 		} else {
-			result = do_thirdput(q,w,f->cached_name,f->payload,WORK_QUEUE_FS_PATH);
+			result = do_thirdput(r,f->cached_name,f->payload,WORK_QUEUE_FS_PATH);
 		}
 	} else if(f->type == WORK_QUEUE_REMOTECMD) {
-		result = do_thirdput(q,w,f->cached_name,f->payload,WORK_QUEUE_FS_CMD);
+		result = do_thirdput(r,f->cached_name,f->payload,WORK_QUEUE_FS_CMD);
 	} else {
-		result = get_file_or_directory(q, w, t, f->cached_name, f->payload, &total_bytes);
+		result = get_file_or_directory(r, f->cached_name, f->payload, rf->gzip, rf->keep_gzip, &total_bytes);
 	}
 
-	timestamp_t close_time = timestamp_get();
-	timestamp_t sum_time = close_time - open_time;
+	rf->time   = timestamp_get() - open_time;
+	rf->bytes  = total_bytes;
+	rf->result = result;
 
-	if(total_bytes>0) {
-		q->stats->bytes_received += total_bytes;
+	return result;
+}
 
-		t->bytes_received    += total_bytes;
-		t->bytes_transferred += total_bytes;
+/*
+The transfer part of a retrieval, which may run in a thread of its own.
+*/
+static void retrieval_transfer( struct retrieval *r )
+{
+	int i;
 
-		w->total_bytes_transferred += total_bytes;
-		w->total_transfer_time += sum_time;
+	r->result = SUCCESS;
 
-		debug(D_WQ, "%s (%s) sent %.2lf MB in %.02lfs (%.02lfs MB/s) average %.02lfs MB/s", w->hostname, w->addrport, total_bytes / 1000000.0, sum_time / 1000000.0, (double) total_bytes / sum_time, (double) w->total_bytes_transferred / w->total_transfer_time);
+	for(i = 0; i < r->nfiles; i++) {
+		r->result = get_output_file(r, &r->files[i]);
+		//if success or app-level failure, continue to get other files.
+		//if worker failure, return.
+		if(r->result == WORKER_FAILURE) {
+			break;
+		}
 	}
 
-	// If the transfer was successful, make a record of it in the cache.
-	if(result == SUCCESS && f->flags & WORK_QUEUE_CACHE) {
-		struct stat local_info;
-		if (stat(f->payload,&local_info) == 0) {
-			struct stat *remote_info = malloc(sizeof(*remote_info));
-			if(!remote_info) {
-				debug(D_NOTICE, "Cannot allocate memory for cache entry for output file %s at %s (%s)", f->payload, w->hostname, w->addrport);
-				return APP_FAILURE;
-			}
-			memcpy(remote_info, &local_info, sizeof(local_info));
-			hash_table_insert(w->current_files, f->cached_name, remote_info);
-		} else {
-			debug(D_NOTICE, "Cannot stat file %s: %s", f->payload, strerror(errno));
-		}
+	pthread_mutex_lock(&r->mutex);
+	r->current_file = NULL;
+	r->done = 1;
+	pthread_mutex_unlock(&r->mutex);
+}
+
+static void *retrieval_thread( void *arg )
+{
+	struct retrieval *r = arg;
+
+	retrieval_transfer(r);
+
+	// Wake up the master, which may be polling the workers.
+	if(write(r->wake_fd, "r", 1) != 1) {
+		debug(D_WQ, "could not wake up the master: %s", strerror(errno));
 	}
 
-	return result;
+	return NULL;
 }
 
-static work_queue_result_code_t get_output_files( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t )
+/*
+Prepare the retrieval of the outputs of t, deciding everything that depends on
+the state of the master beforehand. Only the summary of the resource monitor is
+retrieved from a task that exhausted its resources.
+*/
+static struct retrieval *retrieval_create( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t )
 {
-	struct work_queue_file *f;
-	work_queue_result_code_t result = SUCCESS;
+	struct retrieval *r = xxcalloc(1, sizeof(*r));
+
+	r->taskid   = t->taskid;
+	r->link     = w->link;
+	r->hostname = xxstrdup(w->hostname);
+	r->addrport = xxstrdup(w->addrport);
+
+	r->transfer_rate   = get_tolerable_transfer_rate(q, w);
+	r->minimum_timeout = get_minimum_transfer_timeout(q, w);
+	r->message_timeout = w->foreman ? q->long_timeout : q->short_timeout;
+	r->bandwidth       = q->bandwidth;
+
+	r->deferred = list_create();
+	r->pending  = list_create();
+	r->start    = timestamp_get();
+	pthread_mutex_init(&r->mutex, NULL);
+
+	int monitor_only = t->result == WORK_QUEUE_RESULT_RESOURCE_EXHAUSTION;
+	const char *summary_name = RESOURCE_MONITOR_REMOTE_NAME ".summary";
 
 	if(t->output_files) {
+		r->files = xxcalloc(list_size(t->output_files), sizeof(*r->files));
+
+		struct work_queue_file *f;
 		list_first_item(t->output_files);
 		while((f = list_next_item(t->output_files))) {
-			result = get_output_file(q,w,t,f);
-			//if success or app-level failure, continue to get other files.
-			//if worker failure, return.
-			if(result == WORKER_FAILURE) {
-				break;
+			if(monitor_only && strcmp(summary_name, f->remote_name))
+				continue;
+
+			struct retrieval_file *rf = &r->files[r->nfiles++];
+			rf->f = f;
+			if(!(f->flags & WORK_QUEUE_THIRDPUT) && f->type != WORK_QUEUE_REMOTECMD) {
+				// The size of the output is not known yet, so the worker only compresses it if it is large enough.
+				rf->keep_gzip = is_monitor_log(q, f);
+				rf->gzip = rf->keep_gzip || compress_transfer(q, w, f->flags, -1);
 			}
+
+			if(monitor_only)
+				break;
 		}
 	}
 
-	// tell the worker you no longer need that task's output directory.
-	send_worker_msg(q,w, "kill %d\n",t->taskid);
+	return r;
+}
 
-	return result;
+static void retrieval_delete( struct retrieval *r )
+{
+	char *line;
+	while((line = list_pop_head(r->deferred)))
+		free(line);
+	list_delete(r->deferred);
+
+	while((line = list_pop_head(r->pending)))
+		free(line);
+	list_delete(r->pending);
+
+	pthread_mutex_destroy(&r->mutex);
+	free(r->files);
+	free(r->hostname);
+	free(r->addrport);
+	free(r);
 }
 
-static work_queue_result_code_t get_monitor_output_file( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t )
+/*
+Account for the files of a retrieval, as the transfer could not do it.
+*/
+static work_queue_result_code_t retrieval_account( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, struct retrieval *r )
 {
-	struct work_queue_file *f;
-	work_queue_result_code_t result = SUCCESS;
+	work_queue_result_code_t result = r->result;
+	int i;
 
-	const char *summary_name = RESOURCE_MONITOR_REMOTE_NAME ".summary";
+	for(i = 0; i < r->nfiles; i++) {
+		struct retrieval_file *rf = &r->files[i];
+		struct work_queue_file *f = rf->f;
 
-	if(t->output_files) {
-		list_first_item(t->output_files);
-		while((f = list_next_item(t->output_files))) {
-			if(!strcmp(summary_name, f->remote_name)) {
-				result = get_output_file(q,w,t,f);
-				break;
+		if(rf->preexist)
+			f->flags |= WORK_QUEUE_PREEXIST;
+
+		if(rf->bytes>0) {
+			q->stats->bytes_received += rf->bytes;
+
+			t->bytes_received    += rf->bytes;
+			t->bytes_transferred += rf->bytes;
+
+			w->total_bytes_transferred += rf->bytes;
+			w->total_transfer_time += rf->time;
+
+			debug(D_WQ, "%s (%s) sent %.2lf MB in %.02lfs (%.02lfs MB/s) average %.02lfs MB/s", w->hostname, w->addrport, rf->bytes / 1000000.0, rf->time / 1000000.0, (double) rf->bytes / rf->time, (double) w->total_bytes_transferred / w->total_transfer_time);
+		}
+
+		// If the transfer was successful, make a record of it in the cache.
+		if(rf->result == SUCCESS && f->flags & WORK_QUEUE_CACHE) {
+			struct stat local_info;
+			if (stat(f->payload,&local_info) == 0) {
+				struct stat *remote_info = malloc(sizeof(*remote_info));
+				if(!remote_info) {
+					debug(D_NOTICE, "Cannot allocate memory for cache entry for output file %s at %s (%s)", f->payload, w->hostname, w->addrport);
+					result = APP_FAILURE;
+					continue;
+				}
+				memcpy(remote_info, &local_info, sizeof(local_info));
+				hash_table_insert(w->current_files, f->cached_name, remote_info);
+			} else {
+				debug(D_NOTICE, "Cannot stat file %s: %s", f->payload, strerror(errno));
 			}
 		}
+
+		if(rf->result == WORKER_FAILURE)
+			break;
+	}
+
+	q->compress_stats.bytes_in  += r->compress_stats.bytes_in;
+	q->compress_stats.bytes_out += r->compress_stats.bytes_out;
+
+	if(r->output_missing) {
+		update_task_result(t, WORK_QUEUE_RESULT_OUTPUT_MISSING);
 	}
 
 	// tell the worker you no longer need that task's output directory.
@@ -1426,28 +1902,175 @@ void resource_monitor_append_report(struct work_queue *q, struct work_queue_task
 	free(summary);
 }
 
+/*
+Compress the debug and series files the worker did not send compressed already,
+in the background, so that the next task does not wait for it.
+*/
+static void resource_monitor_compress_log( struct work_queue *q, const char *path )
+{
+	if(access(path, F_OK) != 0)
+		return;
+
+	if(!q->monitor_compressor)
+		q->monitor_compressor = work_queue_compressor_create(WORK_QUEUE_COMPRESS_LEVEL);
+
+	if(q->monitor_compressor) {
+		work_queue_compressor_submit(q->monitor_compressor, path);
+		return;
+	}
+
+	char *target = string_format("%s.gz", path);
+	if(work_queue_compress_file(path, target, WORK_QUEUE_COMPRESS_LEVEL)) {
+		unlink(path);
+	} else {
+		debug(D_NOTICE, "Could not compress '%s': %s\n", path, strerror(errno));
+	}
+	free(target);
+}
+
 void resource_monitor_compress_logs(struct work_queue *q, struct work_queue_task *t) {
 	char *series    = monitor_file_name(q, t, ".series");
 	char *debug_log = monitor_file_name(q, t, ".debug");
 
-	char *command = string_format("gzip -9 -q %s %s", series, debug_log);
+	resource_monitor_compress_log(q, series);
+	resource_monitor_compress_log(q, debug_log);
 
-	int status;
-	int rc = shellcode(command, NULL, NULL, 0, NULL, NULL, &status);
+	free(series);
+	free(debug_log);
+}
 
-	if(rc) {
-		debug(D_NOTICE, "Could no succesfully compress '%s', and '%s'\n", series, debug_log);
+static void finish_retrieval(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, struct retrieval *r)
+{
+	work_queue_result_code_t result = retrieval_account(q, w, t, r);
+
+	if(result != SUCCESS) {
+		debug(D_WQ, "Failed to receive output from worker %s (%s).", w->hostname, w->addrport);
+		handle_failure(q, w, t, result);
 	}
 
-	free(series);
-	free(debug_log);
-	free(command);
+	if(result == WORKER_FAILURE) {
+		// Finish receiving output:
+		t->time_when_done = timestamp_get();
+
+		return;
+	}
+
+	delete_uncacheable_files(q,w,t);
+
+	/* if q is monitoring, append the task summary to the single
+	 * queue summary, update t->resources_used, and delete the task summary. */
+	if(q->monitor_mode) {
+		read_measured_resources(q, t);
+
+		/* Further, if we got uncompressed debug and series files, gzip them. */
+		if(q->monitor_mode == MON_FULL)
+			resource_monitor_compress_logs(q, t);
+	}
+
+	// Finish receiving output.
+	t->time_when_done = timestamp_get();
+
+	work_queue_accumulate_task(q, t);
+
+	// At this point, a task is completed.
+	reap_task_from_worker(q, w, t, WORK_QUEUE_TASK_RETRIEVED);
+
+	w->finished_tasks--;
+	w->total_tasks_complete++;
+
+	if(t->result == WORK_QUEUE_RESULT_RESOURCE_EXHAUSTION) {
+		if(t->resources_measured && t->resources_measured->limits_exceeded) {
+			struct jx *j = rmsummary_to_json(t->resources_measured->limits_exceeded, 1);
+			if(j) {
+				char *str = jx_print_string(j);
+				debug(D_WQ, "Task %d exhausted resources on %s (%s): %s\n",
+						t->taskid,
+						w->hostname,
+						w->addrport,
+						str);
+				free(str);
+				jx_delete(j);
+			}
+		} else {
+				debug(D_WQ, "Task %d exhausted resources on %s (%s), but not resource usage was available.\n",
+						t->taskid,
+						w->hostname,
+						w->addrport);
+		}
+
+		struct category *c = work_queue_category_lookup_or_create(q, t->category);
+		category_allocation_t next = category_next_label(c, t->resource_request, /* resource overflow */ 1, t->resources_requested, t->resources_measured);
+
+		if(next == CATEGORY_ALLOCATION_ERROR) {
+			debug(D_WQ, "Task %d failed given max resource exhaustion.\n", t->taskid);
+		}
+		else {
+			debug(D_WQ, "Task %d resubmitted using new resource allocation.\n", t->taskid);
+			t->resource_request = next;
+			change_task_state(q, t, WORK_QUEUE_TASK_READY);
+			return;
+		}
+	}
+
+	add_task_report(q, t);
+	debug(D_WQ, "%s (%s) done in %.02lfs total tasks %lld average %.02lfs",
+			w->hostname,
+			w->addrport,
+			(t->time_when_done - t->time_when_commit_start) / 1000000.0,
+			(long long) w->total_tasks_complete,
+			w->total_task_time / w->total_tasks_complete / 1000000.0);
+
+	return;
+}
+
+/*
+Send the messages for w that the master queued while the link was busy.
+*/
+static void retrieval_send_pending(struct work_queue *q, struct work_queue_worker *w, struct retrieval *r)
+{
+	char *msg;
+	while((msg = list_pop_head(r->pending))) {
+		send_worker_msg(q, w, "%s", msg);
+		free(msg);
+	}
+}
+
+/*
+Finish a transferred retrieval, unless its task was taken away from the worker
+meanwhile, and consume the status updates it read on its way. Either may remove
+the worker.
+*/
+static void retrieval_complete(struct work_queue *q, struct work_queue_worker *w, struct retrieval *r)
+{
+	char hashkey[WORKER_HASHKEY_MAX];
+	strcpy(hashkey, w->hashkey);
+
+	w->last_msg_recv_time = timestamp_get();
+
+	retrieval_send_pending(q, w, r);
+
+	struct work_queue_task *t = itable_lookup(w->current_tasks, r->taskid);
+	if(t && task_state_is(q, r->taskid, WORK_QUEUE_TASK_WAITING_RETRIEVAL)) {
+		finish_retrieval(q, w, t, r);
+	} else {
+		debug(D_WQ, "Task %d left %s (%s) while its outputs were retrieved.", r->taskid, r->hostname, r->addrport);
+	}
+
+	char *line;
+	while((line = list_pop_head(r->deferred))) {
+		if(hash_table_lookup(q->worker_table, hashkey) == w) {
+			if(dispatch_worker_msg(q, w, line, time(0) + q->short_timeout) == MSG_FAILURE)
+				handle_worker_failure(q, w);
+		}
+		free(line);
+	}
+
+	retrieval_delete(r);
 }
 
 static void fetch_output_from_worker(struct work_queue *q, struct work_queue_worker *w, int taskid)
 {
 	struct work_queue_task *t;
-	work_queue_result_code_t result = SUCCESS;
 
 	t = itable_lookup(w->current_tasks, taskid);
 	if(!t) {
@@ -1459,90 +2082,146 @@ static void fetch_output_from_worker(struct work_queue *q, struct work_queue_wor
 	// Start receiving output...
 	t->time_when_retrieval = timestamp_get();
 
-	if(t->result == WORK_QUEUE_RESULT_RESOURCE_EXHAUSTION) {
-		result = get_monitor_output_file(q,w,t);
-	} else {
-		result = get_output_files(q,w,t);
+	struct retrieval *r = retrieval_create(q, w, t);
+	retrieval_transfer(r);
+	retrieval_complete(q, w, r);
+}
+
+/*
+With async-transfers, retrieve the outputs of t in a thread of its own.
+Returns 0 if the thread could not be started.
+*/
+static int retrieval_start(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t)
+{
+	if(!q->retrieval_link) {
+		if(pipe(q->retrieval_pipe) != 0) {
+			debug(D_NOTICE, "Cannot create pipe for retrievals: %s", strerror(errno));
+			return 0;
+		}
+		q->retrieval_link = link_attach_to_fd(q->retrieval_pipe[0]);
+		link_nonblocking(q->retrieval_link, 1);
+	}
+
+	t->time_when_retrieval = timestamp_get();
+
+	struct retrieval *r = retrieval_create(q, w, t);
+	r->threaded = 1;
+	r->wake_fd  = q->retrieval_pipe[1];
+
+	int rc = pthread_create(&r->thread, NULL, retrieval_thread, r);
+	if(rc != 0) {
+		debug(D_NOTICE, "Cannot start retrieval thread: %s", strerror(rc));
+		retrieval_delete(r);
+		return 0;
 	}
 
-	if(result != SUCCESS) {
-		debug(D_WQ, "Failed to receive output from worker %s (%s).", w->hostname, w->addrport);
-		handle_failure(q, w, t, result);
-	}
+	debug(D_WQ, "%s (%s) retrieving outputs of task %d in the background", w->hostname, w->addrport, t->taskid);
+
+	w->retrieval = r;
+	list_push_tail(q->retrievals, w);
+
+	return 1;
+}
+
+/*
+Queue msg to be sent once the retrieval thread of w, if any, is done with the
+link. Returns 0 if the link can be written now.
+*/
+static int retrieval_queue_msg(struct work_queue_worker *w, const char *msg)
+{
+	struct retrieval *r = w->retrieval;
+	if(!r || !r->threaded || r->joined)
+		return 0;
+
+	debug(D_WQ, "tx to %s (%s) after the retrieval: %s", w->hostname, w->addrport, msg);
+	list_push_tail(r->pending, xxstrdup(msg));
+
+	return 1;
+}
+
+/*
+Wait for the retrieval thread of w, if any, to be done with the link, and send
+the messages queued meanwhile. The retrieval is still finished by
+complete_retrievals.
+*/
+static void retrieval_wait(struct work_queue *q, struct work_queue_worker *w)
+{
+	struct retrieval *r = w->retrieval;
+	if(!r || !r->threaded || r->joined)
+		return;
+
+	debug(D_WQ, "%s (%s) waiting for the retrieval of task %d", w->hostname, w->addrport, r->taskid);
+	pthread_join(r->thread, NULL);
+	r->joined = 1;
 
-	if(result == WORKER_FAILURE) {
-		// Finish receiving output:
-		t->time_when_done = timestamp_get();
+	retrieval_send_pending(q, w, r);
+}
 
+/*
+Stop the retrieval of a worker that is being removed. Shutting down the link
+makes the thread fail promptly, and the task is rescheduled with the others of
+the worker.
+*/
+static void retrieval_abort(struct work_queue *q, struct work_queue_worker *w)
+{
+	struct retrieval *r = w->retrieval;
+	if(!r)
 		return;
-	}
 
-	delete_uncacheable_files(q,w,t);
+	if(!r->joined) {
+		shutdown(link_fd(r->link), SHUT_RDWR);
+		pthread_join(r->thread, NULL);
+		r->joined = 1;
+	}
 
-	/* if q is monitoring, append the task summary to the single
-	 * queue summary, update t->resources_used, and delete the task summary. */
-	if(q->monitor_mode) {
-		read_measured_resources(q, t);
+	if(list_size(r->pending) > 0)
+		debug(D_WQ, "%s (%s) removed before %d messages could be sent", r->hostname, r->addrport, list_size(r->pending));
 
-		/* Further, if we got debug and series files, gzip them. */
-		if(q->monitor_mode == MON_FULL)
-			resource_monitor_compress_logs(q, t);
-	}
+	list_remove(q->retrievals, w);
+	w->retrieval = NULL;
+	retrieval_delete(r);
+}
 
-	// Finish receiving output.
-	t->time_when_done = timestamp_get();
+/*
+Finish the retrievals whose threads are done. Returns how many were finished.
+*/
+static int complete_retrievals(struct work_queue *q)
+{
+	if(list_size(q->retrievals) < 1)
+		return 0;
 
-	work_queue_accumulate_task(q, t);
+	char buf[64];
+	while(read(q->retrieval_pipe[0], buf, sizeof(buf)) > 0) {
+		// drain the wake ups.
+	}
 
-	// At this point, a task is completed.
-	reap_task_from_worker(q, w, t, WORK_QUEUE_TASK_RETRIEVED);
+	struct list *done = list_create();
+	struct work_queue_worker *w;
 
-	w->finished_tasks--;
-	w->total_tasks_complete++;
+	list_first_item(q->retrievals);
+	while((w = list_next_item(q->retrievals))) {
+		pthread_mutex_lock(&w->retrieval->mutex);
+		if(w->retrieval->done)
+			list_push_tail(done, w);
+		pthread_mutex_unlock(&w->retrieval->mutex);
+	}
 
-	if(t->result == WORK_QUEUE_RESULT_RESOURCE_EXHAUSTION) {
-		if(t->resources_measured && t->resources_measured->limits_exceeded) {
-			struct jx *j = rmsummary_to_json(t->resources_measured->limits_exceeded, 1);
-			if(j) {
-				char *str = jx_print_string(j);
-				debug(D_WQ, "Task %d exhausted resources on %s (%s): %s\n",
-						t->taskid,
-						w->hostname,
-						w->addrport,
-						str);
-				free(str);
-				jx_delete(j);
-			}
-		} else {
-				debug(D_WQ, "Task %d exhausted resources on %s (%s), but not resource usage was available.\n",
-						t->taskid,
-						w->hostname,
-						w->addrport);
-		}
+	int count = 0;
+	while((w = list_pop_head(done))) {
+		struct retrieval *r = w->retrieval;
 
-		struct category *c = work_queue_category_lookup_or_create(q, t->category);
-		category_allocation_t next = category_next_label(c, t->resource_request, /* resource overflow */ 1, t->resources_requested, t->resources_measured);
+		if(!r->joined)
+			pthread_join(r->thread, NULL);
+		list_remove(q->retrievals, w);
+		w->retrieval = NULL;
 
-		if(next == CATEGORY_ALLOCATION_ERROR) {
-			debug(D_WQ, "Task %d failed given max resource exhaustion.\n", t->taskid);
-		}
-		else {
-			debug(D_WQ, "Task %d resubmitted using new resource allocation.\n", t->taskid);
-			t->resource_request = next;
-			change_task_state(q, t, WORK_QUEUE_TASK_READY);
-			return;
-		}
+		retrieval_complete(q, w, r);
+		count++;
 	}
 
-	add_task_report(q, t);
-	debug(D_WQ, "%s (%s) done in %.02lfs total tasks %lld average %.02lfs",
-			w->hostname,
-			w->addrport,
-			(t->time_when_done - t->time_when_commit_start) / 1000000.0,
-			(long long) w->total_tasks_complete,
-			w->total_task_time / w->total_tasks_complete / 1000000.0);
+	list_delete(done);
 
-	return;
+	return count;
 }
 
 /*
@@ -1753,9 +2432,11 @@ static work_queue_result_code_t get_result(struct work_queue *q, struct work_que
 	timestamp_t effective_stoptime = 0;
 	time_t stoptime;
 
-	//Format: task completion status, exit status (exit code or signal), output length, execution time, taskid
+	//Format: task completion status, exit status (exit code or signal), output length, execution time, taskid, and
+	//optionally the time to set up the sandbox.
 	char items[5][WORK_QUEUE_PROTOCOL_FIELD_MAX];
-	int n = sscanf(line, "result %s %s %s %s %" SCNd64"", items[0], items[1], items[2], items[3], &taskid);
+	timestamp_t sandbox_time = 0;
+	int n = sscanf(line, "result %s %s %s %s %" SCNd64" %" SCNu64, items[0], items[1], items[2], items[3], &taskid, &sandbox_time);
 
 	if(n < 5) {
 		debug(D_WQ, "Invalid message from worker %s (%s): %s", w->hostname, w->addrport, line);
@@ -1787,6 +2468,7 @@ static work_queue_result_code_t get_result(struct work_queue *q, struct work_que
 	t->time_workers_execute_last = observed_execution_time > execution_time ? execution_time : observed_execution_time;
 
 	t->time_workers_execute_all += t->time_workers_execute_last;
+	t->time_workers_sandbox_last = sandbox_time;
 
 	if(task_status == WORK_QUEUE_RESULT_DISK_ALLOC_FULL) {
 		t->disk_allocation_exhausted = 1;
@@ -2429,6 +3111,16 @@ struct jx * worker_to_jx( struct work_queue *q, struct work_queue_worker *w )
 
 	current_tasks_to_jx(j, w);
 
+	struct retrieval *r = w->retrieval;
+	if(r) {
+		pthread_mutex_lock(&r->mutex);
+		jx_insert_integer(j,"transfer_taskid",r->taskid);
+		if(r->current_file) jx_insert_string(j,"transfer_file",r->current_file);
+		jx_insert_integer(j,"transfer_bytes",r->bytes_received);
+		jx_insert_integer(j,"transfer_time",timestamp_get() - r->start);
+		pthread_mutex_unlock(&r->mutex);
+	}
+
 	return j;
 }
 
@@ -2612,6 +3304,10 @@ static work_queue_result_code_t handle_worker(struct work_queue *q, struct link
 	link_to_hash_key(l, key);
 	w = hash_table_lookup(q->worker_table, key);
 
+	// The link was handed to another worker in this round, e.g. as a data link.
+	if(!w)
+		return SUCCESS;
+
 	int worker_failure = 0;
 	work_queue_msg_code_t result = recv_worker_msg(q, w, line, sizeof(line));
 
@@ -2665,8 +3361,13 @@ static int build_poll_table(struct work_queue *q, struct link *master)
 	// For every worker in the hash table, add an item to the poll table
 	hash_table_firstkey(q->worker_table);
 	while(hash_table_nextkey(q->worker_table, &key, (void **) &w)) {
+		// The link of a worker sending outputs is read by its retrieval.
+		if(w->retrieval)
+			continue;
+
 		// If poll table is not large enough, reallocate it
-		if(n >= q->poll_table_size) {
+		// (leaving room for the retrieval link below.)
+		if(n + 1 >= q->poll_table_size) {
 			q->poll_table_size *= 2;
 			q->poll_table = realloc(q->poll_table, sizeof(*q->poll_table) * q->poll_table_size);
 			if(q->poll_table == NULL) {
@@ -2681,9 +3382,266 @@ static int build_poll_table(struct work_queue *q, struct link *master)
 		n++;
 	}
 
+	// Wake up when a retrieval is done.
+	if(list_size(q->retrievals) > 0) {
+		q->poll_table[n].link = q->retrieval_link;
+		q->poll_table[n].events = LINK_READ;
+		q->poll_table[n].revents = 0;
+		n++;
+	}
+
 	return n;
 }
 
+/*
+A file queued by send_file to be sent on one of the data links of a worker.
+Everything is decided beforehand by the master, so that the threads sending
+the files only move bytes.
+*/
+
+struct staged_file {
+	char *local_name;
+	char *remote_name;
+	off_t offset;
+	int64_t length;
+	int mode;
+	int flags;
+	int gzip;
+	int timeout;
+	int64_t bytes;                                /* bytes sent on the link. */
+	struct work_queue_compress_stats stats;
+	work_queue_result_code_t result;
+	int error;                                    /* errno of an APP_FAILURE. */
+};
+
+struct staging_batch {
+	struct staged_file **files;
+	int count;
+	int next;                                     /* next file to be taken by a link. */
+	pthread_mutex_t mutex;
+};
+
+struct staging_link {
+	struct staging_batch *batch;
+	struct link *link;
+	work_queue_result_code_t result;
+};
+
+static void staged_file_delete(struct staged_file *sf)
+{
+	free(sf->local_name);
+	free(sf->remote_name);
+	free(sf);
+}
+
+static int staged_file_cmp_length(const void *a, const void *b)
+{
+	const struct staged_file *x = *(const struct staged_file **) a;
+	const struct staged_file *y = *(const struct staged_file **) b;
+
+	return (x->length < y->length) - (x->length > y->length);
+}
+
+static work_queue_result_code_t send_staged_file(struct link *link, struct staged_file *sf)
+{
+	char line[WORK_QUEUE_LINE_MAX];
+
+	int fd = open(sf->local_name, O_RDONLY, 0);
+	if(fd < 0) {
+		sf->error = errno;
+		return APP_FAILURE;
+	}
+
+	if(lseek(fd, sf->offset, SEEK_SET) == -1) {
+		sf->error = errno;
+		close(fd);
+		return APP_FAILURE;
+	}
+
+	time_t stoptime = time(0) + sf->timeout;
+
+	int n = snprintf(line, sizeof(line), "put %s %"PRId64" 0%o %d%s\n", sf->remote_name, sf->length, sf->mode, sf->flags, sf->gzip ? " gzip" : "");
+	if(link_putlstring(link, line, n, stoptime) != n) {
+		close(fd);
+		return WORKER_FAILURE;
+	}
+
+	if(sf->gzip) {
+		sf->bytes = work_queue_compress_send(link, fd, sf->length, WORK_QUEUE_COMPRESS_LEVEL, stoptime, &sf->stats);
+	} else {
+		sf->bytes = link_stream_from_fd(link, fd, sf->length, stoptime);
+	}
+
+	close(fd);
+
+	if(sf->bytes < 0 || (!sf->gzip && sf->bytes != sf->length))
+		return WORKER_FAILURE;
+
+	return SUCCESS;
+}
+
+static void *staging_thread(void *arg)
+{
+	struct staging_link *sl = arg;
+	struct staging_batch *b = sl->batch;
+
+	sl->result = SUCCESS;
+
+	while(1) {
+		pthread_mutex_lock(&b->mutex);
+		struct staged_file *sf = b->next < b->count ? b->files[b->next++] : NULL;
+		pthread_mutex_unlock(&b->mutex);
+
+		if(!sf)
+			break;
+
+		sf->result = send_staged_file(sl->link, sf);
+		if(sf->result == WORKER_FAILURE) {
+			sl->result = WORKER_FAILURE;
+			return NULL;
+		}
+	}
+
+	if(link_putliteral(sl->link, "end\n", time(0) + 30) != 4)
+		sl->result = WORKER_FAILURE;
+
+	return NULL;
+}
+
+/*
+Files that could not be staged were already recorded as present at the worker,
+so forget the cache entries of the inputs they belong to.
+*/
+
+static void forget_staged_files(struct work_queue_worker *w, struct work_queue_task *t)
+{
+	struct staged_file *sf;
+	list_first_item(w->staged_files);
+	while((sf = list_next_item(w->staged_files))) {
+		if(sf->result != APP_FAILURE)
+			continue;
+
+		struct work_queue_file *f;
+		list_first_item(t->input_files);
+		while((f = list_next_item(t->input_files))) {
+			size_t n = strlen(f->cached_name);
+			if(!strncmp(sf->remote_name, f->cached_name, n) && (sf->remote_name[n] == '\0' || sf->remote_name[n] == '/')) {
+				struct stat *remote_info = hash_table_remove(w->current_files, f->cached_name);
+				free(remote_info);
+			}
+		}
+	}
+}
+
+/*
+Send the files queued by send_file on the data links of the worker, one thread
+per link, as a single batch. The worker reads all of its data links when it receives
+the batch message, and before any other message on its main link, so the task
+that needs the files can be sent as soon as the batch is done, without waiting
+for an acknowledgement.
+*/
+
+static work_queue_result_code_t send_staged_files(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t)
+{
+	struct staging_batch b;
+	b.count = list_size(w->staged_files);
+	b.next  = 0;
+
+	if(b.count < 1)
+		return SUCCESS;
+
+	b.files = xxmalloc(b.count * sizeof(*b.files));
+
+	// A file named twice by the task is sent only once, as two links
+	// writing to the same file at the worker would corrupt it.
+	struct hash_table *names = hash_table_create(0, 0);
+
+	int i = 0;
+	struct staged_file *sf;
+	list_first_item(w->staged_files);
+	while((sf = list_next_item(w->staged_files))) {
+		if(hash_table_lookup(names, sf->remote_name))
+			continue;
+		hash_table_insert(names, sf->remote_name, sf);
+		b.files[i++] = sf;
+	}
+	b.count = i;
+
+	hash_table_delete(names);
+
+	// Send the largest files first, so that the links finish at about the same time.
+	qsort(b.files, b.count, sizeof(*b.files), staged_file_cmp_length);
+
+	int nlinks = list_size(w->data_links);
+	struct staging_link *links = xxcalloc(nlinks, sizeof(*links));
+	pthread_t *threads = xxcalloc(nlinks, sizeof(*threads));
+
+	pthread_mutex_init(&b.mutex, NULL);
+
+	debug(D_WQ, "%s (%s) staging %d files on %d data links", w->hostname, w->addrport, b.count, nlinks);
+	send_worker_msg(q, w, "batch %d\n", b.count);
+
+	timestamp_t start = timestamp_get();
+
+	int started = 0;
+	struct link *data_link;
+	list_first_item(w->data_links);
+	while(started < nlinks && (data_link = list_next_item(w->data_links))) {
+		links[started].batch = &b;
+		links[started].link  = data_link;
+		if(pthread_create(&threads[started], NULL, staging_thread, &links[started]) != 0) {
+			// The worker waits for an end on every link of the batch.
+			links[started].result = WORKER_FAILURE;
+			break;
+		}
+		started++;
+	}
+
+	work_queue_result_code_t result = started < nlinks ? WORKER_FAILURE : SUCCESS;
+
+	for(i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+		if(links[i].result != SUCCESS)
+			result = WORKER_FAILURE;
+	}
+
+	timestamp_t elapsed = timestamp_get() - start;
+
+	int64_t total_bytes = 0;
+	for(i = 0; i < b.count; i++) {
+		sf = b.files[i];
+
+		total_bytes += MAX(sf->bytes, 0);
+		q->compress_stats.bytes_in  += sf->stats.bytes_in;
+		q->compress_stats.bytes_out += sf->stats.bytes_out;
+		q->compress_stats.deflate_bytes += sf->stats.deflate_bytes;
+		q->compress_stats.deflate_time  += sf->stats.deflate_time;
+
+		if(sf->result == APP_FAILURE) {
+			debug(D_NOTICE, "Cannot read file %s: %s", sf->local_name, strerror(sf->error));
+			if(result == SUCCESS)
+				result = APP_FAILURE;
+		}
+	}
+
+	t->bytes_sent        += total_bytes;
+	t->bytes_transferred += total_bytes;
+
+	w->total_bytes_transferred += total_bytes;
+	w->total_transfer_time     += elapsed;
+
+	q->stats->bytes_sent += total_bytes;
+
+	debug(D_WQ, "%s (%s) received %.2lf MB in %.02lfs on %d data links", w->hostname, w->addrport, total_bytes / 1000000.0, elapsed / 1000000.0, nlinks);
+
+	pthread_mutex_destroy(&b.mutex);
+	free(threads);
+	free(links);
+	free(b.files);
+
+	return result;
+}
+
 static int send_file( struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t, const char *localname, const char *remotename, off_t offset, int64_t length, int64_t *total_bytes, int flags)
 {
 	struct stat local_info;
@@ -2717,6 +3675,27 @@ static int send_file( struct work_queue *q, struct work_queue_worker *w, struct
 	}
 
 	debug(D_WQ, "%s (%s) needs file %s bytes %lld:%lld as '%s'", w->hostname, w->addrport, localname, (long long) offset, (long long) offset+length, remotename);
+
+	if(w->staged_files) {
+		if(offset < 0 || (offset+length) > local_info.st_size) {
+			debug(D_NOTICE, "File specification %s (%lld:%lld) is invalid", localname, (long long) offset, (long long) offset+length);
+			return APP_FAILURE;
+		}
+
+		struct staged_file *sf = xxcalloc(1, sizeof(*sf));
+		sf->local_name  = xxstrdup(localname);
+		sf->remote_name = xxstrdup(remotename);
+		sf->offset      = offset;
+		sf->length      = length;
+		sf->mode        = local_info.st_mode;
+		sf->flags       = flags;
+		sf->gzip        = compress_transfer(q, w, flags, length);
+		sf->timeout     = get_transfer_wait_time(q, w, t, length);
+		list_push_tail(w->staged_files, sf);
+
+		return SUCCESS;
+	}
+
 	int fd = open(localname, O_RDONLY, 0);
 	if(fd < 0) {
 		debug(D_NOTICE, "Cannot open file %s: %s", localname, strerror(errno));
@@ -2741,14 +3720,27 @@ static int send_file( struct work_queue *q, struct work_queue_worker *w, struct
 	}
 
 	stoptime = time(0) + get_transfer_wait_time(q, w, t, length);
-	send_worker_msg(q,w, "put %s %"PRId64" 0%o %d\n",remotename, length, local_info.st_mode, flags);
-	actual = link_stream_from_fd(w->link, fd, length, stoptime);
-	close(fd);
 
-	*total_bytes += actual;
+	if(compress_transfer(q, w, flags, length)) {
+		send_worker_msg(q,w, "put %s %"PRId64" 0%o %d gzip\n",remotename, length, local_info.st_mode, flags);
+		actual = work_queue_compress_send(w->link, fd, length, WORK_QUEUE_COMPRESS_LEVEL, stoptime, &q->compress_stats);
+		close(fd);
 
-	if(actual != length)
-		return WORKER_FAILURE;
+		if(actual < 0)
+			return WORKER_FAILURE;
+
+		// Only the compressed bytes count, so that the transfer rate is that of the link.
+		*total_bytes += actual;
+	} else {
+		send_worker_msg(q,w, "put %s %"PRId64" 0%o %d\n",remotename, length, local_info.st_mode, flags);
+		actual = link_stream_from_fd(w->link, fd, length, stoptime);
+		close(fd);
+
+		*total_bytes += actual;
+
+		if(actual != length)
+			return WORKER_FAILURE;
+	}
 
 	timestamp_t current_time = timestamp_get();
 	if(effective_stoptime && effective_stoptime > current_time) {
@@ -3053,17 +4045,41 @@ static work_queue_result_code_t send_input_files( struct work_queue *q, struct w
 		}
 	}
 
+	// Files are staged to be sent in parallel if the worker has data links.
+	// A bandwidth limit is enforced per link, so it disables them.
+	if(list_size(w->data_links) > 0 && list_size(w->data_links) == w->data_links_expected && !q->bandwidth) {
+		w->staged_files = list_create();
+	}
+
 	// Send each of the input files.
 	// If any one fails to be sent, return failure.
+	work_queue_result_code_t result = SUCCESS;
 	if(t->input_files) {
 		list_first_item(t->input_files);
 		while((f = list_next_item(t->input_files))) {
-			work_queue_result_code_t result = send_input_file(q,w,t,f);
-			if(result != SUCCESS) return result;
+			result = send_input_file(q,w,t,f);
+			if(result != SUCCESS) break;
 		}
 	}
 
-	return SUCCESS;
+	if(w->staged_files) {
+		if(result == SUCCESS) {
+			result = send_staged_files(q, w, t);
+			if(result == APP_FAILURE) {
+				forget_staged_files(w, t);
+				update_task_result(t, WORK_QUEUE_RESULT_INPUT_MISSING);
+			}
+		}
+
+		struct staged_file *sf;
+		while((sf = list_pop_head(w->staged_files))) {
+			staged_file_delete(sf);
+		}
+		list_delete(w->staged_files);
+		w->staged_files = NULL;
+	}
+
+	return result;
 }
 
 /* if max defined, use minimum of max or largest worker
@@ -3295,6 +4311,10 @@ static void compute_capacity(const struct work_queue *q, struct work_queue_stats
 
 static int check_hand_against_task(struct work_queue *q, struct work_queue_worker *w, struct work_queue_task *t) {
 
+	/* the link of the worker is busy with a retrieval */
+	if(w->retrieval)
+		return 0;
+
 	/* worker has no reported any resources yet */
 	if(w->resources->tag < 0)
 		return 0;
@@ -3678,16 +4698,34 @@ static int receive_one_task( struct work_queue *q )
 	struct work_queue_worker *w;
 	uint64_t taskid;
 
+	int events = complete_retrievals(q);
+
 	itable_firstkey(q->tasks);
 	while( itable_nextkey(q->tasks, &taskid, (void **) &t) ) {
 		if( task_state_is(q, taskid, WORK_QUEUE_TASK_WAITING_RETRIEVAL) ) {
 			w = itable_lookup(q->worker_task_map, taskid);
+
+			// one retrieval at a time per worker.
+			if(w->retrieval)
+				continue;
+
+			if(q->async_transfers) {
+				// the other outputs wait for one of the threads to be done.
+				if(list_size(q->retrievals) >= q->max_retrievals)
+					break;
+
+				if(retrieval_start(q, w, t)) {
+					events++;
+					continue;
+				}
+			}
+
 			fetch_output_from_worker(q, w, taskid);
-			return 1;
+			return events + 1;
 		}
 	}
 
-	return 0;
+	return events;
 }
 
 //Sends keepalives to check if connected workers are responsive, and ask for updates If not, removes those workers.
@@ -3698,6 +4736,10 @@ static void ask_for_workers_updates(struct work_queue *q) {
 
 	hash_table_firstkey(q->worker_table);
 	while(hash_table_nextkey(q->worker_table, &key, (void **) &w)) {
+		// a data link waiting for its worker does not answer checks,
+		// and a worker sending outputs answers once it is done.
+		if(w->data_link_of || w->retrieval) continue;
+
 		if(q->keepalive_interval > 0) {
 
 			/* we have not received workqueue message from worker yet, so we
@@ -4757,6 +5799,8 @@ struct work_queue *work_queue_create(int port)
 	q->stats_measure              = calloc(1, sizeof(struct work_queue_stats));
 
 	q->workers_with_available_results = hash_table_create(0, 0);
+	q->retrievals = list_create();
+	q->max_retrievals = WORK_QUEUE_DEFAULT_MAX_RETRIEVALS;
 
 	// The poll table is initially null, and will be created
 	// (and resized) as needed by build_poll_table.
@@ -5036,6 +6080,12 @@ void work_queue_delete(struct work_queue *q)
 
 		hash_table_delete(q->workers_with_available_results);
 
+		list_delete(q->retrievals);
+		if(q->retrieval_link) {
+			link_close(q->retrieval_link);
+			close(q->retrieval_pipe[1]);
+		}
+
 		list_free(q->task_reports);
 		list_delete(q->task_reports);
 
@@ -5085,6 +6135,10 @@ void work_queue_disable_monitoring(struct work_queue *q) {
 	if(q->monitor_mode == MON_DISABLED)
 		return;
 
+	/* wait for the logs still being compressed. */
+	work_queue_compressor_delete(q->monitor_compressor);
+	q->monitor_compressor = NULL;
+
 	rmonitor_measure_process_update_to_peak(q->measured_local_resources, getpid());
 	if(!q->measured_local_resources->exit_type)
 		q->measured_local_resources->exit_type = xxstrdup("normal");
@@ -5602,6 +6656,10 @@ static int poll_active_workers(struct work_queue *q, int stoptime, struct link *
 	int workers_removed = 0;
 	// Then consider all existing active workers
 	for(i = j; i < n; i++) {
+		if(q->poll_table[i].link == q->retrieval_link) {
+			// drained by complete_retrievals.
+			continue;
+		}
 		if(q->poll_table[i].revents) {
 			if(handle_worker(q, q->poll_table[i].link) == WORKER_FAILURE) {
 				workers_removed++;
@@ -6011,6 +7069,15 @@ int work_queue_tune(struct work_queue *q, const char *name, double value)
 	} else if(!strcmp(name, "transfer-outlier-factor")) {
 		q->transfer_outlier_factor = value;
 
+	} else if(!strcmp(name, "compress-transfers")) {
+		q->compress_transfers = value > 0;
+
+	} else if(!strcmp(name, "async-transfers")) {
+		q->async_transfers = value > 0;
+
+	} else if(!strcmp(name, "max-retrievals")) {
+		q->max_retrievals = MAX(1, (int)value);
+
 	} else if(!strcmp(name, "fast-abort-multiplier")) {
 		work_queue_activate_fast_abort(q, value);
 
@@ -6465,6 +7532,9 @@ static void write_transaction_worker(struct work_queue *q, struct work_queue_wor
 			case WORKER_DISCONNECT_STATUS_WORKER:
 				buffer_printf(&B, " STATUS_WORKER");
 				break;
+			case WORKER_DISCONNECT_DATA_LINK:
+				buffer_printf(&B, " DATA_LINK");
+				break;
 			case WORKER_DISCONNECT_EXPLICIT:
 				buffer_printf(&B, " EXPLICIT");
 				break;
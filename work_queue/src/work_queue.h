@@ -42,7 +42,8 @@ typedef enum {
 	WORK_QUEUE_PREEXIST = 4, /**< If the filename already exists on the host, use it in place. */
 	WORK_QUEUE_THIRDGET = 8, /**< Access the file on the client from a shared filesystem */
 	WORK_QUEUE_THIRDPUT = 8, /**< Access the file on the client from a shared filesystem (same as WORK_QUEUE_THIRDGET, included for readability) */
-	WORK_QUEUE_WATCH    = 16 /**< Watch the output file and send back changes as the task runs. */
+	WORK_QUEUE_WATCH    = 16, /**< Watch the output file and send back changes as the task runs. */
+	WORK_QUEUE_COMPRESS = 32  /**< Compress the file while transferring it, if the link is slow enough for it to pay off. */
 } work_queue_file_flags_t;
 
 typedef enum {
@@ -180,6 +181,8 @@ struct work_queue_task {
 	int64_t total_bytes_transferred;                       /**< @deprecated Use bytes_transferred instead. */
 
 	timestamp_t time_app_delay;                            /**< @deprecated The time spent in upper-level application (outside of work_queue_wait). */
+
+	timestamp_t time_workers_sandbox_last;                 /**< Duration of the placement of the input files into the sandbox of the last execution, as reported by the worker. */
 };
 
 /** Statistics describing a work queue. */
@@ -941,6 +944,9 @@ void work_queue_master_preferred_connection(struct work_queue *q, const char *pr
  - "foreman-transfer-timeout" Set the minimum number of seconds to wait for files to be transferred to or from a foreman. (default=3600)
  - "transfer-outlier-factor" Transfer that are this many times slower than the average will be aborted.  (default=10x)
  - "default-transfer-rate" The assumed network bandwidth used until sufficient data has been collected.  (1MB/s)
+ - "compress-transfers" If 1, transfer all files as if they were specified with @ref WORK_QUEUE_COMPRESS. (default=0)
+ - "async-transfers" If 1, retrieve the outputs of tasks in a thread per worker, so that a worker on a slow link does not stall the master. (default=0)
+ - "max-retrievals" With async-transfers, the maximum number of outputs retrieved at once. (default=16)
  - "fast-abort-multiplier" Set the multiplier of the average task time at which point to abort; if negative or zero fast_abort is deactivated. (default=0)
  - "keepalive-interval" Set the minimum number of seconds to wait before sending new keepalive checks to workers. (default=300)
  - "keepalive-timeout" Set the minimum number of seconds to wait for a keepalive response from worker before marking it as dead. (default=30)
@@ -0,0 +1,353 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "work_queue_cache.h"
+
+#include "debug.h"
+#include "delete_dir.h"
+#include "macros.h"
+#include "path_disk_size_info.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct work_queue_cache {
+	char *dir;
+	int64_t budget;
+	int64_t size;
+	int64_t files;
+	uint64_t clock;                /* incremented on every use, orders the entries by recency. */
+	struct hash_table *entries;    /* name -> struct entry */
+	struct hash_table *evicted;    /* names evicted, and not added since. */
+	struct list *pinned;           /* names added since the last task was received. */
+};
+
+struct entry {
+	int64_t size;
+	int64_t files;
+	uint64_t last_use;
+	int cached;
+	int pinned;
+};
+
+struct candidate {
+	char *name;
+	struct entry *e;
+};
+
+struct work_queue_cache * work_queue_cache_create( const char *dir )
+{
+	struct work_queue_cache *c = xxmalloc(sizeof(*c));
+
+	c->dir     = xxstrdup(dir);
+	c->budget  = 0;
+	c->size    = 0;
+	c->files   = 0;
+	c->clock   = 0;
+	c->entries = hash_table_create(0, 0);
+	c->evicted = hash_table_create(0, 0);
+	c->pinned  = list_create();
+
+	return c;
+}
+
+void work_queue_cache_clear( struct work_queue_cache *c )
+{
+	char *name;
+	struct entry *e;
+
+	hash_table_firstkey(c->entries);
+	while(hash_table_nextkey(c->entries, &name, (void **) &e)) {
+		free(e);
+	}
+	hash_table_delete(c->entries);
+	hash_table_delete(c->evicted);
+	c->entries = hash_table_create(0, 0);
+	c->evicted = hash_table_create(0, 0);
+
+	list_free(c->pinned);
+	list_delete(c->pinned);
+	c->pinned = list_create();
+
+	c->size  = 0;
+	c->files = 0;
+}
+
+void work_queue_cache_delete( struct work_queue_cache *c )
+{
+	if(!c)
+		return;
+
+	work_queue_cache_clear(c);
+
+	hash_table_delete(c->entries);
+	hash_table_delete(c->evicted);
+	list_delete(c->pinned);
+	free(c->dir);
+	free(c);
+}
+
+void work_queue_cache_set_budget( struct work_queue_cache *c, int64_t bytes )
+{
+	c->budget = MAX(0, bytes);
+}
+
+int64_t work_queue_cache_budget( struct work_queue_cache *c )
+{
+	return c->budget;
+}
+
+int64_t work_queue_cache_size( struct work_queue_cache *c )
+{
+	return c->size;
+}
+
+int64_t work_queue_cache_file_count( struct work_queue_cache *c )
+{
+	return c->files;
+}
+
+int64_t work_queue_cache_excess( struct work_queue_cache *c, int64_t incoming )
+{
+	if(c->budget < 1)
+		return 0;
+
+	return MAX(0, c->size + incoming - c->budget);
+}
+
+const char * work_queue_cache_entry_name( const char *path, char *buffer, int length )
+{
+	while(!strncmp(path, "./", 2)) {
+		path += 2;
+	}
+
+	const char *slash = strchr(path, '/');
+	int n = slash ? slash - path : (int) strlen(path);
+	n = MIN(n, length - 1);
+
+	memcpy(buffer, path, n);
+	buffer[n] = '\0';
+
+	return buffer;
+}
+
+static struct entry * lookup_or_create( struct work_queue_cache *c, const char *name )
+{
+	struct entry *e = hash_table_lookup(c->entries, name);
+	if(!e) {
+		e = xxmalloc(sizeof(*e));
+		e->size     = 0;
+		e->files    = 0;
+		e->last_use = 0;
+		e->cached   = 0;
+		e->pinned   = 0;
+		hash_table_insert(c->entries, name, e);
+	}
+
+	hash_table_remove(c->evicted, name);
+
+	return e;
+}
+
+static void pin( struct work_queue_cache *c, const char *name, struct entry *e )
+{
+	e->last_use = ++c->clock;
+
+	if(!e->pinned) {
+		e->pinned = 1;
+		list_push_tail(c->pinned, xxstrdup(name));
+	}
+}
+
+static void measure_entry( struct work_queue_cache *c, const char *name, int64_t *size, int64_t *files )
+{
+	char *path = string_format("%s/%s", c->dir, name);
+	struct stat info;
+
+	*size  = 0;
+	*files = 0;
+
+	if(lstat(path, &info) < 0) {
+		debug(D_WQ, "could not measure cached file %s: %s", path, strerror(errno));
+	} else if(S_ISDIR(info.st_mode)) {
+		if(path_disk_size_info_get(path, size, files) < 0) {
+			debug(D_WQ, "could not measure cached directory %s: %s", path, strerror(errno));
+		}
+	} else {
+		*size  = S_ISREG(info.st_mode) ? info.st_size : 0;
+		*files = 1;
+	}
+
+	free(path);
+}
+
+static void set_entry_size( struct work_queue_cache *c, struct entry *e, int64_t size, int64_t files )
+{
+	c->size  += size  - e->size;
+	c->files += files - e->files;
+	e->size   = size;
+	e->files  = files;
+}
+
+void work_queue_cache_add( struct work_queue_cache *c, const char *path, int64_t size, int cached )
+{
+	char name[PATH_MAX];
+	work_queue_cache_entry_name(path, name, sizeof(name));
+
+	struct entry *e = lookup_or_create(c, name);
+
+	while(!strncmp(path, "./", 2)) {
+		path += 2;
+	}
+
+	if(size < 0) {
+		int64_t files;
+		measure_entry(c, name, &size, &files);
+		set_entry_size(c, e, size, files);
+	} else if(!strchr(path, '/')) {
+		/* a file written again replaces the old one, while the files
+		 * put into a directory add up. */
+		set_entry_size(c, e, size, 1);
+	} else {
+		set_entry_size(c, e, e->size + size, e->files + 1);
+	}
+
+	e->cached = cached;
+
+	pin(c, name, e);
+}
+
+void work_queue_cache_update( struct work_queue_cache *c, const char *path, int cached )
+{
+	char name[PATH_MAX];
+	work_queue_cache_entry_name(path, name, sizeof(name));
+
+	int64_t size, files;
+	measure_entry(c, name, &size, &files);
+
+	struct entry *e = lookup_or_create(c, name);
+
+	set_entry_size(c, e, size, files);
+	e->cached   = cached;
+	e->last_use = ++c->clock;
+}
+
+void work_queue_cache_touch( struct work_queue_cache *c, const char *path )
+{
+	char name[PATH_MAX];
+	work_queue_cache_entry_name(path, name, sizeof(name));
+
+	struct entry *e = hash_table_lookup(c->entries, name);
+	if(e) {
+		e->last_use = ++c->clock;
+	}
+}
+
+void work_queue_cache_remove( struct work_queue_cache *c, const char *path )
+{
+	char name[PATH_MAX];
+	work_queue_cache_entry_name(path, name, sizeof(name));
+
+	struct entry *e = hash_table_remove(c->entries, name);
+	if(e) {
+		set_entry_size(c, e, 0, 0);
+		free(e);
+	}
+}
+
+void work_queue_cache_unpin( struct work_queue_cache *c )
+{
+	char *name;
+	while((name = list_pop_head(c->pinned))) {
+		struct entry *e = hash_table_lookup(c->entries, name);
+		if(e) {
+			e->pinned = 0;
+		}
+		free(name);
+	}
+}
+
+int work_queue_cache_was_evicted( struct work_queue_cache *c, const char *path )
+{
+	char name[PATH_MAX];
+	work_queue_cache_entry_name(path, name, sizeof(name));
+
+	return hash_table_lookup(c->evicted, name) != NULL;
+}
+
+static int candidate_compare( const void *a, const void *b )
+{
+	const struct candidate *x = a;
+	const struct candidate *y = b;
+
+	if(x->e->last_use < y->e->last_use)
+		return -1;
+	if(x->e->last_use > y->e->last_use)
+		return 1;
+	return 0;
+}
+
+int64_t work_queue_cache_evict( struct work_queue_cache *c, int64_t needed, struct hash_table *in_use, struct list *evicted )
+{
+	if(needed < 1)
+		return 0;
+
+	struct candidate *candidates = xxmalloc((hash_table_size(c->entries) + 1) * sizeof(*candidates));
+	int n = 0;
+
+	char *name;
+	struct entry *e;
+	hash_table_firstkey(c->entries);
+	while(hash_table_nextkey(c->entries, &name, (void **) &e)) {
+		if(e->cached && !e->pinned && !(in_use && hash_table_lookup(in_use, name))) {
+			candidates[n].name = name;
+			candidates[n].e    = e;
+			n++;
+		}
+	}
+
+	qsort(candidates, n, sizeof(*candidates), candidate_compare);
+
+	int64_t freed = 0;
+	int i;
+	for(i = 0; i < n && freed < needed; i++) {
+		char *victim = xxstrdup(candidates[i].name);
+		char *path   = string_format("%s/%s", c->dir, victim);
+
+		if(delete_dir(path) != 0 && errno != ENOENT) {
+			debug(D_WQ, "could not evict %s from the cache: %s", path, strerror(errno));
+			free(path);
+			free(victim);
+			continue;
+		}
+
+		debug(D_WQ, "evicted %s from the cache (%" PRId64 " bytes)", victim, candidates[i].e->size);
+
+		freed += candidates[i].e->size;
+		work_queue_cache_remove(c, victim);
+		hash_table_insert(c->evicted, victim, (void *) 1);
+
+		if(evicted) {
+			list_push_tail(evicted, victim);
+		} else {
+			free(victim);
+		}
+
+		free(path);
+	}
+
+	free(candidates);
+
+	return freed;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef WORK_QUEUE_CACHE_H
+#define WORK_QUEUE_CACHE_H
+
+#include "hash_table.h"
+#include "list.h"
+
+#include <stdint.h>
+
+/*
+work_queue_cache keeps an index of the files in the cache directory of a
+worker, so that the worker can stay within a byte budget by evicting the
+least recently used files that no task refers to.
+This object is private to the work_queue_worker.
+
+Entries are named by the first component of their cached name, as sent by
+the master, so that all the files put into a cached directory are accounted
+to the directory. Only entries marked as cached by the master are evicted,
+as the master removes the others itself once their tasks are done.
+Entries added since the last task was received are pinned, as they are the
+inputs of a task on its way from the master.
+*/
+
+struct work_queue_cache * work_queue_cache_create( const char *dir );
+void work_queue_cache_delete( struct work_queue_cache *c );
+
+/* Forget all entries, e.g. when the cache directory has been emptied. */
+void work_queue_cache_clear( struct work_queue_cache *c );
+
+/* Bytes the cache may use before eviction starts. 0 means no budget. */
+void    work_queue_cache_set_budget( struct work_queue_cache *c, int64_t bytes );
+int64_t work_queue_cache_budget( struct work_queue_cache *c );
+
+/*
+Bytes and files used by all the entries, kept up to date from the operations
+of the worker, and the bytes over the budget if adding incoming bytes.
+*/
+int64_t work_queue_cache_size( struct work_queue_cache *c );
+int64_t work_queue_cache_file_count( struct work_queue_cache *c );
+int64_t work_queue_cache_excess( struct work_queue_cache *c, int64_t incoming );
+
+/*
+Account size bytes written to name, which becomes pinned and the most recently
+used entry. If size is negative, the entry is measured in the cache directory.
+*/
+void work_queue_cache_add( struct work_queue_cache *c, const char *name, int64_t size, int cached );
+
+/* Measure name in the cache directory, e.g. after a task left its outputs there. */
+void work_queue_cache_update( struct work_queue_cache *c, const char *name, int cached );
+
+/* Mark name as the most recently used entry. */
+void work_queue_cache_touch( struct work_queue_cache *c, const char *name );
+
+/* Forget name, after it was removed from the cache directory. */
+void work_queue_cache_remove( struct work_queue_cache *c, const char *name );
+
+/* Unpin all entries, once the task that will use them has been received. */
+void work_queue_cache_unpin( struct work_queue_cache *c );
+
+/* Return true if name was evicted and has not been added again since. */
+int work_queue_cache_was_evicted( struct work_queue_cache *c, const char *name );
+
+/*
+Delete the least recently used cached entries not in in_use, nor pinned,
+until at least needed bytes are freed. The names of the deleted entries are
+appended to evicted. Returns the number of bytes freed.
+*/
+int64_t work_queue_cache_evict( struct work_queue_cache *c, int64_t needed, struct hash_table *in_use, struct list *evicted );
+
+/* Copy into buffer the name of the entry holding path, relative to the cache directory. */
+const char * work_queue_cache_entry_name( const char *path, char *buffer, int length );
+
+#endif
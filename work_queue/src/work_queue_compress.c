@@ -0,0 +1,336 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "work_queue_compress.h"
+
+#include "debug.h"
+#include "full_io.h"
+#include "list.h"
+#include "macros.h"
+#include "xxmalloc.h"
+
+#include <zlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define COMPRESS_CHUNK (1<<16)
+
+/* windowBits for deflateInit2 that produce a gzip header and trailer. */
+#define GZIP_WINDOW_BITS (15 + 16)
+
+struct work_queue_compressor {
+	int level;
+	int stop;
+	struct list *pending;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+};
+
+int work_queue_compress_file( const char *source, const char *target, int level )
+{
+	int fd = open(source, O_RDONLY);
+	if(fd < 0)
+		return 0;
+
+	char mode[8];
+	snprintf(mode, sizeof(mode), "wb%d", level);
+
+	errno = 0;
+	gzFile out = gzopen(target, mode);
+	if(!out) {
+		close(fd);
+		if(!errno) errno = ENOMEM;
+		return 0;
+	}
+
+	char *chunk = xxmalloc(COMPRESS_CHUNK);
+	ssize_t n;
+	int ok = 1;
+
+	while((n = full_read(fd, chunk, COMPRESS_CHUNK)) > 0) {
+		if(gzwrite(out, chunk, n) != n) {
+			ok = 0;
+			break;
+		}
+	}
+
+	if(n < 0)
+		ok = 0;
+
+	int saved_errno = errno;
+
+	free(chunk);
+	close(fd);
+
+	if(gzclose(out) != Z_OK)
+		ok = 0;
+
+	if(!ok) {
+		unlink(target);
+		errno = saved_errno ? saved_errno : EIO;
+	}
+
+	return ok;
+}
+
+static int send_chunk( struct link *link, const char *data, size_t length, time_t stoptime )
+{
+	char line[32];
+	int n = snprintf(line, sizeof(line), "%zu\n", length);
+
+	if(link_putlstring(link, line, n, stoptime) != n)
+		return 0;
+
+	if(length > 0 && link_putlstring(link, data, length, stoptime) != (ssize_t) length)
+		return 0;
+
+	return 1;
+}
+
+int64_t work_queue_compress_send( struct link *link, int fd, int64_t length, int level, time_t stoptime, struct work_queue_compress_stats *s )
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+
+	if(deflateInit2(&z, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return -1;
+
+	char *in  = xxmalloc(COMPRESS_CHUNK);
+	char *out = xxmalloc(COMPRESS_CHUNK);
+	int64_t sent = 0;
+	int64_t remaining = length;
+	timestamp_t zlib_time = 0;
+	int flush = Z_NO_FLUSH;
+
+	do {
+		ssize_t n = full_read(fd, in, MIN(remaining, COMPRESS_CHUNK));
+		if(n < 0 || (n == 0 && remaining > 0)) {
+			sent = -1;
+			break;
+		}
+
+		remaining -= n;
+		flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
+
+		z.next_in  = (Bytef *) in;
+		z.avail_in = n;
+
+		do {
+			z.next_out  = (Bytef *) out;
+			z.avail_out = COMPRESS_CHUNK;
+
+			timestamp_t start = timestamp_get();
+			deflate(&z, flush);
+			zlib_time += timestamp_get() - start;
+
+			size_t produced = COMPRESS_CHUNK - z.avail_out;
+			if(produced > 0) {
+				if(!send_chunk(link, out, produced, stoptime)) {
+					sent = -1;
+					break;
+				}
+				sent += produced;
+			}
+		} while(z.avail_out == 0);
+	} while(sent >= 0 && flush != Z_FINISH);
+
+	if(sent >= 0 && !send_chunk(link, NULL, 0, stoptime))
+		sent = -1;
+
+	if(sent >= 0 && s) {
+		s->bytes_in  += length;
+		s->bytes_out += sent;
+		s->deflate_bytes += length;
+		s->deflate_time  += zlib_time;
+	}
+
+	deflateEnd(&z);
+	free(in);
+	free(out);
+
+	return sent;
+}
+
+int64_t work_queue_compress_recv( struct link *link, int fd, int inflate_data, time_t stoptime, struct work_queue_compress_stats *s )
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+
+	if(inflate_data && inflateInit2(&z, GZIP_WINDOW_BITS) != Z_OK)
+		return -1;
+
+	char *in  = xxmalloc(COMPRESS_CHUNK);
+	char *out = xxmalloc(COMPRESS_CHUNK);
+	int64_t received = 0;
+	int64_t written = 0;
+
+	while(1) {
+		char line[32];
+		if(!link_readline(link, line, sizeof(line), stoptime)) {
+			written = -1;
+			break;
+		}
+
+		char *end;
+		long long n = strtoll(line, &end, 10);
+		if(*end || n < 0 || n > COMPRESS_CHUNK) {
+			debug(D_DEBUG, "invalid compressed chunk header: %s", line);
+			written = -1;
+			break;
+		}
+
+		if(n == 0)
+			break;
+
+		if(link_read(link, in, n, stoptime) != n) {
+			written = -1;
+			break;
+		}
+		received += n;
+
+		if(!inflate_data) {
+			if(full_write(fd, in, n) != n) {
+				written = -1;
+				break;
+			}
+			written += n;
+			continue;
+		}
+
+		z.next_in  = (Bytef *) in;
+		z.avail_in = n;
+
+		do {
+			z.next_out  = (Bytef *) out;
+			z.avail_out = COMPRESS_CHUNK;
+
+			int rc = inflate(&z, Z_NO_FLUSH);
+
+			if(rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+				debug(D_DEBUG, "corrupted compressed stream: %s", z.msg ? z.msg : "unknown error");
+				written = -1;
+				break;
+			}
+
+			size_t produced = COMPRESS_CHUNK - z.avail_out;
+			if(produced > 0) {
+				if(full_write(fd, out, produced) != (ssize_t) produced) {
+					written = -1;
+					break;
+				}
+				written += produced;
+			}
+		} while(z.avail_out == 0);
+
+		if(written < 0)
+			break;
+	}
+
+	if(written >= 0 && s) {
+		s->bytes_in  += inflate_data ? written : 0;
+		s->bytes_out += received;
+	}
+
+	if(inflate_data)
+		inflateEnd(&z);
+	free(in);
+	free(out);
+
+	return written;
+}
+
+static void *compressor_thread( void *arg )
+{
+	struct work_queue_compressor *c = arg;
+
+	pthread_mutex_lock(&c->mutex);
+	while(1) {
+		char *path = list_pop_head(c->pending);
+		if(!path) {
+			if(c->stop)
+				break;
+			pthread_cond_wait(&c->cond, &c->mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&c->mutex);
+
+		char *target = xxmalloc(strlen(path) + 4);
+		sprintf(target, "%s.gz", path);
+
+		if(work_queue_compress_file(path, target, c->level)) {
+			unlink(path);
+		} else {
+			debug(D_NOTICE, "could not compress %s: %s", path, strerror(errno));
+		}
+
+		free(target);
+		free(path);
+
+		pthread_mutex_lock(&c->mutex);
+	}
+	pthread_mutex_unlock(&c->mutex);
+
+	return NULL;
+}
+
+struct work_queue_compressor * work_queue_compressor_create( int level )
+{
+	struct work_queue_compressor *c = xxmalloc(sizeof(*c));
+
+	c->level   = level;
+	c->stop    = 0;
+	c->pending = list_create();
+
+	pthread_mutex_init(&c->mutex, NULL);
+	pthread_cond_init(&c->cond, NULL);
+
+	int rc = pthread_create(&c->thread, NULL, compressor_thread, c);
+	if(rc != 0) {
+		debug(D_NOTICE, "could not start compression thread: %s", strerror(rc));
+		list_delete(c->pending);
+		pthread_mutex_destroy(&c->mutex);
+		pthread_cond_destroy(&c->cond);
+		free(c);
+		return NULL;
+	}
+
+	return c;
+}
+
+void work_queue_compressor_submit( struct work_queue_compressor *c, const char *path )
+{
+	pthread_mutex_lock(&c->mutex);
+	list_push_tail(c->pending, xxstrdup(path));
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mutex);
+}
+
+void work_queue_compressor_delete( struct work_queue_compressor *c )
+{
+	if(!c)
+		return;
+
+	pthread_mutex_lock(&c->mutex);
+	c->stop = 1;
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mutex);
+
+	pthread_join(c->thread, NULL);
+
+	list_delete(c->pending);
+	pthread_mutex_destroy(&c->mutex);
+	pthread_cond_destroy(&c->cond);
+	free(c);
+}
+
+/* vim: set noexpandtab tabstop=4: */
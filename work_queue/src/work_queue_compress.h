@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef WORK_QUEUE_COMPRESS_H
+#define WORK_QUEUE_COMPRESS_H
+
+#include "link.h"
+#include "timestamp.h"
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+work_queue_compress writes gzip streams with zlib, in process, so that
+neither the master nor the worker have to run an external gzip.
+
+Files are compressed on a link as a sequence of chunks, each a line with the
+number of bytes of gzip data that follows it, and ending with an empty chunk:
+
+<n>\n<n bytes of gzip data><m>\n<m bytes of gzip data>...0\n
+
+so that neither side needs to know the compressed length in advance.
+
+A work_queue_compressor compresses files in a background thread, so that the
+caller, e.g. the master fetching the outputs of a task, does not wait for it.
+*/
+
+#define WORK_QUEUE_COMPRESS_LEVEL 6
+
+struct work_queue_compress_stats {
+	int64_t bytes_in;      /* uncompressed bytes, sent or received. */
+	int64_t bytes_out;     /* compressed bytes, sent or received. */
+	int64_t deflate_bytes; /* uncompressed bytes deflated here. */
+	timestamp_t deflate_time; /* time spent deflating deflate_bytes. */
+};
+
+/* Compress source into the gzip file target. Returns 0 and sets errno on failure. */
+int work_queue_compress_file( const char *source, const char *target, int level );
+
+/*
+Send length bytes from fd as a stream of gzip chunks. Returns the number of
+compressed bytes sent, or -1 on failure. If s is not NULL, it is updated.
+*/
+int64_t work_queue_compress_send( struct link *link, int fd, int64_t length, int level, time_t stoptime, struct work_queue_compress_stats *s );
+
+/*
+Receive a stream of gzip chunks into fd, decompressing it if inflate is true.
+Returns the number of bytes written to fd, or -1 on failure. If s is not NULL,
+it is updated.
+*/
+int64_t work_queue_compress_recv( struct link *link, int fd, int inflate, time_t stoptime, struct work_queue_compress_stats *s );
+
+struct work_queue_compressor * work_queue_compressor_create( int level );
+
+/* Queue path to be compressed into path.gz, after which path is removed. */
+void work_queue_compressor_submit( struct work_queue_compressor *c, const char *path );
+
+/* Wait for all the queued files to be compressed, and free c. */
+void work_queue_compressor_delete( struct work_queue_compressor *c );
+
+#endif
@@ -2,6 +2,7 @@
 #include "work_queue_process.h"
 #include "work_queue.h"
 #include "work_queue_internal.h"
+#include "work_queue_sandbox.h"
 
 #include "debug.h"
 #include "errno.h"
@@ -131,6 +132,8 @@ void work_queue_process_delete(struct work_queue_process *p)
 	if(p->tmpdir)
 		free(p->tmpdir);
 
+	work_queue_sandbox_delete_mounts(p->bind_mounts);
+
 	free(p);
 }
 
@@ -239,6 +242,8 @@ pid_t work_queue_process_execute(struct work_queue_process *p, int container_mod
 		return p->pid;
 
 	} else {
+		work_queue_sandbox_mount(p);
+
 		if(chdir(p->sandbox)) {
 			printf("The sandbox dir is %s", p->sandbox);
 			fatal("could not change directory into %s: %s", p->sandbox, strerror(errno));
@@ -4,6 +4,7 @@
 #include "work_queue.h"
 #include "timestamp.h"
 #include "path_disk_size_info.h"
+#include "list.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -49,6 +50,10 @@ struct work_queue_process {
 	/* state between complete disk measurements. */
 	struct path_disk_size_info *disk_measurement_state;
 
+	/* directories to bind mount into the sandbox, and the time taken to set it up. */
+	struct list *bind_mounts;
+	timestamp_t sandbox_setup_time;
+
 	char container_id[MAX_BUFFER_SIZE];
 };
 
@@ -0,0 +1,540 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "work_queue_sandbox.h"
+#include "work_queue_process.h"
+#include "work_queue.h"
+#include "work_queue_internal.h"
+
+#include "create_dir.h"
+#include "debug.h"
+#include "list.h"
+#include "macros.h"
+#include "path.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "xxmalloc.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+#include <sched.h>
+#include <sys/mount.h>
+#include <linux/fs.h>
+#endif
+
+#define SANDBOX_THREADS_MAX 32
+
+static work_queue_sandbox_strategy_t sandbox_strategy = WORK_QUEUE_SANDBOX_AUTO;
+static int sandbox_symlinks_enabled = 1;
+static int sandbox_threads = 4;
+
+/* A bind mount of a task, or a directory waiting to be linked. */
+struct path_pair {
+	char *source;
+	char *target;
+};
+
+/* A directory being linked by several threads. */
+struct link_walk {
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+	struct list *pending;    /* struct path_pair of directories not yet read. */
+	int busy;                /* threads reading a directory. */
+	int error;               /* errno of the first failure. */
+};
+
+int work_queue_sandbox_strategy_parse( const char *name, work_queue_sandbox_strategy_t *strategy )
+{
+	if(!strcmp(name, "auto")) {
+		*strategy = WORK_QUEUE_SANDBOX_AUTO;
+	} else if(!strcmp(name, "link")) {
+		*strategy = WORK_QUEUE_SANDBOX_LINK;
+	} else if(!strcmp(name, "reflink")) {
+		*strategy = WORK_QUEUE_SANDBOX_REFLINK;
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+void work_queue_sandbox_configure( work_queue_sandbox_strategy_t strategy, int symlinks_enabled, int threads )
+{
+	sandbox_strategy         = strategy;
+	sandbox_symlinks_enabled = symlinks_enabled;
+	sandbox_threads          = MAX(1, MIN(threads, SANDBOX_THREADS_MAX));
+}
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+static int enter_private_mount_namespace()
+{
+	if(unshare(CLONE_NEWNS) < 0)
+		return 0;
+
+	/* do not propagate the bind mounts back to the host. */
+	if(mount("none", "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0)
+		return 0;
+
+	return 1;
+}
+
+static int bind_mount_readonly( const char *source, const char *target )
+{
+	if(mount(source, target, NULL, MS_BIND | MS_REC, NULL) < 0)
+		return 0;
+
+	if(mount(NULL, target, NULL, MS_BIND | MS_REMOUNT | MS_RDONLY, NULL) < 0)
+		return 0;
+
+	return 1;
+}
+#endif
+
+int work_queue_sandbox_bind_available()
+{
+	static int available = -1;
+
+	if(available >= 0)
+		return available;
+
+	available = 0;
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+	char *dir = path_getcwd();
+
+	pid_t pid = fork();
+	if(pid == 0) {
+		_exit(enter_private_mount_namespace() && bind_mount_readonly(dir, dir) ? 0 : 1);
+	} else if(pid > 0) {
+		int status;
+		if(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			available = 1;
+		}
+	}
+
+	free(dir);
+#endif
+
+	debug(D_WQ, "bind mounts for cached directories are %savailable", available ? "" : "not ");
+
+	return available;
+}
+
+static int reflink_file( const char *source, const char *target )
+{
+#if defined(CCTOOLS_OPSYS_LINUX) && defined(FICLONE)
+	struct stat info;
+
+	int in = open(source, O_RDONLY);
+	if(in < 0)
+		return 0;
+
+	if(fstat(in, &info) < 0 || !S_ISREG(info.st_mode)) {
+		close(in);
+		errno = EINVAL;
+		return 0;
+	}
+
+	int out = open(target, O_WRONLY | O_CREAT | O_EXCL, info.st_mode & 07777);
+	if(out < 0) {
+		close(in);
+		return 0;
+	}
+
+	int result = ioctl(out, FICLONE, in);
+	int saved_errno = errno;
+
+	close(out);
+	close(in);
+
+	if(result < 0) {
+		unlink(target);
+		errno = saved_errno;
+		return 0;
+	}
+
+	return 1;
+#else
+	errno = EOPNOTSUPP;
+	return 0;
+#endif
+}
+
+static int link_file( const char *source, const char *target )
+{
+	if(sandbox_strategy == WORK_QUEUE_SANDBOX_REFLINK) {
+		if(reflink_file(source, target)) return 1;
+		if(errno == EEXIST) return 0;
+	}
+
+	if(link(source, target) == 0) return 1;
+	if(errno == EEXIST) return 0;
+
+	/*
+	If the hard link failed, perhaps because the file has too many
+	links, or hard links are not supported in that file system, try
+	to clone the file, and then fall back to a symlink.
+	*/
+
+	if(sandbox_strategy != WORK_QUEUE_SANDBOX_REFLINK) {
+		if(reflink_file(source, target)) return 1;
+		if(errno == EEXIST) return 0;
+	}
+
+	if(sandbox_symlinks_enabled) {
+
+		/*
+		Use an absolute path when symlinking, otherwise the link will
+		be accidentally relative to the current directory.
+		*/
+
+		char *absolute_source;
+		if(source[0] == '/') {
+			absolute_source = xxstrdup(source);
+		} else {
+			char *cwd = path_getcwd();
+			absolute_source = string_format("%s/%s", cwd, source);
+			free(cwd);
+		}
+
+		int result = symlink(absolute_source, target);
+
+		free(absolute_source);
+
+		if(result == 0) return 1;
+	}
+
+	return 0;
+}
+
+static void walk_push( struct link_walk *w, const char *source, const char *target )
+{
+	struct path_pair *d = xxmalloc(sizeof(*d));
+	d->source = xxstrdup(source);
+	d->target = xxstrdup(target);
+
+	pthread_mutex_lock(&w->mutex);
+	list_push_tail(w->pending, d);
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->mutex);
+}
+
+static void walk_fail( struct link_walk *w, int error )
+{
+	pthread_mutex_lock(&w->mutex);
+	if(!w->error) {
+		w->error = error;
+	}
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->mutex);
+}
+
+/*
+Link the entries of one directory. Subdirectories are created here, and
+queued to be read by any of the threads. Symlinks are followed, as they
+were with link_recursive.
+*/
+
+static int walk_directory( struct link_walk *w, const char *source, const char *target )
+{
+	DIR *dir = opendir(source);
+	if(!dir) return 0;
+
+	struct dirent *d;
+	int result = 1;
+
+	while((d = readdir(dir))) {
+		if(!strcmp(d->d_name,".")) continue;
+		if(!strcmp(d->d_name,"..")) continue;
+
+		char *subsource = string_format("%s/%s",source,d->d_name);
+		char *subtarget = string_format("%s/%s",target,d->d_name);
+
+		int is_dir = d->d_type == DT_DIR;
+		if(d->d_type == DT_UNKNOWN || d->d_type == DT_LNK) {
+			struct stat info;
+			is_dir = stat(subsource, &info) == 0 && S_ISDIR(info.st_mode);
+		}
+
+		if(is_dir) {
+			mkdir(subtarget, 0777);
+			walk_push(w, subsource, subtarget);
+		} else {
+			result = link_file(subsource, subtarget);
+		}
+
+		free(subsource);
+		free(subtarget);
+
+		if(!result) break;
+	}
+
+	int saved_errno = errno;
+	closedir(dir);
+	errno = saved_errno;
+
+	return result;
+}
+
+static void * walk_thread( void *arg )
+{
+	struct link_walk *w = arg;
+
+	pthread_mutex_lock(&w->mutex);
+	while(!w->error) {
+		struct path_pair *d = list_pop_head(w->pending);
+		if(!d) {
+			if(w->busy == 0)
+				break;
+			pthread_cond_wait(&w->cond, &w->mutex);
+			continue;
+		}
+
+		w->busy++;
+		pthread_mutex_unlock(&w->mutex);
+
+		if(!walk_directory(w, d->source, d->target)) {
+			walk_fail(w, errno ? errno : EIO);
+		}
+
+		free(d->source);
+		free(d->target);
+		free(d);
+
+		pthread_mutex_lock(&w->mutex);
+		w->busy--;
+		if(w->busy == 0 && list_size(w->pending) == 0) {
+			pthread_cond_broadcast(&w->cond);
+		}
+	}
+	pthread_mutex_unlock(&w->mutex);
+
+	return NULL;
+}
+
+static int link_directory( const char *source, const char *target )
+{
+	struct link_walk w;
+
+	pthread_mutex_init(&w.mutex, NULL);
+	pthread_cond_init(&w.cond, NULL);
+	w.pending = list_create();
+	w.busy    = 0;
+	w.error   = 0;
+
+	mkdir(target, 0777);
+	walk_push(&w, source, target);
+
+	pthread_t threads[SANDBOX_THREADS_MAX];
+	int started = 0;
+	int i;
+
+	for(i = 1; i < sandbox_threads; i++) {
+		if(pthread_create(&threads[started], NULL, walk_thread, &w) != 0)
+			break;
+		started++;
+	}
+
+	walk_thread(&w);
+
+	for(i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	struct path_pair *d;
+	while((d = list_pop_head(w.pending))) {
+		free(d->source);
+		free(d->target);
+		free(d);
+	}
+	list_delete(w.pending);
+
+	pthread_cond_destroy(&w.cond);
+	pthread_mutex_destroy(&w.mutex);
+
+	if(w.error) {
+		errno = w.error;
+		return 0;
+	}
+
+	return 1;
+}
+
+int work_queue_sandbox_link( const char *source, const char *target )
+{
+	struct stat info;
+
+	if(stat(source,&info)<0) return 0;
+
+	if(S_ISDIR(info.st_mode)) {
+		return link_directory(source, target);
+	} else {
+		return link_file(source, target);
+	}
+}
+
+static const char *skip_dotslash( const char *s )
+{
+	while(!strncmp(s,"./",2)) s+=2;
+	return s;
+}
+
+/*
+A cached directory may be bind mounted only if the task does not expect
+to write into it, i.e., none of its outputs is inside the directory.
+*/
+
+static int can_bind_mount( struct work_queue_process *p, struct work_queue_file *f )
+{
+	if(sandbox_strategy != WORK_QUEUE_SANDBOX_AUTO)
+		return 0;
+
+	if(!(f->flags & WORK_QUEUE_CACHE))
+		return 0;
+
+	struct stat info;
+	if(stat(f->payload, &info) < 0 || !S_ISDIR(info.st_mode))
+		return 0;
+
+	struct work_queue_file *o;
+	int length = strlen(f->remote_name);
+
+	list_first_item(p->task->output_files);
+	while((o = list_next_item(p->task->output_files))) {
+		if(!strncmp(o->remote_name, f->remote_name, length) && (o->remote_name[length] == '/' || o->remote_name[length] == '\0')) {
+			return 0;
+		}
+	}
+
+	return work_queue_sandbox_bind_available();
+}
+
+static void add_bind_mount( struct work_queue_process *p, const char *source, const char *target )
+{
+	struct path_pair *m = xxmalloc(sizeof(*m));
+
+	char *cwd = path_getcwd();
+	m->source = source[0] == '/' ? xxstrdup(source) : string_format("%s/%s", cwd, source);
+	m->target = target[0] == '/' ? xxstrdup(target) : string_format("%s/%s", cwd, target);
+	free(cwd);
+
+	if(!p->bind_mounts) {
+		p->bind_mounts = list_create();
+	}
+
+	list_push_tail(p->bind_mounts, m);
+}
+
+int work_queue_sandbox_setup( struct work_queue_process *p )
+{
+	struct work_queue_file *f;
+	timestamp_t start = timestamp_get();
+	int mounts = 0;
+
+	list_first_item(p->task->input_files);
+	while((f = list_next_item(p->task->input_files))) {
+
+		char *sandbox_name = string_format("%s/%s",skip_dotslash(p->sandbox),f->remote_name);
+		int result = 0;
+
+		// remote name may contain relative path components, so create them in advance
+		create_dir_parents(sandbox_name,0777);
+
+		if(f->type == WORK_QUEUE_DIRECTORY) {
+			debug(D_WQ,"creating directory %s",sandbox_name);
+			result = create_dir(sandbox_name, 0700);
+			if(!result) debug(D_WQ,"couldn't create directory %s: %s", sandbox_name, strerror(errno));
+		} else if(can_bind_mount(p, f)) {
+			debug(D_WQ,"mounting %s at %s",f->payload,sandbox_name);
+			result = mkdir(sandbox_name, 0777) == 0 || errno == EEXIST;
+			if(result) {
+				add_bind_mount(p, skip_dotslash(f->payload), sandbox_name);
+				mounts++;
+			} else {
+				debug(D_WQ,"couldn't create mount point %s: %s", sandbox_name, strerror(errno));
+			}
+		} else {
+			debug(D_WQ,"linking %s to %s",f->payload,sandbox_name);
+			result = work_queue_sandbox_link(skip_dotslash(f->payload),skip_dotslash(sandbox_name));
+			if(!result) {
+				if(errno==EEXIST) {
+					// XXX silently ignore the case where the target file exists.
+					// This happens when masters apps map the same input file twice, or to the same name.
+					// Would be better to reject this at the master instead.
+					result = 1;
+				} else {
+					debug(D_WQ,"couldn't link %s into sandbox as %s: %s",f->payload,sandbox_name,strerror(errno));
+				}
+			}
+		}
+
+		free(sandbox_name);
+		if(!result) return 0;
+	}
+
+	p->sandbox_setup_time = timestamp_get() - start;
+
+	debug(D_WQ, "sandbox of task %d set up in %.3lfs (%d bind mounts)", p->task->taskid, p->sandbox_setup_time / 1000000.0, mounts);
+
+	return 1;
+}
+
+void work_queue_sandbox_mount( struct work_queue_process *p )
+{
+	struct path_pair *m;
+
+	if(!p->bind_mounts)
+		return;
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+	int private = enter_private_mount_namespace();
+#else
+	int private = 0;
+#endif
+
+	list_first_item(p->bind_mounts);
+	while((m = list_next_item(p->bind_mounts))) {
+#if defined(CCTOOLS_OPSYS_LINUX)
+		if(private && bind_mount_readonly(m->source, m->target))
+			continue;
+#endif
+		/* the mount point is an empty directory, so we can still link into it. */
+		debug(D_WQ, "couldn't mount %s at %s: %s, linking instead", m->source, m->target, strerror(errno));
+		if(!link_directory(m->source, m->target)) {
+			fatal("couldn't link %s into sandbox as %s: %s", m->source, m->target, strerror(errno));
+		}
+	}
+}
+
+void work_queue_sandbox_delete_mounts( struct list *mounts )
+{
+	struct path_pair *m;
+
+	if(!mounts)
+		return;
+
+	while((m = list_pop_head(mounts))) {
+		free(m->source);
+		free(m->target);
+		free(m);
+	}
+
+	list_delete(mounts);
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2018- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef WORK_QUEUE_SANDBOX_H
+#define WORK_QUEUE_SANDBOX_H
+
+#include "work_queue_process.h"
+
+/*
+work_queue_sandbox places the input files of a task from the cache
+directory into its sandbox. This object is private to the work_queue_worker.
+
+Files are hard linked, or cloned with a reflink when hard links fail
+(e.g. too many links to the file), or symlinked as a last resort.
+Directories are walked by several threads at once.
+
+When the worker may create mount namespaces (e.g. running as root),
+cached directories are instead bind mounted read-only into the sandbox,
+in a private mount namespace created for the task, so that the cost of
+placing a directory does not depend on the number of files in it.
+*/
+
+typedef enum {
+	WORK_QUEUE_SANDBOX_AUTO,     /* bind mount cached directories if possible, and link the rest. */
+	WORK_QUEUE_SANDBOX_LINK,     /* hard links, then reflinks, then symlinks. */
+	WORK_QUEUE_SANDBOX_REFLINK   /* reflinks, then hard links, then symlinks. */
+} work_queue_sandbox_strategy_t;
+
+/* Parse auto, link, or reflink. Returns 0 if the name is not known. */
+int work_queue_sandbox_strategy_parse( const char *name, work_queue_sandbox_strategy_t *strategy );
+
+/* Set how inputs are placed, and the number of threads linking a directory. */
+void work_queue_sandbox_configure( work_queue_sandbox_strategy_t strategy, int symlinks_enabled, int threads );
+
+/* Return true if the tasks may bind mount their cached directories. Probed only once. */
+int work_queue_sandbox_bind_available();
+
+/* Place source, a file or a directory, at target. Returns 0 and sets errno on failure. */
+int work_queue_sandbox_link( const char *source, const char *target );
+
+/*
+Place the input files of p into its sandbox, recording in p the bind mounts
+for the child to make and the time taken. Returns 0 on failure.
+*/
+int work_queue_sandbox_setup( struct work_queue_process *p );
+
+/* Called by the child process of the task, before changing into the sandbox. */
+void work_queue_sandbox_mount( struct work_queue_process *p );
+
+/* Free the list of bind mounts of a process. */
+void work_queue_sandbox_delete_mounts( struct list *mounts );
+
+#endif
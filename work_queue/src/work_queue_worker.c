@@ -11,6 +11,9 @@ See the file COPYING for details.
 #include "work_queue_process.h"
 #include "work_queue_catalog.h"
 #include "work_queue_watcher.h"
+#include "work_queue_cache.h"
+#include "work_queue_sandbox.h"
+#include "work_queue_compress.h"
 
 #include "cctools.h"
 #include "macros.h"
@@ -54,6 +57,7 @@ See the file COPYING for details.
 #include <time.h>
 
 #include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 
 #include <sys/mman.h>
@@ -128,9 +132,24 @@ char *password = 0;
 // Allow worker to use symlinks when link() fails.  Enabled by default.
 static int symlinks_enabled = 1;
 
+// How input files are placed into the sandboxes. See work_queue_sandbox.h
+static work_queue_sandbox_strategy_t sandbox_strategy = WORK_QUEUE_SANDBOX_AUTO;
+
 // Worker id. A unique id for this worker instance.
 static char *worker_id;
 
+// Extra connections to the master on which inputs are received in parallel.
+#define MAX_DATA_LINKS 16
+static int data_links_requested = 0;
+static int data_links_count = 0;
+static struct link *data_links[MAX_DATA_LINKS];
+
+// Serializes the bookkeeping of the files put by the data links.
+static pthread_mutex_t put_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Bytes of the puts being received, not yet in the cache index.
+static int64_t puts_reserved = 0;
+
 static worker_mode_t worker_mode = WORKER_MODE_WORKER;
 
 static container_mode_t container_mode = CONTAINER_MODE_NONE;
@@ -174,6 +193,8 @@ static int disk_allocation = 0;
 static int64_t files_counted = 0;
 
 static int check_resources_interval = 5;
+// Walk the cache directory this often to reconcile the cache index with the disk.
+static int disk_reconcile_interval = 300;
 static int max_time_on_measurement  = 3;
 
 static struct work_queue *foreman_q = NULL;
@@ -199,6 +220,15 @@ static struct list   *procs_waiting = NULL;
 // These are additional pointers into procs_table.
 static struct itable *procs_complete = NULL;
 
+// Index of the files in the cache directory, to evict the least recently used
+// when the cache goes over cache_budget bytes, or the disk fills up.
+static struct work_queue_cache *cache = NULL;
+static int64_t cache_budget = 0;
+
+// Whether the master accepts cache-invalidate messages. Older masters disconnect
+// workers that send them, so nothing is evicted until the master says so.
+static int master_accepts_invalidate = 0;
+
 static int results_to_be_sent_msg = 0;
 
 static timestamp_t total_task_execution_time = 0;
@@ -243,34 +273,137 @@ void reset_idle_timer()
 }
 
 /*
-   Measure the disk used by the worker. We only manually measure the cache directory, as processes measure themselves.
-   */
+Add to in_use the cache entries of the files of a task, which
+cannot be evicted while the task is at this worker.
+*/
+
+static void cache_entries_of_files( struct list *files, struct hash_table *in_use )
+{
+	char name[WORK_QUEUE_LINE_MAX];
+	struct work_queue_file *f;
+
+	if(!files)
+		return;
+
+	list_first_item(files);
+	while((f = list_next_item(files))) {
+		if(f->payload && !strncmp(f->payload, "cache/", 6)) {
+			work_queue_cache_entry_name(f->payload + 6, name, sizeof(name));
+			hash_table_insert(in_use, name, (void *) 1);
+		}
+	}
+}
+
+/*
+Evict the least recently used files that no task needs from the cache,
+until needed bytes are freed. The master is told about every file evicted,
+so that it sends it again to the tasks that need it.
+*/
+
+static int64_t cache_evict( struct link *master, int64_t needed )
+{
+	if(needed < 1)
+		return 0;
+
+	if(!master_accepts_invalidate) {
+		debug(D_WQ, "cannot evict %" PRId64 " bytes from the cache, as the master does not accept cache-invalidate", needed);
+		return 0;
+	}
+
+	struct hash_table *in_use = hash_table_create(0, 0);
+
+	struct work_queue_process *p;
+	uint64_t taskid;
+	itable_firstkey(procs_table);
+	while(itable_nextkey(procs_table, &taskid, (void **) &p)) {
+		cache_entries_of_files(p->task->input_files, in_use);
+		cache_entries_of_files(p->task->output_files, in_use);
+	}
+
+	struct list *evicted = list_create();
+	int64_t freed = work_queue_cache_evict(cache, needed, in_use, evicted);
+
+	char *name;
+	while((name = list_pop_head(evicted))) {
+		send_master_message(master, "cache-invalidate %s\n", name);
+		free(name);
+	}
+
+	list_delete(evicted);
+	hash_table_delete(in_use);
+
+	if(freed < needed) {
+		debug(D_WQ, "could only evict %" PRId64 " of %" PRId64 " bytes from the cache", freed, needed);
+	}
+
+	return freed;
+}
+
+/*
+Make room for a file of length bytes, first to stay within the cache budget,
+and then to keep the available disk above the threshold.
+The puts still being received count as already in the cache.
+Returns true if the file fits on disk.
+*/
+
+static int cache_make_room( struct link *master, int64_t length )
+{
+	length += puts_reserved;
+
+	cache_evict(master, work_queue_cache_excess(cache, length));
+
+	if(check_disk_space_for_filesize(".", length, disk_avail_threshold)) {
+		return 1;
+	}
+
+	UINT64_T disk_avail, disk_total;
+	host_disk_info_get(".", &disk_avail, &disk_total);
+
+	cache_evict(master, length + disk_avail_threshold - (int64_t) disk_avail);
+
+	return check_disk_space_for_filesize(".", length, disk_avail_threshold);
+}
+
+/*
+Measure the disk used by the worker. The cache index is kept up to date by
+the files put, fetched, unlinked, evicted, and left by tasks, so the cache
+directory is only walked every disk_reconcile_interval seconds, to account
+for what the index does not see, such as the files tasks leave in cache/tmp.
+Processes measure their own sandboxes.
+*/
 
 int64_t measure_worker_disk() {
 	static struct path_disk_size_info *state = NULL;
+	static time_t last_reconcile = 0;
+	static int64_t untracked_bytes = 0;
+	static int64_t untracked_files = 0;
+
+	/* continue a walk in progress, or start a new one when it is time. */
+	if((state && state->current_dirs) || time(0) >= last_reconcile + disk_reconcile_interval) {
+		path_disk_size_info_get_r("./cache", max_time_on_measurement, &state);
 
-	path_disk_size_info_get_r("./cache", max_time_on_measurement, &state);
+		if(state->complete_measurement && state->last_byte_size_complete >= 0) {
+			untracked_bytes = state->last_byte_size_complete - work_queue_cache_size(cache);
+			untracked_files = state->last_file_count_complete - work_queue_cache_file_count(cache);
+			last_reconcile = time(0);
 
-	int64_t disk_measured = 0;
-	if(state->last_byte_size_complete >= 0) {
-		disk_measured = (int64_t) ceil(state->last_byte_size_complete/(1.0*MEGA));
+			debug(D_WQ, "cache has %" PRId64 " bytes in %" PRId64 " files not accounted by the index", untracked_bytes, untracked_files);
+		}
 	}
 
-	files_counted = state->last_file_count_complete;
+	int64_t bytes = work_queue_cache_size(cache) + untracked_bytes;
+	int64_t disk_measured = (int64_t) ceil(MAX(0, bytes)/(1.0*MEGA));
 
-	if(state->complete_measurement) {
-		/* if a complete measurement has been done, then update
-		 * for the found value, and add the known values of the processes. */
+	files_counted = MAX(0, work_queue_cache_file_count(cache) + untracked_files);
 
-		struct work_queue_process *p;
-		uint64_t taskid;
+	struct work_queue_process *p;
+	uint64_t taskid;
 
-		itable_firstkey(procs_table);
-		while(itable_nextkey(procs_table,&taskid,(void**)&p)) {
-			if(p->sandbox_size > 0) {
-				disk_measured += p->sandbox_size;
-				files_counted += p->sandbox_file_count;
-			}
+	itable_firstkey(procs_table);
+	while(itable_nextkey(procs_table,&taskid,(void**)&p)) {
+		if(p->sandbox_size > 0) {
+			disk_measured += p->sandbox_size;
+			files_counted += p->sandbox_file_count;
 		}
 	}
 
@@ -420,84 +553,13 @@ static void report_worker_ready( struct link *master )
 	domain_name_cache_guess(hostname);
 	send_master_message(master,"workqueue %d %s %s %s %d.%d.%d\n",WORK_QUEUE_PROTOCOL_VERSION,hostname,os_name,arch_name,CCTOOLS_VERSION_MAJOR,CCTOOLS_VERSION_MINOR,CCTOOLS_VERSION_MICRO);
 	send_master_message(master, "info worker-id %s\n", worker_id);
+	send_master_message(master, "info compression gzip\n");
+	send_master_message(master, "info cache-invalidate supported\n");
 	send_keepalive(master, 1);
-}
 
-
-const char *skip_dotslash( const char *s )
-{
-	while(!strncmp(s,"./",2)) s+=2;
-	return s;
+	master_accepts_invalidate = 0;
 }
 
-/*
-Link a file from one place to another.
-If a hard link doesn't work, use a symbolic link.
-If it is a directory, do it recursively.
-*/
-
-int link_recursive( const char *source, const char *target )
-{
-	struct stat info;
-
-	if(stat(source,&info)<0) return 0;
-
-	if(S_ISDIR(info.st_mode)) {
-		DIR *dir = opendir(source);
-		if(!dir) return 0;
-
-		mkdir(target, 0777);
-
-		struct dirent *d;
-		int result = 1;
-
-		while((d = readdir(dir))) {
-			if(!strcmp(d->d_name,".")) continue;
-			if(!strcmp(d->d_name,"..")) continue;
-
-			char *subsource = string_format("%s/%s",source,d->d_name);
-			char *subtarget = string_format("%s/%s",target,d->d_name);
-
-			result = link_recursive(subsource,subtarget);
-
-			free(subsource);
-			free(subtarget);
-
-			if(!result) break;
-		}
-		closedir(dir);
-
-		return result;
-	} else {
-		if(link(source, target)==0) return 1;
-
-		/*
-		If the hard link failed, perhaps because the source
-		was a directory, or if hard links are not supported
-		in that file system, fall back to a symlink.
-		*/
-
-		if(symlinks_enabled) {
-
-			/*
-			Use an absolute path when symlinking, otherwise the link will
-			be accidentally relative to the current directory.
-			*/
-
-			char *cwd = path_getcwd();
-			char *absolute_source = string_format("%s/%s", cwd, source);
-
-			int result = symlink(absolute_source, target);
-
-			free(absolute_source);
-			free(cwd);
-
-			if(result==0) return 1;
-		}
-
-		return 0;
-	}
-}
 
 /*
 Start executing the given process on the local host,
@@ -545,7 +607,7 @@ static void report_task_complete( struct link *master, struct work_queue_process
 		fstat(p->output_fd, &st);
 		output_length = st.st_size;
 		lseek(p->output_fd, 0, SEEK_SET);
-		send_master_message(master, "result %d %d %lld %llu %d\n", p->task_status, p->exit_status, (long long) output_length, (unsigned long long) p->execution_end-p->execution_start, p->task->taskid);
+		send_master_message(master, "result %d %d %lld %llu %d %llu\n", p->task_status, p->exit_status, (long long) output_length, (unsigned long long) p->execution_end-p->execution_start, p->task->taskid, (unsigned long long) p->sandbox_setup_time);
 		link_stream_from_fd(master, p->output_fd, output_length, time(0)+active_timeout);
 
 		total_task_execution_time += (p->execution_end - p->execution_start);
@@ -557,7 +619,7 @@ static void report_task_complete( struct link *master, struct work_queue_process
 		} else {
 			output_length = 0;
 		}
-		send_master_message(master, "result %d %d %lld %llu %d\n", t->result, t->return_status, (long long) output_length, (unsigned long long) t->time_workers_execute_last, t->taskid);
+		send_master_message(master, "result %d %d %lld %llu %d %llu\n", t->result, t->return_status, (long long) output_length, (unsigned long long) t->time_workers_execute_last, t->taskid, (unsigned long long) t->time_workers_sandbox_last);
 		if(output_length) {
 			link_putlstring(master, t->output, output_length, time(0)+active_timeout);
 		}
@@ -692,6 +754,8 @@ static int handle_tasks(struct link *master)
 					}
 				}
 
+				work_queue_cache_update(cache, f->payload + 6, f->flags & WORK_QUEUE_CACHE);
+
 				free(sandbox_name);
 			}
 
@@ -708,7 +772,9 @@ static int handle_tasks(struct link *master)
  * Format:
  * 		for a directory: a new line in the format of "dir $DIR_NAME 0"
  * 		for a file: a new line in the format of "file $FILE_NAME $FILE_LENGTH"
- * 					then file contents.
+ * 					then file contents. If the master asked for gzip, files of
+ * 					at least the size it gave are sent as "file $FILE_NAME $FILE_LENGTH gzip",
+ * 					then the contents as a stream of gzip chunks (see work_queue_compress.h).
  * 		string "end" at the end of the stream (on a new line).
  *
  * Example:
@@ -738,7 +804,7 @@ static int handle_tasks(struct link *master)
  * end
  *
  */
-static int stream_output_item(struct link *master, const char *filename, int recursive)
+static int stream_output_item(struct link *master, const char *filename, int recursive, int64_t gzip_min_size)
 {
 	DIR *dir;
 	struct dirent *dent;
@@ -766,14 +832,23 @@ static int stream_output_item(struct link *master, const char *filename, int rec
 			if(!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, ".."))
 				continue;
 			sprintf(dentline, "%s/%s", filename, dent->d_name);
-			stream_output_item(master, dentline, recursive);
+			stream_output_item(master, dentline, recursive, gzip_min_size);
 		}
 
 		closedir(dir);
 	} else {
 		// stream a file
 		fd = open(cached_filename, O_RDONLY, 0);
-		if(fd >= 0) {
+		if(fd >= 0 && gzip_min_size >= 0 && info.st_size >= gzip_min_size) {
+			length = info.st_size;
+			send_master_message(master, "file %s %"PRId64" gzip\n", filename, length);
+			actual = work_queue_compress_send(master, fd, length, WORK_QUEUE_COMPRESS_LEVEL, time(0) + active_timeout, NULL);
+			close(fd);
+			if(actual < 0) {
+				debug(D_WQ, "Sending back compressed output file - %s failed.", filename);
+				return 0;
+			}
+		} else if(fd >= 0) {
 			length = info.st_size;
 			send_master_message(master, "file %s %"PRId64"\n", filename, length);
 			actual = link_stream_from_fd(master, fd, length, time(0) + active_timeout);
@@ -794,50 +869,6 @@ failure:
 	return 0;
 }
 
-/*
-For each of the files and directories needed by a task, link
-them into the sandbox.  Return true if successful.
-*/
-
-int setup_sandbox( struct work_queue_process *p )
-{
-	struct work_queue_file *f;
-
-	list_first_item(p->task->input_files);
-	while((f = list_next_item(p->task->input_files))) {
-
-		char *sandbox_name = string_format("%s/%s",skip_dotslash(p->sandbox),f->remote_name);
-		int result = 0;
-
-		// remote name may contain relative path components, so create them in advance
-		create_dir_parents(sandbox_name,0777);
-
-		if(f->type == WORK_QUEUE_DIRECTORY) {
-			debug(D_WQ,"creating directory %s",sandbox_name);
-			result = create_dir(sandbox_name, 0700);
-			if(!result) debug(D_WQ,"couldn't create directory %s: %s", sandbox_name, strerror(errno));
-		} else {
-			debug(D_WQ,"linking %s to %s",f->payload,sandbox_name);
-			result = link_recursive(skip_dotslash(f->payload),skip_dotslash(sandbox_name));
-			if(!result) {
-				if(errno==EEXIST) {
-					// XXX silently ignore the case where the target file exists.
-					// This happens when masters apps map the same input file twice, or to the same name.
-					// Would be better to reject this at the master instead.
-					result = 1;
-				} else {
-					debug(D_WQ,"couldn't link %s into sandbox as %s: %s",f->payload,sandbox_name,strerror(errno));
-				}
-			}
-		}
-
-		free(sandbox_name);
-		if(!result) return 0;
-	}
-
-	return 1;
-}
-
 /*
 For a task run locally, if the resources are all set to -1,
 then assume that the task occupies all worker resources.
@@ -861,6 +892,8 @@ static void normalize_resources( struct work_queue_process *p )
 	}
 }
 
+void forsake_waiting_process(struct link *master, struct work_queue_process *p);
+
 /*
 Handle an incoming task message from the master.
 Generate a work_queue_process wrapped around a work_queue_task,
@@ -878,6 +911,7 @@ static int do_task( struct link *master, int taskid, time_t stoptime )
 	int flags, length;
 	int64_t n;
 	int disk_alloc = disk_allocation;
+	int inputs_evicted = 0;
 
 	timestamp_t nt;
 
@@ -900,6 +934,11 @@ static int do_task( struct link *master, int taskid, time_t stoptime )
 			sprintf(localname, "cache/%s", filename);
 			url_decode(taskname_encoded, taskname, WORK_QUEUE_LINE_MAX);
 			work_queue_task_specify_file(task, localname, taskname, WORK_QUEUE_INPUT, flags);
+			work_queue_cache_touch(cache, filename);
+			if(work_queue_cache_was_evicted(cache, filename)) {
+				debug(D_WQ, "input %s of task %d was evicted from the cache", filename, taskid);
+				inputs_evicted = 1;
+			}
 		} else if(sscanf(line,"outfile %s %s %d", filename, taskname_encoded, &flags)) {
 			sprintf(localname, "cache/%s", filename);
 			url_decode(taskname_encoded, taskname, WORK_QUEUE_LINE_MAX);
@@ -937,6 +976,9 @@ static int do_task( struct link *master, int taskid, time_t stoptime )
 
 	last_task_received = task->taskid;
 
+	// The files sent for this task are now protected by its references.
+	work_queue_cache_unpin(cache);
+
 	struct work_queue_process *p = work_queue_process_create(task, disk_alloc);
 
 	if(!p) {
@@ -946,12 +988,20 @@ static int do_task( struct link *master, int taskid, time_t stoptime )
 	// Every received task goes into procs_table.
 	itable_insert(procs_table,taskid,p);
 
+	if(inputs_evicted) {
+		// The master sent the task before learning about the eviction.
+		// It will send the task again, along with the evicted files.
+		work_queue_watcher_add_process(watcher,p);
+		forsake_waiting_process(master,p);
+		return 1;
+	}
+
 	if(worker_mode==WORKER_MODE_FOREMAN) {
 		work_queue_submit_internal(foreman_q,task);
 	} else {
 		// XXX sandbox setup should be done in task execution,
 		// so that it can be returned cleanly as a failure to execute.
-		if(!setup_sandbox(p)) {
+		if(!work_queue_sandbox_setup(p)) {
 			itable_remove(procs_table,taskid);
 			work_queue_process_delete(p);
 			return 0;
@@ -966,31 +1016,22 @@ static int do_task( struct link *master, int taskid, time_t stoptime )
 }
 
 /*
-Handle an incoming "put" message from the master,
-which places a file into the cache directory.
+Receive the contents of a put from source into the cache directory.
 */
 
-static int do_put( struct link *master, char *filename, int64_t length, int mode )
+static int receive_put( struct link *source, const char *filename, int64_t length, int mode, int gzip )
 {
 	char cached_filename[WORK_QUEUE_LINE_MAX];
+	const char *name = filename;
 	char *cur_pos;
 
-	debug(D_WQ, "Putting file %s into workspace\n", filename);
-	if(!check_disk_space_for_filesize(".", length, disk_avail_threshold)) {
-		debug(D_WQ, "Could not put file %s, not enough disk space (%"PRId64" bytes needed)\n", filename, length);
-		return 0;
-	}
-
-
 	mode = mode | 0600;
 
-	cur_pos = filename;
-
-	while(!strncmp(cur_pos, "./", 2)) {
-		cur_pos += 2;
+	while(!strncmp(name, "./", 2)) {
+		name += 2;
 	}
 
-	sprintf(cached_filename, "cache/%s", cur_pos);
+	sprintf(cached_filename, "cache/%s", name);
 
 	cur_pos = strrchr(cached_filename, '/');
 	if(cur_pos) {
@@ -1008,7 +1049,12 @@ static int do_put( struct link *master, char *filename, int64_t length, int mode
 		return 0;
 	}
 
-	int64_t actual = link_stream_to_fd(master, fd, length, time(0) + active_timeout);
+	int64_t actual;
+	if(gzip) {
+		actual = work_queue_compress_recv(source, fd, 1, time(0) + active_timeout, NULL);
+	} else {
+		actual = link_stream_to_fd(source, fd, length, time(0) + active_timeout);
+	}
 	close(fd);
 	if(actual != length) {
 		debug(D_WQ, "Failed to put file - %s (%s)\n", filename, strerror(errno));
@@ -1018,6 +1064,160 @@ static int do_put( struct link *master, char *filename, int64_t length, int mode
 	return 1;
 }
 
+/*
+Handle an incoming "put" message from the master,
+which places a file into the cache directory.
+The contents are read from source, which is either the master
+link or one of the data links. The length of the file is reserved
+while it is received, so that concurrent puts do not overcommit the disk.
+*/
+
+static int do_put( struct link *master, struct link *source, char *filename, int64_t length, int mode, int flags, int gzip )
+{
+	debug(D_WQ, "Putting file %s into workspace\n", filename);
+
+	pthread_mutex_lock(&put_mutex);
+	int has_room = cache_make_room(master, length);
+	if(has_room) {
+		puts_reserved += length;
+	}
+	pthread_mutex_unlock(&put_mutex);
+
+	if(!has_room) {
+		debug(D_WQ, "Could not put file %s, not enough disk space (%"PRId64" bytes needed)\n", filename, length);
+		return 0;
+	}
+
+	int result = receive_put(source, filename, length, mode, gzip);
+
+	pthread_mutex_lock(&put_mutex);
+	puts_reserved -= length;
+	if(result) {
+		work_queue_cache_add(cache, filename, length, flags & WORK_QUEUE_CACHE);
+	}
+	pthread_mutex_unlock(&put_mutex);
+
+	return result;
+}
+
+struct batch_link {
+	struct link *master;
+	struct link *link;
+	int result;
+};
+
+/*
+Receive puts on one data link until the master ends the batch on it.
+*/
+
+static void *batch_thread( void *arg )
+{
+	struct batch_link *b = arg;
+	char line[WORK_QUEUE_LINE_MAX];
+	char filename[WORK_QUEUE_LINE_MAX];
+	char path[WORK_QUEUE_LINE_MAX];
+	int64_t length;
+	int mode, flags, n;
+
+	b->result = 1;
+
+	while(b->result) {
+		if(!link_readline(b->link, line, sizeof(line), time(0) + active_timeout)) {
+			debug(D_WQ, "Failed to read from data link.\n");
+			b->result = 0;
+		} else if(!strcmp(line, "end")) {
+			break;
+		} else if((n = sscanf(line, "put %s %" SCNd64 " %o %d %s", filename, &length, &mode, &flags, path)) >= 4) {
+			if(path_within_dir(filename, workspace)) {
+				b->result = do_put(b->master, b->link, filename, length, mode, flags, n == 5 && !strcmp(path, "gzip"));
+			} else {
+				debug(D_WQ, "Path - %s is not within workspace %s.", filename, workspace);
+				b->result = 0;
+			}
+		} else {
+			debug(D_WQ, "Unrecognized data link message: %s.\n", line);
+			b->result = 0;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+Handle an incoming "batch" message from the master, which sends the
+files that follow on all of the data links at once, each one ended by
+an "end" line.
+*/
+
+static int do_batch( struct link *master, int nfiles )
+{
+	struct batch_link batch[MAX_DATA_LINKS];
+	pthread_t threads[MAX_DATA_LINKS];
+	int i, started, result = 1;
+
+	if(data_links_count < 1) {
+		debug(D_WQ, "master sent a batch, but there are no data links.\n");
+		return 0;
+	}
+
+	debug(D_WQ, "Receiving %d files on %d data links\n", nfiles, data_links_count);
+
+	for(started = 0; started < data_links_count; started++) {
+		batch[started].master = master;
+		batch[started].link   = data_links[started];
+		if(pthread_create(&threads[started], NULL, batch_thread, &batch[started]) != 0) {
+			debug(D_WQ, "Could not start data link thread: %s\n", strerror(errno));
+			result = 0;
+			break;
+		}
+	}
+
+	for(i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+		if(!batch[i].result)
+			result = 0;
+	}
+
+	return result;
+}
+
+/*
+Open the data links to the master, after the worker has reported its id on
+the main link. The master uses them once all of them are connected, and
+otherwise sends every file on the main link.
+*/
+
+static void connect_data_links( int port )
+{
+	while(data_links_count < data_links_requested) {
+		struct link *l = link_connect(current_master_address->addr, port, idle_stoptime);
+		if(!l) {
+			debug(D_WQ, "couldn't open data link to %s:%d: %s", current_master_address->addr, port, strerror(errno));
+			break;
+		}
+
+		if(password && !link_auth_password(l, password, idle_stoptime)) {
+			link_close(l);
+			break;
+		}
+
+		link_tune(l, LINK_TUNE_BULK);
+		data_links[data_links_count++] = l;
+	}
+
+	int i;
+	for(i = 0; i < data_links_count; i++) {
+		send_master_message(data_links[i], "datalink %s %d\n", worker_id, data_links_count);
+	}
+}
+
+static void disconnect_data_links()
+{
+	while(data_links_count > 0) {
+		link_close(data_links[--data_links_count]);
+	}
+}
+
 static int file_from_url(const char *url, const char *filename) {
 
 		debug(D_WQ, "Retrieving %s from (%s)\n", filename, url);
@@ -1034,7 +1234,7 @@ static int file_from_url(const char *url, const char *filename) {
 		return 1;
 }
 
-static int do_url(struct link* master, const char *filename, int length, int mode) {
+static int do_url(struct link* master, const char *filename, int length, int mode, int flags) {
 
 		char url[WORK_QUEUE_LINE_MAX];
 		link_read(master, url, length, time(0) + active_timeout);
@@ -1042,7 +1242,15 @@ static int do_url(struct link* master, const char *filename, int length, int mod
 		char cache_name[WORK_QUEUE_LINE_MAX];
 		snprintf(cache_name,WORK_QUEUE_LINE_MAX, "cache/%s", filename);
 
-		return file_from_url(url, cache_name);
+		cache_make_room(master, 0);
+
+		if(!file_from_url(url, cache_name)) {
+			return 0;
+		}
+
+		work_queue_cache_add(cache, filename, -1, flags & WORK_QUEUE_CACHE);
+
+		return 1;
 }
 
 static int do_unlink(const char *path) {
@@ -1060,11 +1268,12 @@ static int do_unlink(const char *path) {
 		// Failed to do unlink
 		return 0;
 	}
+	work_queue_cache_remove(cache, path);
 	return 1;
 }
 
-static int do_get(struct link *master, const char *filename, int recursive) {
-	stream_output_item(master, filename, recursive);
+static int do_get(struct link *master, const char *filename, int recursive, int64_t gzip_min_size) {
+	stream_output_item(master, filename, recursive, gzip_min_size);
 	send_master_message(master, "end\n");
 	return 1;
 }
@@ -1125,6 +1334,10 @@ static int do_thirdget(int mode, char *filename, const char *path) {
 		}
 		break;
 	}
+
+	// thirdget does not tell whether the file is cached, so it is never evicted.
+	work_queue_cache_add(cache, filename, -1, 0);
+
 	return 1;
 }
 
@@ -1403,16 +1616,19 @@ static int handle_master(struct link *master) {
 	if(recv_master_message(master, line, sizeof(line), idle_stoptime )) {
 		if(sscanf(line,"task %" SCNd64, &taskid)==1) {
 			r = do_task(master, taskid,time(0)+active_timeout);
-		} else if((n = sscanf(line, "put %s %" SCNd64 " %o %d", filename, &length, &mode, &flags)) >= 3) {
+		} else if((n = sscanf(line, "put %s %" SCNd64 " %o %d %s", filename, &length, &mode, &flags, path)) >= 3) {
 			if(path_within_dir(filename, workspace)) {
-				r = do_put(master, filename, length, mode);
+				r = do_put(master, master, filename, length, mode, flags, n == 5 && !strcmp(path, "gzip"));
 				reset_idle_timer();
 			} else {
 				debug(D_WQ, "Path - %s is not within workspace %s.", filename, workspace);
 				r = 0;
 			}
-		} else if(sscanf(line, "url %s %" SCNd64 " %o", filename, &length, &mode) == 3) {
-			r = do_url(master, filename, length, mode);
+		} else if(sscanf(line, "batch %d", &n) == 1) {
+			r = do_batch(master, n);
+			reset_idle_timer();
+		} else if(sscanf(line, "url %s %" SCNd64 " %o %d", filename, &length, &mode, &flags) >= 3) {
+			r = do_url(master, filename, length, mode, flags);
 			reset_idle_timer();
 		} else if(sscanf(line, "unlink %s", filename) == 1) {
 			if(path_within_dir(filename, workspace)) {
@@ -1421,8 +1637,12 @@ static int handle_master(struct link *master) {
 				debug(D_WQ, "Path - %s is not within workspace %s.", filename, workspace);
 				r= 0;
 			}
-		} else if(sscanf(line, "get %s %d", filename, &mode) == 2) {
-			r = do_get(master, filename, mode);
+		} else if((n = sscanf(line, "get %s %d %s %" SCNd64, filename, &mode, path, &length)) >= 2) {
+			/* get name recursive [gzip [min_size]] */
+			int64_t gzip_min_size = -1;
+			if(n >= 3 && !strcmp(path, "gzip"))
+				gzip_min_size = n == 4 ? length : 0;
+			r = do_get(master, filename, mode, gzip_min_size);
 		} else if(sscanf(line, "thirdget %o %s %[^\n]", &mode, filename, path) == 3) {
 			r = do_thirdget(mode, filename, path);
 		} else if(sscanf(line, "thirdput %o %s %[^\n]", &mode, filename, path) == 3) {
@@ -1451,6 +1671,9 @@ static int handle_master(struct link *master) {
 		} else if(sscanf(line, "send_results %d", &n) == 1) {
 			report_tasks_complete(master);
 			r = 1;
+		} else if(!strcmp(line, "cache-invalidate accepted")) {
+			master_accepts_invalidate = 1;
+			r = 1;
 		} else {
 			debug(D_WQ, "Unrecognized master message: %s.\n", line);
 			r = 0;
@@ -1627,6 +1850,9 @@ static void work_for_master(struct link *master) {
 			ok &= handle_master(master);
 		}
 
+		// Files released by tasks, or left by them, may put the cache over budget.
+		cache_evict(master, work_queue_cache_excess(cache, 0));
+
 		expire_procs_running();
 
 		ok &= handle_tasks(master);
@@ -1816,6 +2042,7 @@ static void workspace_cleanup()
 {
 	debug(D_WQ,"cleaning workspace %s",workspace);
 	delete_dir_contents(workspace);
+	work_queue_cache_clear(cache);
 }
 
 /*
@@ -1837,6 +2064,7 @@ static void workspace_delete()
 	if(procs_waiting)      list_delete(procs_waiting);
 
 	if(watcher)            work_queue_watcher_delete(watcher);
+	if(cache)              work_queue_cache_delete(cache);
 
 	printf( "work_queue_worker: deleting workspace %s\n", workspace);
 
@@ -1909,6 +2137,8 @@ static int serve_master_by_hostport( const char *host, int port, const char *ver
 
 	report_worker_ready(master);
 
+	connect_data_links(port);
+
 	if(worker_mode == WORKER_MODE_FOREMAN) {
 		foreman_for_master(master);
 	} else {
@@ -1923,6 +2153,7 @@ static int serve_master_by_hostport( const char *host, int port, const char *ver
 	results_to_be_sent_msg = 0;
 
 	workspace_cleanup();
+	disconnect_data_links();
 	disconnect_master(master);
 	printf("disconnected from master %s:%d\n", host, port );
 
@@ -2170,6 +2401,8 @@ static void show_help(const char *cmd)
 	printf( " %-30s clean up and reconnect. (default=%" PRIu64 "MB)\n", "", disk_avail_threshold);
 	printf( " %-30s Set available memory size threshold (in MB). When exceeded worker will\n", "--memory-threshold=<size>");
 	printf( " %-30s clean up and reconnect. (default=%" PRIu64 "MB)\n", "", memory_avail_threshold);
+	printf( " %-30s Evict the least recently used cached files not needed by any task\n", "--cache-budget=<size>");
+	printf( " %-30s when the cache grows over this size (in MB). (default=no limit)\n", "");
 	printf( " %-30s Set architecture string for the worker to report to master instead\n", "-A,--arch=<arch>");
 	printf( " %-30s of the value in uname (%s).\n", "", arch_name);
 	printf( " %-30s Set operating system string for the worker to report to master instead\n", "-O,--os=<os>");
@@ -2186,6 +2419,9 @@ static void show_help(const char *cmd)
 	printf( " %-30s Use loop devices for task sandboxes (default=disabled, requires root access).\n", "--disk-allocation");
 	printf( " %-30s Set the maximum number of seconds the worker may be active. (in s).\n", "--wall-time=<s>");
 	printf( " %-30s Forbid the use of symlinks for cache management.\n", "--disable-symlinks");
+	printf( " %-30s How to place inputs into task sandboxes: auto, link, or reflink.\n", "--sandbox-strategy=<s>");
+	printf( " %-30s auto bind mounts cached directories when possible. (default=auto)\n", "");
+	printf( " %-30s Open <n> extra connections to receive inputs in parallel. (default=0, max=%d)\n", "--data-links=<n>", MAX_DATA_LINKS);
 	printf(" %-30s Single-shot mode -- quit immediately after disconnection.\n", "--single-shot");
 	printf(" %-30s docker mode -- run each task with a container based on this docker image.\n", "--docker=<image>");
 	printf(" %-30s docker-preserve mode -- tasks execute by a worker share a container based on this docker image.\n", "--docker-preserve=<image>");
@@ -2198,7 +2434,8 @@ enum {LONG_OPT_DEBUG_FILESIZE = 256, LONG_OPT_VOLATILITY, LONG_OPT_BANDWIDTH,
 	  LONG_OPT_DISK, LONG_OPT_GPUS, LONG_OPT_FOREMAN, LONG_OPT_FOREMAN_PORT, LONG_OPT_DISABLE_SYMLINKS,
 	  LONG_OPT_IDLE_TIMEOUT, LONG_OPT_CONNECT_TIMEOUT, LONG_OPT_RUN_DOCKER, LONG_OPT_RUN_DOCKER_PRESERVE,
 	  LONG_OPT_BUILD_FROM_TAR, LONG_OPT_SINGLE_SHOT, LONG_OPT_WALL_TIME, LONG_OPT_DISK_ALLOCATION,
-	  LONG_OPT_MEMORY_THRESHOLD};
+	  LONG_OPT_MEMORY_THRESHOLD, LONG_OPT_CACHE_BUDGET, LONG_OPT_SANDBOX_STRATEGY,
+	  LONG_OPT_DATA_LINKS};
 
 static const struct option long_options[] = {
 	{"advertise",           no_argument,        0,  'a'},
@@ -2226,6 +2463,9 @@ static const struct option long_options[] = {
 	{"disable-symlinks",    no_argument,        0,  LONG_OPT_DISABLE_SYMLINKS},
 	{"disk-threshold",      required_argument,  0,  'z'},
 	{"memory-threshold",    required_argument,  0,  LONG_OPT_MEMORY_THRESHOLD},
+	{"cache-budget",        required_argument,  0,  LONG_OPT_CACHE_BUDGET},
+	{"sandbox-strategy",    required_argument,  0,  LONG_OPT_SANDBOX_STRATEGY},
+	{"data-links",          required_argument,  0,  LONG_OPT_DATA_LINKS},
 	{"arch",                required_argument,  0,  'A'},
 	{"os",                  required_argument,  0,  'O'},
 	{"workdir",             required_argument,  0,  's'},
@@ -2359,6 +2599,22 @@ int main(int argc, char *argv[])
 		case LONG_OPT_MEMORY_THRESHOLD:
 			memory_avail_threshold = atoll(optarg);
 			break;
+		case LONG_OPT_CACHE_BUDGET:
+			cache_budget = atoll(optarg) * MEGA;
+			break;
+		case LONG_OPT_SANDBOX_STRATEGY:
+			if(!work_queue_sandbox_strategy_parse(optarg, &sandbox_strategy)) {
+				fprintf(stderr, "work_queue_worker: unknown sandbox strategy %s (use auto, link, or reflink)\n", optarg);
+				exit(1);
+			}
+			break;
+		case LONG_OPT_DATA_LINKS:
+			data_links_requested = atoi(optarg);
+			if(data_links_requested < 0 || data_links_requested > MAX_DATA_LINKS) {
+				fprintf(stderr, "work_queue_worker: --data-links must be between 0 and %d\n", MAX_DATA_LINKS);
+				exit(1);
+			}
+			break;
 		case 'A':
 			free(arch_name); //free the arch string obtained from uname
 			arch_name = xxstrdup(optarg);
@@ -2625,6 +2881,15 @@ int main(int argc, char *argv[])
 
 	watcher = work_queue_watcher_create();
 
+	cache = work_queue_cache_create("cache");
+	work_queue_cache_set_budget(cache, cache_budget);
+
+	// Tasks in containers do not see the mounts of the worker.
+	if(container_mode != CONTAINER_MODE_NONE && sandbox_strategy == WORK_QUEUE_SANDBOX_AUTO) {
+		sandbox_strategy = WORK_QUEUE_SANDBOX_LINK;
+	}
+	work_queue_sandbox_configure(sandbox_strategy, symlinks_enabled, 4);
+
 	if(!check_disk_space_for_filesize(".", 0, disk_avail_threshold)) {
 		fprintf(stderr,"work_queue_worker: %s has less than minimum disk space %"PRIu64" MB\n",workspace,disk_avail_threshold);
 		return 1;
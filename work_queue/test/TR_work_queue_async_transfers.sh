@@ -0,0 +1,121 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:$PATH
+
+exe="work_queue_async_transfers.test"
+
+prepare()
+{
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libwork_queue.a ../../dttools/src/libdttools.a -lz -lpthread -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "work_queue.h"
+
+/*
+Run 20 tasks on two workers, retrieving their outputs, a file and a directory
+each, in the background, one at a time. Every fifth task has an output that is
+missing.
+*/
+
+int main(int argc, char *argv[])
+{
+	debug_config_file("master.log");
+	debug_flags_set("wq");
+
+	struct work_queue *q = work_queue_create(0);
+	if(!q) return 1;
+
+	work_queue_tune(q, "async-transfers", 1);
+	work_queue_tune(q, "max-retrievals", 1);
+
+	FILE *f = fopen("master.port", "w");
+	fprintf(f, "%d\n", work_queue_port(q));
+	fclose(f);
+
+	int i;
+	for(i = 0; i < 20; i++) {
+		char output[64];
+		char outdir[64];
+		sprintf(output, "async.output.%d", i);
+		sprintf(outdir, "async.dir.%d", i);
+
+		struct work_queue_task *t = work_queue_task_create(i % 5 ? "dd if=/dev/zero of=out bs=1024 count=512 2> /dev/null; mkdir d; echo a > d/a; echo b > d/b" : "mkdir d; echo a > d/a");
+		work_queue_task_specify_file(t, output, "out", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE);
+		work_queue_task_specify_directory(t, outdir, "d", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE, 1);
+		work_queue_submit(q, t);
+	}
+
+	int missing = 0;
+	while(!work_queue_empty(q)) {
+		struct work_queue_task *t = work_queue_wait(q, 5);
+		if(t) {
+			if(t->result == WORK_QUEUE_RESULT_OUTPUT_MISSING) {
+				missing++;
+			} else if(t->result != WORK_QUEUE_RESULT_SUCCESS || t->return_status != 0) {
+				return 1;
+			}
+			work_queue_task_delete(t);
+		}
+	}
+
+	work_queue_delete(q);
+
+	printf("%d tasks with missing outputs\n", missing);
+
+	return missing != 4;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" &
+	master=$!
+	wait_for_file_creation master.port 5
+
+	work_queue_worker localhost `cat master.port` --timeout 10 --single-shot > /dev/null &
+	work_queue_worker localhost `cat master.port` --timeout 10 --single-shot > /dev/null
+
+	wait $master || return 1
+
+	for i in `seq 0 19`
+	do
+		if [ "`cat async.dir.$i/a`" != a ]
+		then
+			echo "outputs of task $i were not retrieved"
+			return 1
+		fi
+
+		if [ `expr $i % 5` != 0 ] && [ "`wc -c < async.output.$i`" != 524288 ]
+		then
+			echo "output of task $i is incomplete"
+			return 1
+		fi
+	done
+
+	grep "in the background" master.log > /dev/null || return 1
+
+	# messages to a worker during a retrieval are queued, not waited for.
+	if grep "waiting for the retrieval" master.log > /dev/null
+	then
+		echo "the master waited for a retrieval"
+		return 1
+	fi
+
+	return 0
+}
+
+clean()
+{
+	rm -rf "$exe" async.output.* async.dir.* master.port master.log
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,74 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:$PATH
+
+prepare()
+{
+	echo "nothing to do"
+}
+
+run()
+{
+	# each submit creates a new cached input of 1 MB, so a worker with a
+	# budget of 2 MB has to evict the inputs of the earlier batches.
+	cat > master.script << EOF
+submit 1 0 1 2
+wait
+submit 1 0 1 2
+wait
+submit 1 0 1 2
+wait
+submit 1 0 1 2
+wait
+quit
+EOF
+
+	echo "starting master"
+	work_queue_test -d all -o master.log -Z master.port < master.script &
+
+	echo "waiting for master to get ready"
+	wait_for_file_creation master.port 5
+
+	echo "starting worker"
+	work_queue_worker -d all -o worker.log localhost `cat master.port` --timeout 10 --cores 1 --memory-threshold 10 --memory 50 --cache-budget 2 --single-shot
+
+	echo "checking for output"
+	i=0
+	while [ $i -lt 8 ]
+	do
+		file=output.$i
+		if [ ! -f $file ]
+		then
+			echo "$file is missing!"
+			return 1
+		fi
+		i=$((i+1))
+	done
+
+	echo "checking for evictions"
+	if ! grep -q "evicted file-0-.*from the cache" worker.log
+	then
+		echo "worker did not evict any file"
+		return 1
+	fi
+
+	if ! grep -q "rx from .*: cache-invalidate file-0-" master.log
+	then
+		echo "master was not told about the evictions"
+		return 1
+	fi
+
+	echo "all output present, and cache evicted"
+	return 0
+}
+
+clean()
+{
+	rm -f master.script master.log master.port worker.log output.* input.*
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,91 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:$PATH
+
+exe="work_queue_compress.test"
+
+prepare()
+{
+	seq 1 200000 > compress.input
+
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libwork_queue.a ../../dttools/src/libdttools.a -lz -lpthread -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "work_queue.h"
+
+/* Send an input and get an output back, both compressed on the link. */
+
+int main(int argc, char *argv[])
+{
+	debug_config_file("master.log");
+	debug_flags_set("wq");
+
+	struct work_queue *q = work_queue_create(0);
+	if(!q) return 1;
+
+	FILE *f = fopen("master.port", "w");
+	fprintf(f, "%d\n", work_queue_port(q));
+	fclose(f);
+
+	struct work_queue_task *t = work_queue_task_create("sort -rn in > out");
+	work_queue_task_specify_file(t, "compress.input", "in", WORK_QUEUE_INPUT, WORK_QUEUE_CACHE | WORK_QUEUE_COMPRESS);
+	work_queue_task_specify_file(t, "compress.output", "out", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE | WORK_QUEUE_COMPRESS);
+	work_queue_submit(q, t);
+
+	t = work_queue_wait(q, 30);
+	if(!t || t->result != WORK_QUEUE_RESULT_SUCCESS || t->return_status != 0) return 1;
+
+	printf("sent %lld bytes, received %lld bytes\n", (long long) t->bytes_sent, (long long) t->bytes_received);
+
+	work_queue_task_delete(t);
+	work_queue_delete(q);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" &
+	wait_for_file_creation master.port 5
+
+	work_queue_worker localhost `cat master.port` --timeout 10 --single-shot > /dev/null
+
+	wait $! || return 1
+
+	if ! sort -rn compress.input | cmp - compress.output
+	then
+		echo "output does not match"
+		return 1
+	fi
+
+	if ! grep -q "tx to .*: put .* gzip" master.log
+	then
+		echo "input was not compressed"
+		return 1
+	fi
+
+	if ! grep -q "rx from .*: file .* gzip" master.log
+	then
+		echo "output was not compressed"
+		return 1
+	fi
+
+	return 0
+}
+
+clean()
+{
+	rm -f "$exe" compress.input compress.output master.port master.log
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,121 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:$PATH
+
+exe="work_queue_data_links.test"
+
+prepare()
+{
+	rm -rf datalinks.input
+	mkdir -p datalinks.input/dir
+	for f in `seq 1 40`
+	do
+		echo "file $f" > datalinks.input/file.$f
+		echo "dir file $f" > datalinks.input/dir/file.$f
+	done
+	dd if=/dev/zero of=datalinks.input/large bs=1024 count=4096 2> /dev/null
+
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libwork_queue.a ../../dttools/src/libdttools.a -lz -lpthread -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "work_queue.h"
+
+/*
+Send two tasks, each with 40 files, a directory with 40 more files, and a
+large file. The second task finds the cached files at the worker, and only
+receives the ones that are not cached.
+*/
+
+int main(int argc, char *argv[])
+{
+	debug_config_file("master.log");
+	debug_flags_set("wq");
+
+	struct work_queue *q = work_queue_create(0);
+	if(!q) return 1;
+
+	FILE *f = fopen("master.port", "w");
+	fprintf(f, "%d\n", work_queue_port(q));
+	fclose(f);
+
+	int i, j;
+	for(i = 0; i < 2; i++) {
+		char output[64];
+		sprintf(output, "datalinks.output.%d", i);
+
+		struct work_queue_task *t = work_queue_task_create("cat file.* dir/file.* | sort | md5sum > out; wc -c < large >> out");
+		work_queue_task_specify_file(t, output, "out", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE);
+
+		for(j = 1; j <= 40; j++) {
+			char name[64];
+			sprintf(name, "file.%d", j);
+
+			char local[64];
+			sprintf(local, "datalinks.input/%s", name);
+
+			work_queue_task_specify_file(t, local, name, WORK_QUEUE_INPUT, j % 2 ? WORK_QUEUE_CACHE : WORK_QUEUE_NOCACHE);
+		}
+
+		work_queue_task_specify_directory(t, "datalinks.input/dir", "dir", WORK_QUEUE_INPUT, WORK_QUEUE_CACHE, 1);
+		work_queue_task_specify_file(t, "datalinks.input/large", "large", WORK_QUEUE_INPUT, WORK_QUEUE_NOCACHE);
+
+		work_queue_submit(q, t);
+	}
+
+	while(!work_queue_empty(q)) {
+		struct work_queue_task *t = work_queue_wait(q, 5);
+		if(t) {
+			printf("task %d: result %d, exit %d\n", t->taskid, t->result, t->return_status);
+			if(t->result != WORK_QUEUE_RESULT_SUCCESS || t->return_status != 0) return 1;
+			work_queue_task_delete(t);
+		}
+	}
+
+	work_queue_delete(q);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" &
+	wait_for_file_creation master.port 5
+
+	work_queue_worker localhost `cat master.port` --timeout 10 --single-shot --data-links 4 > /dev/null
+
+	wait $! || return 1
+
+	expected=`cat datalinks.input/file.* datalinks.input/dir/file.* | sort | md5sum; echo 4194304`
+	for i in 0 1
+	do
+		if [ "`cat datalinks.output.$i`" != "$expected" ]
+		then
+			echo "task $i did not receive its inputs"
+			return 1
+		fi
+	done
+
+	# the inputs were staged on the data links, at least for the second task,
+	# as the first one may be sent before all the links are connected.
+	grep "tx to .*: batch" master.log || return 1
+	grep "staging [0-9]* files on 4 data links" master.log || return 1
+
+	return 0
+}
+
+clean()
+{
+	rm -rf "$exe" datalinks.input datalinks.output.* master.port master.log
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
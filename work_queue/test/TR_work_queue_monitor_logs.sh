@@ -0,0 +1,102 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:../../resource_monitor/src:$PATH
+
+exe="work_queue_monitor_logs.test"
+
+prepare()
+{
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libwork_queue.a ../../dttools/src/libdttools.a -lz -lpthread -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "work_queue.h"
+
+/* Run a few tasks with full monitoring, so that their debug and series files are sent back. */
+
+int main(int argc, char *argv[])
+{
+	debug_config_file("master.log");
+	debug_flags_set("wq");
+
+	struct work_queue *q = work_queue_create(0);
+	if(!q) return 1;
+
+	if(!work_queue_enable_monitoring_full(q, "monitor.out")) return 1;
+
+	FILE *f = fopen("master.port", "w");
+	fprintf(f, "%d\n", work_queue_port(q));
+	fclose(f);
+
+	int i;
+	for(i = 0; i < 3; i++) {
+		work_queue_submit(q, work_queue_task_create("sleep 1"));
+	}
+
+	while(!work_queue_empty(q)) {
+		struct work_queue_task *t = work_queue_wait(q, 5);
+		if(t) {
+			if(t->result != WORK_QUEUE_RESULT_SUCCESS || t->return_status != 0) {
+				fprintf(stderr, "task %d: result %d, exit %d\n", t->taskid, t->result, t->return_status);
+				return 1;
+			}
+			work_queue_task_delete(t);
+		}
+	}
+
+	work_queue_delete(q);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" &
+	wait_for_file_creation master.port 5
+
+	work_queue_worker localhost `cat master.port` --timeout 10 --single-shot > /dev/null
+
+	wait $! || return 1
+
+	for log in series debug
+	do
+		count=`ls monitor.out/*.$log.gz | wc -l`
+		if [ "$count" != 3 ]
+		then
+			echo "expected 3 compressed $log files, found $count"
+			return 1
+		fi
+
+		if ls monitor.out/*.$log > /dev/null 2>&1
+		then
+			echo "uncompressed $log files were left behind"
+			return 1
+		fi
+
+		gzip -t monitor.out/*.$log.gz || return 1
+	done
+
+	if ! grep -q "rx from .*: file .*\.series [0-9]* gzip" master.log
+	then
+		echo "the worker did not send compressed series files"
+		return 1
+	fi
+
+	return 0
+}
+
+clean()
+{
+	rm -rf "$exe" monitor.out master.port master.log
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,112 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+export PATH=../src:$PATH
+
+exe="work_queue_sandbox.test"
+
+prepare()
+{
+	rm -rf sandbox.input
+	for d in a b c d
+	do
+		for e in 1 2 3
+		do
+			mkdir -p sandbox.input/$d/$e
+			for f in 1 2 3 4 5 6 7 8 9 10
+			do
+				echo "$d $e $f" > sandbox.input/$d/$e/file.$f
+			done
+		done
+	done
+
+	gcc $CCTOOLS_TEST_CCFLAGS -o "$exe" -x c - -x none -I ../src -I ../../dttools/src ../src/libwork_queue.a ../../dttools/src/libdttools.a -lz -lpthread -lm <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "work_queue.h"
+
+/*
+Place a directory of 120 files into the sandbox of three tasks: cached, not
+cached, and cached but with an output inside of it. Each task counts the
+files it sees.
+*/
+
+int main(int argc, char *argv[])
+{
+	struct work_queue *q = work_queue_create(0);
+	if(!q) return 1;
+
+	FILE *f = fopen("master.port", "w");
+	fprintf(f, "%d\n", work_queue_port(q));
+	fclose(f);
+
+	int i;
+	for(i = 0; i < 3; i++) {
+		struct work_queue_task *t;
+		char output[64];
+		sprintf(output, "sandbox.count.%d", i);
+
+		if(i < 2) {
+			t = work_queue_task_create("find indir -type f | wc -l > count");
+			work_queue_task_specify_file(t, output, "count", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE);
+		} else {
+			t = work_queue_task_create("n=\`find indir -type f | wc -l\`; echo \$n > indir/count");
+			work_queue_task_specify_file(t, output, "indir/count", WORK_QUEUE_OUTPUT, WORK_QUEUE_NOCACHE);
+		}
+
+		work_queue_task_specify_directory(t, "sandbox.input", "indir", WORK_QUEUE_INPUT, i == 1 ? WORK_QUEUE_NOCACHE : WORK_QUEUE_CACHE, 1);
+		work_queue_submit(q, t);
+	}
+
+	while(!work_queue_empty(q)) {
+		struct work_queue_task *t = work_queue_wait(q, 5);
+		if(t) {
+			printf("task %d: result %d, exit %d, sandbox set up in %llu us\n", t->taskid, t->result, t->return_status, (unsigned long long) t->time_workers_sandbox_last);
+			if(t->result != WORK_QUEUE_RESULT_SUCCESS || t->return_status != 0) return 1;
+			work_queue_task_delete(t);
+		}
+	}
+
+	work_queue_delete(q);
+
+	return 0;
+}
+EOF
+	return $?
+}
+
+run()
+{
+	./"$exe" &
+	wait_for_file_creation master.port 5
+
+	work_queue_worker -d all -o worker.log localhost `cat master.port` --timeout 10 --single-shot > /dev/null
+
+	wait $! || return 1
+
+	for i in 0 1 2
+	do
+		count=`cat sandbox.count.$i`
+		if [ "$count" != 120 ]
+		then
+			echo "task $i saw $count files instead of 120"
+			return 1
+		fi
+	done
+
+	grep "set up in" worker.log
+
+	return 0
+}
+
+clean()
+{
+	rm -rf "$exe" sandbox.input sandbox.count.* master.port worker.log
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4: